@@ -1,4 +1,5 @@
 #include "moose-misc-job-manager.h"
+#include "moose-misc-metrics-private.h"
 
 #include <glib.h>
 
@@ -14,65 +15,100 @@ typedef struct _MooseJob {
 
     /* Integer ID of the Job (incrementing up from 0) */
     long id;
+
+    /* The value returned by the callback, valid once finished is set */
+    gpointer result;
+
+    /* True once the job ran */
+    gboolean finished;
+
+    /* Monotonic time in µs when the job was sent */
+    gint64 sent;
+
+    /* Monotonic time in µs when the result is forgotten, if not retrieved before */
+    gint64 expires;
+
+    /* Signaled (with priv->mutex) once finished is set */
+    GCond finish_cond;
+
+    /* Held by the results table, the executing worker and waiters */
+    int refcount;
 } MooseJob;
 
 typedef struct _MooseJobManagerPrivate {
-    /* Pointer to currently executing job */
-    MooseJob *current_job;
+    /* Protects everything below, and the cancel flag of the jobs */
+    GMutex mutex;
 
-    /* Const value used to check for as termination value (with max Priority) */
-    MooseJob terminator;
+    /* Binary min-heap of pending MooseJobs (small prio comes earlier) */
+    GPtrArray *heap;
 
-    /* Mesasge Queue between control and executor */
-    GAsyncQueue *job_queue;
+    /* Signaled when a job was added to the heap or on shutdown */
+    GCond queue_cond;
 
-    /* Thread moose_job_manager_executor runs in */
-    GThread *execute_thread;
+    /* Signaled once the heap is empty and no job is executing anymore */
+    GCond idle_cond;
 
-    /* CondVar that gets signaled on every finished job */
-    GCond finish_cond;
+    /* Threads moose_job_manager_executor runs in */
+    GPtrArray *workers;
+
+    /* Jobs currently executed by a worker */
+    GPtrArray *running;
 
-    /* Mutex that is locked/unlocked with finish_cond */
-    GMutex finish_mutex;
+    /* Number of workers waiting for a job */
+    unsigned n_idle;
 
-    /* Mutex to protect the current job member */
-    GMutex current_job_mutex;
+    /* Set on dispose; workers run the pending jobs and quit */
+    gboolean stopping;
 
-    /* Mutex to protext access to the hash table */
-    GMutex hash_table_mutex;
+    /* Threads in moose_job_manager_wait() or _wait_for_id() */
+    unsigned n_waiters;
 
-    /* A hashtable of the results, with a job id as key and a void* as value */
+    /* Maps job ids to their MooseJob, from send until retrieved or expired */
     GHashTable *results;
 
+    /* Ids of finished jobs in the order they finished (= order of expiry) */
+    GQueue expiry;
+
     /* Job IDs are created by incrementing this counter */
     long job_id_counter;
 
-    /* Mutex to protext job id counter */
-    GMutex job_id_counter_mutex;
+    /* Number of worker threads, see MooseJobManager:workers */
+    unsigned n_workers;
 
-    /* The ID of the most recently finished job (-1 initially) */
-    long last_finished_job;
+    /* Results are forgotten this many ms after the job finished */
+    unsigned result_ttl;
 
-    /* The ID of the most recently send job (-1 initially) */
-    long last_send_job;
+    /* Called on results that are forgotten without being retrieved */
+    GDestroyNotify result_free_func;
 } MooseJobManagerPrivate;
 
 enum { SIGNAL_DISPATCH, NUM_SIGNALS };
 
+enum { PROP_WORKERS = 1, PROP_RESULT_TTL, PROP_N };
+
 static guint SIGNALS[NUM_SIGNALS];
 
 G_DEFINE_TYPE_WITH_PRIVATE(MooseJobManager, moose_job_manager, G_TYPE_OBJECT);
 
 static MooseJob *moose_job_create(MooseJobManager *jm) {
     MooseJob *job = g_new0(MooseJob, 1);
-    g_mutex_lock(&jm->priv->job_id_counter_mutex);
     job->id = (jm->priv->job_id_counter)++;
-    g_mutex_unlock(&jm->priv->job_id_counter_mutex);
+    job->refcount = 1;
+    g_cond_init(&job->finish_cond);
+    return job;
+}
+
+static MooseJob *moose_job_ref(MooseJob *job) {
+    job->refcount++;
     return job;
 }
 
-static void moose_job_free(MooseJob *job) {
-    g_free(job);
+/* All refcounting happens with priv->mutex held */
+static void moose_job_unref(MooseJob *job) {
+    if(--job->refcount == 0) {
+        g_cond_clear(&job->finish_cond);
+        g_free(job);
+    }
 }
 
 static int moose_job_manager_prio_sort_func(gconstpointer a, gconstpointer b,
@@ -99,68 +135,183 @@ static int moose_job_manager_prio_sort_func(gconstpointer a, gconstpointer b,
     return 0;
 }
 
+static void moose_job_manager_heap_push(GPtrArray *heap, MooseJob *job) {
+    unsigned idx = heap->len;
+    g_ptr_array_add(heap, job);
+
+    /* Sift up */
+    while(idx > 0) {
+        unsigned parent = (idx - 1) / 2;
+        if(moose_job_manager_prio_sort_func(g_ptr_array_index(heap, parent), job, NULL) <=
+           0) {
+            break;
+        }
+
+        heap->pdata[idx] = heap->pdata[parent];
+        idx = parent;
+    }
+
+    heap->pdata[idx] = job;
+}
+
+static MooseJob *moose_job_manager_heap_pop(GPtrArray *heap) {
+    if(heap->len == 0) {
+        return NULL;
+    }
+
+    MooseJob *top = g_ptr_array_index(heap, 0);
+    MooseJob *last = g_ptr_array_index(heap, heap->len - 1);
+    g_ptr_array_set_size(heap, heap->len - 1);
+
+    /* Sift down the former last element from the root */
+    unsigned idx = 0, len = heap->len;
+    while(len > 0) {
+        unsigned child = 2 * idx + 1;
+        if(child >= len) {
+            break;
+        }
+
+        if(child + 1 < len &&
+           moose_job_manager_prio_sort_func(g_ptr_array_index(heap, child + 1),
+                                            g_ptr_array_index(heap, child), NULL) < 0) {
+            child++;
+        }
+
+        if(moose_job_manager_prio_sort_func(last, g_ptr_array_index(heap, child), NULL) <=
+           0) {
+            break;
+        }
+
+        heap->pdata[idx] = heap->pdata[child];
+        idx = child;
+    }
+
+    if(len > 0) {
+        heap->pdata[idx] = last;
+    }
+
+    return top;
+}
+
+/* Forget results nobody asked for in time. Called with priv->mutex held. */
+static void moose_job_manager_expire_results(MooseJobManagerPrivate *priv) {
+    gint64 now = g_get_monotonic_time();
+
+    while(!g_queue_is_empty(&priv->expiry)) {
+        gpointer key = g_queue_peek_head(&priv->expiry);
+        MooseJob *job = g_hash_table_lookup(priv->results, key);
+
+        if(job != NULL && (priv->result_ttl == 0 || job->expires > now)) {
+            break;
+        }
+
+        /* Not there anymore if moose_job_manager_get_result() fetched it */
+        g_queue_pop_head(&priv->expiry);
+        if(job != NULL) {
+            moose_metrics_count(MOOSE_METRIC_JOB_EXPIRED, 1);
+            if(priv->result_free_func != NULL && job->result != NULL) {
+                priv->result_free_func(job->result);
+            }
+            g_hash_table_remove(priv->results, key);
+        }
+    }
+}
+
+/* Called with priv->mutex held */
+static void moose_job_manager_finish(MooseJobManagerPrivate *priv, MooseJob *job,
+                                     gpointer result) {
+    job->result = result;
+    job->finished = TRUE;
+
+    /* With no TTL results are kept until retrieved; nothing to expire */
+    if(priv->result_ttl > 0) {
+        job->expires = g_get_monotonic_time() + (gint64)priv->result_ttl * 1000;
+        g_queue_push_tail(&priv->expiry, GINT_TO_POINTER(job->id));
+    }
+    g_cond_broadcast(&job->finish_cond);
+}
+
 static gpointer moose_job_manager_executor(gpointer data) {
-    MooseJob *job;
     MooseJobManager *jm = MOOSE_JOB_MANAGER(data);
     MooseJobManagerPrivate *priv = jm->priv;
 
-    while((job = g_async_queue_pop(jm->priv->job_queue)) != &priv->terminator) {
-        gboolean is_already_canceled = FALSE;
+    g_mutex_lock(&priv->mutex);
 
-        /* Check if the previous job needs to be freed.
-         * Also remember the current one and check if its
-         * already cancelled */
-        g_mutex_lock(&priv->current_job_mutex);
-        {
-            /* Free previous job (last job is freed in moose_job_manager_unref() */
-            if(priv->current_job != NULL) {
-                moose_job_free(priv->current_job);
-            }
+    for(;;) {
+        MooseJob *job = NULL;
+
+        priv->n_idle++;
+        while(priv->stopping == FALSE && priv->heap->len == 0) {
+            g_cond_wait(&priv->queue_cond, &priv->mutex);
+        }
+        priv->n_idle--;
+
+        /* On shutdown the pending jobs are still run */
+        if(priv->heap->len == 0) {
+            break;
+        }
+
+        job = moose_job_manager_heap_pop(priv->heap);
+        g_ptr_array_add(priv->running, job);
 
-            priv->current_job = job;
-            is_already_canceled = job->cancel;
-            g_mutex_unlock(&priv->current_job_mutex);
+        gboolean is_already_canceled = job->cancel;
+        void *item = NULL;
+
+        g_mutex_unlock(&priv->mutex);
+        {
+            gint64 started = g_get_monotonic_time();
+            moose_metrics_record(MOOSE_METRIC_JOB_WAIT, started - job->sent);
 
             /* Do actual job */
             if(is_already_canceled == FALSE) {
-                void *item = NULL;
-
                 g_object_ref(jm);
                 {
                     g_signal_emit(jm, SIGNALS[SIGNAL_DISPATCH], 0, &job->cancel,
                                   job->job_data, &item);
                 }
                 g_object_unref(jm);
-
-                g_mutex_lock(&priv->hash_table_mutex);
-                { g_hash_table_insert(priv->results, GINT_TO_POINTER(job->id), item); }
-                g_mutex_unlock(&priv->hash_table_mutex);
+                moose_metrics_record_since(MOOSE_METRIC_JOB_RUN, started);
             }
         }
+        g_mutex_lock(&priv->mutex);
 
-        /* Signal that a job was finished */
-        g_mutex_lock(&priv->finish_mutex);
-        {
-            priv->last_finished_job = job->id;
-            g_cond_broadcast(&priv->finish_cond);
+        g_ptr_array_remove_fast(priv->running, job);
+        moose_job_manager_finish(priv, job, item);
+        moose_job_manager_expire_results(priv);
+        moose_job_unref(job);
+
+        if(priv->heap->len == 0 && priv->running->len == 0) {
+            g_cond_broadcast(&priv->idle_cond);
         }
-        g_mutex_unlock(&priv->finish_mutex);
     }
 
+    g_mutex_unlock(&priv->mutex);
     return NULL;
 }
 
+/* Called with priv->mutex held; dispose waits for the last waiter to leave */
+static void moose_job_manager_leave_wait(MooseJobManagerPrivate *priv) {
+    if(--priv->n_waiters == 0 && priv->stopping) {
+        g_cond_broadcast(&priv->idle_cond);
+    }
+}
+
 MooseJobManager *moose_job_manager_new(void) {
     return g_object_new(MOOSE_TYPE_JOB_MANAGER, NULL);
 }
 
+MooseJobManager *moose_job_manager_new_full(unsigned n_workers, unsigned result_ttl) {
+    return g_object_new(MOOSE_TYPE_JOB_MANAGER, "workers", n_workers, "result-ttl",
+                        result_ttl, NULL);
+}
+
 gboolean moose_job_manager_check_cancel(MooseJobManager *jm, volatile gboolean *cancel) {
     gboolean rc = FALSE;
 
     if(jm && cancel) {
-        g_mutex_lock(&jm->priv->current_job_mutex);
+        g_mutex_lock(&jm->priv->mutex);
         { rc = *cancel; }
-        g_mutex_unlock(&jm->priv->current_job_mutex);
+        g_mutex_unlock(&jm->priv->mutex);
     }
 
     return rc;
@@ -172,32 +323,38 @@ long moose_job_manager_send(MooseJobManager *jm, int priority, gpointer job_data
     }
 
     MooseJobManagerPrivate *priv = jm->priv;
+    long job_id = -1;
 
-    /* Create a new job, with a unique job-id */
-    MooseJob *job = moose_job_create(jm);
-    job->priority = priority;
-    job->job_data = job_data;
-
-    /* Lock the current job structure, since it gets read in the main thread */
-    g_mutex_lock(&priv->current_job_mutex);
+    g_mutex_lock(&priv->mutex);
     {
-        if(priv->current_job != NULL) {
-            if(priv->current_job->priority > priority) {
-                priv->current_job->cancel = TRUE;
+        /* Create a new job, with a unique job-id */
+        MooseJob *job = moose_job_create(jm);
+        job->priority = priority;
+        job->job_data = job_data;
+        job->sent = g_get_monotonic_time();
+        job_id = job->id;
+
+        /* If no worker is free, make room by cancelling less important jobs */
+        if(priv->n_idle <= priv->heap->len) {
+            for(unsigned i = 0; i < priv->running->len; ++i) {
+                MooseJob *running = g_ptr_array_index(priv->running, i);
+                if(running->priority > priority) {
+                    running->cancel = TRUE;
+                }
             }
         }
 
-        /* Remember the last sended job */
-        priv->last_send_job = job->id;
-    }
-    g_mutex_unlock(&priv->current_job_mutex);
+        moose_job_manager_expire_results(priv);
+        g_hash_table_insert(priv->results, GINT_TO_POINTER(job_id), job);
 
-    /* Push the item sorted with priority (small prio comes earlier) */
-    g_async_queue_push_sorted(priv->job_queue, job, moose_job_manager_prio_sort_func,
-                              NULL);
+        /* Push the item sorted with priority (small prio comes earlier) */
+        moose_job_manager_heap_push(priv->heap, moose_job_ref(job));
+        g_cond_signal(&priv->queue_cond);
+    }
+    g_mutex_unlock(&priv->mutex);
 
     /* Return the Job ID, so users can get the result later */
-    return job->id;
+    return job_id;
 }
 
 void moose_job_manager_wait(MooseJobManager *jm) {
@@ -207,19 +364,17 @@ void moose_job_manager_wait(MooseJobManager *jm) {
 
     MooseJobManagerPrivate *priv = jm->priv;
 
-    g_mutex_lock(&priv->finish_mutex);
+    g_mutex_lock(&priv->mutex);
     {
-        for(;;) {
-            /* If there are no jobs in the Queue we can
-             * expect that we're finished for now */
-            if(g_async_queue_length(priv->job_queue) <= 0) {
-                break;
-            } else {
-                g_cond_wait(&priv->finish_cond, &priv->finish_mutex);
-            }
+        /* If there are no jobs in the Queue and none is executed
+         * we can expect that we're finished for now */
+        priv->n_waiters++;
+        while(priv->heap->len > 0 || priv->running->len > 0) {
+            g_cond_wait(&priv->idle_cond, &priv->mutex);
         }
+        moose_job_manager_leave_wait(priv);
     }
-    g_mutex_unlock(&priv->finish_mutex);
+    g_mutex_unlock(&priv->mutex);
 }
 
 void moose_job_manager_wait_for_id(MooseJobManager *jm, int job_id) {
@@ -230,78 +385,159 @@ void moose_job_manager_wait_for_id(MooseJobManager *jm, int job_id) {
 
     MooseJobManagerPrivate *priv = jm->priv;
 
-    if(job_id > priv->last_send_job) {
-        /* Was not sended yet, also no need to wait */
-        return;
-    }
-
-    gboolean has_key = FALSE;
-
-    /* Lookup if the results hash table already has this key */
-    g_mutex_lock(&priv->hash_table_mutex);
-    { has_key = g_hash_table_contains(priv->results, GINT_TO_POINTER(job_id)); }
-    g_mutex_unlock(&priv->hash_table_mutex);
-
-    if(has_key == TRUE) {
-        /* Result was already computed */
-        return;
-    }
-
-    /* Otherwise wait till we get notified upon execution */
-    g_mutex_lock(&priv->finish_mutex);
+    g_mutex_lock(&priv->mutex);
     {
-        for(;;) {
-            if(priv->last_finished_job == job_id) {
-                break;
-            } else {
-                g_cond_wait(&priv->finish_cond, &priv->finish_mutex);
+        /* Not known if it was not sended yet, retrieved already or expired */
+        MooseJob *job = g_hash_table_lookup(priv->results, GINT_TO_POINTER(job_id));
+
+        if(job != NULL) {
+            priv->n_waiters++;
+            moose_job_ref(job);
+            while(job->finished == FALSE) {
+                g_cond_wait(&job->finish_cond, &priv->mutex);
             }
+            moose_job_unref(job);
+            moose_job_manager_leave_wait(priv);
         }
     }
-    g_mutex_unlock(&priv->finish_mutex);
+    g_mutex_unlock(&priv->mutex);
 }
 
 void *moose_job_manager_get_result(MooseJobManager *jm, int job_id) {
     void *result = NULL;
 
     if(jm != NULL) {
-        /* Lock the hashtable and lookup the result */
-        g_mutex_lock(&jm->priv->hash_table_mutex);
-        { result = g_hash_table_lookup(jm->priv->results, GINT_TO_POINTER(job_id)); }
-        g_mutex_unlock(&jm->priv->hash_table_mutex);
+        MooseJobManagerPrivate *priv = jm->priv;
+
+        /* Lock the table and lookup the result; it's handed out only once */
+        g_mutex_lock(&priv->mutex);
+        {
+            MooseJob *job = g_hash_table_lookup(priv->results, GINT_TO_POINTER(job_id));
+            if(job != NULL && job->finished) {
+                result = job->result;
+                g_hash_table_remove(priv->results, GINT_TO_POINTER(job_id));
+            }
+        }
+        g_mutex_unlock(&priv->mutex);
     }
 
     return result;
 }
 
+void moose_job_manager_set_result_free_func(MooseJobManager *jm,
+                                            GDestroyNotify free_func) {
+    if(jm != NULL) {
+        g_mutex_lock(&jm->priv->mutex);
+        { jm->priv->result_free_func = free_func; }
+        g_mutex_unlock(&jm->priv->mutex);
+    }
+}
+
 void moose_job_manager_unref(MooseJobManager *jm) {
     if(jm != NULL) {
         g_object_unref(jm);
     }
 }
 
-static void moose_job_manager_finalize(GObject *gobject) {
+static void moose_job_manager_get_property(GObject *object,
+                                           guint property_id,
+                                           GValue *value,
+                                           GParamSpec *pspec) {
+    MooseJobManagerPrivate *priv = MOOSE_JOB_MANAGER(object)->priv;
+
+    switch(property_id) {
+    case PROP_WORKERS:
+        g_value_set_uint(value, priv->n_workers);
+        break;
+    case PROP_RESULT_TTL:
+        g_value_set_uint(value, priv->result_ttl);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+        break;
+    }
+}
+
+static void moose_job_manager_set_property(GObject *object,
+                                           guint property_id,
+                                           const GValue *value,
+                                           GParamSpec *pspec) {
+    MooseJobManagerPrivate *priv = MOOSE_JOB_MANAGER(object)->priv;
+
+    switch(property_id) {
+    case PROP_WORKERS:
+        priv->n_workers = g_value_get_uint(value);
+        break;
+    case PROP_RESULT_TTL:
+        g_mutex_lock(&priv->mutex);
+        { priv->result_ttl = g_value_get_uint(value); }
+        g_mutex_unlock(&priv->mutex);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+        break;
+    }
+}
+
+static void moose_job_manager_dispose(GObject *gobject) {
     MooseJobManager *self = MOOSE_JOB_MANAGER(gobject);
     MooseJobManagerPrivate *priv = self->priv;
 
-    /* Send a terminating job to the Queue and wait for it finish */
-    g_async_queue_push(priv->job_queue, (gpointer)&priv->terminator);
-    g_thread_join(priv->execute_thread);
+    /* Run the pending jobs while the dispatch handlers are still connected,
+     * so their job_data is consumed and all waiters see them finished. */
+    g_mutex_lock(&priv->mutex);
+    {
+        priv->stopping = TRUE;
+        g_cond_broadcast(&priv->queue_cond);
+    }
+    g_mutex_unlock(&priv->mutex);
 
-    /* Free ressources */
-    g_async_queue_unref(priv->job_queue);
+    /* dispose may run more than once; the workers are joined only the first time */
+    for(unsigned i = 0; i < priv->workers->len; ++i) {
+        g_thread_join(g_ptr_array_index(priv->workers, i));
+    }
+    g_ptr_array_set_size(priv->workers, 0);
+
+    /* Do not free the mutex under threads that still wake up from waiting */
+    g_mutex_lock(&priv->mutex);
+    {
+        while(priv->n_waiters > 0) {
+            g_cond_wait(&priv->idle_cond, &priv->mutex);
+        }
+    }
+    g_mutex_unlock(&priv->mutex);
+
+    G_OBJECT_CLASS(g_type_class_peek_parent(G_OBJECT_GET_CLASS(self)))->dispose(gobject);
+}
 
-    g_cond_clear(&priv->finish_cond);
-    g_mutex_clear(&priv->finish_mutex);
-    g_mutex_clear(&priv->current_job_mutex);
-    g_mutex_clear(&priv->hash_table_mutex);
-    g_mutex_clear(&priv->job_id_counter_mutex);
+static void moose_job_manager_finalize(GObject *gobject) {
+    MooseJobManager *self = MOOSE_JOB_MANAGER(gobject);
+    MooseJobManagerPrivate *priv = self->priv;
+
+    /* Results nobody retrieved */
+    if(priv->result_free_func != NULL) {
+        GHashTableIter iter;
+        gpointer value = NULL;
 
-    if(priv->current_job != NULL) {
-        moose_job_free(priv->current_job);
+        g_hash_table_iter_init(&iter, priv->results);
+        while(g_hash_table_iter_next(&iter, NULL, &value)) {
+            MooseJob *job = value;
+            if(job->finished && job->result != NULL) {
+                priv->result_free_func(job->result);
+            }
+        }
     }
 
+    /* Free ressources */
+    g_ptr_array_free(priv->workers, TRUE);
+    g_ptr_array_free(priv->running, TRUE);
+    g_ptr_array_free(priv->heap, TRUE);
     g_hash_table_destroy(priv->results);
+    g_queue_clear(&priv->expiry);
+
+    g_cond_clear(&priv->queue_cond);
+    g_cond_clear(&priv->idle_cond);
+    g_mutex_clear(&priv->mutex);
 
     /* Always chain up to the parent class; as with dispose(), finalize()
      * is guaranteed to exist on the parent's class virtual function table
@@ -309,9 +545,27 @@ static void moose_job_manager_finalize(GObject *gobject) {
     G_OBJECT_CLASS(g_type_class_peek_parent(G_OBJECT_GET_CLASS(self)))->finalize(gobject);
 }
 
+static void moose_job_manager_constructed(GObject *object) {
+    MooseJobManager *self = MOOSE_JOB_MANAGER(object);
+    MooseJobManagerPrivate *priv = self->priv;
+
+    G_OBJECT_CLASS(g_type_class_peek_parent(G_OBJECT_GET_CLASS(self)))
+        ->constructed(object);
+
+    /* Keep the threads running in the background */
+    for(unsigned i = 0; i < priv->n_workers; ++i) {
+        g_ptr_array_add(priv->workers, g_thread_new("job-execute-thread",
+                                                    moose_job_manager_executor, self));
+    }
+}
+
 static void moose_job_manager_class_init(MooseJobManagerClass *klass) {
     GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+    gobject_class->dispose = moose_job_manager_dispose;
     gobject_class->finalize = moose_job_manager_finalize;
+    gobject_class->constructed = moose_job_manager_constructed;
+    gobject_class->get_property = moose_job_manager_get_property;
+    gobject_class->set_property = moose_job_manager_set_property;
 
     /**
      * MooseJobManager:dispatch:
@@ -319,6 +573,7 @@ static void moose_job_manager_class_init(MooseJobManagerClass *klass) {
      * @job_data: (transfer none): pointer to passed job data.
      *
      * Emitted once the job is supposed to run.
+     * With more than one worker this happens in several threads at once.
      *
      * Returns: (transfer none): The result of the job.
      */
@@ -333,6 +588,38 @@ static void moose_job_manager_class_init(MooseJobManagerClass *klass) {
                                             2 /* n_params */,
                                             G_TYPE_POINTER,
                                             G_TYPE_POINTER);
+
+    GParamSpec *pspec = NULL;
+    pspec = g_param_spec_uint("workers",
+                              "Workers",
+                              "Number of threads executing jobs",
+                              1, 64,
+                              1, /* default value */
+                              G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+
+    /**
+     * MooseJobManager:workers: (type guint)
+     *
+     * Number of jobs that may run at the same time.
+     * With a single worker jobs run strictly in the order of their priority.
+     */
+    g_object_class_install_property(gobject_class, PROP_WORKERS, pspec);
+
+    pspec = g_param_spec_uint("result-ttl",
+                              "Result TTL",
+                              "Milliseconds to keep results that were not retrieved",
+                              0, G_MAXUINT,
+                              MOOSE_JOB_MANAGER_RESULT_TTL, /* default value */
+                              G_PARAM_READWRITE | G_PARAM_CONSTRUCT);
+
+    /**
+     * MooseJobManager:result-ttl: (type guint)
+     *
+     * A result is kept until moose_job_manager_get_result() was called
+     * for it, or until this many milliseconds passed since the job finished.
+     * 0 keeps it until it is retrieved.
+     */
+    g_object_class_install_property(gobject_class, PROP_RESULT_TTL, pspec);
 }
 
 static void moose_job_manager_init(MooseJobManager *self) {
@@ -340,22 +627,17 @@ static void moose_job_manager_init(MooseJobManager *self) {
         moose_job_manager_get_instance_private(self);
 
     /* Initialize Synchronisation Primitives */
-    g_cond_init(&priv->finish_cond);
-    g_mutex_init(&priv->finish_mutex);
-    g_mutex_init(&priv->current_job_mutex);
-    g_mutex_init(&priv->hash_table_mutex);
-    g_mutex_init(&priv->job_id_counter_mutex);
-
-    /* Save arguments */
-    priv->job_queue = g_async_queue_new();
-    priv->terminator.priority = -INT_MAX;
-    priv->results = g_hash_table_new(g_direct_hash, g_direct_equal);
-
-    /* Job ids */
-    priv->last_finished_job = -1;
-    priv->last_send_job = -1;
-
-    /* Keep the thread running in the background */
-    priv->execute_thread =
-        g_thread_new("job-execute-thread", moose_job_manager_executor, self);
+    g_mutex_init(&priv->mutex);
+    g_cond_init(&priv->queue_cond);
+    g_cond_init(&priv->idle_cond);
+
+    priv->heap = g_ptr_array_new();
+    priv->running = g_ptr_array_new();
+    priv->workers = g_ptr_array_new();
+    priv->results = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+                                          (GDestroyNotify)moose_job_unref);
+    g_queue_init(&priv->expiry);
+
+    priv->n_workers = 1;
+    priv->result_ttl = MOOSE_JOB_MANAGER_RESULT_TTL;
 }
@@ -10,6 +10,13 @@
 
 G_BEGIN_DECLS
 
+/**
+ * MOOSE_JOB_MANAGER_RESULT_TTL:
+ *
+ * Default of #MooseJobManager:result-ttl in milliseconds.
+ */
+#define MOOSE_JOB_MANAGER_RESULT_TTL (60 * 1000)
+
 /*
  * Type macros.
  */
@@ -46,6 +53,18 @@ typedef struct _MooseJobManagerClass { GObjectClass parent; } MooseJobManagerCla
  */
 MooseJobManager *moose_job_manager_new(void);
 
+/**
+ * moose_job_manager_new_full:
+ * @n_workers: Number of threads executing jobs, see #MooseJobManager:workers
+ * @result_ttl: ms to keep unretrieved results, see #MooseJobManager:result-ttl
+ *
+ * Create a new JobManger instance.
+ *
+ * Returns: a newly allocated MooseJobManager, pass to moose_job_manager_unref() when
+ *done.
+ */
+MooseJobManager *moose_job_manager_new_full(unsigned n_workers, unsigned result_ttl);
+
 /**
  * moose_job_manager_check_cancel:
  * @jm: a #MooseJobManager
@@ -76,7 +95,7 @@ long moose_job_manager_send(MooseJobManager *jm, int priority, void *user_data);
  * moose_job_manager_wait:
  * @jm: a #MooseJobManager
  *
- * Blocks until the internal Queue is empty. (== No jobs currently processed)
+ * Blocks until the internal Queue is empty and no job is processed anymore.
  */
 void moose_job_manager_wait(MooseJobManager *jm);
 
@@ -94,22 +113,37 @@ void moose_job_manager_wait_for_id(MooseJobManager *jm, int job_id);
  * @jm: a #MooseJobManager
  * @job_id: Id of the job, obtained from moose_job_manager_send()
  *
- * Get the result of a job.
+ * Get the result of a job. It is forgotten afterwards, so this
+ * works only once for each job.
  * Note: NULL might be returned either if you really returned NULL,
- *       or if the result is not computed yet!
+ *       if the result is not computed yet, or was forgotten already
+ *       after #MooseJobManager:result-ttl.
  *
  * Returns: (transfer none): the void * pointer returned by your callback.
  */
 void *moose_job_manager_get_result(MooseJobManager *jm, int job_id);
 
+/**
+ * moose_job_manager_set_result_free_func:
+ * @jm: a #MooseJobManager
+ * @free_func: (nullable): called on results that are forgotten without being
+ *             retrieved, i.e. after #MooseJobManager:result-ttl or on unref.
+ *
+ * Set this if the results of your callback own memory. Results handed out
+ * by moose_job_manager_get_result() are never passed to it.
+ */
+void moose_job_manager_set_result_free_func(MooseJobManager *jm,
+                                            GDestroyNotify free_func);
+
 /**
  * moose_job_manager_unref:
  * @jm: a #MooseJobManager
  *
  * Free all data associated with this Job Manager.
  *
- * Note: This will send a termination job, with highest priority.
- *       Call moose_job_manager_wait() before if you want to wait for the jobs to finish.
+ * Note: All jobs sent before are still run, so their job_data is passed to
+ *       the dispatch handlers and threads waiting for them return.
+ *       Never call this from a dispatch handler.
  */
 void moose_job_manager_unref(MooseJobManager *jm);
 
@@ -0,0 +1,62 @@
+#ifndef MOOSE_MISC_METRICS_PRIVATE_H
+#define MOOSE_MISC_METRICS_PRIVATE_H
+
+#include "moose-misc-metrics.h"
+
+G_BEGIN_DECLS
+
+/*
+ * All metrics known to moose_metrics_snapshot().
+ * The names are given in moose-misc-metrics.c; durations are in µs.
+ */
+typedef enum {
+    /* Latencies */
+    MOOSE_METRIC_JOB_WAIT,          /* Time a job spent in the queue */
+    MOOSE_METRIC_JOB_RUN,           /* Time a job was executed */
+    MOOSE_METRIC_CLIENT_ROUNDTRIP,  /* Uncached command sent via moose_client_cache_run */
+    MOOSE_METRIC_CLIENT_COMMAND,    /* Handling of a command sent by the user */
+    MOOSE_METRIC_STORE_LISTALLINFO, /* Fetching and indexing the whole database */
+    MOOSE_METRIC_STORE_PLCHANGES,   /* Fetching the changes of the queue */
+    MOOSE_METRIC_STORE_QUERY,       /* Full text search in the store */
+
+    /* Counters */
+    MOOSE_METRIC_JOB_EXPIRED,    /* Results dropped since nobody fetched them */
+    MOOSE_METRIC_CLIENT_EVENTS,  /* Idle events received from the server */
+    MOOSE_METRIC_STORE_SONGS,    /* Songs read by listallinfo */
+    MOOSE_METRIC_N
+} MooseMetric;
+
+/* Metrics before this one are histograms, the others counters */
+#define MOOSE_METRIC_FIRST_COUNTER MOOSE_METRIC_JOB_EXPIRED
+
+/**
+ * moose_metrics_record: skip:
+ * @metric: a latency metric
+ * @usec: the measured duration in µs, usually the difference of two
+ *        g_get_monotonic_time() calls.
+ *
+ * Add a sample to the histogram of @metric. Lock free, callable from any thread.
+ */
+void moose_metrics_record(MooseMetric metric, gint64 usec);
+
+/**
+ * moose_metrics_record_since: skip:
+ * @metric: a latency metric
+ * @start: g_get_monotonic_time() when the measured operation began.
+ *
+ * Same as moose_metrics_record(metric, g_get_monotonic_time() - start).
+ */
+void moose_metrics_record_since(MooseMetric metric, gint64 start);
+
+/**
+ * moose_metrics_count: skip:
+ * @metric: a counter metric
+ * @n: value to add
+ *
+ * Lock free, callable from any thread.
+ */
+void moose_metrics_count(MooseMetric metric, gsize n);
+
+G_END_DECLS
+
+#endif /* end of include guard: MOOSE_MISC_METRICS_PRIVATE_H */
@@ -0,0 +1,139 @@
+#include "moose-misc-metrics-private.h"
+
+/* Bucket i holds samples in [2^(i-1), 2^i) µs; the last one everything above */
+#define MOOSE_METRICS_BUCKETS 40
+
+typedef struct {
+    /* All members are updated with g_atomic_pointer_add() only */
+    volatile gsize buckets[MOOSE_METRICS_BUCKETS];
+    volatile gsize sum;
+} MooseMetricsHistogram;
+
+static const char *MOOSE_METRIC_NAMES[] = {
+    [MOOSE_METRIC_JOB_WAIT] = "job.wait",
+    [MOOSE_METRIC_JOB_RUN] = "job.run",
+    [MOOSE_METRIC_CLIENT_ROUNDTRIP] = "client.roundtrip",
+    [MOOSE_METRIC_CLIENT_COMMAND] = "client.command",
+    [MOOSE_METRIC_STORE_LISTALLINFO] = "store.listallinfo",
+    [MOOSE_METRIC_STORE_PLCHANGES] = "store.plchanges",
+    [MOOSE_METRIC_STORE_QUERY] = "store.query",
+    [MOOSE_METRIC_JOB_EXPIRED] = "job.expired",
+    [MOOSE_METRIC_CLIENT_EVENTS] = "client.events",
+    [MOOSE_METRIC_STORE_SONGS] = "store.songs"};
+
+G_STATIC_ASSERT(G_N_ELEMENTS(MOOSE_METRIC_NAMES) == MOOSE_METRIC_N);
+
+static MooseMetricsHistogram HISTOGRAMS[MOOSE_METRIC_FIRST_COUNTER];
+static volatile gsize COUNTERS[MOOSE_METRIC_N - MOOSE_METRIC_FIRST_COUNTER];
+
+void moose_metrics_record(MooseMetric metric, gint64 usec) {
+    g_assert(metric < MOOSE_METRIC_FIRST_COUNTER);
+
+    MooseMetricsHistogram *histogram = &HISTOGRAMS[metric];
+    unsigned bucket = (usec > 0) ? g_bit_storage((gsize)usec) : 0;
+
+    g_atomic_pointer_add(&histogram->buckets[MIN(bucket, MOOSE_METRICS_BUCKETS - 1)], 1);
+    g_atomic_pointer_add(&histogram->sum, MAX(usec, 0));
+}
+
+void moose_metrics_record_since(MooseMetric metric, gint64 start) {
+    moose_metrics_record(metric, g_get_monotonic_time() - start);
+}
+
+void moose_metrics_count(MooseMetric metric, gsize n) {
+    g_assert(MOOSE_METRIC_FIRST_COUNTER <= metric && metric < MOOSE_METRIC_N);
+    g_atomic_pointer_add(&COUNTERS[metric - MOOSE_METRIC_FIRST_COUNTER], n);
+}
+
+/* Upper bound of the bucket holding the sample at percentile (0..100) */
+static guint64 moose_metrics_percentile(const guint64 *buckets, guint64 count,
+                                        unsigned percentile) {
+    guint64 target = MAX((count * percentile + 99) / 100, 1), seen = 0;
+
+    for(unsigned i = 0; i < MOOSE_METRICS_BUCKETS; ++i) {
+        seen += buckets[i];
+        if(seen >= target) {
+            return G_GUINT64_CONSTANT(1) << i;
+        }
+    }
+
+    return 0;
+}
+
+static GVariant *moose_metrics_histogram_snapshot(MooseMetricsHistogram *histogram) {
+    guint64 buckets[MOOSE_METRICS_BUCKETS];
+    guint64 count = 0, max = 0;
+
+    for(unsigned i = 0; i < MOOSE_METRICS_BUCKETS; ++i) {
+        buckets[i] = (gsize)g_atomic_pointer_get(&histogram->buckets[i]);
+        count += buckets[i];
+
+        if(buckets[i] > 0) {
+            max = G_GUINT64_CONSTANT(1) << i;
+        }
+    }
+
+    GVariantBuilder builder;
+    g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+    g_variant_builder_add(&builder, "{sv}", "count", g_variant_new_uint64(count));
+    g_variant_builder_add(
+        &builder, "{sv}", "sum_us",
+        g_variant_new_uint64((gsize)g_atomic_pointer_get(&histogram->sum)));
+
+    if(count > 0) {
+        static const struct {
+            const char *name;
+            unsigned percentile;
+        } PERCENTILES[] = {{"p50_us", 50}, {"p90_us", 90}, {"p99_us", 99}};
+
+        for(unsigned i = 0; i < G_N_ELEMENTS(PERCENTILES); ++i) {
+            guint64 bound =
+                moose_metrics_percentile(buckets, count, PERCENTILES[i].percentile);
+            g_variant_builder_add(&builder, "{sv}", PERCENTILES[i].name,
+                                  g_variant_new_uint64(bound));
+        }
+
+        g_variant_builder_add(&builder, "{sv}", "max_us", g_variant_new_uint64(max));
+    }
+
+    g_variant_builder_add(&builder, "{sv}", "buckets",
+                          g_variant_new_fixed_array(G_VARIANT_TYPE_UINT64, buckets,
+                                                    MOOSE_METRICS_BUCKETS,
+                                                    sizeof(guint64)));
+    return g_variant_builder_end(&builder);
+}
+
+GVariant *moose_metrics_snapshot(void) {
+    GVariantBuilder builder;
+    g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+
+    g_variant_builder_add(&builder, "{sv}", "time_us",
+                          g_variant_new_int64(g_get_monotonic_time()));
+
+    for(unsigned i = 0; i < MOOSE_METRIC_N; ++i) {
+        GVariant *value = NULL;
+        if(i < MOOSE_METRIC_FIRST_COUNTER) {
+            value = moose_metrics_histogram_snapshot(&HISTOGRAMS[i]);
+        } else {
+            value = g_variant_new_uint64(
+                (gsize)g_atomic_pointer_get(&COUNTERS[i - MOOSE_METRIC_FIRST_COUNTER]));
+        }
+
+        g_variant_builder_add(&builder, "{sv}", MOOSE_METRIC_NAMES[i], value);
+    }
+
+    return g_variant_builder_end(&builder);
+}
+
+void moose_metrics_reset(void) {
+    for(unsigned i = 0; i < MOOSE_METRIC_FIRST_COUNTER; ++i) {
+        for(unsigned j = 0; j < MOOSE_METRICS_BUCKETS; ++j) {
+            g_atomic_pointer_set(&HISTOGRAMS[i].buckets[j], 0);
+        }
+        g_atomic_pointer_set(&HISTOGRAMS[i].sum, 0);
+    }
+
+    for(unsigned i = 0; i < G_N_ELEMENTS(COUNTERS); ++i) {
+        g_atomic_pointer_set(&COUNTERS[i], 0);
+    }
+}
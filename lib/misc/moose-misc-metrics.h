@@ -0,0 +1,48 @@
+#ifndef MOOSE_MISC_METRICS_H
+#define MOOSE_MISC_METRICS_H
+
+/**
+ * SECTION: moose-misc-metrics
+ * @short_description: Process wide counters and latency histograms.
+ *
+ * libmoosecat measures where its time goes: how long jobs wait and run,
+ * round trips to the server, syncs of the store and searches in it.
+ * The numbers are collected for the whole process, with atomic operations only,
+ * and can be read at any time with moose_metrics_snapshot().
+ */
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * moose_metrics_snapshot:
+ *
+ * Take a copy of all metrics. The result is a dictionary of type "a{sv}",
+ * mapping the name of each metric (e.g. "job.wait", "store.query") to:
+ *
+ * - a "t" with the current value for counters,
+ * - an "a{sv}" for latencies, with "count", "sum_us", "p50_us", "p90_us",
+ *   "p99_us", "max_us" (all "t") and "buckets" ("at").
+ *   Bucket i counts the samples below 2^i µs and not below 2^(i-1) µs;
+ *   percentiles and the maximum are the upper bound of the bucket they fall into.
+ *
+ * Additionally "time_us" ("x") holds g_get_monotonic_time() of the snapshot;
+ * rates (e.g. idle events per second) are the difference of two snapshots
+ * divided by the difference of their "time_us".
+ *
+ * Returns: (transfer full): a floating #GVariant.
+ */
+GVariant *moose_metrics_snapshot(void);
+
+/**
+ * moose_metrics_reset:
+ *
+ * Set all counters and histograms back to zero.
+ * Samples recorded concurrently might survive the reset.
+ */
+void moose_metrics_reset(void);
+
+G_END_DECLS
+
+#endif /* end of include guard: MOOSE_MISC_METRICS_H */
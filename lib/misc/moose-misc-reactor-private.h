@@ -0,0 +1,104 @@
+#ifndef MOOSE_MISC_REACTOR_PRIVATE_H
+#define MOOSE_MISC_REACTOR_PRIVATE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * A single epoll thread shared by everything in the process that waits
+ * on a socket (i.e. the connections of all MooseClients) or needs a
+ * periodic timer (pings). All callbacks run in this one thread, so they
+ * must not block for long - use trylock for locks held while talking to
+ * the server.
+ */
+
+typedef struct _MooseReactor MooseReactor;
+
+/**
+ * MooseReactorFunc: skip:
+ * @reactor: the reactor that dispatched
+ * @id: id of the source, as returned by moose_reactor_add_fd() or _add_timer()
+ * @condition: the events that happened; G_IO_IN for timers.
+ * @user_data: user_data passed on adding
+ *
+ * Returns: FALSE to remove the source.
+ */
+typedef gboolean (*MooseReactorFunc)(MooseReactor *reactor, guint id,
+                                     GIOCondition condition, gpointer user_data);
+
+/**
+ * moose_reactor_ref_default: skip:
+ *
+ * Get the process wide reactor; the thread is started on the first call.
+ *
+ * Returns: (transfer full): the reactor; pass to moose_reactor_unref().
+ */
+MooseReactor *moose_reactor_ref_default(void);
+
+/**
+ * moose_reactor_unref: skip:
+ * @self: a #MooseReactor
+ *
+ * Drop a reference. The thread is joined once the last is gone,
+ * so never call this from a reactor callback.
+ */
+void moose_reactor_unref(MooseReactor *self);
+
+/**
+ * moose_reactor_add_fd: skip:
+ * @self: a #MooseReactor
+ * @fd: the file descriptor to watch; each fd may only be added once.
+ * @condition: G_IO_IN and/or G_IO_OUT; errors and hangups are always reported.
+ * @func: called in the reactor thread once @condition is met.
+ * @user_data: passed to @func
+ *
+ * Returns: the id of the new source, or 0 on error.
+ */
+guint moose_reactor_add_fd(MooseReactor *self, int fd, GIOCondition condition,
+                           MooseReactorFunc func, gpointer user_data);
+
+/**
+ * moose_reactor_modify_fd: skip:
+ * @self: a #MooseReactor
+ * @id: id of a source returned by moose_reactor_add_fd()
+ * @condition: the new events to wait for; 0 pauses the source,
+ *             which then does not report errors and hangups either.
+ *
+ * Unknown ids are ignored.
+ */
+void moose_reactor_modify_fd(MooseReactor *self, guint id, GIOCondition condition);
+
+/**
+ * moose_reactor_add_timer: skip:
+ * @self: a #MooseReactor
+ * @interval_ms: call @func every @interval_ms milliseconds; 0 adds it disarmed.
+ * @func: called in the reactor thread
+ * @user_data: passed to @func
+ *
+ * Returns: the id of the new source, or 0 on error.
+ */
+guint moose_reactor_add_timer(MooseReactor *self, int interval_ms, MooseReactorFunc func,
+                              gpointer user_data);
+
+/**
+ * moose_reactor_set_timer: skip:
+ * @self: a #MooseReactor
+ * @id: id of a source returned by moose_reactor_add_timer()
+ * @interval_ms: the new interval, counting from now; 0 disarms the timer.
+ */
+void moose_reactor_set_timer(MooseReactor *self, guint id, int interval_ms);
+
+/**
+ * moose_reactor_remove: skip:
+ * @self: a #MooseReactor
+ * @id: id of any source; 0 and unknown ids are ignored.
+ *
+ * Remove a source. If its callback is running in the moment this waits
+ * till it is done, so after return it is safe to free the user_data.
+ */
+void moose_reactor_remove(MooseReactor *self, guint id);
+
+G_END_DECLS
+
+#endif /* end of include guard: MOOSE_MISC_REACTOR_PRIVATE_H */
@@ -0,0 +1,425 @@
+#include "moose-misc-reactor-private.h"
+#include "../moose-config.h"
+
+#include <glib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+/* Max. number of events handled per epoll_wait() */
+#define MOOSE_REACTOR_MAX_EVENTS 32
+
+/* epoll data of the wakeup eventfd; source ids start at 1 */
+#define MOOSE_REACTOR_WAKEUP_ID 0
+
+typedef struct _MooseReactorSource {
+    guint id;
+    int fd;
+
+    /* True if fd is a timerfd, which is owned (and closed) by us */
+    gboolean is_timer;
+
+    /* True if fd was taken out of the epoll set by modifying it to 0 */
+    gboolean paused;
+
+    MooseReactorFunc func;
+    gpointer user_data;
+} MooseReactorSource;
+
+struct _MooseReactor {
+    int epoll_fd;
+
+    /* Written to in order to make epoll_wait() return */
+    int wakeup_fd;
+
+    GThread *thread;
+
+    /* Protects everything below */
+    GMutex mutex;
+
+    /* Signalled once a callback returned */
+    GCond dispatched;
+
+    /* Maps ids to MooseReactorSource */
+    GHashTable *sources;
+    guint last_id;
+
+    /* Id of the source whose callback runs at the moment, or 0 */
+    guint dispatching;
+
+    gboolean running;
+    int refcount;
+};
+
+/* There is only one reactor per process */
+G_LOCK_DEFINE_STATIC(DEFAULT_REACTOR);
+static MooseReactor *DEFAULT_REACTOR = NULL;
+
+static const unsigned MAP_IO_EPOLL[][2] = {{G_IO_IN, EPOLLIN},
+                                           {G_IO_PRI, EPOLLPRI},
+                                           {G_IO_OUT, EPOLLOUT},
+                                           {G_IO_ERR, EPOLLERR},
+                                           {G_IO_HUP, EPOLLHUP}};
+
+static uint32_t moose_reactor_gio_to_epoll(GIOCondition condition) {
+    uint32_t events = 0;
+    for(unsigned i = 0; i < G_N_ELEMENTS(MAP_IO_EPOLL); ++i) {
+        if(condition & MAP_IO_EPOLL[i][0]) {
+            events |= MAP_IO_EPOLL[i][1];
+        }
+    }
+    return events;
+}
+
+static GIOCondition moose_reactor_epoll_to_gio(uint32_t events) {
+    unsigned condition = 0;
+    for(unsigned i = 0; i < G_N_ELEMENTS(MAP_IO_EPOLL); ++i) {
+        if(events & MAP_IO_EPOLL[i][1]) {
+            condition |= MAP_IO_EPOLL[i][0];
+        }
+    }
+    return (GIOCondition)condition;
+}
+
+static void moose_reactor_source_free(MooseReactorSource *source) {
+    if(source->is_timer) {
+        close(source->fd);
+    }
+    g_slice_free(MooseReactorSource, source);
+}
+
+/* Must be called with the mutex held */
+static void moose_reactor_source_remove(MooseReactor *self, guint id) {
+    MooseReactorSource *source = g_hash_table_lookup(self->sources, GUINT_TO_POINTER(id));
+    if(source == NULL) {
+        return;
+    }
+
+    if(source->paused == FALSE &&
+       epoll_ctl(self->epoll_fd, EPOLL_CTL_DEL, source->fd, NULL) < 0) {
+        moose_warning("reactor: cannot remove fd %d: %s", source->fd, g_strerror(errno));
+    }
+
+    g_hash_table_remove(self->sources, GUINT_TO_POINTER(id));
+}
+
+static guint moose_reactor_source_add(MooseReactor *self, int fd, gboolean is_timer,
+                                      uint32_t events, MooseReactorFunc func,
+                                      gpointer user_data) {
+    guint id = 0;
+
+    g_mutex_lock(&self->mutex);
+    {
+        MooseReactorSource *source = g_slice_new0(MooseReactorSource);
+        source->id = id = ++self->last_id;
+        source->fd = fd;
+        source->is_timer = is_timer;
+        source->func = func;
+        source->user_data = user_data;
+
+        struct epoll_event event = {.events = events, .data.u32 = id};
+        if(epoll_ctl(self->epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+            moose_critical("reactor: cannot watch fd %d: %s", fd, g_strerror(errno));
+            moose_reactor_source_free(source);
+            id = 0;
+        } else {
+            g_hash_table_insert(self->sources, GUINT_TO_POINTER(id), source);
+        }
+    }
+    g_mutex_unlock(&self->mutex);
+
+    return id;
+}
+
+static void moose_reactor_dispatch(MooseReactor *self, guint id, uint32_t events) {
+    MooseReactorFunc func = NULL;
+    gpointer user_data = NULL;
+
+    g_mutex_lock(&self->mutex);
+    {
+        MooseReactorSource *source =
+            g_hash_table_lookup(self->sources, GUINT_TO_POINTER(id));
+
+        if(source != NULL && source->paused) {
+            /* Paused since epoll_wait() returned */
+            source = NULL;
+        }
+
+        if(source != NULL && source->is_timer) {
+            /* Reset the timerfd; a spurious wakeup means it was re-set meanwhile */
+            uint64_t expirations = 0;
+            if(read(source->fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+                source = NULL;
+            }
+        }
+
+        if(source != NULL) {
+            func = source->func;
+            user_data = source->user_data;
+            self->dispatching = id;
+        }
+    }
+    g_mutex_unlock(&self->mutex);
+
+    if(func == NULL) {
+        /* Removed since epoll_wait() returned */
+        return;
+    }
+
+    gboolean keep = func(self, id, moose_reactor_epoll_to_gio(events), user_data);
+
+    g_mutex_lock(&self->mutex);
+    {
+        if(keep == FALSE) {
+            moose_reactor_source_remove(self, id);
+        }
+
+        self->dispatching = 0;
+        g_cond_broadcast(&self->dispatched);
+    }
+    g_mutex_unlock(&self->mutex);
+}
+
+static gpointer moose_reactor_thread(gpointer user_data) {
+    MooseReactor *self = user_data;
+    struct epoll_event events[MOOSE_REACTOR_MAX_EVENTS];
+
+    while(TRUE) {
+        gboolean running = FALSE;
+        g_mutex_lock(&self->mutex);
+        { running = self->running; }
+        g_mutex_unlock(&self->mutex);
+
+        if(running == FALSE) {
+            break;
+        }
+
+        int n_events = epoll_wait(self->epoll_fd, events, MOOSE_REACTOR_MAX_EVENTS, -1);
+        if(n_events < 0) {
+            if(errno != EINTR) {
+                moose_critical("reactor: epoll_wait failed: %s", g_strerror(errno));
+                break;
+            }
+            continue;
+        }
+
+        for(int i = 0; i < n_events; ++i) {
+            if(events[i].data.u32 == MOOSE_REACTOR_WAKEUP_ID) {
+                uint64_t value = 0;
+                if(read(self->wakeup_fd, &value, sizeof(value)) < 0) {
+                    moose_warning("reactor: cannot read wakeup fd: %s", g_strerror(errno));
+                }
+            } else {
+                moose_reactor_dispatch(self, events[i].data.u32, events[i].events);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static MooseReactor *moose_reactor_new(void) {
+    MooseReactor *self = g_slice_new0(MooseReactor);
+
+    self->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    self->wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if(self->epoll_fd < 0 || self->wakeup_fd < 0) {
+        moose_critical("reactor: cannot create epoll/eventfd: %s", g_strerror(errno));
+    }
+
+    struct epoll_event event = {.events = EPOLLIN, .data.u32 = MOOSE_REACTOR_WAKEUP_ID};
+    if(epoll_ctl(self->epoll_fd, EPOLL_CTL_ADD, self->wakeup_fd, &event) < 0) {
+        moose_critical("reactor: cannot watch wakeup fd: %s", g_strerror(errno));
+    }
+
+    g_mutex_init(&self->mutex);
+    g_cond_init(&self->dispatched);
+    self->sources = g_hash_table_new_full(NULL, NULL, NULL,
+                                          (GDestroyNotify)moose_reactor_source_free);
+    self->running = TRUE;
+    self->refcount = 1;
+    self->thread = g_thread_new("moose-reactor", moose_reactor_thread, self);
+    return self;
+}
+
+static void moose_reactor_free(MooseReactor *self) {
+    g_mutex_lock(&self->mutex);
+    { self->running = FALSE; }
+    g_mutex_unlock(&self->mutex);
+
+    uint64_t value = 1;
+    if(write(self->wakeup_fd, &value, sizeof(value)) < 0) {
+        moose_warning("reactor: cannot wake up: %s", g_strerror(errno));
+    }
+
+    g_thread_join(self->thread);
+
+    if(g_hash_table_size(self->sources) > 0) {
+        moose_warning("reactor: %u sources were not removed",
+                      g_hash_table_size(self->sources));
+    }
+
+    g_hash_table_destroy(self->sources);
+    g_mutex_clear(&self->mutex);
+    g_cond_clear(&self->dispatched);
+    close(self->wakeup_fd);
+    close(self->epoll_fd);
+    g_slice_free(MooseReactor, self);
+}
+
+MooseReactor *moose_reactor_ref_default(void) {
+    MooseReactor *self = NULL;
+
+    G_LOCK(DEFAULT_REACTOR);
+    {
+        if(DEFAULT_REACTOR == NULL) {
+            DEFAULT_REACTOR = moose_reactor_new();
+        } else {
+            DEFAULT_REACTOR->refcount++;
+        }
+        self = DEFAULT_REACTOR;
+    }
+    G_UNLOCK(DEFAULT_REACTOR);
+
+    return self;
+}
+
+void moose_reactor_unref(MooseReactor *self) {
+    if(self == NULL) {
+        return;
+    }
+
+    g_assert(g_thread_self() != self->thread);
+
+    gboolean is_last = FALSE;
+    G_LOCK(DEFAULT_REACTOR);
+    {
+        if(--self->refcount == 0) {
+            is_last = TRUE;
+            if(DEFAULT_REACTOR == self) {
+                DEFAULT_REACTOR = NULL;
+            }
+        }
+    }
+    G_UNLOCK(DEFAULT_REACTOR);
+
+    if(is_last) {
+        moose_reactor_free(self);
+    }
+}
+
+guint moose_reactor_add_fd(MooseReactor *self, int fd, GIOCondition condition,
+                           MooseReactorFunc func, gpointer user_data) {
+    g_assert(self);
+    g_assert(func);
+
+    return moose_reactor_source_add(self, fd, FALSE, moose_reactor_gio_to_epoll(condition),
+                                    func, user_data);
+}
+
+void moose_reactor_modify_fd(MooseReactor *self, guint id, GIOCondition condition) {
+    g_assert(self);
+
+    g_mutex_lock(&self->mutex);
+    {
+        MooseReactorSource *source =
+            g_hash_table_lookup(self->sources, GUINT_TO_POINTER(id));
+
+        if(source != NULL && source->is_timer == FALSE) {
+            struct epoll_event event = {.events = moose_reactor_gio_to_epoll(condition),
+                                        .data.u32 = id};
+
+            /* epoll reports errors and hangups even with no events set,
+             * so a paused fd is taken out of the set altogether */
+            int op = EPOLL_CTL_MOD;
+            if(condition == 0) {
+                op = source->paused ? -1 : EPOLL_CTL_DEL;
+            } else if(source->paused) {
+                op = EPOLL_CTL_ADD;
+            }
+
+            if(op >= 0 && epoll_ctl(self->epoll_fd, op, source->fd, &event) < 0) {
+                moose_warning("reactor: cannot modify fd %d: %s", source->fd,
+                              g_strerror(errno));
+            } else {
+                source->paused = (condition == 0);
+            }
+        }
+    }
+    g_mutex_unlock(&self->mutex);
+}
+
+static void moose_reactor_timerfd_set(int fd, int interval_ms) {
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+
+    spec.it_interval.tv_sec = interval_ms / 1000;
+    spec.it_interval.tv_nsec = (interval_ms % 1000) * 1000 * 1000;
+    spec.it_value = spec.it_interval;
+
+    if(timerfd_settime(fd, 0, &spec, NULL) < 0) {
+        moose_warning("reactor: cannot set timer: %s", g_strerror(errno));
+    }
+}
+
+guint moose_reactor_add_timer(MooseReactor *self, int interval_ms, MooseReactorFunc func,
+                              gpointer user_data) {
+    g_assert(self);
+    g_assert(func);
+
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if(fd < 0) {
+        moose_critical("reactor: cannot create timer: %s", g_strerror(errno));
+        return 0;
+    }
+
+    moose_reactor_timerfd_set(fd, MAX(interval_ms, 0));
+    return moose_reactor_source_add(self, fd, TRUE, EPOLLIN, func, user_data);
+}
+
+void moose_reactor_set_timer(MooseReactor *self, guint id, int interval_ms) {
+    g_assert(self);
+
+    g_mutex_lock(&self->mutex);
+    {
+        MooseReactorSource *source =
+            g_hash_table_lookup(self->sources, GUINT_TO_POINTER(id));
+
+        if(source != NULL && source->paused) {
+            /* Paused since epoll_wait() returned */
+            source = NULL;
+        }
+
+        if(source != NULL && source->is_timer) {
+            moose_reactor_timerfd_set(source->fd, MAX(interval_ms, 0));
+        }
+    }
+    g_mutex_unlock(&self->mutex);
+}
+
+void moose_reactor_remove(MooseReactor *self, guint id) {
+    g_assert(self);
+
+    if(id == 0) {
+        return;
+    }
+
+    g_mutex_lock(&self->mutex);
+    {
+        /* Callbacks may remove themselves, anyone else waits for them */
+        if(g_thread_self() != self->thread) {
+            while(self->dispatching == id) {
+                g_cond_wait(&self->dispatched, &self->mutex);
+            }
+        }
+
+        moose_reactor_source_remove(self, id);
+    }
+    g_mutex_unlock(&self->mutex);
+}
@@ -0,0 +1,52 @@
+#ifndef MOOSE_MISC_TRACE_PRIVATE_H
+#define MOOSE_MISC_TRACE_PRIVATE_H
+
+#include "moose-misc-trace.h"
+
+G_BEGIN_DECLS
+
+/* Non-zero while moose_trace_enable() is in effect; only read it via the macros */
+extern volatile gint MOOSE_TRACE_ENABLED;
+
+/**
+ * moose_trace_begin: skip:
+ *
+ * Start a span, e.g.:
+ *
+ *   gint64 span = moose_trace_begin();
+ *   ...
+ *   moose_trace_end(span, "store", "listallinfo");
+ *
+ * Returns: the start time of the span, or 0 if tracing is disabled.
+ */
+#define moose_trace_begin() (G_UNLIKELY(MOOSE_TRACE_ENABLED) ? g_get_monotonic_time() : 0)
+
+/**
+ * moose_trace_end: skip:
+ * @span: as returned by moose_trace_begin()
+ * @category: a static string naming the component
+ * @name: a static string naming the span; it is not copied.
+ *
+ * Record a span that lasted from @span until now.
+ */
+#define moose_trace_end(span, category, name)                \
+    G_STMT_START {                                           \
+        if(G_UNLIKELY((span) != 0)) {                        \
+            moose_trace_record((span), (category), (name));  \
+        }                                                    \
+    }                                                        \
+    G_STMT_END
+
+/**
+ * moose_trace_record: skip:
+ * @start: g_get_monotonic_time() when the span began.
+ * @category: a static string naming the component
+ * @name: a static string naming the span; it is not copied.
+ *
+ * Use moose_trace_end() instead.
+ */
+void moose_trace_record(gint64 start, const char *category, const char *name);
+
+G_END_DECLS
+
+#endif /* end of include guard: MOOSE_MISC_TRACE_PRIVATE_H */
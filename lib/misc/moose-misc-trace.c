@@ -0,0 +1,99 @@
+#include "moose-misc-trace-private.h"
+
+typedef struct {
+    /* Static strings, see moose_trace_end() */
+    const char *category;
+    const char *name;
+
+    /* Monotonic start time and duration in µs */
+    gint64 start;
+    gint64 duration;
+
+    /* Small number identifying the recording thread */
+    int thread_id;
+} MooseTraceSpan;
+
+volatile gint MOOSE_TRACE_ENABLED = 0;
+
+/* Protects the ring buffer below */
+G_LOCK_DEFINE_STATIC(TRACE);
+
+/* Ring buffer of CAPACITY spans; the next one goes to RECORDED % CAPACITY */
+static MooseTraceSpan *SPANS = NULL;
+static unsigned CAPACITY = 0;
+static guint64 RECORDED = 0;
+
+/* Thread ids are handed out in the order threads record their first span */
+static GPrivate THREAD_ID = G_PRIVATE_INIT(NULL);
+static volatile gint LAST_THREAD_ID = 0;
+
+static int moose_trace_thread_id(void) {
+    int thread_id = GPOINTER_TO_INT(g_private_get(&THREAD_ID));
+    if(thread_id == 0) {
+        thread_id = g_atomic_int_add(&LAST_THREAD_ID, 1) + 1;
+        g_private_set(&THREAD_ID, GINT_TO_POINTER(thread_id));
+    }
+
+    return thread_id;
+}
+
+void moose_trace_enable(unsigned capacity) {
+    G_LOCK(TRACE);
+    {
+        g_free(SPANS);
+        CAPACITY = MAX(capacity, 1);
+        SPANS = g_new0(MooseTraceSpan, CAPACITY);
+        RECORDED = 0;
+    }
+    G_UNLOCK(TRACE);
+
+    g_atomic_int_set(&MOOSE_TRACE_ENABLED, 1);
+}
+
+void moose_trace_disable(void) {
+    g_atomic_int_set(&MOOSE_TRACE_ENABLED, 0);
+}
+
+void moose_trace_record(gint64 start, const char *category, const char *name) {
+    gint64 end = g_get_monotonic_time();
+    int thread_id = moose_trace_thread_id();
+
+    G_LOCK(TRACE);
+    {
+        /* Spans started before moose_trace_disable() still end here */
+        if(SPANS != NULL) {
+            MooseTraceSpan *span = &SPANS[RECORDED++ % CAPACITY];
+            span->category = category;
+            span->name = name;
+            span->start = start;
+            span->duration = end - start;
+            span->thread_id = thread_id;
+        }
+    }
+    G_UNLOCK(TRACE);
+}
+
+char *moose_trace_export_json(void) {
+    GString *json = g_string_new("{\"traceEvents\":[");
+
+    G_LOCK(TRACE);
+    {
+        guint64 first = (RECORDED > CAPACITY) ? RECORDED - CAPACITY : 0;
+
+        for(guint64 i = first; i < RECORDED; ++i) {
+            const MooseTraceSpan *span = &SPANS[i % CAPACITY];
+
+            /* "X" is a complete event: a begin with a duration */
+            g_string_append_printf(json,
+                                   "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+                                   "\"ts\":%" G_GINT64_FORMAT ",\"dur\":%" G_GINT64_FORMAT
+                                   ",\"pid\":1,\"tid\":%d}",
+                                   (i == first) ? "" : ",", span->name, span->category,
+                                   span->start, span->duration, span->thread_id);
+        }
+    }
+    G_UNLOCK(TRACE);
+
+    g_string_append(json, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    return g_string_free(json, FALSE);
+}
@@ -0,0 +1,47 @@
+#ifndef MOOSE_MISC_TRACE_H
+#define MOOSE_MISC_TRACE_H
+
+/**
+ * SECTION: moose-misc-trace
+ * @short_description: Record a timeline of what libmoosecat does.
+ *
+ * Once enabled, store jobs, MPD commands, the phases of database updates,
+ * idle event handling and main loop callbacks are recorded as spans with
+ * their start time, duration and thread in a ring buffer.
+ * Export it with moose_trace_export_json() and open the result in a trace
+ * viewer understanding the Chrome trace event format (chrome://tracing, Perfetto).
+ *
+ * Tracing is off by default; then each span costs a test of a flag
+ * when it begins and a test of the start time when it ends.
+ */
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * moose_trace_enable:
+ * @capacity: number of spans to keep; older ones are overwritten.
+ *
+ * Start recording. Spans recorded before are dropped.
+ */
+void moose_trace_enable(unsigned capacity);
+
+/**
+ * moose_trace_disable:
+ *
+ * Stop recording. The spans recorded so far can still be exported.
+ */
+void moose_trace_disable(void);
+
+/**
+ * moose_trace_export_json:
+ *
+ * Returns: (transfer full): the recorded spans, oldest first, as
+ *          JSON in the Chrome trace event format. Free with g_free().
+ */
+char *moose_trace_export_json(void);
+
+G_END_DECLS
+
+#endif /* end of include guard: MOOSE_MISC_TRACE_H */
@@ -5,6 +5,8 @@
 #include "moose-config.h"
 #include "moose-debug.h"
 #include "misc/moose-misc-zeroconf.h"
+#include "misc/moose-misc-metrics.h"
+#include "misc/moose-misc-trace.h"
 #include "mpd/moose-mpd-client.h"
 #include "store/moose-store.h"
 #include "store/moose-store-query-parser.h"
@@ -46,6 +46,114 @@ gboolean moose_client_check_error_without_handling(MooseClient *self,
 struct mpd_connection *moose_base_connect(MooseClient *self, const char *host, int port,
                                           float timeout, char **err);
 
+/**
+ * MooseClientSongResolver: skip:
+ * @self: the client asking
+ * @song_id: the queue id of the song to look up
+ * @queue_version: the queue version @song_id belongs to
+ * @user_data: data passed to moose_client_set_song_resolver()
+ *
+ * Called from the update thread; must not block for long.
+ *
+ * Returns: a reffed #MooseSong, or NULL if the id is unknown for this
+ * queue version.
+ */
+typedef MooseSong *(*MooseClientSongResolver)(MooseClient *self,
+                                              int song_id,
+                                              unsigned queue_version,
+                                              gpointer user_data);
+
+/**
+ * moose_client_set_song_resolver: skip:
+ * @self: a #MooseClient
+ * @resolver: (nullable): lookup function, NULL to unset.
+ * @user_data: passed to @resolver
+ *
+ * Let the client take the current and next song from somewhere else
+ * (i.e. a #MooseStore) instead of sending currentsong on every player event.
+ * currentsong is still used for ids the resolver returns NULL for.
+ * Once this returns, the previous resolver is not called anymore.
+ */
+void moose_client_set_song_resolver(MooseClient *self,
+                                    MooseClientSongResolver resolver,
+                                    gpointer user_data);
+
+/**
+ * moose_client_connection_lost: skip:
+ * @self: a #MooseClient
+ *
+ * Report that the connection broke, from any thread.
+ * The client disconnects on the mainloop and tries to reconnect to the same
+ * server, waiting 1, 2, 4, ... (at most 32) seconds between the attempts.
+ */
+void moose_client_connection_lost(MooseClient *self);
+
+/**
+ * moose_client_ping: skip:
+ * @self: a #MooseClient
+ *
+ * Queue a "ping" on the command connection, so the server does not close
+ * it. It runs in the client's command thread like any other command, so
+ * this never blocks. Does nothing if the last ping did not run yet.
+ */
+void moose_client_ping(MooseClient *self);
+
+/**
+ * moose_client_send_idle: skip:
+ * @self: a #MooseClient
+ * @async: the async connection to send on
+ * @sent_mask: (out) (nullable): the subscribed mask that was used
+ *
+ * Send "idle" for the subsystems in moose_client_get_idle_mask(),
+ * without waiting for the response. Used by the protocol machines.
+ * The response cache only trusts masks that were sent this way.
+ *
+ * Returns: FALSE on error.
+ */
+gboolean moose_client_send_idle(MooseClient *self, struct mpd_async *async, MooseIdle *sent_mask);
+
+/**
+ * moose_client_cache_run: skip:
+ * @self: a #MooseClient
+ * @conn: a connection from moose_client_get()
+ * @command: a read-only command without arguments, e.g. "listplaylists"
+ *
+ * Send @command and read its response as name/value pairs.
+ * Responses of outputs, listplaylists, stats and replay_gain_status are
+ * kept until an idle event arrives that may change them, repeated calls
+ * are served from this cache without talking to the server.
+ *
+ * Returns: (transfer full): A #GPtrArray alternating names and values,
+ * NULL on error. Do not modify it, it might be shared.
+ */
+GPtrArray *moose_client_cache_run(MooseClient *self, struct mpd_connection *conn,
+                                  const char *command);
+
+/**
+ * moose_client_pairs_lookup: skip:
+ * @pairs: pairs as returned by moose_client_cache_run()
+ * @name: the name to look for
+ *
+ * Returns: the value of the first pair called @name or NULL.
+ */
+const char *moose_client_pairs_lookup(GPtrArray *pairs, const char *name);
+
+/**
+ * gio_to_mpd_async: skip:
+ * @condition: events as reported by a #MooseReactor watch
+ *
+ * Returns: the same events as libmpdclient names them.
+ */
+enum mpd_async_event gio_to_mpd_async(GIOCondition condition);
+
+/**
+ * mpd_async_to_gio: skip:
+ * @events: events as returned by mpd_async_events()
+ *
+ * Returns: the same events to wait for in a #MooseReactor watch.
+ */
+GIOCondition mpd_async_to_gio(enum mpd_async_event events);
+
 G_END_DECLS
 
 #endif /* end of include guard: MOOSE_MPD_CLIENT_PRIVATE_H */
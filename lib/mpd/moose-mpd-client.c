@@ -8,6 +8,8 @@
 #include "moose-song-private.h"
 
 #include "../misc/moose-misc-job-manager.h"
+#include "../misc/moose-misc-metrics-private.h"
+#include "../misc/moose-misc-trace-private.h"
 #include "../moose-config.h"
 
 /* memset() */
@@ -22,7 +24,13 @@
 #define ASSERT_IS_MAINTHREAD(client) \
     g_assert(g_thread_self() == (client)->priv->initial_thread)
 
-enum { SIGNAL_CLIENT_EVENT, SIGNAL_CONNECTIVITY, SIGNAL_LOG_MESSAGE, NUM_SIGNALS };
+enum {
+    SIGNAL_CLIENT_EVENT,
+    SIGNAL_STATUS_CHANGED,
+    SIGNAL_CONNECTIVITY,
+    SIGNAL_LOG_MESSAGE,
+    NUM_SIGNALS
+};
 
 enum {
     PROP_HOST = 1,
@@ -31,6 +39,8 @@ enum {
     PROP_TIMER_INTERVAL,
     PROP_TIMER_TRIGGER_EVENT,
     PROP_TIMER_ONLY_WHEN_PLAYING,
+    PROP_PIPELINE_DEPTH,
+    PROP_RESYNC_INTERVAL,
     PROP_NUMBER
 };
 
@@ -68,6 +78,24 @@ typedef struct _MooseClientPrivate {
         GList *commands;
     } command_list;
 
+    struct {
+        /* Commands that were send, but not executed yet (in order of sending) */
+        GQueue *pending;
+
+        /* Protects pending and the done/result fields of the entries */
+        GMutex mutex;
+
+        /* Max. number of commands that are send in one go */
+        int depth;
+
+        /* True while handlers are writing a pipelined batch.
+         * Only accessed by the job manager's thread. */
+        gboolean is_sending;
+
+        /* True while a keepalive ping waits for execution (atomic) */
+        gint ping_queued;
+    } pipeline;
+
     GAsyncQueue *event_queue;
     GThread *update_thread;
     MooseStatus *status;
@@ -81,6 +109,60 @@ typedef struct _MooseClientPrivate {
         GMutex mutex;
     } status_timer;
 
+    struct {
+        /* Max. seconds between two status updates while playing; 0 disables.
+         * The elapsed time is interpolated in between, this only corrects drift. */
+        float interval;
+        guint timeout_id;
+    } resync;
+
+    struct {
+        /* Pending reconnect attempt after the connection was lost, or 0 */
+        guint timeout_id;
+
+        /* Attempts since the connection was lost; the delay doubles with each */
+        guint attempts;
+    } reconnect;
+
+    struct {
+        /* Looks up songs by id (usually in a MooseStore), may be NULL.
+         * The mutex is held while calling it, so unsetting waits. */
+        MooseClientSongResolver func;
+        gpointer user_data;
+        GMutex mutex;
+    } resolver;
+
+    struct {
+        /* Maps subscription ids to the MooseIdle mask each consumer wants.
+         * Protected by client_attr_mutex. */
+        GHashTable *masks;
+        guint last_id;
+
+        /* The mask of the last "idle" sent to the server, 0 if none (atomic).
+         * Lags behind the masks above until the protocol machine re-idles. */
+        gint idling;
+    } subscriptions;
+
+    struct {
+        /* Maps commands to the name/value pairs of their last response.
+         * An entry lives until an idle event that may change it arrives. */
+        GHashTable *responses;
+
+        /* Incremented on each invalidation; responses that were requested
+         * before are not stored, they might be outdated already. */
+        guint epoch;
+        GMutex mutex;
+    } cache;
+
+    struct {
+        /* Events (and status changes) not yet emitted on the mainloop.
+         * Everything that arrives until the idle source runs is merged. */
+        MooseIdle events;
+        MooseStatusChange changes;
+        guint source_id;
+        GMutex mutex;
+    } dispatch;
+
     /* ID of the last played song or -1
      * Needed to distinguish between
      * MOOSE_IDLE_SEEK and MOOSE_IDLE_PLAYER.
@@ -95,10 +177,18 @@ typedef struct _MooseClientPrivate {
 
 G_DEFINE_ABSTRACT_TYPE_WITH_PRIVATE(MooseClient, moose_client, G_TYPE_OBJECT);
 
+static void moose_client_cache_invalidate(MooseClient *self, MooseIdle events);
+
+/* Arguments of a command, unpacked once on sending */
 typedef struct {
-    MooseClient *self;
-    MooseIdle event;
-} MooseClientEventTag;
+    int ints[3];
+    double number;
+    gboolean flag;
+    char *strings[2];
+} MooseClientArgs;
+
+/* A command waiting for or during execution */
+typedef struct _MooseClientPipelineEntry MooseClientPipelineEntry;
 
 //////////////////////////////////////////////////////////////
 //                                                          //
@@ -106,25 +196,11 @@ typedef struct {
 //                                                          //
 //////////////////////////////////////////////////////////////
 
-static void moose_report_connectivity(MooseClient *self,
-                                      const char *new_host,
-                                      int new_port,
-                                      float new_timeout) {
-    gboolean server_changed;
+static void moose_report_connectivity(MooseClient *self, gboolean server_changed) {
     g_rec_mutex_lock(&self->priv->client_attr_mutex);
     {
-        /* Im weird, sorry. TODO. */
-        server_changed = 1 && self->priv->is_virgin == false &&
-                         ((g_strcmp0(new_host, self->priv->host) != 0) ||
-                          (new_port != self->priv->port));
-
         /* Defloreate the Client (Wheeeh!) */
         self->priv->is_virgin = false;
-
-        g_free(self->priv->host);
-        self->priv->host = g_strdup(new_host);
-        self->priv->port = new_port;
-        self->priv->timeout = new_timeout;
     }
     g_rec_mutex_unlock(&self->priv->client_attr_mutex);
 
@@ -140,11 +216,78 @@ static char *moose_compose_error_msg(const char *topic, const char *src) {
     }
 }
 
-static gboolean moose_client_disconnect_idle(MooseClient *self) {
-    moose_client_disconnect(self);
+/* Seconds between two reconnect attempts: 1, 2, 4, ... up to this */
+#define MOOSE_CLIENT_RECONNECT_MAX_DELAY 32
+
+static void moose_client_reconnect_schedule(MooseClient *self);
+
+static gboolean moose_client_reconnect_cb(gpointer user_data) {
+    MooseClient *self = MOOSE_CLIENT(user_data);
+
+    char *host = NULL;
+    int port = 0;
+    float timeout = 0;
+    gint64 span = moose_trace_begin();
+
+    g_rec_mutex_lock(&self->priv->client_attr_mutex);
+    {
+        self->priv->reconnect.timeout_id = 0;
+        host = g_strdup(self->priv->host);
+        port = self->priv->port;
+        timeout = self->priv->timeout;
+    }
+    g_rec_mutex_unlock(&self->priv->client_attr_mutex);
+
+    moose_message("Trying to reconnect to %s:%d…", host, port);
+    if(moose_client_connect_to(self, host, port, timeout) == FALSE) {
+        moose_client_reconnect_schedule(self);
+    }
+
+    g_free(host);
+    moose_trace_end(span, "mainloop", "reconnect");
+    return FALSE;
+}
+
+static void moose_client_reconnect_schedule(MooseClient *self) {
+    g_rec_mutex_lock(&self->priv->client_attr_mutex);
+    {
+        if(self->priv->reconnect.timeout_id == 0 && self->priv->host != NULL) {
+            guint delay = 1u << MIN(self->priv->reconnect.attempts, 16);
+            self->priv->reconnect.attempts++;
+            self->priv->reconnect.timeout_id = g_timeout_add_seconds(
+                MIN(delay, MOOSE_CLIENT_RECONNECT_MAX_DELAY), moose_client_reconnect_cb, self);
+        }
+    }
+    g_rec_mutex_unlock(&self->priv->client_attr_mutex);
+}
+
+static void moose_client_reconnect_unschedule(MooseClient *self) {
+    g_rec_mutex_lock(&self->priv->client_attr_mutex);
+    {
+        if(self->priv->reconnect.timeout_id != 0) {
+            g_source_remove(self->priv->reconnect.timeout_id);
+            self->priv->reconnect.timeout_id = 0;
+        }
+    }
+    g_rec_mutex_unlock(&self->priv->client_attr_mutex);
+}
+
+static gboolean moose_client_connection_lost_idle(MooseClient *self) {
+    /* Several errors may report the same loss, only the first counts */
+    if(moose_client_is_connected(self)) {
+        moose_client_disconnect(self);
+        moose_client_reconnect_schedule(self);
+    }
+
+    g_object_unref(self);
     return FALSE;
 }
 
+void moose_client_connection_lost(MooseClient *self) {
+    g_assert(self);
+    g_idle_add((GSourceFunc)moose_client_connection_lost_idle, g_object_ref(self));
+}
+
 static gboolean moose_client_check_error_impl(MooseClient *self,
                                               struct mpd_connection *cconn,
                                               gboolean handle_fatal) {
@@ -182,7 +325,7 @@ static gboolean moose_client_check_error_impl(MooseClient *self,
          * than using an invalid connection */
         if(handle_fatal && is_fatal) {
             moose_warning("That was fatal. Disconnecting on mainthread.");
-            g_idle_add((GSourceFunc)moose_client_disconnect_idle, self);
+            moose_client_connection_lost(self);
         }
 
         g_free(error_message);
@@ -201,12 +344,62 @@ gboolean moose_client_check_error_without_handling(MooseClient *self,
     return moose_client_check_error_impl(self, cconn, false);
 }
 
-/* Prototype */
+/* Prototypes */
+static void moose_updata_data_push(MooseClient *self, MooseIdle event,
+                                   gboolean is_status_timer);
 static void *moose_client_command_dispatcher(MooseJobManager *jm,
                                              volatile gboolean *cancel,
                                              void *job_data,
                                              void *user_data);
 
+static gboolean moose_client_resync_cb(gpointer user_data) {
+    MooseClient *self = MOOSE_CLIENT(user_data);
+    if(moose_client_is_connected(self) == false) {
+        return TRUE;
+    }
+
+    gint64 max_age = 0;
+    g_rec_mutex_lock(&self->priv->client_attr_mutex);
+    { max_age = self->priv->resync.interval * 0.9 * G_USEC_PER_SEC; }
+    g_rec_mutex_unlock(&self->priv->client_attr_mutex);
+
+    MooseStatus *status = moose_client_ref_status(self);
+    if(status != NULL) {
+        gint64 age = g_get_monotonic_time() - moose_status_get_elapsed_timestamp(status);
+        if(moose_status_get_state(status) == MOOSE_STATE_PLAY && age >= max_age) {
+            moose_updata_data_push(self, MOOSE_IDLE_STATUS_TIMER_FLAG, true);
+        }
+    }
+    moose_status_unref(status);
+
+    return TRUE;
+}
+
+static void moose_client_resync_unschedule(MooseClient *self) {
+    g_rec_mutex_lock(&self->priv->client_attr_mutex);
+    {
+        if(self->priv->resync.timeout_id != 0) {
+            g_source_remove(self->priv->resync.timeout_id);
+            self->priv->resync.timeout_id = 0;
+        }
+    }
+    g_rec_mutex_unlock(&self->priv->client_attr_mutex);
+}
+
+static void moose_client_resync_schedule(MooseClient *self) {
+    moose_client_resync_unschedule(self);
+
+    g_rec_mutex_lock(&self->priv->client_attr_mutex);
+    {
+        float interval = self->priv->resync.interval;
+        if(interval > 0) {
+            self->priv->resync.timeout_id =
+                g_timeout_add(interval * 1000, moose_client_resync_cb, self);
+        }
+    }
+    g_rec_mutex_unlock(&self->priv->client_attr_mutex);
+}
+
 gboolean moose_client_connect_to(MooseClient *self,
                                  const char *host,
                                  int port,
@@ -220,16 +413,29 @@ gboolean moose_client_connect_to(MooseClient *self,
 
     ASSERT_IS_MAINTHREAD(self);
 
-    /* Launch a workerthread in the background that will do the communication */
-    self->priv->jm = moose_job_manager_new();
+    /* A ping dropped with the last connection must not block new ones */
+    g_atomic_int_set(&self->priv->pipeline.ping_queued, FALSE);
+
+    /* Launch a workerthread in the background that will do the communication.
+     * Exactly one worker: the pipeline entries are shared between the queue
+     * and their jobs, which is only safe when the jobs run one after another. */
+    self->priv->jm = moose_job_manager_new_full(1, MOOSE_JOB_MANAGER_RESULT_TTL);
     g_signal_connect(self->priv->jm, "dispatch",
                         G_CALLBACK(moose_client_command_dispatcher), self);
 
+    gboolean server_changed = FALSE;
     g_rec_mutex_lock(&self->priv->client_attr_mutex);
     {
+        /* Compare with the last server before forgetting it */
+        server_changed = self->priv->is_virgin == false &&
+                         ((g_strcmp0(host, self->priv->host) != 0) ||
+                          (port != self->priv->port));
+
+        char *last_host = self->priv->host;
         self->priv->timeout = timeout;
         self->priv->port = port;
         self->priv->host = g_strdup(host);
+        g_free(last_host);
     }
     g_rec_mutex_unlock(&self->priv->client_attr_mutex);
 
@@ -242,12 +448,31 @@ gboolean moose_client_connect_to(MooseClient *self,
         /* Force updating of status/stats/song on connect */
         moose_client_force_sync(self, INT_MAX);
 
+        /* Elapsed time is interpolated; only resync now and then */
+        moose_client_resync_schedule(self);
+
+        /* Connected again, forget about the previous failures */
+        moose_client_reconnect_unschedule(self);
+        g_rec_mutex_lock(&self->priv->client_attr_mutex);
+        { self->priv->reconnect.attempts = 0; }
+        g_rec_mutex_unlock(&self->priv->client_attr_mutex);
+
         /* Check if server changed and trigger a signal. */
-        moose_report_connectivity(self, host, port, timeout);
+        moose_report_connectivity(self, server_changed);
         moose_message("…Fully connected!");
     } else {
         //g_signal_emit(self, SIGNALS[SIGNAL_CONNECTIVITY], 0, false);
         moose_client_disconnect(self);
+
+        /* Never connected, so disconnect did not drop the job manager;
+         * reconnect attempts would leak one (and its thread) each time */
+        g_rec_mutex_lock(&self->getput_mutex);
+        {
+            moose_job_manager_unref(self->priv->jm);
+            self->priv->jm = NULL;
+        }
+        g_rec_mutex_unlock(&self->getput_mutex);
+
         moose_critical("…Cannot connect: %s", error);
     }
 
@@ -292,13 +517,22 @@ gboolean moose_client_disconnect(MooseClient *self) {
     gboolean error_happenend = true;
     MooseClientPrivate *priv = self->priv;
 
-    if(self == NULL || moose_client_is_connected(self) == false) {
+    if(self == NULL) {
+        return error_happenend;
+    }
+
+    /* Also stops trying to come back after a lost connection */
+    moose_client_reconnect_unschedule(self);
+
+    if(moose_client_is_connected(self) == false) {
         return error_happenend;
     }
 
     // TODO: Needed?
     // ASSERT_IS_MAINTHREAD(self);
 
+    moose_client_resync_unschedule(self);
+
     /* Lock the connection while destroying it */
     g_rec_mutex_lock(&self->getput_mutex);
     {
@@ -313,6 +547,10 @@ gboolean moose_client_disconnect(MooseClient *self) {
         priv->status = NULL;
         moose_status_unref(status);
 
+        /* Another server might answer differently */
+        g_atomic_int_set(&priv->subscriptions.idling, 0);
+        moose_client_cache_invalidate(self, MOOSE_IDLE_ALL);
+
         /* let the connector clean up itself */
         error_happenend = (self->do_disconnect) ? !self->do_disconnect(self) : true;
     }
@@ -340,6 +578,8 @@ static void moose_updata_data_push(MooseClient *self, MooseIdle event,
         MooseIdle send_event = event;
         if(is_status_timer) {
             event |= MOOSE_IDLE_STATUS_TIMER_FLAG;
+        } else {
+            moose_metrics_count(MOOSE_METRIC_CLIENT_EVENTS, 1);
         }
 
         g_async_queue_push(self->priv->event_queue, GINT_TO_POINTER(send_event));
@@ -351,6 +591,253 @@ void moose_client_force_sync(MooseClient *self, MooseIdle events) {
     moose_updata_data_push(self, events, false);
 }
 
+MooseIdle moose_client_get_idle_mask(MooseClient *self) {
+    g_assert(self);
+
+    /* Events the client needs itself to keep the MooseStatus current.
+     * They are always idled on, regardless of the subscriptions. */
+    MooseIdle mask = (ON_STATUS_UPDATE_FLAGS | ON_STATS_UPDATE_FLAGS |
+                      ON_CURRENT_SONG_UPDATE_FLAGS | ON_REPLAYGAIN_UPDATE_FLAGS |
+                      MOOSE_IDLE_SEEK) & ~MOOSE_IDLE_STATUS_TIMER_FLAG;
+    g_rec_mutex_lock(&self->priv->client_attr_mutex);
+    {
+        if(g_hash_table_size(self->priv->subscriptions.masks) == 0) {
+            mask = MOOSE_IDLE_ALL;
+        } else {
+            GHashTableIter iter;
+            gpointer value = NULL;
+            g_hash_table_iter_init(&iter, self->priv->subscriptions.masks);
+            while(g_hash_table_iter_next(&iter, NULL, &value)) {
+                mask |= GPOINTER_TO_INT(value);
+            }
+        }
+    }
+    g_rec_mutex_unlock(&self->priv->client_attr_mutex);
+
+    return mask;
+}
+
+/* All subsystems mpd knows, i.e. everything a plain "idle" waits for */
+static const MooseIdle MOOSE_IDLE_ALL_SUBSYSTEMS = (MPD_IDLE_MESSAGE << 1) - 1;
+
+gboolean moose_client_send_idle(MooseClient *self, struct mpd_async *async, MooseIdle *sent_mask) {
+    g_assert(self);
+    g_assert(async);
+
+    MooseIdle mask = moose_client_get_idle_mask(self);
+    if(sent_mask != NULL) {
+        *sent_mask = mask;
+    }
+    g_atomic_int_set(&self->priv->subscriptions.idling, mask);
+
+    /* Seek events are derived from player events */
+    if(mask & MOOSE_IDLE_SEEK) {
+        mask |= MOOSE_IDLE_PLAYER;
+    }
+
+    /* One slot for each mpd subsystem, the rest stays NULL */
+    const char *names[11] = {NULL};
+    unsigned n_names = 0;
+
+    if((mask & MOOSE_IDLE_ALL_SUBSYSTEMS) != MOOSE_IDLE_ALL_SUBSYSTEMS) {
+        for(unsigned bit = MPD_IDLE_DATABASE; bit <= MPD_IDLE_MESSAGE; bit <<= 1) {
+            const char *name = mpd_idle_name(bit);
+            if((mask & bit) && name != NULL && n_names < G_N_ELEMENTS(names)) {
+                names[n_names++] = name;
+            }
+        }
+    }
+
+    /* The argument list ends at the first NULL, so a plain "idle" if empty */
+    return mpd_async_send_command(async, "idle",
+                                  names[0], names[1], names[2], names[3],
+                                  names[4], names[5], names[6], names[7],
+                                  names[8], names[9], names[10], NULL);
+}
+
+/* Re-enter idle mode, so the new mask is sent to the server */
+static void moose_client_resubscribe(MooseClient *self, MooseIdle old_mask) {
+    if(moose_client_get_idle_mask(self) == old_mask) {
+        return;
+    }
+
+    /* We might not hear about changes to cached responses anymore */
+    moose_client_cache_invalidate(self, MOOSE_IDLE_ALL);
+
+    if(moose_client_is_connected(self)) {
+        moose_client_get(self);
+        if(self->do_resubscribe != NULL) {
+            self->do_resubscribe(self);
+        }
+        moose_client_put(self);
+    }
+}
+
+guint moose_client_subscribe(MooseClient *self, MooseIdle events) {
+    g_assert(self);
+
+    guint subscription_id = 0;
+    MooseIdle old_mask = moose_client_get_idle_mask(self);
+
+    g_rec_mutex_lock(&self->priv->client_attr_mutex);
+    {
+        subscription_id = ++self->priv->subscriptions.last_id;
+        g_hash_table_insert(self->priv->subscriptions.masks,
+                            GUINT_TO_POINTER(subscription_id),
+                            GINT_TO_POINTER(events));
+    }
+    g_rec_mutex_unlock(&self->priv->client_attr_mutex);
+
+    moose_client_resubscribe(self, old_mask);
+    return subscription_id;
+}
+
+void moose_client_unsubscribe(MooseClient *self, guint subscription_id) {
+    g_assert(self);
+
+    MooseIdle old_mask = moose_client_get_idle_mask(self);
+
+    g_rec_mutex_lock(&self->priv->client_attr_mutex);
+    {
+        g_hash_table_remove(self->priv->subscriptions.masks,
+                            GUINT_TO_POINTER(subscription_id));
+    }
+    g_rec_mutex_unlock(&self->priv->client_attr_mutex);
+
+    moose_client_resubscribe(self, old_mask);
+}
+
+//////////////////////////////
+//      Response Cache      //
+//////////////////////////////
+
+/* Read-only commands whose response only changes with certain idle events */
+static const struct {
+    const char *command;
+    MooseIdle invalidated_by;
+} MOOSE_CLIENT_CACHEABLE[] = {
+    {"outputs", MOOSE_IDLE_OUTPUT},
+    {"listplaylists", MOOSE_IDLE_STORED_PLAYLIST},
+    {"stats", MOOSE_IDLE_DATABASE | MOOSE_IDLE_UPDATE},
+    {"replay_gain_status", MOOSE_IDLE_OPTIONS}};
+
+static gboolean moose_client_cache_is_cacheable(MooseClient *self, const char *command) {
+    for(unsigned i = 0; i < G_N_ELEMENTS(MOOSE_CLIENT_CACHEABLE); ++i) {
+        if(g_strcmp0(MOOSE_CLIENT_CACHEABLE[i].command, command) == 0) {
+            /* Only if we get told when it changes, by the server right now
+             * and by the subscriptions once it re-idled. */
+            MooseIdle needed = MOOSE_CLIENT_CACHEABLE[i].invalidated_by;
+            MooseIdle mask = moose_client_get_idle_mask(self) &
+                             g_atomic_int_get(&self->priv->subscriptions.idling);
+            return (mask & needed) == needed;
+        }
+    }
+    return false;
+}
+
+static void moose_client_cache_invalidate(MooseClient *self, MooseIdle events) {
+    g_mutex_lock(&self->priv->cache.mutex);
+    {
+        for(unsigned i = 0; i < G_N_ELEMENTS(MOOSE_CLIENT_CACHEABLE); ++i) {
+            if(events & MOOSE_CLIENT_CACHEABLE[i].invalidated_by) {
+                g_hash_table_remove(self->priv->cache.responses,
+                                    MOOSE_CLIENT_CACHEABLE[i].command);
+            }
+        }
+        self->priv->cache.epoch++;
+    }
+    g_mutex_unlock(&self->priv->cache.mutex);
+}
+
+/* Returns a new reference to the cached response of command or NULL.
+ * epoch is set to the value moose_client_cache_recv() expects. */
+static GPtrArray *moose_client_cache_lookup(MooseClient *self, const char *command,
+                                            guint *epoch) {
+    GPtrArray *pairs = NULL;
+
+    g_mutex_lock(&self->priv->cache.mutex);
+    {
+        pairs = g_hash_table_lookup(self->priv->cache.responses, command);
+        if(pairs != NULL) {
+            g_ptr_array_ref(pairs);
+        }
+        *epoch = self->priv->cache.epoch;
+    }
+    g_mutex_unlock(&self->priv->cache.mutex);
+
+    return pairs;
+}
+
+/* Read the pairs of the current response and cache them if possible */
+static GPtrArray *moose_client_cache_recv(MooseClient *self, struct mpd_connection *conn,
+                                          const char *command, guint epoch) {
+    GPtrArray *pairs = g_ptr_array_new_with_free_func(g_free);
+    struct mpd_pair *pair = NULL;
+
+    while((pair = mpd_recv_pair(conn)) != NULL) {
+        g_ptr_array_add(pairs, g_strdup(pair->name));
+        g_ptr_array_add(pairs, g_strdup(pair->value));
+        mpd_return_pair(conn, pair);
+    }
+
+    if(mpd_connection_get_error(conn) != MPD_ERROR_SUCCESS) {
+        /* Incomplete, the error is handled by the caller */
+        g_ptr_array_unref(pairs);
+        return NULL;
+    }
+
+    if(moose_client_cache_is_cacheable(self, command)) {
+        g_mutex_lock(&self->priv->cache.mutex);
+        {
+            if(self->priv->cache.epoch == epoch) {
+                g_hash_table_insert(self->priv->cache.responses, (char *)command,
+                                    g_ptr_array_ref(pairs));
+            }
+        }
+        g_mutex_unlock(&self->priv->cache.mutex);
+    }
+
+    return pairs;
+}
+
+GPtrArray *moose_client_cache_run(MooseClient *self, struct mpd_connection *conn,
+                                  const char *command) {
+    g_assert(self);
+    g_assert(conn);
+
+    guint epoch = 0;
+    GPtrArray *pairs = moose_client_cache_lookup(self, command, &epoch);
+    if(pairs != NULL) {
+        return pairs;
+    }
+
+    gint64 started = g_get_monotonic_time(), span = moose_trace_begin();
+    if(mpd_send_command(conn, command, NULL) == false) {
+        moose_client_check_error(self, conn);
+        return NULL;
+    }
+
+    pairs = moose_client_cache_recv(self, conn, command, epoch);
+    if(mpd_response_finish(conn) == false) {
+        moose_client_check_error(self, conn);
+    }
+
+    moose_metrics_record_since(MOOSE_METRIC_CLIENT_ROUNDTRIP, started);
+    moose_trace_end(span, "mpd", command);
+    return pairs;
+}
+
+const char *moose_client_pairs_lookup(GPtrArray *pairs, const char *name) {
+    g_assert(pairs);
+
+    for(unsigned i = 0; i + 1 < pairs->len; i += 2) {
+        if(g_strcmp0(g_ptr_array_index(pairs, i), name) == 0) {
+            return g_ptr_array_index(pairs, i + 1);
+        }
+    }
+    return NULL;
+}
+
 char *moose_client_get_host(MooseClient *self) {
     g_assert(self);
 
@@ -482,7 +969,8 @@ MooseStatus *moose_client_ref_status(MooseClient *self) {
 
 /* Prototypes */
 static gboolean moose_client_command_list_begin(MooseClient *self);
-static void moose_client_command_list_append(MooseClient *self, GVariant *variant);
+static void moose_client_command_list_append(MooseClient *self,
+                                             MooseClientPipelineEntry *entry);
 static gboolean moose_client_command_list_commit(MooseClient *self);
 
 /**
@@ -491,34 +979,31 @@ static gboolean moose_client_command_list_commit(MooseClient *self);
  *  shuffle_range
  *  (...)
  */
-#define COMMAND(_getput_code_, _command_list_code_) \
-    if(moose_client_command_list_is_active(self)) { \
-        _command_list_code_;                        \
-    } else {                                        \
-        _getput_code_;                              \
+#define COMMAND(_getput_code_, _command_list_code_)                              \
+    if(self->priv->pipeline.is_sending || moose_client_command_list_is_active(self)) { \
+        _command_list_code_;                                                    \
+    } else {                                                                    \
+        _getput_code_;                                                          \
     }
 
 static gboolean handle_queue_add(MooseClient *self, struct mpd_connection *conn,
-                                 const char *format, GVariant *variant) {
-    const char *uri = NULL;
-    g_variant_get(variant, format, NULL, &uri);
+                                 const MooseClientArgs *args) {
+    const char *uri = args->strings[0];
     COMMAND(mpd_run_add(conn, uri), mpd_send_add(conn, uri))
 
     return true;
 }
 
 static gboolean handle_queue_clear(MooseClient *self, struct mpd_connection *conn,
-                                   G_GNUC_UNUSED const char *format,
-                                   G_GNUC_UNUSED GVariant *variant) {
+                                   G_GNUC_UNUSED const MooseClientArgs *args) {
     COMMAND(mpd_run_clear(conn), mpd_send_clear(conn))
 
     return true;
 }
 
 static gboolean handle_consume(MooseClient *self, struct mpd_connection *conn,
-                               const char *format, GVariant *variant) {
-    gboolean mode = false;
-    g_variant_get(variant, format, NULL, &mode);
+                               const MooseClientArgs *args) {
+    gboolean mode = args->flag;
 
     COMMAND(mpd_run_consume(conn, mode), mpd_send_consume(conn, mode))
 
@@ -526,9 +1011,8 @@ static gboolean handle_consume(MooseClient *self, struct mpd_connection *conn,
 }
 
 static gboolean handle_crossfade(MooseClient *self, struct mpd_connection *conn,
-                                 const char *format, GVariant *variant) {
-    double xfade = 0;
-    g_variant_get(variant, format, NULL, &xfade);
+                                 const MooseClientArgs *args) {
+    double xfade = args->number;
 
     COMMAND(mpd_run_crossfade(conn, xfade), mpd_send_crossfade(conn, xfade))
 
@@ -536,9 +1020,8 @@ static gboolean handle_crossfade(MooseClient *self, struct mpd_connection *conn,
 }
 
 static gboolean handle_queue_delete(MooseClient *self, struct mpd_connection *conn,
-                                    const char *format, GVariant *variant) {
-    int pos = 0;
-    g_variant_get(variant, format, NULL, &pos);
+                                    const MooseClientArgs *args) {
+    int pos = args->ints[0];
 
     COMMAND(mpd_run_delete(conn, pos), mpd_send_delete(conn, pos))
 
@@ -546,9 +1029,8 @@ static gboolean handle_queue_delete(MooseClient *self, struct mpd_connection *co
 }
 
 static gboolean handle_queue_delete_id(MooseClient *self, struct mpd_connection *conn,
-                                       const char *format, GVariant *variant) {
-    int id = 0;
-    g_variant_get(variant, format, NULL, &id);
+                                       const MooseClientArgs *args) {
+    int id = args->ints[0];
 
     COMMAND(mpd_run_delete_id(conn, id), mpd_send_delete_id(conn, id))
 
@@ -556,9 +1038,8 @@ static gboolean handle_queue_delete_id(MooseClient *self, struct mpd_connection
 }
 
 static gboolean handle_queue_delete_range(MooseClient *self, struct mpd_connection *conn,
-                                          const char *format, GVariant *variant) {
-    int start = 0, end = 1;
-    g_variant_get(variant, format, NULL, &start, &end);
+                                          const MooseClientArgs *args) {
+    int start = args->ints[0], end = args->ints[1];
 
     COMMAND(mpd_run_delete_range(conn, start, end),
             mpd_send_delete_range(conn, start, end))
@@ -567,14 +1048,12 @@ static gboolean handle_queue_delete_range(MooseClient *self, struct mpd_connecti
 }
 
 static gboolean handle_output_switch(MooseClient *self, struct mpd_connection *conn,
-                                     const char *format, GVariant *variant) {
-    char *output_name = NULL;
-    gboolean mode = true;
+                                     const MooseClientArgs *args) {
+    const char *output_name = args->strings[0];
+    gboolean mode = args->flag;
     int output_id;
     gboolean result = false;
 
-    g_variant_get(variant, format, NULL, &output_name, &mode);
-
     MooseStatus *status = moose_client_ref_status(self);
     { output_id = moose_status_output_lookup_id(status, output_name); }
     moose_status_unref(status);
@@ -593,17 +1072,12 @@ static gboolean handle_output_switch(MooseClient *self, struct mpd_connection *c
         result = false;
     }
 
-    g_free(output_name);
     return result;
 }
 
 static gboolean handle_playlist_load(MooseClient *self, struct mpd_connection *conn,
-                                     const char *format, GVariant *variant) {
-    const char *playlist = NULL;
-    g_variant_get(variant, format, NULL, &playlist);
-    if(playlist == NULL) {
-        return false;
-    }
+                                     const MooseClientArgs *args) {
+    const char *playlist = args->strings[0];
 
     COMMAND(mpd_run_load(conn, playlist), mpd_send_load(conn, playlist));
 
@@ -611,9 +1085,8 @@ static gboolean handle_playlist_load(MooseClient *self, struct mpd_connection *c
 }
 
 static gboolean handle_mixramdb(MooseClient *self, struct mpd_connection *conn,
-                                const char *format, GVariant *variant) {
-    double decibel = 0;
-    g_variant_get(variant, format, NULL, &decibel);
+                                const MooseClientArgs *args) {
+    double decibel = args->number;
 
     COMMAND(mpd_run_mixrampdb(conn, decibel), mpd_send_mixrampdb(conn, decibel));
 
@@ -621,9 +1094,8 @@ static gboolean handle_mixramdb(MooseClient *self, struct mpd_connection *conn,
 }
 
 static gboolean handle_mixramdelay(MooseClient *self, struct mpd_connection *conn,
-                                   const char *format, GVariant *variant) {
-    double seconds = 0;
-    g_variant_get(variant, format, NULL, &seconds);
+                                   const MooseClientArgs *args) {
+    double seconds = args->number;
 
     COMMAND(mpd_run_mixrampdelay(conn, seconds), mpd_send_mixrampdelay(conn, seconds));
 
@@ -631,9 +1103,8 @@ static gboolean handle_mixramdelay(MooseClient *self, struct mpd_connection *con
 }
 
 static gboolean handle_queue_move(MooseClient *self, struct mpd_connection *conn,
-                                  const char *format, GVariant *variant) {
-    int old_id = 0, new_id = 0;
-    g_variant_get(variant, format, NULL, &old_id, &new_id);
+                                  const MooseClientArgs *args) {
+    int old_id = args->ints[0], new_id = args->ints[1];
 
     COMMAND(mpd_run_move_id(conn, old_id, new_id),
             mpd_send_move_id(conn, old_id, new_id));
@@ -642,9 +1113,8 @@ static gboolean handle_queue_move(MooseClient *self, struct mpd_connection *conn
 }
 
 static gboolean handle_queue_move_range(MooseClient *self, struct mpd_connection *conn,
-                                        const char *format, GVariant *variant) {
-    int start_pos = 0, end_pos = 1, new_pos = 0;
-    g_variant_get(variant, format, NULL, &start_pos, &end_pos, &new_pos);
+                                        const MooseClientArgs *args) {
+    int start_pos = args->ints[0], end_pos = args->ints[1], new_pos = args->ints[2];
 
     COMMAND(mpd_run_move_range(conn, start_pos, end_pos, new_pos),
             mpd_send_move_range(conn, start_pos, end_pos, new_pos));
@@ -653,47 +1123,38 @@ static gboolean handle_queue_move_range(MooseClient *self, struct mpd_connection
 }
 
 static gboolean handle_next(MooseClient *self, struct mpd_connection *conn,
-                            G_GNUC_UNUSED const char *format,
-                            G_GNUC_UNUSED GVariant *variant) {
+                            G_GNUC_UNUSED const MooseClientArgs *args) {
     COMMAND(mpd_run_next(conn), mpd_send_next(conn))
     return true;
 }
 
 static gboolean handle_password(MooseClient *self, struct mpd_connection *conn,
-                                const char *format, GVariant *variant) {
-    const char *password = NULL;
+                                const MooseClientArgs *args) {
+    const char *password = args->strings[0];
     gboolean rc = false;
 
-    g_variant_get(variant, format, NULL, &password);
-
-    if(password == NULL) {
-        return FALSE;
-    }
-
-    COMMAND(rc = mpd_run_password(conn, password), mpd_send_password(conn, password));
+    COMMAND(rc = mpd_run_password(conn, password),
+            rc = mpd_send_password(conn, password));
     return rc;
 }
 
 static gboolean handle_pause(MooseClient *self, struct mpd_connection *conn,
-                             G_GNUC_UNUSED const char *format,
-                             G_GNUC_UNUSED GVariant *variant) {
+                             G_GNUC_UNUSED const MooseClientArgs *args) {
     COMMAND(mpd_run_toggle_pause(conn), mpd_send_toggle_pause(conn))
 
     return true;
 }
 
 static gboolean handle_play(MooseClient *self, struct mpd_connection *conn,
-                            G_GNUC_UNUSED const char *format,
-                            G_GNUC_UNUSED GVariant *variant) {
+                            G_GNUC_UNUSED const MooseClientArgs *args) {
     COMMAND(mpd_run_play(conn), mpd_send_play(conn))
 
     return true;
 }
 
 static gboolean handle_play_id(MooseClient *self, struct mpd_connection *conn,
-                               const char *format, GVariant *variant) {
-    int id = 0;
-    g_variant_get(variant, format, NULL, &id);
+                               const MooseClientArgs *args) {
+    int id = args->ints[0];
 
     COMMAND(mpd_run_play_id(conn, id), mpd_send_play_id(conn, id))
 
@@ -701,14 +1162,8 @@ static gboolean handle_play_id(MooseClient *self, struct mpd_connection *conn,
 }
 
 static gboolean handle_playlist_add(MooseClient *self, struct mpd_connection *conn,
-                                    const char *format, GVariant *variant) {
-    const char *name = NULL, *file = NULL;
-
-    g_variant_get(variant, format, NULL, &name, &file);
-
-    if(name == NULL || file == NULL) {
-        return FALSE;
-    }
+                                    const MooseClientArgs *args) {
+    const char *name = args->strings[0], *file = args->strings[1];
 
     COMMAND(mpd_run_playlist_add(conn, name, file),
             mpd_send_playlist_add(conn, name, file))
@@ -717,14 +1172,8 @@ static gboolean handle_playlist_add(MooseClient *self, struct mpd_connection *co
 }
 
 static gboolean handle_playlist_clear(MooseClient *self, struct mpd_connection *conn,
-                                      const char *format, GVariant *variant) {
-    const char *name = NULL;
-
-    g_variant_get(variant, format, NULL, &name);
-
-    if(name == NULL) {
-        return FALSE;
-    }
+                                      const MooseClientArgs *args) {
+    const char *name = args->strings[0];
 
     COMMAND(mpd_run_playlist_clear(conn, name), mpd_send_playlist_clear(conn, name))
 
@@ -732,15 +1181,9 @@ static gboolean handle_playlist_clear(MooseClient *self, struct mpd_connection *
 }
 
 static gboolean handle_playlist_delete(MooseClient *self, struct mpd_connection *conn,
-                                       const char *format, GVariant *variant) {
-    const char *name = NULL;
-    int pos = 0;
-
-    g_variant_get(variant, format, NULL, &name, &pos);
-
-    if(name == NULL) {
-        return FALSE;
-    }
+                                       const MooseClientArgs *args) {
+    const char *name = args->strings[0];
+    int pos = args->ints[0];
 
     COMMAND(mpd_run_playlist_delete(conn, name, pos),
             mpd_send_playlist_delete(conn, name, pos))
@@ -749,15 +1192,9 @@ static gboolean handle_playlist_delete(MooseClient *self, struct mpd_connection
 }
 
 static gboolean handle_playlist_move(MooseClient *self, struct mpd_connection *conn,
-                                     const char *format, GVariant *variant) {
-    const char *name = NULL;
-    int old_pos = 0, new_pos = 1;
-
-    g_variant_get(variant, format, NULL, &name, &old_pos, &new_pos);
-
-    if(name == NULL) {
-        return FALSE;
-    }
+                                     const MooseClientArgs *args) {
+    const char *name = args->strings[0];
+    int old_pos = args->ints[0], new_pos = args->ints[1];
 
     COMMAND(mpd_send_playlist_move(conn, name, old_pos, new_pos);
             mpd_response_finish(conn);
@@ -767,17 +1204,15 @@ static gboolean handle_playlist_move(MooseClient *self, struct mpd_connection *c
 }
 
 static gboolean handle_previous(MooseClient *self, struct mpd_connection *conn,
-                                G_GNUC_UNUSED const char *format,
-                                G_GNUC_UNUSED GVariant *variant) {
+                                G_GNUC_UNUSED const MooseClientArgs *args) {
     COMMAND(mpd_run_previous(conn), mpd_send_previous(conn))
 
     return true;
 }
 
 static gboolean handle_prio(MooseClient *self, struct mpd_connection *conn,
-                            const char *format, GVariant *variant) {
-    int prio = 0, position = 0;
-    g_variant_get(variant, format, NULL, &prio, &position);
+                            const MooseClientArgs *args) {
+    int prio = args->ints[0], position = args->ints[1];
 
     COMMAND(mpd_run_prio(conn, prio, position), mpd_send_prio(conn, prio, position))
 
@@ -785,9 +1220,8 @@ static gboolean handle_prio(MooseClient *self, struct mpd_connection *conn,
 }
 
 static gboolean handle_prio_range(MooseClient *self, struct mpd_connection *conn,
-                                  const char *format, GVariant *variant) {
-    int prio = 0, start_pos = 0, end_pos = 1;
-    g_variant_get(variant, format, NULL, &prio, &start_pos, &end_pos);
+                                  const MooseClientArgs *args) {
+    int prio = args->ints[0], start_pos = args->ints[1], end_pos = args->ints[2];
 
     COMMAND(mpd_run_prio_range(conn, prio, start_pos, end_pos),
             mpd_send_prio_range(conn, prio, start_pos, end_pos))
@@ -796,11 +1230,9 @@ static gboolean handle_prio_range(MooseClient *self, struct mpd_connection *conn
 }
 
 static gboolean handle_prio_id(MooseClient *self, struct mpd_connection *conn,
-                               const char *format, GVariant *variant) {
-    int prio = 0;
-    int id = 0;
-
-    g_variant_get(variant, format, NULL, &prio, &id);
+                               const MooseClientArgs *args) {
+    int prio = args->ints[0];
+    int id = args->ints[1];
 
     COMMAND(mpd_run_prio_id(conn, prio, id), mpd_send_prio_id(conn, prio, id))
 
@@ -808,10 +1240,8 @@ static gboolean handle_prio_id(MooseClient *self, struct mpd_connection *conn,
 }
 
 static gboolean handle_random(MooseClient *self, struct mpd_connection *conn,
-                              const char *format, GVariant *variant) {
-    gboolean mode = FALSE;
-
-    g_variant_get(variant, format, NULL, &mode);
+                              const MooseClientArgs *args) {
+    gboolean mode = args->flag;
 
     COMMAND(mpd_run_random(conn, mode), mpd_send_random(conn, mode))
 
@@ -819,14 +1249,9 @@ static gboolean handle_random(MooseClient *self, struct mpd_connection *conn,
 }
 
 static gboolean handle_playlist_rename(MooseClient *self, struct mpd_connection *conn,
-                                       const char *format, GVariant *variant) {
-    const char *old_name = NULL;
-    const char *new_name = NULL;
-    g_variant_get(variant, format, NULL, &old_name, &new_name);
-
-    if(old_name == NULL || new_name == NULL) {
-        return FALSE;
-    }
+                                       const MooseClientArgs *args) {
+    const char *old_name = args->strings[0];
+    const char *new_name = args->strings[1];
 
     COMMAND(mpd_run_rename(conn, old_name, new_name),
             mpd_send_rename(conn, old_name, new_name));
@@ -834,9 +1259,8 @@ static gboolean handle_playlist_rename(MooseClient *self, struct mpd_connection
 }
 
 static gboolean handle_repeat(MooseClient *self, struct mpd_connection *conn,
-                              const char *format, GVariant *variant) {
-    gboolean mode = false;
-    g_variant_get(variant, format, NULL, &mode);
+                              const MooseClientArgs *args) {
+    gboolean mode = args->flag;
 
     COMMAND(mpd_run_repeat(conn, mode), mpd_send_repeat(conn, mode));
 
@@ -844,12 +1268,8 @@ static gboolean handle_repeat(MooseClient *self, struct mpd_connection *conn,
 }
 
 static gboolean handle_replay_gain_mode(MooseClient *self, struct mpd_connection *conn,
-                                        const char *format, GVariant *variant) {
-    const char *replay_gain_mode = NULL;
-    g_variant_get(variant, format, NULL, &replay_gain_mode);
-    if(replay_gain_mode == NULL) {
-        return FALSE;
-    }
+                                        const MooseClientArgs *args) {
+    const char *replay_gain_mode = args->strings[0];
 
     COMMAND(mpd_send_command(conn, "replay_gain_mode", replay_gain_mode, NULL);
             mpd_response_finish(conn);
@@ -860,11 +1280,11 @@ static gboolean handle_replay_gain_mode(MooseClient *self, struct mpd_connection
 }
 
 static gboolean handle_database_rescan(MooseClient *self, struct mpd_connection *conn,
-                                       const char *format, GVariant *variant) {
-    const char *path = NULL;
-    g_variant_get(variant, format, NULL, &path);
-    if(path == NULL) {
-        return FALSE;
+                                       const MooseClientArgs *args) {
+    /* NULL or "" means the whole database */
+    const char *path = args->strings[0];
+    if(path != NULL && *path == 0) {
+        path = NULL;
     }
 
     COMMAND(mpd_run_rescan(conn, path), mpd_send_rescan(conn, path));
@@ -873,12 +1293,8 @@ static gboolean handle_database_rescan(MooseClient *self, struct mpd_connection
 }
 
 static gboolean handle_playlist_rm(MooseClient *self, struct mpd_connection *conn,
-                                   const char *format, GVariant *variant) {
-    const char *playlist_name = NULL;
-    g_variant_get(variant, format, NULL, &playlist_name);
-    if(playlist_name == NULL) {
-        return FALSE;
-    }
+                                   const MooseClientArgs *args) {
+    const char *playlist_name = args->strings[0];
 
     COMMAND(mpd_run_rm(conn, playlist_name), mpd_send_rm(conn, playlist_name));
 
@@ -886,12 +1302,8 @@ static gboolean handle_playlist_rm(MooseClient *self, struct mpd_connection *con
 }
 
 static gboolean handle_playlist_save(MooseClient *self, struct mpd_connection *conn,
-                                     const char *format, GVariant *variant) {
-    const char *as_name = NULL;
-    g_variant_get(variant, format, NULL, &as_name);
-    if(as_name == NULL) {
-        return FALSE;
-    }
+                                     const MooseClientArgs *args) {
+    const char *as_name = args->strings[0];
 
     COMMAND(mpd_run_save(conn, as_name), mpd_send_save(conn, as_name));
 
@@ -899,10 +1311,9 @@ static gboolean handle_playlist_save(MooseClient *self, struct mpd_connection *c
 }
 
 static gboolean handle_seek(MooseClient *self, struct mpd_connection *conn,
-                            const char *format, GVariant *variant) {
-    int pos = 0;
-    double seconds = 0;
-    g_variant_get(variant, format, NULL, &pos, &seconds);
+                            const MooseClientArgs *args) {
+    int pos = args->ints[0];
+    double seconds = args->number;
 
     COMMAND(mpd_run_seek_pos(conn, pos, seconds), mpd_send_seek_pos(conn, pos, seconds));
 
@@ -910,10 +1321,9 @@ static gboolean handle_seek(MooseClient *self, struct mpd_connection *conn,
 }
 
 static gboolean handle_seek_id(MooseClient *self, struct mpd_connection *conn,
-                               const char *format, GVariant *variant) {
-    int id = 0;
-    double seconds = 0;
-    g_variant_get(variant, format, NULL, &id, &seconds);
+                               const MooseClientArgs *args) {
+    int id = args->ints[0];
+    double seconds = args->number;
 
     COMMAND(mpd_run_seek_id(conn, id, seconds), mpd_send_seek_id(conn, id, seconds));
 
@@ -921,9 +1331,8 @@ static gboolean handle_seek_id(MooseClient *self, struct mpd_connection *conn,
 }
 
 static gboolean handle_seekcur(MooseClient *self, struct mpd_connection *conn,
-                               const char *format, GVariant *variant) {
-    int seconds = 0;
-    g_variant_get(variant, format, NULL, &seconds);
+                               const MooseClientArgs *args) {
+    double seconds = args->number;
 
     /* there is 'seekcur' in newer mpd versions,
      * but we can emulate it easily */
@@ -951,9 +1360,8 @@ static gboolean handle_seekcur(MooseClient *self, struct mpd_connection *conn,
 }
 
 static gboolean handle_setvol(MooseClient *self, struct mpd_connection *conn,
-                              const char *format, GVariant *variant) {
-    int volume = 100;
-    g_variant_get(variant, format, NULL, &volume);
+                              const MooseClientArgs *args) {
+    int volume = args->ints[0];
 
     COMMAND(mpd_run_set_volume(conn, volume), mpd_send_set_volume(conn, volume));
 
@@ -961,16 +1369,14 @@ static gboolean handle_setvol(MooseClient *self, struct mpd_connection *conn,
 }
 
 static gboolean handle_queue_shuffle(MooseClient *self, struct mpd_connection *conn,
-                                     G_GNUC_UNUSED const char *format,
-                                     G_GNUC_UNUSED GVariant *variant) {
+                                     G_GNUC_UNUSED const MooseClientArgs *args) {
     COMMAND(mpd_run_shuffle(conn), mpd_send_shuffle(conn));
     return true;
 }
 
 static gboolean handle_single(MooseClient *self, struct mpd_connection *conn,
-                              const char *format, GVariant *variant) {
-    gboolean mode = false;
-    g_variant_get(variant, format, NULL, &mode);
+                              const MooseClientArgs *args) {
+    gboolean mode = args->flag;
 
     COMMAND(mpd_run_single(conn, mode), mpd_send_single(conn, mode));
 
@@ -978,17 +1384,15 @@ static gboolean handle_single(MooseClient *self, struct mpd_connection *conn,
 }
 
 static gboolean handle_stop(MooseClient *self, struct mpd_connection *conn,
-                            G_GNUC_UNUSED const char *format,
-                            G_GNUC_UNUSED GVariant *variant) {
+                            G_GNUC_UNUSED const MooseClientArgs *args) {
     COMMAND(mpd_run_stop(conn), mpd_send_stop(conn));
 
     return true;
 }
 
 static gboolean handle_queue_swap(MooseClient *self, struct mpd_connection *conn,
-                                  const char *format, GVariant *variant) {
-    int pos_a = 0, pos_b = 0;
-    g_variant_get(variant, format, NULL, &pos_a, &pos_b);
+                                  const MooseClientArgs *args) {
+    int pos_a = args->ints[0], pos_b = args->ints[1];
 
     COMMAND(mpd_run_swap(conn, pos_a, pos_b), mpd_send_swap(conn, pos_a, pos_b));
 
@@ -996,9 +1400,8 @@ static gboolean handle_queue_swap(MooseClient *self, struct mpd_connection *conn
 }
 
 static gboolean handle_queue_swap_id(MooseClient *self, struct mpd_connection *conn,
-                                     const char *format, GVariant *variant) {
-    int id_a = 0, id_b = 0;
-    g_variant_get(variant, format, NULL, &id_a, &id_b);
+                                     const MooseClientArgs *args) {
+    int id_a = args->ints[0], id_b = args->ints[1];
 
     COMMAND(mpd_run_swap_id(conn, id_a, id_b), mpd_send_swap_id(conn, id_a, id_b));
 
@@ -1006,12 +1409,11 @@ static gboolean handle_queue_swap_id(MooseClient *self, struct mpd_connection *c
 }
 
 static gboolean handle_database_update(MooseClient *self, struct mpd_connection *conn,
-                                       const char *format, GVariant *variant) {
-    const char *path = NULL;
-    g_variant_get(variant, format, NULL, &path);
-
-    if(path != NULL) {
-        return FALSE;
+                                       const MooseClientArgs *args) {
+    /* NULL or "" means the whole database */
+    const char *path = args->strings[0];
+    if(path != NULL && *path == 0) {
+        path = NULL;
     }
 
     COMMAND(mpd_run_update(conn, path), mpd_send_update(conn, path));
@@ -1019,65 +1421,117 @@ static gboolean handle_database_update(MooseClient *self, struct mpd_connection
     return true;
 }
 
+static gboolean handle_ping(MooseClient *self, struct mpd_connection *conn,
+                            G_GNUC_UNUSED const MooseClientArgs *args) {
+    g_atomic_int_set(&self->priv->pipeline.ping_queued, FALSE);
+
+    COMMAND(if(mpd_send_command(conn, "ping", NULL)) { mpd_response_finish(conn); },
+            mpd_send_command(conn, "ping", NULL));
+
+    return true;
+}
+
 typedef gboolean (*MooseClientHandler)(
     MooseClient *self,           /* Client to operate on */
     struct mpd_connection *conn, /* Readily prepared connection */
-    const char *format,          /* Variant Type format */
-    GVariant *variant            /* Variant storing the data */
+    const MooseClientArgs *args  /* Already unpacked arguments */
     );
 
+/* Commands in the same group supersede each other ("last value wins").
+ * Different groups do not affect each other, so they may be reordered. */
+typedef enum {
+    MOOSE_COALESCE_NEVER = 0,
+    MOOSE_COALESCE_VOLUME,
+    MOOSE_COALESCE_SEEK,
+    MOOSE_COALESCE_CROSSFADE,
+    MOOSE_COALESCE_MIXRAMPDB,
+    MOOSE_COALESCE_MIXRAMPDELAY
+} MooseCoalesceGroup;
+
 typedef struct {
     const char *command;
     int num_args;
     const char *format;
     MooseClientHandler handler;
+    MooseCoalesceGroup coalesce;
 } MooseHandlerField;
 
-static const MooseHandlerField HandlerTable[] = {
-    {"consume", 1, "(sb)", handle_consume},
-    {"crossfade", 1, "(sb)", handle_crossfade},
-    {"database-rescan", 1, "(ss)", handle_database_rescan},
-    {"database-update", 1, "(ss)", handle_database_update},
-    {"mixramdb", 1, "(sd)", handle_mixramdb},
-    {"mixramdelay", 1, "(sd)", handle_mixramdelay},
-    {"next", 0, "(s)", handle_next},
-    {"output-switch", 2, "(ssb)", handle_output_switch},
-    {"password", 1, "(ss)", handle_password},
-    {"pause", 0, "(s)", handle_pause},
-    {"play", 0, "(s)", handle_play},
-    {"play-id", 1, "(si)", handle_play_id},
-    {"playlist-add", 2, "(sss)", handle_playlist_add},
-    {"playlist-clear", 1, "(ss)", handle_playlist_clear},
-    {"playlist-delete", 2, "(ssi)", handle_playlist_delete},
-    {"playlist-load", 1, "(ss)", handle_playlist_load},
-    {"playlist-move", 3, "(ssii)", handle_playlist_move},
-    {"playlist-rename", 2, "(sss)", handle_playlist_rename},
-    {"playlist-rm", 1, "(ss)", handle_playlist_rm},
-    {"playlist-save", 1, "(ss)", handle_playlist_save},
-    {"previous", 0, "(s)", handle_previous},
-    {"prio", 2, "(sii)", handle_prio},
-    {"prio-id", 2, "(sii)", handle_prio_id},
-    {"prio-range", 3, "(siii)", handle_prio_range},
-    {"queue-add", 1, "(ss)", handle_queue_add},
-    {"queue-clear", 0, "(s)", handle_queue_clear},
-    {"queue-delete", 1, "(si)", handle_queue_delete},
-    {"queue-delete-id", 1, "(si)", handle_queue_delete_id},
-    {"queue-delete-range", 2, "(sii)", handle_queue_delete_range},
-    {"queue-move", 2, "(sii)", handle_queue_move},
-    {"queue-move-range", 3, "(siii)", handle_queue_move_range},
-    {"queue-shuffle", 0, "(s)", handle_queue_shuffle},
-    {"queue-swap", 2, "(sii)", handle_queue_swap},
-    {"queue-swap-id", 2, "(sii)", handle_queue_swap_id},
-    {"random", 1, "(sb)", handle_random},
-    {"repeat", 1, "(sb)", handle_repeat},
-    {"replay-gain-mode", 1, "(ss)", handle_replay_gain_mode},
-    {"seek", 2, "(sid)", handle_seek},
-    {"seekcur", 1, "(sd)", handle_seekcur},
-    {"seek-id", 2, "(sid)", handle_seek_id},
-    {"setvol", 1, "(si)", handle_setvol},
-    {"single", 1, "(sb)", handle_single},
-    {"stop", 0, "(s)", handle_stop},
-    {NULL, 0, NULL, NULL}};
+/* Indexed by MooseCommand, so looking up a handler is just an array access. */
+static const MooseHandlerField HandlerTable[MOOSE_COMMAND_N + 1] = {
+    [MOOSE_COMMAND_CONSUME] = {"consume", 1, "(sb)", handle_consume},
+    [MOOSE_COMMAND_CROSSFADE] = {"crossfade", 1, "(sd)", handle_crossfade,
+                                MOOSE_COALESCE_CROSSFADE},
+    [MOOSE_COMMAND_DATABASE_RESCAN] = {"database-rescan", 1, "(ss)", handle_database_rescan},
+    [MOOSE_COMMAND_DATABASE_UPDATE] = {"database-update", 1, "(ss)", handle_database_update},
+    [MOOSE_COMMAND_MIXRAMDB] = {"mixramdb", 1, "(sd)", handle_mixramdb,
+                               MOOSE_COALESCE_MIXRAMPDB},
+    [MOOSE_COMMAND_MIXRAMDELAY] = {"mixramdelay", 1, "(sd)", handle_mixramdelay,
+                                  MOOSE_COALESCE_MIXRAMPDELAY},
+    [MOOSE_COMMAND_NEXT] = {"next", 0, "(s)", handle_next},
+    [MOOSE_COMMAND_OUTPUT_SWITCH] = {"output-switch", 2, "(ssb)", handle_output_switch},
+    [MOOSE_COMMAND_PASSWORD] = {"password", 1, "(ss)", handle_password},
+    [MOOSE_COMMAND_PAUSE] = {"pause", 0, "(s)", handle_pause},
+    [MOOSE_COMMAND_PLAY] = {"play", 0, "(s)", handle_play},
+    [MOOSE_COMMAND_PLAY_ID] = {"play-id", 1, "(si)", handle_play_id},
+    [MOOSE_COMMAND_PLAYLIST_ADD] = {"playlist-add", 2, "(sss)", handle_playlist_add},
+    [MOOSE_COMMAND_PLAYLIST_CLEAR] = {"playlist-clear", 1, "(ss)", handle_playlist_clear},
+    [MOOSE_COMMAND_PLAYLIST_DELETE] = {"playlist-delete", 2, "(ssi)", handle_playlist_delete},
+    [MOOSE_COMMAND_PLAYLIST_LOAD] = {"playlist-load", 1, "(ss)", handle_playlist_load},
+    [MOOSE_COMMAND_PLAYLIST_MOVE] = {"playlist-move", 3, "(ssii)", handle_playlist_move},
+    [MOOSE_COMMAND_PLAYLIST_RENAME] = {"playlist-rename", 2, "(sss)", handle_playlist_rename},
+    [MOOSE_COMMAND_PLAYLIST_RM] = {"playlist-rm", 1, "(ss)", handle_playlist_rm},
+    [MOOSE_COMMAND_PLAYLIST_SAVE] = {"playlist-save", 1, "(ss)", handle_playlist_save},
+    [MOOSE_COMMAND_PREVIOUS] = {"previous", 0, "(s)", handle_previous},
+    [MOOSE_COMMAND_PRIO] = {"prio", 2, "(sii)", handle_prio},
+    [MOOSE_COMMAND_PRIO_ID] = {"prio-id", 2, "(sii)", handle_prio_id},
+    [MOOSE_COMMAND_PRIO_RANGE] = {"prio-range", 3, "(siii)", handle_prio_range},
+    [MOOSE_COMMAND_QUEUE_ADD] = {"queue-add", 1, "(ss)", handle_queue_add},
+    [MOOSE_COMMAND_QUEUE_CLEAR] = {"queue-clear", 0, "(s)", handle_queue_clear},
+    [MOOSE_COMMAND_QUEUE_DELETE] = {"queue-delete", 1, "(si)", handle_queue_delete},
+    [MOOSE_COMMAND_QUEUE_DELETE_ID] = {"queue-delete-id", 1, "(si)", handle_queue_delete_id},
+    [MOOSE_COMMAND_QUEUE_DELETE_RANGE] = {"queue-delete-range", 2, "(sii)",
+                                          handle_queue_delete_range},
+    [MOOSE_COMMAND_QUEUE_MOVE] = {"queue-move", 2, "(sii)", handle_queue_move},
+    [MOOSE_COMMAND_QUEUE_MOVE_RANGE] = {"queue-move-range", 3, "(siii)",
+                                        handle_queue_move_range},
+    [MOOSE_COMMAND_QUEUE_SHUFFLE] = {"queue-shuffle", 0, "(s)", handle_queue_shuffle},
+    [MOOSE_COMMAND_QUEUE_SWAP] = {"queue-swap", 2, "(sii)", handle_queue_swap},
+    [MOOSE_COMMAND_QUEUE_SWAP_ID] = {"queue-swap-id", 2, "(sii)", handle_queue_swap_id},
+    [MOOSE_COMMAND_RANDOM] = {"random", 1, "(sb)", handle_random},
+    [MOOSE_COMMAND_REPEAT] = {"repeat", 1, "(sb)", handle_repeat},
+    [MOOSE_COMMAND_REPLAY_GAIN_MODE] = {"replay-gain-mode", 1, "(ss)",
+                                        handle_replay_gain_mode},
+    [MOOSE_COMMAND_SEEK] = {"seek", 2, "(sid)", handle_seek, MOOSE_COALESCE_SEEK},
+    [MOOSE_COMMAND_SEEKCUR] = {"seekcur", 1, "(sd)", handle_seekcur, MOOSE_COALESCE_SEEK},
+    [MOOSE_COMMAND_SEEK_ID] = {"seek-id", 2, "(sid)", handle_seek_id, MOOSE_COALESCE_SEEK},
+    [MOOSE_COMMAND_SETVOL] = {"setvol", 1, "(si)", handle_setvol, MOOSE_COALESCE_VOLUME},
+    [MOOSE_COMMAND_SINGLE] = {"single", 1, "(sb)", handle_single},
+    [MOOSE_COMMAND_STOP] = {"stop", 0, "(s)", handle_stop},
+    [MOOSE_COMMAND_N] = {NULL, 0, NULL, NULL, MOOSE_COALESCE_NEVER}};
+
+/* Not a MooseCommand, only send by moose_client_ping() */
+static const MooseHandlerField PING_HANDLER = {"ping", 0, "(s)", handle_ping,
+                                               MOOSE_COALESCE_NEVER};
+
+struct _MooseClientPipelineEntry {
+    /* Handler to call or NULL for command_list_{begin,end} */
+    const MooseHandlerField *handler;
+
+    /* Arguments, unpacked once on sending */
+    MooseClientArgs args;
+
+    /* +1 for command_list_begin, -1 for command_list_end, 0 otherwise */
+    int list_marker;
+
+    /* True if a previous batch already executed this command */
+    gboolean done;
+
+    /* True if the handler actually wrote something to the connection */
+    gboolean in_flight;
+
+    /* Result that is passed back to the job manager */
+    gboolean result;
+};
 
 gpointer moose_client_handler_iter_copy(G_GNUC_UNUSED GType boxed_type, gconstpointer src_boxed) {
     return (gpointer)src_boxed;
@@ -1117,85 +1571,251 @@ bool moose_client_handler_iter_next(MooseHandlerIter *iter) {
     return true;
 }
 
+static guint moose_client_command_hash(gconstpointer key) {
+    /* djb2, but case insensitive */
+    guint hash = 5381;
+    for(const char *c = key; *c; ++c) {
+        hash = (hash << 5) + hash + g_ascii_tolower(*c);
+    }
+    return hash;
+}
+
+static gboolean moose_client_command_equal(gconstpointer a, gconstpointer b) {
+    return g_ascii_strcasecmp(a, b) == 0;
+}
+
 static const MooseHandlerField *moose_client_find_handler(const char *command) {
-    for(int i = 0; HandlerTable[i].command; ++i) {
-        if(g_ascii_strcasecmp(command, HandlerTable[i].command) == 0) {
-            return &HandlerTable[i];
+    static GHashTable *handler_index = NULL;
+
+    if(g_once_init_enter(&handler_index)) {
+        GHashTable *index =
+            g_hash_table_new(moose_client_command_hash, moose_client_command_equal);
+        for(int i = 0; i < MOOSE_COMMAND_N; ++i) {
+            g_hash_table_insert(index, (gpointer)HandlerTable[i].command,
+                                (gpointer)&HandlerTable[i]);
         }
+        g_once_init_leave(&handler_index, index);
     }
-    return NULL;
+
+    return g_hash_table_lookup(handler_index, command);
+}
+
+static int moose_client_command_list_marker(const char *command) {
+    if(g_ascii_strcasecmp(command, "command_list_begin") == 0) {
+        return +1;
+    }
+
+    if(g_ascii_strcasecmp(command, "command_list_end") == 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static void moose_client_args_clear(MooseClientArgs *args) {
+    for(unsigned i = 0; i < G_N_ELEMENTS(args->strings); ++i) {
+        g_free(args->strings[i]);
+        args->strings[i] = NULL;
+    }
+}
+
+static gboolean moose_client_args_from_variant(const MooseHandlerField *handler,
+                                               GVariant *variant,
+                                               MooseClientArgs *args) {
+    /* Count arguments */
+    int n_arguments = g_variant_n_children(variant);
+
+    /* -1 for not counting the command itself; like the format, it must match exactly */
+    if((n_arguments - 1) != handler->num_args) {
+        moose_critical("API-Misuse: Wrong number of arguments to %s: Expected %d, Got %d\n",
+                       handler->command, handler->num_args, n_arguments - 1);
+        return false;
+    }
+
+    if(g_variant_check_format_string(variant, handler->format, FALSE) == FALSE) {
+        moose_critical("Invalid commandtype. Type %s required, got %s", handler->format,
+                       g_variant_get_type_string(variant));
+        return false;
+    }
+
+    int n_ints = 0, n_strings = 0;
+
+    /* format is "(s...)"; the argument types start after the command */
+    for(int i = 1; i <= handler->num_args; ++i) {
+        GVariant *child = g_variant_get_child_value(variant, i);
+        switch(handler->format[i + 1]) {
+        case 'i':
+            args->ints[n_ints++] = g_variant_get_int32(child);
+            break;
+        case 'd':
+            args->number = g_variant_get_double(child);
+            break;
+        case 'b':
+            args->flag = g_variant_get_boolean(child);
+            break;
+        case 's':
+            args->strings[n_strings++] = g_variant_dup_string(child, NULL);
+            break;
+        }
+        g_variant_unref(child);
+    }
+
+    return true;
 }
 
 static gboolean moose_client_execute(MooseClient *self,
-                                     GVariant *variant,
+                                     MooseClientPipelineEntry *entry,
                                      struct mpd_connection *conn) {
     g_assert(conn);
-    g_return_val_if_fail(variant, FALSE);
+    g_return_val_if_fail(entry && entry->handler, FALSE);
 
-    /* success state of the command */
-    gboolean result = FALSE;
+    if(moose_client_is_connected(self) == false) {
+        return FALSE;
+    }
 
-    /* Argument vector */
-    char *command = NULL;
-    g_variant_get_child(variant, 0, "s", &command);
+    gint64 started = g_get_monotonic_time(), span = moose_trace_begin();
+    gboolean rc = entry->handler->handler(self, conn, &entry->args);
+    moose_metrics_record_since(MOOSE_METRIC_CLIENT_COMMAND, started);
+    moose_trace_end(span, "mpd", entry->handler->command);
+    return rc;
+}
 
-    if(command == NULL) {
-        return FALSE;
+static MooseClientPipelineEntry *moose_client_entry_new(const MooseHandlerField *handler,
+                                                        int list_marker) {
+    MooseClientPipelineEntry *entry = g_slice_new0(MooseClientPipelineEntry);
+    entry->handler = handler;
+    entry->list_marker = list_marker;
+    return entry;
+}
+
+static void moose_client_entry_free(MooseClientPipelineEntry *entry) {
+    moose_client_args_clear(&entry->args);
+    g_slice_free(MooseClientPipelineEntry, entry);
+}
+
+/* Send the whole batch as one command_list_ok_begin ... command_list_end block,
+ * so all commands are in flight at the same time. The responses are then
+ * matched to the commands in the order they were send.
+ *
+ * Returns the number of entries that were resolved (starting from the first).
+ * The server aborts the list on the first ACK, so commands after a failed one
+ * were never executed and need to be retried by the caller.
+ */
+static unsigned moose_client_pipeline_run(MooseClient *self,
+                                          struct mpd_connection *conn,
+                                          GPtrArray *batch) {
+    MooseClientPrivate *priv = self->priv;
+
+    if(mpd_command_list_begin(conn, true) == false) {
+        moose_client_check_error(self, conn);
+        return batch->len;
     }
 
-    /* find out what handler to call */
-    const MooseHandlerField *handler = moose_client_find_handler(g_strstrip(command));
+    priv->pipeline.is_sending = true;
+    {
+        for(unsigned i = 0; i < batch->len; ++i) {
+            MooseClientPipelineEntry *entry = g_ptr_array_index(batch, i);
+            entry->in_flight = moose_client_execute(self, entry, conn);
+        }
+    }
+    priv->pipeline.is_sending = false;
 
-    if(handler != NULL) {
-        /* Count arguments */
-        int n_arguments = g_variant_n_children(variant);
-
-        /* -2 because: -1 for off-by-one and -1 for not counting the command itself */
-        if((n_arguments - 1) >= handler->num_args) {
-            if(moose_client_is_connected(self)) {
-                if(g_variant_check_format_string(variant, handler->format, TRUE) ==
-                   FALSE) {
-                    moose_critical("Invalid commandtype. Type %s required, got %s",
-                                   handler->format, g_variant_get_type_string(variant));
-                } else {
-                    /* Alright. */
-                    result = handler->handler(self, conn, handler->format, variant);
-                }
-            }
-        } else {
-            moose_critical("API-Misuse: Wrong number of arguments to %s: Expected %d, Got %d\n",
-                           command, handler->num_args, n_arguments - 1);
+    if(mpd_command_list_end(conn) == false) {
+        moose_client_check_error(self, conn);
+        return batch->len;
+    }
+
+    for(unsigned i = 0; i < batch->len; ++i) {
+        MooseClientPipelineEntry *entry = g_ptr_array_index(batch, i);
+        if(entry->in_flight == false) {
+            /* Handler refused to send anything, so there's no response either */
+            continue;
+        }
+
+        entry->result = mpd_response_next(conn);
+        if(entry->result == false) {
+            moose_client_check_error(self, conn);
+            return i + 1;
         }
-    } else {
-        /* No Handler found */
-        moose_critical("There is no such command: %s", command);
     }
 
-    g_free(command);
-    return result;
+    if(mpd_response_finish(conn) == false) {
+        moose_client_check_error(self, conn);
+    }
+
+    return batch->len;
 }
 
-static char moose_client_command_list_is_start_or_end(GVariant *variant) {
-    g_return_val_if_fail(variant, 0);
+static void moose_client_pipeline_flush(MooseClient *self) {
+    MooseClientPrivate *priv = self->priv;
+    GPtrArray *batch = g_ptr_array_sized_new(priv->pipeline.depth);
 
-    char status = 0;
-    char *command = NULL;
-    g_variant_get_child(variant, 0, "s", &command);
+    /* Take as many plain commands from the head as we may send at once.
+     * command_list_{begin,end} are barriers and are handled one by one. */
+    g_mutex_lock(&priv->pipeline.mutex);
+    {
+        while(batch->len < (unsigned)MAX(1, priv->pipeline.depth)) {
+            MooseClientPipelineEntry *head = g_queue_peek_head(priv->pipeline.pending);
+            if(head == NULL || head->list_marker != 0) {
+                break;
+            }
+            g_ptr_array_add(batch, g_queue_pop_head(priv->pipeline.pending));
+        }
+    }
+    g_mutex_unlock(&priv->pipeline.mutex);
 
-    if(command == NULL) {
-        return 0;
+    unsigned n_resolved = batch->len;
+    struct mpd_connection *conn = moose_client_get(self);
+    if(conn != NULL && moose_client_is_connected(self)) {
+        if(batch->len == 1) {
+            /* No need for the command list overhead */
+            MooseClientPipelineEntry *entry = g_ptr_array_index(batch, 0);
+            entry->result = moose_client_execute(self, entry, conn);
+            if(mpd_response_finish(conn) == false) {
+                // moose_client_check_error(self, conn);
+            }
+        } else if(batch->len > 1) {
+            n_resolved = moose_client_pipeline_run(self, conn, batch);
+        }
     }
+    moose_client_put(self);
 
-    if(g_ascii_strcasecmp(command, "command_list_begin") == 0) {
-        status = 1;
+    g_mutex_lock(&priv->pipeline.mutex);
+    {
+        for(unsigned i = 0; i < n_resolved; ++i) {
+            ((MooseClientPipelineEntry *)g_ptr_array_index(batch, i))->done = true;
+        }
+
+        /* Push back the unexecuted rest, keeping the original order */
+        for(unsigned i = batch->len; i > n_resolved; --i) {
+            g_queue_push_head(priv->pipeline.pending, g_ptr_array_index(batch, i - 1));
+        }
     }
+    g_mutex_unlock(&priv->pipeline.mutex);
 
-    if(g_ascii_strcasecmp(command, "command_list_end") == 0) {
-        status = -1;
+    g_ptr_array_free(batch, TRUE);
+}
+
+static gboolean moose_client_dispatch_list_command(MooseClient *self,
+                                                   MooseClientPipelineEntry *entry) {
+    /* Shall we commit? */
+    if(entry->list_marker == -1) {
+        return moose_client_command_list_commit(self);
+    }
+
+    /* Are we in command list mode? */
+    if(moose_client_command_list_is_active(self)) {
+        moose_client_command_list_append(self, entry);
+        return moose_client_is_connected(self);
+    }
+
+    /* Apparently not, shall we get into command list mode? */
+    if(entry->list_marker == +1) {
+        moose_client_command_list_begin(self);
+        return moose_client_is_connected(self);
     }
 
-    g_free(command);
-    return status;
+    return false;
 }
 
 static void *moose_client_command_dispatcher(G_GNUC_UNUSED MooseJobManager *jm,
@@ -1207,55 +1827,46 @@ static void *moose_client_command_dispatcher(G_GNUC_UNUSED MooseJobManager *jm,
     /* Success? */
     gboolean result = false;
 
-    /* Input command left to parse */
-    GVariant *input = job_data;
+    /* Entry that was created for this job */
+    MooseClientPipelineEntry *entry = job_data;
 
     /* Client to operate on */
     MooseClient *self = MOOSE_CLIENT(user_data);
+    MooseClientPrivate *priv = self->priv;
 
-    /* Free input? (since it was strdrup'd) */
-    gboolean free_input = true;
-
-    if(input == NULL) {
-        goto cleanup;
+    if(entry == NULL) {
+        return GINT_TO_POINTER(result);
     }
 
-    if(moose_client_is_connected(self) == false) {
-        goto cleanup;
-    }
+    gboolean is_done = false;
+    gboolean is_connected = moose_client_is_connected(self);
+    gboolean is_plain =
+        entry->list_marker == 0 && !moose_client_command_list_is_active(self);
 
-    /* Shall we commit? */
-    if(moose_client_command_list_is_start_or_end(input) == -1) {
-        result = moose_client_command_list_commit(self);
-        goto cleanup;
+    g_mutex_lock(&priv->pipeline.mutex);
+    {
+        is_done = entry->done;
+        if(is_done == false && (is_plain == false || is_connected == false)) {
+            /* Not pipelined; handled right here */
+            g_queue_remove(priv->pipeline.pending, entry);
+        }
     }
+    g_mutex_unlock(&priv->pipeline.mutex);
 
-    /* Are we in command list mode? */
-    if(moose_client_command_list_is_active(self)) {
-        moose_client_command_list_append(self, input);
-        result = moose_client_is_connected(self);
-        free_input = false;
-    } else if(moose_client_command_list_is_start_or_end(input) == +1) {
-        /* Apparently not, shall we get into command list mode? */
-        moose_client_command_list_begin(self);
-        result = moose_client_is_connected(self);
-    } else {
-        /* Nope, just a normal command. */
-        struct mpd_connection *conn = moose_client_get(self);
-        if(conn != NULL && moose_client_is_connected(self)) {
-            result = moose_client_execute(self, input, conn);
-            if(mpd_response_finish(conn) == false) {
-                // moose_client_check_error(self, conn);
-            }
+    if(is_done == false && is_connected) {
+        if(is_plain) {
+            /* This will execute our entry and possibly the ones after it */
+            moose_client_pipeline_flush(self);
+        } else {
+            entry->result = moose_client_dispatch_list_command(self, entry);
         }
-        moose_client_put(self);
     }
 
-cleanup:
-    if(free_input) {
-        /* Input was strdup'd */
-        g_variant_unref(input);
-    }
+    g_mutex_lock(&priv->pipeline.mutex);
+    { result = entry->result; }
+    g_mutex_unlock(&priv->pipeline.mutex);
+
+    moose_client_entry_free(entry);
     return GINT_TO_POINTER(result);
 }
 
@@ -1293,12 +1904,18 @@ static gboolean moose_client_command_list_begin(MooseClient *self) {
     return moose_client_command_list_is_active(self);
 }
 
-static void moose_client_command_list_append(MooseClient *self, GVariant *variant) {
+static void moose_client_command_list_append(MooseClient *self,
+                                             MooseClientPipelineEntry *entry) {
     g_assert(self);
 
+    /* The entry is freed by the dispatcher, so the list gets it's own copy.
+     * The strings are moved over to the copy. */
+    MooseClientPipelineEntry *copy = g_slice_dup(MooseClientPipelineEntry, entry);
+    memset(&entry->args, 0, sizeof(MooseClientArgs));
+
     /* prepend now, reverse later on commit */
     self->priv->command_list.commands =
-        g_list_prepend(self->priv->command_list.commands, (gpointer)variant);
+        g_list_prepend(self->priv->command_list.commands, copy);
 }
 
 static gboolean moose_client_command_list_commit(MooseClient *self) {
@@ -1313,9 +1930,7 @@ static gboolean moose_client_command_list_commit(MooseClient *self) {
     if(conn != NULL) {
         if(mpd_command_list_begin(conn, false) != false) {
             for(GList *iter = priv->command_list.commands; iter; iter = iter->next) {
-                GVariant *variant = iter->data;
-                moose_client_execute(self, variant, conn);
-                g_variant_unref(variant);
+                moose_client_execute(self, iter->data, conn);
             }
 
             if(mpd_command_list_end(conn) == false) {
@@ -1330,7 +1945,7 @@ static gboolean moose_client_command_list_commit(MooseClient *self) {
         }
     }
 
-    g_list_free(priv->command_list.commands);
+    g_list_free_full(priv->command_list.commands, (GDestroyNotify)moose_client_entry_free);
     priv->command_list.commands = NULL;
 
     /* Put mutex back */
@@ -1343,31 +1958,248 @@ static gboolean moose_client_command_list_commit(MooseClient *self) {
     return !moose_client_command_list_is_active(self);
 }
 
+/* Find a queued command that would be made obsolete by @entry.
+ * Only commands at the end of the queue are considered; we may look past
+ * other coalesceable commands (they do not depend on each other), but not past
+ * anything else, since e.g. a seek before and after 'next' is not the same.
+ * Needs the pipeline mutex to be held.
+ */
+static GList *moose_client_find_superseded(MooseClient *self,
+                                           MooseClientPipelineEntry *entry) {
+    if(entry->handler == NULL || entry->handler->coalesce == MOOSE_COALESCE_NEVER) {
+        return NULL;
+    }
+
+    for(GList *iter = self->priv->pipeline.pending->tail; iter; iter = iter->prev) {
+        MooseClientPipelineEntry *queued = iter->data;
+        if(queued->handler == NULL ||
+           queued->handler->coalesce == MOOSE_COALESCE_NEVER) {
+            break;
+        }
+
+        if(queued->handler->coalesce == entry->handler->coalesce) {
+            return iter;
+        }
+    }
+
+    return NULL;
+}
+
+static long moose_client_send_entry(MooseClient *self, MooseClientPipelineEntry *entry) {
+    MooseClientPrivate *priv = self->priv;
+    long job_id = -1;
+
+    if(priv->jm == NULL) {
+        moose_client_entry_free(entry);
+        return job_id;
+    }
+
+    /* Queue order and job order need to be the same */
+    g_mutex_lock(&priv->pipeline.mutex);
+    {
+        GList *superseded = moose_client_find_superseded(self, entry);
+        if(superseded != NULL) {
+            /* Still waiting for execution, so nobody will notice if we drop it.
+             * Its job will see that it's done and just report success. */
+            MooseClientPipelineEntry *queued = superseded->data;
+            queued->done = true;
+            queued->result = true;
+            g_queue_delete_link(priv->pipeline.pending, superseded);
+        }
+
+        g_queue_push_tail(priv->pipeline.pending, entry);
+        job_id = moose_job_manager_send(priv->jm, 0, entry);
+    }
+    g_mutex_unlock(&priv->pipeline.mutex);
+
+    return job_id;
+}
+
+void moose_client_ping(MooseClient *self) {
+    g_assert(self);
+
+    /* One at a time, so pings do not pile up behind a stuck server */
+    if(g_atomic_int_compare_and_exchange(&self->priv->pipeline.ping_queued, FALSE, TRUE)) {
+        if(moose_client_send_entry(self, moose_client_entry_new(&PING_HANDLER, 0)) < 0) {
+            g_atomic_int_set(&self->priv->pipeline.ping_queued, FALSE);
+        }
+    }
+}
+
 long moose_client_send_variant(MooseClient *self, GVariant *variant) {
     g_return_val_if_fail(self, -1);
+    g_return_val_if_fail(variant, -1);
+
+    long job_id = -1;
+    char *command = NULL;
+
+    if(g_variant_is_of_type(variant, G_VARIANT_TYPE_TUPLE) &&
+       g_variant_n_children(variant) > 0) {
+        GVariant *name = g_variant_get_child_value(variant, 0);
+        if(g_variant_is_of_type(name, G_VARIANT_TYPE_STRING)) {
+            command = g_variant_dup_string(name, NULL);
+        }
+        g_variant_unref(name);
+    }
+
+    if(command == NULL) {
+        moose_critical("Invalid command: %s", g_variant_get_type_string(variant));
+        return job_id;
+    }
+
+    int list_marker = moose_client_command_list_marker(g_strstrip(command));
+    const MooseHandlerField *handler = moose_client_find_handler(command);
+
+    if(list_marker != 0) {
+        job_id = moose_client_send_entry(self, moose_client_entry_new(NULL, list_marker));
+    } else if(handler != NULL) {
+        MooseClientPipelineEntry *entry = moose_client_entry_new(handler, 0);
+        if(moose_client_args_from_variant(handler, variant, &entry->args)) {
+            job_id = moose_client_send_entry(self, entry);
+        } else {
+            moose_client_entry_free(entry);
+        }
+    } else {
+        /* No Handler found */
+        moose_critical("There is no such command: %s", command);
+    }
 
-    return moose_job_manager_send(self->priv->jm, 0, g_variant_ref(variant));
+    g_free(command);
+    return job_id;
 }
 
 long moose_client_send_single(MooseClient *self, const char *command_name) {
     g_return_val_if_fail(self, -1);
 
+    int list_marker = moose_client_command_list_marker(command_name);
+    if(list_marker != 0) {
+        return moose_client_send_entry(self, moose_client_entry_new(NULL, list_marker));
+    }
+
     const MooseHandlerField *handler = moose_client_find_handler(command_name);
     if(handler != NULL) {
-        if(strcmp(handler->format, "(s)") != 0) {
+        if(handler->num_args != 0) {
             moose_warning("moose_client_send_single(\"%s\") requires arguments.",
                           command_name);
             return -1;
         }
 
-        return moose_job_manager_send(self->priv->jm, 0,
-                                      g_variant_new("(s)", command_name));
+        return moose_client_send_entry(self, moose_client_entry_new(handler, 0));
     } else {
         moose_warning("Could not find handler ,,%s``\n", command_name);
         return -1;
     }
 }
 
+/* Send @command with already packed @args, if @format is the signature of
+ * @command. The strings in @args are copied. */
+static long moose_client_send_typed(MooseClient *self,
+                                    MooseCommand command,
+                                    const char *format,
+                                    const MooseClientArgs *args) {
+    g_return_val_if_fail(self, -1);
+
+    if(command < 0 || command >= MOOSE_COMMAND_N) {
+        moose_critical("API-Misuse: No such command id: %d", command);
+        return -1;
+    }
+
+    const MooseHandlerField *handler = &HandlerTable[command];
+    if(g_strcmp0(handler->format, format) != 0) {
+        moose_critical("API-Misuse: %s takes %s, but was send as %s", handler->command,
+                       handler->format, format);
+        return -1;
+    }
+
+    /* Only the database path is optional; NULL there means everything */
+    for(int i = 0; i < 2; ++i) {
+        if(format[i + 2] == 's' && args->strings[i] == NULL &&
+           command != MOOSE_COMMAND_DATABASE_UPDATE &&
+           command != MOOSE_COMMAND_DATABASE_RESCAN) {
+            moose_critical("API-Misuse: NULL string passed to %s", handler->command);
+            return -1;
+        }
+    }
+
+    MooseClientPipelineEntry *entry = moose_client_entry_new(handler, 0);
+    entry->args = *args;
+    for(unsigned i = 0; i < G_N_ELEMENTS(args->strings); ++i) {
+        entry->args.strings[i] = g_strdup(args->strings[i]);
+    }
+
+    return moose_client_send_entry(self, entry);
+}
+
+long moose_client_send_command(MooseClient *self, MooseCommand command) {
+    MooseClientArgs args = {{0}};
+    return moose_client_send_typed(self, command, "(s)", &args);
+}
+
+long moose_client_send_command_flag(MooseClient *self, MooseCommand command,
+                                    gboolean flag) {
+    MooseClientArgs args = {.flag = flag};
+    return moose_client_send_typed(self, command, "(sb)", &args);
+}
+
+long moose_client_send_command_int(MooseClient *self, MooseCommand command, int a) {
+    MooseClientArgs args = {.ints = {a}};
+    return moose_client_send_typed(self, command, "(si)", &args);
+}
+
+long moose_client_send_command_int2(MooseClient *self, MooseCommand command, int a,
+                                    int b) {
+    MooseClientArgs args = {.ints = {a, b}};
+    return moose_client_send_typed(self, command, "(sii)", &args);
+}
+
+long moose_client_send_command_int3(MooseClient *self, MooseCommand command, int a,
+                                    int b, int c) {
+    MooseClientArgs args = {.ints = {a, b, c}};
+    return moose_client_send_typed(self, command, "(siii)", &args);
+}
+
+long moose_client_send_command_double(MooseClient *self, MooseCommand command,
+                                      double number) {
+    MooseClientArgs args = {.number = number};
+    return moose_client_send_typed(self, command, "(sd)", &args);
+}
+
+long moose_client_send_command_int_double(MooseClient *self, MooseCommand command,
+                                          int a, double number) {
+    MooseClientArgs args = {.ints = {a}, .number = number};
+    return moose_client_send_typed(self, command, "(sid)", &args);
+}
+
+long moose_client_send_command_string(MooseClient *self, MooseCommand command,
+                                      const char *string) {
+    MooseClientArgs args = {.strings = {(char *)string}};
+    return moose_client_send_typed(self, command, "(ss)", &args);
+}
+
+long moose_client_send_command_string2(MooseClient *self, MooseCommand command,
+                                       const char *string_a, const char *string_b) {
+    MooseClientArgs args = {.strings = {(char *)string_a, (char *)string_b}};
+    return moose_client_send_typed(self, command, "(sss)", &args);
+}
+
+long moose_client_send_command_string_flag(MooseClient *self, MooseCommand command,
+                                           const char *string, gboolean flag) {
+    MooseClientArgs args = {.strings = {(char *)string}, .flag = flag};
+    return moose_client_send_typed(self, command, "(ssb)", &args);
+}
+
+long moose_client_send_command_string_int(MooseClient *self, MooseCommand command,
+                                          const char *string, int a) {
+    MooseClientArgs args = {.strings = {(char *)string}, .ints = {a}};
+    return moose_client_send_typed(self, command, "(ssi)", &args);
+}
+
+long moose_client_send_command_string_int2(MooseClient *self, MooseCommand command,
+                                           const char *string, int a, int b) {
+    MooseClientArgs args = {.strings = {(char *)string}, .ints = {a, b}};
+    return moose_client_send_typed(self, command, "(ssii)", &args);
+}
+
 long moose_client_send(MooseClient *self, const char *command) {
     g_return_val_if_fail(self, -1);
 
@@ -1382,10 +2214,12 @@ long moose_client_send(MooseClient *self, const char *command) {
 #else
         moose_critical("Cannot run command: %s (exact error only available with GLib>=2.40)", command);
 #endif
+        g_error_free(error);
         return -1;
     } else {
-        int id = moose_job_manager_send(self->priv->jm, 0, parsed);
-        return id;
+        long job_id = moose_client_send_variant(self, parsed);
+        g_variant_unref(parsed);
+        return job_id;
     }
 }
 
@@ -1438,9 +2272,75 @@ long moose_client_commit(MooseClient *self) {
     return moose_client_send_single(self, "command_list_end");
 }
 
-static void moose_update_context_info_cb(MooseClient *self, MooseIdle events) {
+void moose_client_set_song_resolver(MooseClient *self,
+                                    MooseClientSongResolver resolver,
+                                    gpointer user_data) {
+    g_assert(self);
+
+    g_mutex_lock(&self->priv->resolver.mutex);
+    {
+        self->priv->resolver.func = resolver;
+        self->priv->resolver.user_data = user_data;
+    }
+    g_mutex_unlock(&self->priv->resolver.mutex);
+}
+
+static gboolean moose_client_has_song_resolver(MooseClient *self) {
+    gboolean has_resolver = FALSE;
+    g_mutex_lock(&self->priv->resolver.mutex);
+    { has_resolver = self->priv->resolver.func != NULL; }
+    g_mutex_unlock(&self->priv->resolver.mutex);
+    return has_resolver;
+}
+
+/* Returns a reffed song or NULL if the resolver does not know song_id */
+static MooseSong *moose_client_resolve_song(MooseClient *self, int song_id, unsigned queue_version) {
+    MooseSong *song = NULL;
+    g_mutex_lock(&self->priv->resolver.mutex);
+    {
+        if(self->priv->resolver.func != NULL) {
+            song = self->priv->resolver.func(
+                self, song_id, queue_version, self->priv->resolver.user_data);
+        }
+    }
+    g_mutex_unlock(&self->priv->resolver.mutex);
+    return song;
+}
+
+/* Read the response of a currentsong command; NULL if nothing is playing */
+static MooseSong *moose_client_recv_current_song(struct mpd_connection *conn) {
+    struct mpd_song *new_song_struct = mpd_recv_song(conn);
+    MooseSong *new_song = moose_song_new_from_struct(new_song_struct);
+    if(new_song_struct != NULL) {
+        mpd_song_free(new_song_struct);
+    }
+
+    /* We need to call recv() one more time
+     * so we end the songlist,
+     * it should only return  NULL
+     * */
+    if(new_song_struct != NULL) {
+        struct mpd_song *empty = mpd_recv_song(conn);
+        g_assert(empty == NULL);
+    }
+
+    return new_song;
+}
+
+static MooseStatusChange moose_client_apply_current_song(MooseClient *self, MooseSong *song) {
+    MooseStatusChange changes = MOOSE_STATUS_CHANGE_NONE;
+    MooseStatus *status = moose_client_ref_status(self);
+    if(status != NULL) {
+        changes |= moose_status_set_current_song(status, song);
+    }
+    moose_status_unref(status);
+    moose_song_unref(song);
+    return changes;
+}
+
+static MooseStatusChange moose_update_context_info_cb(MooseClient *self, MooseIdle events) {
     if(self == NULL || events == 0 || moose_client_is_connected(self) == false) {
-        return;
+        return MOOSE_STATUS_CHANGE_NONE;
     }
 
     const gboolean update_status = events & ON_STATUS_UPDATE_FLAGS;
@@ -1449,17 +2349,35 @@ static void moose_update_context_info_cb(MooseClient *self, MooseIdle events) {
     const gboolean update_rg = events & ON_REPLAYGAIN_UPDATE_FLAGS;
 
     if(!(update_status || update_stats || update_song || update_rg)) {
-        return;
+        return MOOSE_STATUS_CHANGE_NONE;
     }
 
     struct mpd_connection *conn = moose_client_get(self);
 
     if(conn == NULL) {
         moose_client_put(self);
-        return;
+        return MOOSE_STATUS_CHANGE_NONE;
     }
 
     MooseClientPrivate *priv = self->priv;
+    MooseStatusChange changes = MOOSE_STATUS_CHANGE_NONE;
+
+    /* Served from the cache if nothing changed them since the last time */
+    guint stats_epoch = 0, rg_epoch = 0;
+    GPtrArray *stats_pairs = NULL, *rg_pairs = NULL;
+    if(update_stats) {
+        stats_pairs = moose_client_cache_lookup(self, "stats", &stats_epoch);
+    }
+    if(update_rg) {
+        rg_pairs = moose_client_cache_lookup(self, "replay_gain_status", &rg_epoch);
+    }
+
+    /* If somebody (i.e. a MooseStore) can look up songs by id, the current
+     * song is taken from there and currentsong is only sent for ids it
+     * does not know. */
+    const gboolean use_resolver = update_status && moose_client_has_song_resolver(self);
+    gboolean need_current_song = update_song;
+    MooseSong *resolved_song = NULL;
 
     /* Send a block of commands, speeds the thing up by 2x */
     mpd_command_list_begin(conn, true);
@@ -1469,15 +2387,15 @@ static void moose_update_context_info_cb(MooseClient *self, MooseIdle events) {
             mpd_send_status(conn);
         }
 
-        if(update_stats) {
+        if(update_stats && stats_pairs == NULL) {
             mpd_send_stats(conn);
         }
 
-        if(update_rg) {
+        if(update_rg && rg_pairs == NULL) {
             mpd_send_command(conn, "replay_gain_status", NULL);
         }
 
-        if(update_song) {
+        if(update_song && !use_resolver) {
             mpd_send_current_song(conn);
         }
     }
@@ -1511,20 +2429,46 @@ static void moose_update_context_info_cb(MooseClient *self, MooseIdle events) {
             }
             moose_status_unref(status);
 
-            /* TODO Locking? */
-
-            /* Swap the value */
+            /* The status object lives as long as the connection,
+             * only the differing fields are written. */
             g_rec_mutex_lock(&self->priv->client_attr_mutex);
             {
-                MooseStatus *old_status = priv->status;
-                priv->status = moose_status_new_from_struct(old_status, tmp_status_struct);
-                if(old_status != NULL && !(events & MOOSE_IDLE_OUTPUT)) {
-                    moose_status_outputs_copy(priv->status, old_status);
+                if(priv->status == NULL) {
+                    priv->status = moose_status_new();
+                    changes |= MOOSE_STATUS_CHANGE_ALL;
                 }
-                moose_status_unref(old_status);
+                changes |= moose_status_update_from_struct(priv->status, tmp_status_struct);
             }
             g_rec_mutex_unlock(&self->priv->client_attr_mutex);
 
+            if(use_resolver) {
+                const unsigned queue_version = mpd_status_get_queue_version(tmp_status_struct);
+                const int song_id = mpd_status_get_song_id(tmp_status_struct);
+                const int next_song_id = mpd_status_get_next_song_id(tmp_status_struct);
+
+                if(update_song) {
+                    if(song_id < 0) {
+                        /* Nothing selected, no need to ask anyone */
+                        need_current_song = false;
+                    } else {
+                        resolved_song = moose_client_resolve_song(self, song_id, queue_version);
+                        need_current_song = (resolved_song == NULL);
+                    }
+                }
+
+                MooseSong *next_song = NULL;
+                if(next_song_id >= 0) {
+                    next_song = moose_client_resolve_song(self, next_song_id, queue_version);
+                }
+
+                MooseStatus *status = moose_client_ref_status(self);
+                if(status != NULL) {
+                    changes |= moose_status_set_next_song(status, next_song);
+                }
+                moose_status_unref(status);
+                moose_song_unref(next_song);
+            }
+
             mpd_status_free(tmp_status_struct);
         }
 
@@ -1534,57 +2478,55 @@ static void moose_update_context_info_cb(MooseClient *self, MooseIdle events) {
 
     /* Try to receive statistics as last */
     if(update_stats) {
-        struct mpd_stats *tmp_stats_struct;
-        tmp_stats_struct = mpd_recv_stats(conn);
+        if(stats_pairs == NULL) {
+            stats_pairs = moose_client_cache_recv(self, conn, "stats", stats_epoch);
+            mpd_response_next(conn);
+            moose_client_check_error(self, conn);
+        }
+
+        if(stats_pairs != NULL) {
+            struct mpd_stats *tmp_stats_struct = mpd_stats_begin();
+            for(unsigned i = 0; i + 1 < stats_pairs->len; i += 2) {
+                struct mpd_pair pair = {g_ptr_array_index(stats_pairs, i),
+                                        g_ptr_array_index(stats_pairs, i + 1)};
+                mpd_stats_feed(tmp_stats_struct, &pair);
+            }
 
-        if(tmp_stats_struct) {
             MooseStatus *status = moose_client_ref_status(self);
-            { moose_status_update_stats(status, tmp_stats_struct); }
+            if(status != NULL) {
+                changes |= moose_status_update_stats(status, tmp_stats_struct);
+            }
             moose_status_unref(status);
             mpd_stats_free(tmp_stats_struct);
+            g_ptr_array_unref(stats_pairs);
         }
-
-        mpd_response_next(conn);
-        moose_client_check_error(self, conn);
     }
 
     /* Read the current replay gain status */
     if(update_rg) {
-        struct mpd_pair *mode = mpd_recv_pair_named(conn, "replay_gain_mode");
-        if(mode != NULL) {
+        if(rg_pairs == NULL) {
+            rg_pairs = moose_client_cache_recv(self, conn, "replay_gain_status", rg_epoch);
+            mpd_response_next(conn);
+            moose_client_check_error(self, conn);
+        }
+
+        const char *mode = NULL;
+        if(rg_pairs != NULL && (mode = moose_client_pairs_lookup(rg_pairs, "replay_gain_mode"))) {
             MooseStatus *status = moose_client_ref_status(self);
             if(status != NULL) {
-                moose_status_set_replay_gain_mode(status, mode->value);
+                changes |= moose_status_set_replay_gain_mode(status, mode);
             }
-
             moose_status_unref(status);
-            mpd_return_pair(conn, mode);
         }
 
-        mpd_response_next(conn);
-        moose_client_check_error(self, conn);
+        if(rg_pairs != NULL) {
+            g_ptr_array_unref(rg_pairs);
+        }
     }
 
     /* Try to receive the current song */
-    if(update_song) {
-        struct mpd_song *new_song_struct = mpd_recv_song(conn);
-        MooseSong *new_song = moose_song_new_from_struct(new_song_struct);
-        if(new_song_struct != NULL) {
-            mpd_song_free(new_song_struct);
-        }
-
-        /* We need to call recv() one more time
-         * so we end the songlist,
-         * it should only return  NULL
-         * */
-        if(new_song_struct != NULL) {
-            struct mpd_song *empty = mpd_recv_song(conn);
-            g_assert(empty == NULL);
-        }
-
-        MooseStatus *status = moose_client_ref_status(self);
-        moose_status_set_current_song(status, new_song);
-        moose_status_unref(status);
+    if(update_song && !use_resolver) {
+        changes |= moose_client_apply_current_song(self, moose_client_recv_current_song(conn));
         moose_client_check_error(self, conn);
     }
 
@@ -1594,41 +2536,73 @@ static void moose_update_context_info_cb(MooseClient *self, MooseIdle events) {
         moose_client_check_error(self, conn);
     }
 
+    if(update_song && use_resolver) {
+        if(need_current_song) {
+            /* The resolver did not know the id (yet), ask MPD */
+            if(mpd_send_current_song(conn)) {
+                resolved_song = moose_client_recv_current_song(conn);
+            }
+            mpd_response_finish(conn);
+            moose_client_check_error(self, conn);
+        }
+        changes |= moose_client_apply_current_song(self, resolved_song);
+    }
+
     moose_client_put(self);
+    return changes;
+}
+
+static void moose_priv_outputs_add_and_free(GHashTable *outputs, struct mpd_output *output) {
+    if(output != NULL) {
+        moose_status_outputs_add(outputs,
+                    mpd_output_get_name(output),
+                    mpd_output_get_id(output),
+                    mpd_output_get_enabled(output));
+        mpd_output_free(output);
+    }
 }
 
-void moose_priv_outputs_update(MooseClient *self, MooseIdle event) {
+MooseStatusChange moose_priv_outputs_update(MooseClient *self, MooseIdle event) {
     g_assert(self);
 
     if((event & MOOSE_IDLE_OUTPUT) == 0) {
-        return /* because of no relevant event */;
+        return MOOSE_STATUS_CHANGE_NONE /* because of no relevant event */;
     }
 
+    MooseStatusChange changes = MOOSE_STATUS_CHANGE_NONE;
+
     struct mpd_connection *conn = moose_client_get(self);
-    if(conn != NULL) {
-        if(mpd_send_outputs(conn) == false) {
-            moose_client_check_error(self, conn);
-        } else {
-            struct mpd_output *output = NULL;
-            MooseStatus *status = moose_client_ref_status(self);
-            {
-                moose_status_outputs_clear(status);
-                while((output = mpd_recv_output(conn)) != NULL) {
-                    moose_status_outputs_add(status, 
-                                mpd_output_get_name(output),
-                                mpd_output_get_id(output),
-                                mpd_output_get_enabled(output));
-                    mpd_output_free(output);
-                }
+    GPtrArray *pairs = NULL;
+
+    if(conn != NULL && (pairs = moose_client_cache_run(self, conn, "outputs")) != NULL) {
+        struct mpd_output *output = NULL;
+        GHashTable *outputs = moose_status_outputs_new();
+
+        /* Every output starts with an "outputid" pair */
+        for(unsigned i = 0; i + 1 < pairs->len; i += 2) {
+            struct mpd_pair pair = {g_ptr_array_index(pairs, i),
+                                    g_ptr_array_index(pairs, i + 1)};
+
+            if(output != NULL && mpd_output_feed(output, &pair)) {
+                continue;
             }
-            moose_status_unref(status);
+
+            moose_priv_outputs_add_and_free(outputs, output);
+            output = mpd_output_begin(&pair);
         }
+        moose_priv_outputs_add_and_free(outputs, output);
 
-        if(mpd_response_finish(conn) == false) {
-            moose_client_check_error(self, conn);
+        MooseStatus *status = moose_client_ref_status(self);
+        if(status != NULL) {
+            changes |= moose_status_outputs_set(status, outputs);
+        } else {
+            g_hash_table_unref(outputs);
         }
+        moose_status_unref(status);
+        g_ptr_array_unref(pairs);
     }
     moose_client_put(self);
+    return changes;
 }
 
 static gboolean moose_update_is_a_seek_event(MooseClient *self, MooseIdle event_mask) {
@@ -1657,16 +2631,52 @@ static gboolean moose_update_is_a_seek_event(MooseClient *self, MooseIdle event_
 
 static gboolean moose_idle_client_event(gpointer user_data) {
     g_assert(user_data);
-    MooseClientEventTag *tag = user_data;
+    MooseClient *self = user_data;
+
+    ASSERT_IS_MAINTHREAD(self);
+
+    MooseIdle events = 0;
+    MooseStatusChange changes = MOOSE_STATUS_CHANGE_NONE;
+    gint64 span = moose_trace_begin();
+
+    /* Take everything accumulated so far; later events schedule anew */
+    g_mutex_lock(&self->priv->dispatch.mutex);
+    {
+        events = self->priv->dispatch.events;
+        changes = self->priv->dispatch.changes;
+        self->priv->dispatch.events = 0;
+        self->priv->dispatch.changes = MOOSE_STATUS_CHANGE_NONE;
+        self->priv->dispatch.source_id = 0;
+    }
+    g_mutex_unlock(&self->priv->dispatch.mutex);
 
-    ASSERT_IS_MAINTHREAD(tag->self);
+    g_signal_emit(self, SIGNALS[SIGNAL_CLIENT_EVENT], 0, events);
+    if(changes != MOOSE_STATUS_CHANGE_NONE) {
+        g_signal_emit(self, SIGNALS[SIGNAL_STATUS_CHANGED], 0, changes);
+    }
+    g_object_unref(self);
 
-    g_signal_emit(tag->self, SIGNALS[SIGNAL_CLIENT_EVENT], 0, tag->event);
-    g_object_unref(tag->self);
-    g_free(tag);
+    /* Includes all handlers of client-event, e.g. the ones of the UI */
+    moose_trace_end(span, "mainloop", "client-event");
     return FALSE; /* Remove this idle event */
 }
 
+/* Merge events into the pending ones; only schedules a dispatch if none is pending */
+static void moose_client_dispatch_event(MooseClient *self, MooseIdle events, MooseStatusChange changes) {
+    g_mutex_lock(&self->priv->dispatch.mutex);
+    {
+        self->priv->dispatch.events |= events;
+        self->priv->dispatch.changes |= changes;
+
+        if(self->priv->dispatch.source_id == 0) {
+            /* Make sure client still exists on the other side. */
+            self->priv->dispatch.source_id = g_idle_add_full(
+                G_PRIORITY_HIGH_IDLE, moose_idle_client_event, g_object_ref(self), NULL);
+        }
+    }
+    g_mutex_unlock(&self->priv->dispatch.mutex);
+}
+
 static gpointer moose_update_thread(gpointer user_data) {
     g_assert(user_data);
 
@@ -1675,8 +2685,14 @@ static gpointer moose_update_thread(gpointer user_data) {
 
     while((event_mask = GPOINTER_TO_INT(g_async_queue_pop(self->priv->event_queue))) !=
           MOOSE_THREAD_TERMINATOR) {
-        moose_update_context_info_cb(self, event_mask);
-        moose_priv_outputs_update(self, event_mask);
+        MooseStatusChange changes = MOOSE_STATUS_CHANGE_NONE;
+        gint64 span = moose_trace_begin();
+
+        /* Drop cached responses first, so they are fetched anew below */
+        moose_client_cache_invalidate(self, event_mask);
+
+        changes |= moose_update_context_info_cb(self, event_mask);
+        changes |= moose_priv_outputs_update(self, event_mask);
 
         /* Lookup if we need to trigger a client-event (maybe not if auto-update) */
         gboolean trigger_it = true;
@@ -1695,15 +2711,11 @@ static gpointer moose_update_thread(gpointer user_data) {
         }
 
         if(trigger_it) {
-            MooseClientEventTag *tag = g_new0(MooseClientEventTag, 1);
-
-            /* Make sure client still exists on the other side. */
-            tag->self = g_object_ref(self);
-            tag->event = event_mask;
-
             /* Defer the execution on the mainthread */
-            g_idle_add_full(G_PRIORITY_HIGH_IDLE, moose_idle_client_event, tag, NULL);
+            moose_client_dispatch_event(self, event_mask, changes);
         }
+
+        moose_trace_end(span, "client", "idle-update");
     }
 
     return NULL;
@@ -1745,6 +2757,17 @@ static void moose_client_init(MooseClient *self) {
     g_rec_mutex_init(&self->getput_mutex);
     g_rec_mutex_init(&priv->client_attr_mutex);
     g_mutex_init(&priv->status_timer.mutex);
+    g_mutex_init(&priv->pipeline.mutex);
+    g_mutex_init(&priv->resolver.mutex);
+    g_mutex_init(&priv->dispatch.mutex);
+    g_mutex_init(&priv->cache.mutex);
+    priv->cache.responses =
+        g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify)g_ptr_array_unref);
+    priv->subscriptions.masks = g_hash_table_new(NULL, NULL);
+
+    priv->pipeline.pending = g_queue_new();
+    priv->pipeline.depth = 16;
+    priv->resync.interval = 30;
 
     priv->is_virgin = true;
     priv->jm = NULL;
@@ -1805,6 +2828,14 @@ static void moose_client_finalize(GObject *gobject) {
 
     g_mutex_clear(&priv->status_timer.mutex);
 
+    g_queue_free_full(priv->pipeline.pending, (GDestroyNotify)moose_client_entry_free);
+    g_mutex_clear(&priv->pipeline.mutex);
+    g_mutex_clear(&priv->resolver.mutex);
+    g_mutex_clear(&priv->dispatch.mutex);
+    g_mutex_clear(&priv->cache.mutex);
+    g_hash_table_destroy(priv->cache.responses);
+    g_hash_table_destroy(priv->subscriptions.masks);
+
     /* Kill any previously connected host info */
     g_rec_mutex_lock(&priv->client_attr_mutex);
     if(priv->host != NULL) {
@@ -1846,6 +2877,12 @@ static void moose_client_get_property(GObject *object,
         case PROP_TIMER_ONLY_WHEN_PLAYING:
             g_value_set_boolean(value, self->priv->status_timer.only_when_playing);
             break;
+        case PROP_PIPELINE_DEPTH:
+            g_value_set_int(value, self->priv->pipeline.depth);
+            break;
+        case PROP_RESYNC_INTERVAL:
+            g_value_set_float(value, self->priv->resync.interval);
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
             break;
@@ -1882,6 +2919,15 @@ static void moose_client_set_property(GObject *object,
         case PROP_TIMER_ONLY_WHEN_PLAYING:
             self->priv->status_timer.only_when_playing = g_value_get_boolean(value);
             break;
+        case PROP_PIPELINE_DEPTH:
+            self->priv->pipeline.depth = g_value_get_int(value);
+            break;
+        case PROP_RESYNC_INTERVAL:
+            self->priv->resync.interval = g_value_get_float(value);
+            if(self->priv->resync.timeout_id != 0) {
+                moose_client_resync_schedule(self);
+            }
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
             break;
@@ -1907,6 +2953,20 @@ static void moose_client_class_init(MooseClientClass *klass) {
         "client-event", G_OBJECT_CLASS_TYPE(klass), G_SIGNAL_RUN_LAST, 0, NULL, NULL,
         g_cclosure_marshal_VOID__FLAGS, G_TYPE_NONE, 1, G_TYPE_INT);
 
+    /**
+     * MooseClient::status-changed:
+     * @client: The client.
+     * @changes: #MooseStatusChange bits of the fields that differ.
+     *
+     * Emitted right after client-event when the status, stats,
+     * current song or outputs actually changed. The #MooseStatus
+     * is updated in place, so only the fields in @changes need
+     * to be read again.
+     */
+    SIGNALS[SIGNAL_STATUS_CHANGED] = g_signal_new(
+        "status-changed", G_OBJECT_CLASS_TYPE(klass), G_SIGNAL_RUN_LAST, 0, NULL, NULL,
+        g_cclosure_marshal_VOID__FLAGS, G_TYPE_NONE, 1, MOOSE_TYPE_STATUS_CHANGE);
+
     /**
      * MooseClient::connectivity:
      * @client: The client.
@@ -2005,6 +3065,42 @@ static void moose_client_class_init(MooseClientClass *klass) {
      * Timer Interval, after which the status is force-updated.
      */
     g_object_class_install_property(gobject_class, PROP_TIMER_ONLY_WHEN_PLAYING, pspec);
+
+    pspec = g_param_spec_int("pipeline-depth",
+                             "Pipeline depth",
+                             "Max. number of commands that are in flight at the same time",
+                             1,        /* Minimum value */
+                             G_MAXINT, /* Maximum value */
+                             16,       /* Default value */
+                             G_PARAM_READWRITE);
+
+    /**
+     * MooseClient:pipeline-depth: (type int)
+     *
+     * Commands that queue up while another one is executed are send together
+     * and their responses are matched in order. This is the max. number
+     * of commands that are send in one go. 1 disables pipelining.
+     */
+    g_object_class_install_property(gobject_class, PROP_PIPELINE_DEPTH, pspec);
+
+    pspec = g_param_spec_float("resync-interval",
+                               "Resync interval",
+                               "Max. seconds between two status updates while playing",
+                               0,          /* Minimum value */
+                               G_MAXFLOAT, /* Maximum value */
+                               30,         /* Default value */
+                               G_PARAM_READWRITE);
+
+    /**
+     * MooseClient:resync-interval: (type float)
+     *
+     * The elapsed time is interpolated locally
+     * (see moose_status_get_elapsed_ms_interpolated()), and the status is
+     * only updated on events. As safety net against drift the status is
+     * refreshed while playing when it's older than this many seconds.
+     * 0 disables it.
+     */
+    g_object_class_install_property(gobject_class, PROP_RESYNC_INTERVAL, pspec);
 }
 
 GType moose_idle_get_type(void) {
@@ -2049,3 +3145,59 @@ GType moose_protocol_get_type(void) {
 
     return enum_type;
 }
+
+GType moose_command_get_type(void) {
+    static GType enum_type = 0;
+
+    if(enum_type == 0) {
+        static GEnumValue command_types[] = {
+            {MOOSE_COMMAND_CONSUME, "MOOSE_COMMAND_CONSUME", "consume"},
+            {MOOSE_COMMAND_CROSSFADE, "MOOSE_COMMAND_CROSSFADE", "crossfade"},
+            {MOOSE_COMMAND_DATABASE_RESCAN, "MOOSE_COMMAND_DATABASE_RESCAN", "database-rescan"},
+            {MOOSE_COMMAND_DATABASE_UPDATE, "MOOSE_COMMAND_DATABASE_UPDATE", "database-update"},
+            {MOOSE_COMMAND_MIXRAMDB, "MOOSE_COMMAND_MIXRAMDB", "mixramdb"},
+            {MOOSE_COMMAND_MIXRAMDELAY, "MOOSE_COMMAND_MIXRAMDELAY", "mixramdelay"},
+            {MOOSE_COMMAND_NEXT, "MOOSE_COMMAND_NEXT", "next"},
+            {MOOSE_COMMAND_OUTPUT_SWITCH, "MOOSE_COMMAND_OUTPUT_SWITCH", "output-switch"},
+            {MOOSE_COMMAND_PASSWORD, "MOOSE_COMMAND_PASSWORD", "password"},
+            {MOOSE_COMMAND_PAUSE, "MOOSE_COMMAND_PAUSE", "pause"},
+            {MOOSE_COMMAND_PLAY, "MOOSE_COMMAND_PLAY", "play"},
+            {MOOSE_COMMAND_PLAY_ID, "MOOSE_COMMAND_PLAY_ID", "play-id"},
+            {MOOSE_COMMAND_PLAYLIST_ADD, "MOOSE_COMMAND_PLAYLIST_ADD", "playlist-add"},
+            {MOOSE_COMMAND_PLAYLIST_CLEAR, "MOOSE_COMMAND_PLAYLIST_CLEAR", "playlist-clear"},
+            {MOOSE_COMMAND_PLAYLIST_DELETE, "MOOSE_COMMAND_PLAYLIST_DELETE", "playlist-delete"},
+            {MOOSE_COMMAND_PLAYLIST_LOAD, "MOOSE_COMMAND_PLAYLIST_LOAD", "playlist-load"},
+            {MOOSE_COMMAND_PLAYLIST_MOVE, "MOOSE_COMMAND_PLAYLIST_MOVE", "playlist-move"},
+            {MOOSE_COMMAND_PLAYLIST_RENAME, "MOOSE_COMMAND_PLAYLIST_RENAME", "playlist-rename"},
+            {MOOSE_COMMAND_PLAYLIST_RM, "MOOSE_COMMAND_PLAYLIST_RM", "playlist-rm"},
+            {MOOSE_COMMAND_PLAYLIST_SAVE, "MOOSE_COMMAND_PLAYLIST_SAVE", "playlist-save"},
+            {MOOSE_COMMAND_PREVIOUS, "MOOSE_COMMAND_PREVIOUS", "previous"},
+            {MOOSE_COMMAND_PRIO, "MOOSE_COMMAND_PRIO", "prio"},
+            {MOOSE_COMMAND_PRIO_ID, "MOOSE_COMMAND_PRIO_ID", "prio-id"},
+            {MOOSE_COMMAND_PRIO_RANGE, "MOOSE_COMMAND_PRIO_RANGE", "prio-range"},
+            {MOOSE_COMMAND_QUEUE_ADD, "MOOSE_COMMAND_QUEUE_ADD", "queue-add"},
+            {MOOSE_COMMAND_QUEUE_CLEAR, "MOOSE_COMMAND_QUEUE_CLEAR", "queue-clear"},
+            {MOOSE_COMMAND_QUEUE_DELETE, "MOOSE_COMMAND_QUEUE_DELETE", "queue-delete"},
+            {MOOSE_COMMAND_QUEUE_DELETE_ID, "MOOSE_COMMAND_QUEUE_DELETE_ID", "queue-delete-id"},
+            {MOOSE_COMMAND_QUEUE_DELETE_RANGE, "MOOSE_COMMAND_QUEUE_DELETE_RANGE", "queue-delete-range"},
+            {MOOSE_COMMAND_QUEUE_MOVE, "MOOSE_COMMAND_QUEUE_MOVE", "queue-move"},
+            {MOOSE_COMMAND_QUEUE_MOVE_RANGE, "MOOSE_COMMAND_QUEUE_MOVE_RANGE", "queue-move-range"},
+            {MOOSE_COMMAND_QUEUE_SHUFFLE, "MOOSE_COMMAND_QUEUE_SHUFFLE", "queue-shuffle"},
+            {MOOSE_COMMAND_QUEUE_SWAP, "MOOSE_COMMAND_QUEUE_SWAP", "queue-swap"},
+            {MOOSE_COMMAND_QUEUE_SWAP_ID, "MOOSE_COMMAND_QUEUE_SWAP_ID", "queue-swap-id"},
+            {MOOSE_COMMAND_RANDOM, "MOOSE_COMMAND_RANDOM", "random"},
+            {MOOSE_COMMAND_REPEAT, "MOOSE_COMMAND_REPEAT", "repeat"},
+            {MOOSE_COMMAND_REPLAY_GAIN_MODE, "MOOSE_COMMAND_REPLAY_GAIN_MODE", "replay-gain-mode"},
+            {MOOSE_COMMAND_SEEK, "MOOSE_COMMAND_SEEK", "seek"},
+            {MOOSE_COMMAND_SEEKCUR, "MOOSE_COMMAND_SEEKCUR", "seekcur"},
+            {MOOSE_COMMAND_SEEK_ID, "MOOSE_COMMAND_SEEK_ID", "seek-id"},
+            {MOOSE_COMMAND_SETVOL, "MOOSE_COMMAND_SETVOL", "setvol"},
+            {MOOSE_COMMAND_SINGLE, "MOOSE_COMMAND_SINGLE", "single"},
+            {MOOSE_COMMAND_STOP, "MOOSE_COMMAND_STOP", "stop"},
+            {0, NULL, NULL}};
+
+        enum_type = g_enum_register_static("MooseCommand", command_types);
+    }
+
+    return enum_type;
+}
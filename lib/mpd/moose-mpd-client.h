@@ -13,6 +13,11 @@
  * If the state of the server changes, the 'client-event' is changed with the
  * appropiate event. Once the signal handler is called, it is guaranteed, that
  * a #MooseStatus can be retrieved with moose_client_ref_status().
+ * The #MooseStatus is updated in place; if something in it actually changed,
+ * 'status-changed' follows with a #MooseStatusChange mask telling which
+ * fields need to be redrawn.
+ * Events that pile up while the mainloop is busy are merged and delivered
+ * as one 'client-event' with the combined #MooseIdle mask.
  *
  * Commands can be asynchronously send to the server via the moose_client_send()
  * method. If you're interested if the command could be executed correctly,
@@ -20,6 +25,17 @@
  * moose_client_run in the first place. Normally this is not needed though,
  * since most error handling and logging is done for you.
  *
+ * Commands that queue up while another one is executed are pipelined:
+ * They are written to the connection in one go and the responses are matched
+ * in order afterwards, so a burst of commands costs one roundtrip instead of
+ * one per command. Every command still gets it's own result.
+ * See the "pipeline-depth" property.
+ *
+ * Commands where only the last value matters (setvol, crossfade, and the seek
+ * family) replace a still-queued command of the same kind instead of being
+ * queued after it. This keeps e.g. a dragged volume slider from flooding the
+ * server with stale values. The replaced command reports success.
+ *
  * The send-mechanism can be used together with command-lists.
  * A bunch of commands can be queued and executed at once. This is useful in
  * particular when executing many commands (like 'add' at once)
@@ -89,6 +105,109 @@ typedef enum MooseIdle {
     MOOSE_IDLE_EVERYTHING = UINT_MAX
 } MooseIdle;
 
+/**
+ * MooseCommand:
+ *
+ * All commands that can be send with moose_client_send_command() and its
+ * variants. The arguments that need to be passed are noted for each command.
+ * The command name that is accepted by moose_client_send() is the
+ * lowercase name with '-' instead of '_' (e.g. "queue-delete-range").
+ */
+typedef enum MooseCommand {
+    /* gboolean mode */
+    MOOSE_COMMAND_CONSUME,
+    /* double seconds */
+    MOOSE_COMMAND_CROSSFADE,
+    /* const char *path (NULL for everything) */
+    MOOSE_COMMAND_DATABASE_RESCAN,
+    /* const char *path (NULL for everything) */
+    MOOSE_COMMAND_DATABASE_UPDATE,
+    /* double decibel */
+    MOOSE_COMMAND_MIXRAMDB,
+    /* double seconds */
+    MOOSE_COMMAND_MIXRAMDELAY,
+    /* no arguments */
+    MOOSE_COMMAND_NEXT,
+    /* const char *output_name, gboolean mode */
+    MOOSE_COMMAND_OUTPUT_SWITCH,
+    /* const char *password */
+    MOOSE_COMMAND_PASSWORD,
+    /* no arguments */
+    MOOSE_COMMAND_PAUSE,
+    /* no arguments */
+    MOOSE_COMMAND_PLAY,
+    /* int id */
+    MOOSE_COMMAND_PLAY_ID,
+    /* const char *name, const char *uri */
+    MOOSE_COMMAND_PLAYLIST_ADD,
+    /* const char *name */
+    MOOSE_COMMAND_PLAYLIST_CLEAR,
+    /* const char *name, int pos */
+    MOOSE_COMMAND_PLAYLIST_DELETE,
+    /* const char *name */
+    MOOSE_COMMAND_PLAYLIST_LOAD,
+    /* const char *name, int old_pos, int new_pos */
+    MOOSE_COMMAND_PLAYLIST_MOVE,
+    /* const char *old_name, const char *new_name */
+    MOOSE_COMMAND_PLAYLIST_RENAME,
+    /* const char *name */
+    MOOSE_COMMAND_PLAYLIST_RM,
+    /* const char *name */
+    MOOSE_COMMAND_PLAYLIST_SAVE,
+    /* no arguments */
+    MOOSE_COMMAND_PREVIOUS,
+    /* int prio, int pos */
+    MOOSE_COMMAND_PRIO,
+    /* int prio, int id */
+    MOOSE_COMMAND_PRIO_ID,
+    /* int prio, int start_pos, int end_pos */
+    MOOSE_COMMAND_PRIO_RANGE,
+    /* const char *uri */
+    MOOSE_COMMAND_QUEUE_ADD,
+    /* no arguments */
+    MOOSE_COMMAND_QUEUE_CLEAR,
+    /* int pos */
+    MOOSE_COMMAND_QUEUE_DELETE,
+    /* int id */
+    MOOSE_COMMAND_QUEUE_DELETE_ID,
+    /* int start_pos, int end_pos */
+    MOOSE_COMMAND_QUEUE_DELETE_RANGE,
+    /* int old_id, int new_id */
+    MOOSE_COMMAND_QUEUE_MOVE,
+    /* int start_pos, int end_pos, int new_pos */
+    MOOSE_COMMAND_QUEUE_MOVE_RANGE,
+    /* no arguments */
+    MOOSE_COMMAND_QUEUE_SHUFFLE,
+    /* int pos_a, int pos_b */
+    MOOSE_COMMAND_QUEUE_SWAP,
+    /* int id_a, int id_b */
+    MOOSE_COMMAND_QUEUE_SWAP_ID,
+    /* gboolean mode */
+    MOOSE_COMMAND_RANDOM,
+    /* gboolean mode */
+    MOOSE_COMMAND_REPEAT,
+    /* const char *mode */
+    MOOSE_COMMAND_REPLAY_GAIN_MODE,
+    /* int pos, double seconds */
+    MOOSE_COMMAND_SEEK,
+    /* double seconds */
+    MOOSE_COMMAND_SEEKCUR,
+    /* int id, double seconds */
+    MOOSE_COMMAND_SEEK_ID,
+    /* int volume */
+    MOOSE_COMMAND_SETVOL,
+    /* gboolean mode */
+    MOOSE_COMMAND_SINGLE,
+    /* no arguments */
+    MOOSE_COMMAND_STOP,
+
+    /*< private >*/
+    MOOSE_COMMAND_N
+} MooseCommand;
+
+#define MOOSE_TYPE_COMMAND (moose_command_get_type())
+GType moose_command_get_type(void);
+
 typedef struct MooseHandlerIter {
     const char *command;
     const char *format;
@@ -163,6 +282,12 @@ typedef struct _MooseClient {
      */
     gboolean (*do_is_connected)(struct _MooseClient *self);
 
+    /* Called with the connection taken after the subscriptions changed;
+     * make the server idle on the new mask soon. May be NULL, then
+     * putting the connection back has to do it.
+     */
+    void (*do_resubscribe)(struct _MooseClient *self);
+
     GRecMutex getput_mutex;
 } MooseClient;
 
@@ -199,6 +324,8 @@ MooseClient *moose_client_new(MooseProtocol protocol);
  * A 'connectivity' signal is triggered on success.
  *
  * Any Errors will be logged through GLib's logging system.
+ * If the connection breaks later on, the client reconnects to the same
+ * server on its own, with a growing delay (up to 32 seconds) between attempts.
  *
  * Returns: True on success.
  */
@@ -246,7 +373,8 @@ gboolean moose_client_is_connected(MooseClient *self);
  *
  * Disconnects from the previous server. On successful disconenct
  * a 'connectivity' signal is emitted.
- * That's a no-op if the client is already disconnected.
+ * That's a no-op if the client is already disconnected,
+ * but it stops any pending attempt to reconnect.
  *
  * Returns: True on succesful disconenct.
  */
@@ -273,6 +401,43 @@ void moose_client_unref(MooseClient *self);
  */
 void moose_client_force_sync(MooseClient *self, MooseIdle events);
 
+/**
+ * moose_client_subscribe:
+ * @self: a #MooseClient
+ * @events: the #MooseIdle events this consumer is interested in.
+ *
+ * Register interest in a set of events. The client only idles on the
+ * union of all subscribed events and the events it needs to keep the
+ * #MooseStatus current (player, mixer, options, outputs, queue, database
+ * and update), so server activity nobody subscribed to (i.e. stickers or
+ * messages) does not wake it up at all.
+ * As long as nobody subscribed, all events are delivered.
+ *
+ * Note that a #MooseStore subscribes to the events it needs itself,
+ * so other consumers on the same client should subscribe too.
+ *
+ * Returns: an id to pass to moose_client_unsubscribe().
+ */
+guint moose_client_subscribe(MooseClient *self, MooseIdle events);
+
+/**
+ * moose_client_unsubscribe:
+ * @self: a #MooseClient
+ * @subscription_id: an id returned by moose_client_subscribe()
+ *
+ * Remove a subscription again.
+ */
+void moose_client_unsubscribe(MooseClient *self, guint subscription_id);
+
+/**
+ * moose_client_get_idle_mask:
+ * @self: a #MooseClient
+ *
+ * Returns: the union of all subscribed events and the ones the status
+ * needs, or MOOSE_IDLE_ALL if nobody subscribed.
+ */
+MooseIdle moose_client_get_idle_mask(MooseClient *self);
+
 /**
  * moose_client_get_host:
  * @self: a #MooseClient
@@ -311,6 +476,8 @@ float moose_client_get_timeout(MooseClient *self);
  * The status timer updates the #MooseStatus in a fixed interval or whenever an
  * event occurs. This is useful if you want to display the changing kbit-rate
  * of a song. In any other case, normal event-based updating should be enough.
+ * Note that you do not need it for displaying the elapsed time; use
+ * moose_status_get_elapsed_ms_interpolated() for that.
  *
  * See also the "timer-trigger-event" and "timer-interval" properties.
  */
@@ -375,6 +542,180 @@ long moose_client_send_single(MooseClient *self, const char *command_name);
  */
 long moose_client_send_variant(MooseClient *self, GVariant *variant);
 
+/**
+ * moose_client_send_command:
+ * @self: a #MooseClient
+ * @command: a #MooseCommand that takes no arguments
+ *
+ * Typed version of moose_client_send(). Nothing needs to be parsed here,
+ * so this and the moose_client_send_command_*() variants below are the
+ * preferred way to send commands, especially often send ones like
+ * MOOSE_COMMAND_SETVOL or MOOSE_COMMAND_SEEKCUR.
+ *
+ * There is one variant for each kind of arguments; the documentation of
+ * #MooseCommand tells which one a command needs. Passing a command to the
+ * wrong variant is refused. Use moose_client_recv() to wait for the result.
+ *
+ * Returns: A unique job-id or -1 on invalid arguments.
+ */
+long moose_client_send_command(MooseClient *self, MooseCommand command);
+
+/**
+ * moose_client_send_command_flag:
+ * @self: a #MooseClient
+ * @command: a #MooseCommand taking a #gboolean (e.g. MOOSE_COMMAND_RANDOM)
+ * @flag: the argument
+ *
+ * See moose_client_send_command().
+ *
+ * Returns: A unique job-id or -1 on invalid arguments.
+ */
+long moose_client_send_command_flag(MooseClient *self, MooseCommand command,
+                                    gboolean flag);
+
+/**
+ * moose_client_send_command_int:
+ * @self: a #MooseClient
+ * @command: a #MooseCommand taking one int (e.g. MOOSE_COMMAND_SETVOL)
+ * @a: the argument
+ *
+ * See moose_client_send_command().
+ *
+ * Returns: A unique job-id or -1 on invalid arguments.
+ */
+long moose_client_send_command_int(MooseClient *self, MooseCommand command, int a);
+
+/**
+ * moose_client_send_command_int2:
+ * @self: a #MooseClient
+ * @command: a #MooseCommand taking two ints (e.g. MOOSE_COMMAND_QUEUE_SWAP)
+ * @a: the first argument
+ * @b: the second argument
+ *
+ * See moose_client_send_command().
+ *
+ * Returns: A unique job-id or -1 on invalid arguments.
+ */
+long moose_client_send_command_int2(MooseClient *self, MooseCommand command, int a,
+                                    int b);
+
+/**
+ * moose_client_send_command_int3:
+ * @self: a #MooseClient
+ * @command: a #MooseCommand taking three ints (e.g. MOOSE_COMMAND_PRIO_RANGE)
+ * @a: the first argument
+ * @b: the second argument
+ * @c: the third argument
+ *
+ * See moose_client_send_command().
+ *
+ * Returns: A unique job-id or -1 on invalid arguments.
+ */
+long moose_client_send_command_int3(MooseClient *self, MooseCommand command, int a,
+                                    int b, int c);
+
+/**
+ * moose_client_send_command_double:
+ * @self: a #MooseClient
+ * @command: a #MooseCommand taking a double (e.g. MOOSE_COMMAND_SEEKCUR)
+ * @number: the argument
+ *
+ * See moose_client_send_command().
+ *
+ * Returns: A unique job-id or -1 on invalid arguments.
+ */
+long moose_client_send_command_double(MooseClient *self, MooseCommand command,
+                                      double number);
+
+/**
+ * moose_client_send_command_int_double:
+ * @self: a #MooseClient
+ * @command: a #MooseCommand taking an int and a double (e.g. MOOSE_COMMAND_SEEK_ID)
+ * @a: the first argument
+ * @number: the second argument
+ *
+ * See moose_client_send_command().
+ *
+ * Returns: A unique job-id or -1 on invalid arguments.
+ */
+long moose_client_send_command_int_double(MooseClient *self, MooseCommand command,
+                                          int a, double number);
+
+/**
+ * moose_client_send_command_string:
+ * @self: a #MooseClient
+ * @command: a #MooseCommand taking a string (e.g. MOOSE_COMMAND_QUEUE_ADD)
+ * @string: (allow-none): the argument; may only be NULL for
+ *          MOOSE_COMMAND_DATABASE_UPDATE and MOOSE_COMMAND_DATABASE_RESCAN,
+ *          meaning the whole database.
+ *
+ * See moose_client_send_command().
+ *
+ * Returns: A unique job-id or -1 on invalid arguments.
+ */
+long moose_client_send_command_string(MooseClient *self, MooseCommand command,
+                                      const char *string);
+
+/**
+ * moose_client_send_command_string2:
+ * @self: a #MooseClient
+ * @command: a #MooseCommand taking two strings (e.g. MOOSE_COMMAND_PLAYLIST_ADD)
+ * @string_a: the first argument
+ * @string_b: the second argument
+ *
+ * See moose_client_send_command().
+ *
+ * Returns: A unique job-id or -1 on invalid arguments.
+ */
+long moose_client_send_command_string2(MooseClient *self, MooseCommand command,
+                                       const char *string_a, const char *string_b);
+
+/**
+ * moose_client_send_command_string_flag:
+ * @self: a #MooseClient
+ * @command: a #MooseCommand taking a string and a #gboolean
+ *           (e.g. MOOSE_COMMAND_OUTPUT_SWITCH)
+ * @string: the first argument
+ * @flag: the second argument
+ *
+ * See moose_client_send_command().
+ *
+ * Returns: A unique job-id or -1 on invalid arguments.
+ */
+long moose_client_send_command_string_flag(MooseClient *self, MooseCommand command,
+                                           const char *string, gboolean flag);
+
+/**
+ * moose_client_send_command_string_int:
+ * @self: a #MooseClient
+ * @command: a #MooseCommand taking a string and an int
+ *           (e.g. MOOSE_COMMAND_PLAYLIST_DELETE)
+ * @string: the first argument
+ * @a: the second argument
+ *
+ * See moose_client_send_command().
+ *
+ * Returns: A unique job-id or -1 on invalid arguments.
+ */
+long moose_client_send_command_string_int(MooseClient *self, MooseCommand command,
+                                          const char *string, int a);
+
+/**
+ * moose_client_send_command_string_int2:
+ * @self: a #MooseClient
+ * @command: a #MooseCommand taking a string and two ints
+ *           (e.g. MOOSE_COMMAND_PLAYLIST_MOVE)
+ * @string: the first argument
+ * @a: the second argument
+ * @b: the third argument
+ *
+ * See moose_client_send_command().
+ *
+ * Returns: A unique job-id or -1 on invalid arguments.
+ */
+long moose_client_send_command_string_int2(MooseClient *self, MooseCommand command,
+                                           const char *string, int a, int b);
+
 /**
  * moose_client_recv:
  * @self: a #MooseClient
@@ -14,6 +14,17 @@ G_BEGIN_DECLS
  * */
 MooseSong* moose_song_new_from_struct(struct mpd_song* song);
 
+/* moose_song_new_from_struct_masked: skip:
+ * @song: The mpd_song to convert.
+ * @tag_mask: Bit (1 << tag) set for each #MooseTagType to keep;
+ *            G_MAXUINT keeps all of them.
+ *
+ * Like moose_song_new_from_struct(), but drops all other tags.
+ *
+ * Returns: a newly allocated #MooseSong with a refcount of 1
+ * */
+MooseSong* moose_song_new_from_struct_masked(struct mpd_song* song, unsigned tag_mask);
+
 /* moose_song_convert: skip:
  * @self: an empty #MooseSong
  * @song: The mpd_song to convert.
@@ -22,6 +33,24 @@ MooseSong* moose_song_new_from_struct(struct mpd_song* song);
  * */
 void moose_song_convert(MooseSong* self, struct mpd_song* song);
 
+/* moose_song_get_instance_size: skip:
+ *
+ * Returns: the bytes one #MooseSong takes without its strings.
+ * */
+gsize moose_song_get_instance_size(void);
+
+/* moose_song_new_shared: skip:
+ * @origin: The song to share the uri and tags with.
+ *
+ * Create a song with the same uri, tags, duration and modification time as
+ * @origin, but with its own queue pos, id and prio. The strings are not
+ * copied but borrowed from @origin, so @origin's uri and tags must not be
+ * changed afterwards (setting them on the new song copies them first).
+ *
+ * Returns: a newly allocated #MooseSong with a refcount of 1
+ * */
+MooseSong* moose_song_new_shared(MooseSong* origin);
+
 /**
  * moose_song_set_prio:
  * @self: a #MooseSong
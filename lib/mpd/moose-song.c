@@ -30,6 +30,12 @@ typedef struct _MooseSongPrivate {
      * The priority of this song within the queue.
      */
     unsigned prio;
+
+    /**
+     * If not NULL, uri and tags are borrowed from this song,
+     * which is kept alive by a reference. See moose_song_new_shared().
+     */
+    MooseSong* origin;
 } MooseSongPrivate;
 
 G_DEFINE_TYPE_WITH_PRIVATE(MooseSong, moose_song, G_TYPE_OBJECT);
@@ -108,10 +114,14 @@ static void moose_song_finalize(GObject* gobject) {
         return;
     }
 
-    for(size_t i = 0; i < MOOSE_TAG_COUNT; ++i) {
-        g_free(self->priv->tags[i]);
+    if(self->priv->origin != NULL) {
+        g_object_unref(self->priv->origin);
+    } else {
+        for(size_t i = 0; i < MOOSE_TAG_COUNT; ++i) {
+            g_free(self->priv->tags[i]);
+        }
+        g_free(self->priv->uri);
     }
-    g_free(self->priv->uri);
 
     /* Always chain up to the parent class; as with dispose(), finalize()
      * is guaranteed to exist on the parent's class virtual function table
@@ -178,9 +188,27 @@ char* moose_song_get_tag(MooseSong* self, MooseTagType tag) {
     return self->priv->tags[tag];
 }
 
+/* Take a private copy of borrowed strings before changing one of them */
+static void moose_song_unshare(MooseSong* self) {
+    MooseSongPrivate* priv = self->priv;
+    if(priv->origin == NULL) {
+        return;
+    }
+
+    for(size_t i = 0; i < MOOSE_TAG_COUNT; ++i) {
+        priv->tags[i] = g_strdup(priv->tags[i]);
+    }
+    priv->uri = g_strdup(priv->uri);
+
+    g_object_unref(priv->origin);
+    priv->origin = NULL;
+}
+
 void moose_song_set_tag(MooseSong* self, MooseTagType tag, const char* value) {
     g_return_if_fail(tag >= 0 && tag < MOOSE_TAG_COUNT);
 
+    moose_song_unshare(self);
+
     if(self->priv->tags[tag]) {
         g_free(self->priv->tags[tag]);
     }
@@ -194,6 +222,7 @@ const char* moose_song_get_uri(MooseSong* self) {
 
 void moose_song_set_uri(MooseSong* self, const char* uri) {
     g_assert(self);
+    moose_song_unshare(self);
     if(self->priv->uri) {
         g_free(self->priv->uri);
     }
@@ -250,11 +279,16 @@ void moose_song_set_prio(MooseSong* self, unsigned prio) {
     self->priv->prio = prio;
 }
 
-void moose_song_convert(MooseSong* self, struct mpd_song* song) {
+static void moose_song_convert_masked(MooseSong* self, struct mpd_song* song,
+                                      unsigned tag_mask) {
     g_assert(self);
     g_assert(song);
 
     for(size_t i = 0; i < MOOSE_TAG_COUNT; ++i) {
+        if(tag_mask != G_MAXUINT && (i >= 32 || (tag_mask & (1u << i)) == 0)) {
+            continue;
+        }
+
         const char* value = mpd_song_get_tag(song, i, 0);
         if(value != NULL) {
             moose_song_set_tag(self, i, value);
@@ -273,13 +307,47 @@ void moose_song_convert(MooseSong* self, struct mpd_song* song) {
 #endif
 }
 
+void moose_song_convert(MooseSong* self, struct mpd_song* song) {
+    moose_song_convert_masked(self, song, G_MAXUINT);
+}
+
 MooseSong* moose_song_new_from_struct(struct mpd_song* song) {
+    return moose_song_new_from_struct_masked(song, G_MAXUINT);
+}
+
+MooseSong* moose_song_new_from_struct_masked(struct mpd_song* song, unsigned tag_mask) {
     if(song == NULL) {
         return NULL;
     }
 
     MooseSong* self = moose_song_new();
-    moose_song_convert(self, song);
+    moose_song_convert_masked(self, song, tag_mask);
+    return self;
+}
+
+gsize moose_song_get_instance_size(void) {
+    return sizeof(MooseSong) + sizeof(MooseSongPrivate);
+}
+
+MooseSong* moose_song_new_shared(MooseSong* origin) {
+    g_return_val_if_fail(origin != NULL, NULL);
+
+    /* Always borrow from the song owning the strings, never build chains */
+    if(origin->priv->origin != NULL) {
+        origin = origin->priv->origin;
+    }
+
+    MooseSong* self = moose_song_new();
+    MooseSongPrivate* priv = self->priv;
+
+    priv->origin = g_object_ref(origin);
+    priv->uri = origin->priv->uri;
+    memcpy(priv->tags, origin->priv->tags, sizeof(priv->tags));
+
+    priv->duration = origin->priv->duration;
+    priv->last_modified = origin->priv->last_modified;
+    priv->pos = -1;
+    priv->id = -1;
     return self;
 }
 
@@ -5,17 +5,14 @@
 
 G_BEGIN_DECLS
 
-void moose_status_update_stats(const MooseStatus* self, const struct mpd_stats* stats);
-void moose_status_set_replay_gain_mode(const MooseStatus* self, const char* mode);
-void moose_status_set_current_song(MooseStatus* self, const MooseSong* song);
-void moose_status_outputs_clear(const MooseStatus* self);
-void moose_status_outputs_copy(MooseStatus *self, const MooseStatus *other);
-void moose_status_outputs_add(
-    const MooseStatus *self,
-    const char *name,
-    int id,
-    bool enabled
-);
+MooseStatusChange moose_status_update_stats(const MooseStatus* self, const struct mpd_stats* stats);
+MooseStatusChange moose_status_set_replay_gain_mode(const MooseStatus* self, const char* mode);
+MooseStatusChange moose_status_set_current_song(MooseStatus* self, const MooseSong* song);
+MooseStatusChange moose_status_set_next_song(MooseStatus* self, const MooseSong* song);
+gint64 moose_status_get_elapsed_timestamp(const MooseStatus* self);
+GHashTable *moose_status_outputs_new(void);
+void moose_status_outputs_add(GHashTable *outputs, const char *name, int id, bool enabled);
+MooseStatusChange moose_status_outputs_set(const MooseStatus *self, GHashTable *outputs);
 
 G_END_DECLS
 
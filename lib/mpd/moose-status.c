@@ -2,11 +2,16 @@
 #include <string.h>
 
 #include "moose-status.h"
-
-typedef struct _MooseStatusPrivate {
-    /** Locked if the Status is "in use", i.e. attributes are being set */
-    GRWLock ref_lock;
-
+#include "moose-status-private.h"
+
+/*
+ * The actual values of a MooseStatus.
+ *
+ * A published MooseStatusData is never modified again (apart from its reader
+ * count). Writers copy the current one, change the copy and swap the pointer,
+ * so readers can use whatever snapshot they loaded without holding a lock.
+ */
+typedef struct _MooseStatusData {
     /** 0-100, or MOOSE_STATUS_NO_VOLUME when there is no volume support */
     int volume;
 
@@ -68,6 +73,12 @@ typedef struct _MooseStatusPrivate {
      */
     unsigned elapsed_ms;
 
+    /**
+     * Monotonic time (in microseconds) when elapsed_ms was reported.
+     * Used to interpolate the elapsed time locally.
+     */
+    gint64 elapsed_timestamp;
+
     /** length in seconds of the currently playing/paused song */
     unsigned total_time;
 
@@ -99,11 +110,14 @@ typedef struct _MooseStatusPrivate {
     /** non-zero if MPD is updating, 0 otherwise */
     unsigned update_id;
 
-    /** error message */
+    /** error message, owned by the snapshot */
     char *last_error;
 
     const MooseSong *current_song;
 
+    /** Only known if the client has a song resolver (i.e. a store) */
+    const MooseSong *next_song;
+
     struct {
         unsigned number_of_artists;
         unsigned number_of_albums;
@@ -114,22 +128,156 @@ typedef struct _MooseStatusPrivate {
         unsigned long db_play_time;
     } stats;
 
-    char replay_gain_mode[64];
+    /** interned */
+    const char *replay_gain_mode;
 
+    /** Never modified after publishing, replaced as a whole */
     GHashTable *outputs;
 
+    /** Number of readers currently using this snapshot */
+    gint readers;
+} MooseStatusData;
+
+typedef struct _MooseStatusPrivate {
+    /** The currently published snapshot, swapped atomically */
+    MooseStatusData *data;
+
+    /** Number of readers between loading the pointer and counting themselves */
+    gint acquiring;
+
+    /** Serializes writers, readers never touch it */
+    GMutex write_lock;
+
+    /** Replaced snapshots that might still be in use by a reader (writers only) */
+    GSList *retired;
 } MooseStatusPrivate;
 
 G_DEFINE_TYPE_WITH_PRIVATE(MooseStatus, moose_status, G_TYPE_OBJECT);
 
-#define READ(self, return_name, return_type, default_val) \
-    {                                                     \
-        g_return_val_if_fail(self, default_val);          \
-        return_type rval;                                 \
-        g_rw_lock_reader_lock(&self->priv->ref_lock);     \
-        { rval = self->priv->return_name; }               \
-        g_rw_lock_reader_unlock(&self->priv->ref_lock);   \
-        return rval;                                      \
+//////////////////////////////
+// Snapshot handling        //
+//////////////////////////////
+
+static MooseStatusData *moose_status_data_new(void) {
+    MooseStatusData *data = g_slice_new0(MooseStatusData);
+    data->state = MOOSE_STATE_UNKNOWN;
+    data->volume = -1;
+    data->song_pos = -1;
+    data->song_id = -1;
+    data->next_song_pos = -1;
+    data->next_song_id = -1;
+    data->replay_gain_mode = "";
+    data->outputs = moose_status_outputs_new();
+    return data;
+}
+
+static MooseStatusData *moose_status_data_copy(const MooseStatusData *data) {
+    MooseStatusData *copy = g_slice_dup(MooseStatusData, data);
+    copy->readers = 0;
+    copy->last_error = g_strdup(data->last_error);
+    if(copy->current_song != NULL) {
+        g_object_ref(MOOSE_SONG(copy->current_song));
+    }
+    if(copy->next_song != NULL) {
+        g_object_ref(MOOSE_SONG(copy->next_song));
+    }
+    g_hash_table_ref(copy->outputs);
+    return copy;
+}
+
+static void moose_status_data_free(MooseStatusData *data) {
+    if(data->current_song != NULL) {
+        g_object_unref(MOOSE_SONG(data->current_song));
+    }
+    if(data->next_song != NULL) {
+        g_object_unref(MOOSE_SONG(data->next_song));
+    }
+    g_hash_table_unref(data->outputs);
+    g_free(data->last_error);
+    g_slice_free(MooseStatusData, data);
+}
+
+/*
+ * Readers count themselves in the snapshot they loaded, so it is not
+ * reclaimed while they use it. They never wait on anything.
+ *
+ * Between loading the pointer and incrementing the snapshot's counter
+ * the reader is announced in priv->acquiring, since the writer might
+ * replace and check the snapshot right in that moment.
+ */
+static const MooseStatusData *moose_status_read_begin(const MooseStatus *self) {
+    MooseStatusPrivate *priv = self->priv;
+
+    g_atomic_int_inc(&priv->acquiring);
+    MooseStatusData *data = g_atomic_pointer_get(&priv->data);
+    g_atomic_int_inc(&data->readers);
+    g_atomic_int_add(&priv->acquiring, -1);
+
+    return data;
+}
+
+static void moose_status_read_end(const MooseStatusData *data) {
+    g_atomic_int_add(&((MooseStatusData *)data)->readers, -1);
+}
+
+/* Returns a private copy of the current snapshot to modify */
+static MooseStatusData *moose_status_write_begin(const MooseStatus *self) {
+    g_mutex_lock(&self->priv->write_lock);
+    return moose_status_data_copy(self->priv->data);
+}
+
+/*
+ * Free the retired snapshots nobody reads anymore.
+ *
+ * Retired snapshots cannot be loaded anymore, but a reader might have
+ * loaded one without having counted itself in it yet. If nobody is in
+ * that window (acquiring is zero after the swap), a reader count of
+ * zero means the snapshot is unused for good. Otherwise the next write
+ * tries again; the window is only a few instructions long.
+ */
+static void moose_status_reclaim(MooseStatusPrivate *priv) {
+    if(g_atomic_int_get(&priv->acquiring) != 0) {
+        return;
+    }
+
+    GSList *iter = priv->retired;
+    while(iter != NULL) {
+        GSList *next = iter->next;
+        MooseStatusData *data = iter->data;
+
+        if(g_atomic_int_get(&data->readers) == 0) {
+            moose_status_data_free(data);
+            priv->retired = g_slist_delete_link(priv->retired, iter);
+        }
+
+        iter = next;
+    }
+}
+
+/* Publish (or drop, if nothing changed) the copy from write_begin */
+static void moose_status_write_end(const MooseStatus *self, MooseStatusData *data, gboolean publish) {
+    MooseStatusPrivate *priv = self->priv;
+
+    if(publish) {
+        MooseStatusData *old = priv->data;
+        g_atomic_pointer_set(&priv->data, data);
+        priv->retired = g_slist_prepend(priv->retired, old);
+        moose_status_reclaim(priv);
+    } else {
+        moose_status_data_free(data);
+    }
+
+    g_mutex_unlock(&priv->write_lock);
+}
+
+#define READ(self, return_name, return_type, default_val)       \
+    {                                                           \
+        g_return_val_if_fail(self, default_val);                \
+        return_type rval;                                       \
+        const MooseStatusData *data = moose_status_read_begin(self); \
+        { rval = data->return_name; }                           \
+        moose_status_read_end(data);                            \
+        return rval;                                            \
     }
 
 /* This feels a bit like doing taxes, but well. */
@@ -151,6 +299,7 @@ enum {
     PROP_NEXT_SONG_ID,
     PROP_ELAPSED_TIME,
     PROP_ELAPSED_MS,
+    PROP_ELAPSED_MS_INTERPOLATED,
     PROP_TOTAL_TIME,
     PROP_KBIT_RATE,
     PROP_UPDATE_ID,
@@ -168,115 +317,132 @@ enum {
     N_PROPS
 };
 
+static unsigned moose_status_interpolate_elapsed_ms(const MooseStatusData *data) {
+    guint64 elapsed_ms = data->elapsed_ms;
+
+    if(data->state == MOOSE_STATE_PLAY && data->elapsed_timestamp > 0) {
+        elapsed_ms += (g_get_monotonic_time() - data->elapsed_timestamp) / 1000;
+    }
+
+    /* Do not run over the end while waiting for the next song */
+    if(data->total_time > 0) {
+        elapsed_ms = MIN(elapsed_ms, data->total_time * 1000ull);
+    }
+
+    return elapsed_ms;
+}
+
 /* This is implemented for easier introspection support */
 static void moose_status_get_property(GObject *object,
                                       guint property_id,
                                       GValue *value,
                                       GParamSpec *pspec) {
     MooseStatus *self = MOOSE_STATUS(object);
-    MooseStatusPrivate *priv = self->priv;
-    g_rw_lock_reader_lock(&priv->ref_lock);
+    const MooseStatusData *data = moose_status_read_begin(self);
     {
         switch(property_id) {
         case PROP_VOLUME:
-            g_value_set_int(value, priv->volume);
+            g_value_set_int(value, data->volume);
             break;
         case PROP_REPEAT:
-            g_value_set_boolean(value, priv->repeat);
+            g_value_set_boolean(value, data->repeat);
             break;
         case PROP_RANDOM:
-            g_value_set_boolean(value, priv->random);
+            g_value_set_boolean(value, data->random);
             break;
         case PROP_SINGLE:
-            g_value_set_boolean(value, priv->single);
+            g_value_set_boolean(value, data->single);
             break;
         case PROP_CONSUME:
-            g_value_set_boolean(value, priv->consume);
+            g_value_set_boolean(value, data->consume);
             break;
         case PROP_QUEUE_LENGTH:
-            g_value_set_int(value, priv->queue_length);
+            g_value_set_int(value, data->queue_length);
             break;
         case PROP_QUEUE_VERSION:
-            g_value_set_int(value, priv->queue_version);
+            g_value_set_int(value, data->queue_version);
             break;
         case PROP_STATE:
-            g_value_set_enum(value, priv->state);
+            g_value_set_enum(value, data->state);
             break;
         case PROP_CROSSFADE:
-            g_value_set_int(value, priv->crossfade);
+            g_value_set_int(value, data->crossfade);
             break;
         case PROP_MIXRAMPDB:
-            g_value_set_float(value, priv->mixrampdb);
+            g_value_set_float(value, data->mixrampdb);
             break;
         case PROP_MIXRAMPDELAY:
-            g_value_set_float(value, priv->mixrampdelay);
+            g_value_set_float(value, data->mixrampdelay);
             break;
         case PROP_SONG_POS:
-            g_value_set_int(value, priv->song_pos);
+            g_value_set_int(value, data->song_pos);
             break;
         case PROP_SONG_ID:
-            g_value_set_int(value, priv->song_id);
+            g_value_set_int(value, data->song_id);
             break;
         case PROP_NEXT_SONG_POS:
-            g_value_set_int(value, priv->next_song_pos);
+            g_value_set_int(value, data->next_song_pos);
             break;
         case PROP_NEXT_SONG_ID:
-            g_value_set_int(value, priv->next_song_id);
+            g_value_set_int(value, data->next_song_id);
             break;
         case PROP_ELAPSED_TIME:
-            g_value_set_int(value, priv->elapsed_time);
+            g_value_set_int(value, data->elapsed_time);
             break;
         case PROP_ELAPSED_MS:
-            g_value_set_int(value, priv->elapsed_ms);
+            g_value_set_int(value, data->elapsed_ms);
+            break;
+        case PROP_ELAPSED_MS_INTERPOLATED:
+            g_value_set_int(value, moose_status_interpolate_elapsed_ms(data));
             break;
         case PROP_TOTAL_TIME:
-            g_value_set_int(value, priv->total_time);
+            g_value_set_int(value, data->total_time);
             break;
         case PROP_KBIT_RATE:
-            g_value_set_int(value, priv->kbit_rate);
+            g_value_set_int(value, data->kbit_rate);
             break;
         case PROP_UPDATE_ID:
-            g_value_set_int(value, priv->update_id);
+            g_value_set_int(value, data->update_id);
             break;
         case PROP_AUDIO_SAMPLE_RATE:
-            g_value_set_int(value, priv->audio.sample_rate);
+            g_value_set_int(value, data->audio.sample_rate);
             break;
         case PROP_AUDIO_BITS:
-            g_value_set_int(value, priv->audio.bits);
+            g_value_set_int(value, data->audio.bits);
             break;
         case PROP_AUDIO_CHANNELS:
-            g_value_set_int(value, priv->audio.channels);
+            g_value_set_int(value, data->audio.channels);
             break;
         case PROP_NUMBER_OF_ARTISTS:
-            g_value_set_int(value, priv->stats.number_of_artists);
+            g_value_set_int(value, data->stats.number_of_artists);
             break;
         case PROP_NUMBER_OF_ALBUMS:
-            g_value_set_int(value, priv->stats.number_of_albums);
+            g_value_set_int(value, data->stats.number_of_albums);
             break;
         case PROP_NUMBER_OF_SONGS:
-            g_value_set_int(value, priv->stats.number_of_songs);
+            g_value_set_int(value, data->stats.number_of_songs);
             break;
         case PROP_UP_TIME:
-            g_value_set_int(value, priv->stats.uptime);
+            g_value_set_int(value, data->stats.uptime);
             break;
         case PROP_DB_UPDATE_TIME:
-            g_value_set_int(value, priv->stats.db_update_time);
+            g_value_set_int(value, data->stats.db_update_time);
             break;
         case PROP_PLAY_TIME:
-            g_value_set_int(value, priv->stats.play_time);
+            g_value_set_int(value, data->stats.play_time);
             break;
         case PROP_REPLAY_GAIN_MODE:
-            g_value_set_string(value, priv->replay_gain_mode);
+            g_value_set_string(value, data->replay_gain_mode);
             break;
         case PROP_LAST_ERROR:
-            g_value_set_string(value, priv->last_error);
+            g_value_set_string(value, data->last_error);
             break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
             break;
         }
     }
-    g_rw_lock_reader_unlock(&self->priv->ref_lock);
+    moose_status_read_end(data);
 }
 
 static void moose_status_finalize(GObject *gobject) {
@@ -286,14 +452,9 @@ static void moose_status_finalize(GObject *gobject) {
         return;
     }
 
-    if(self->priv->current_song != NULL) {
-        g_object_unref(MOOSE_SONG(self->priv->current_song));
-    }
-
-    g_rw_lock_clear(&self->priv->ref_lock);
-    g_hash_table_destroy(self->priv->outputs);
-    g_free(self->priv->last_error);
-    self->priv->outputs = NULL;
+    g_slist_free_full(self->priv->retired, (GDestroyNotify)moose_status_data_free);
+    moose_status_data_free(self->priv->data);
+    g_mutex_clear(&self->priv->write_lock);
 
     /* Always chain up to the parent class; as with dispose(), finalize()
      * is guaranteed to exist on the parent's class virtual function table
@@ -349,6 +510,7 @@ static void moose_status_class_init(MooseStatusClass *klass) {
     props[PROP_NEXT_SONG_ID] = moose_status_prop_int("next-song-id");
     props[PROP_ELAPSED_TIME] = moose_status_prop_int("elapsed-time");
     props[PROP_ELAPSED_MS] = moose_status_prop_int("elapsed-ms");
+    props[PROP_ELAPSED_MS_INTERPOLATED] = moose_status_prop_int("elapsed-ms-interpolated");
     props[PROP_TOTAL_TIME] = moose_status_prop_int("total-time");
     props[PROP_KBIT_RATE] = moose_status_prop_int("kbit-rate");
     props[PROP_UPDATE_ID] = moose_status_prop_int("update-id");
@@ -369,18 +531,8 @@ static void moose_status_class_init(MooseStatusClass *klass) {
 
 static void moose_status_init(MooseStatus *self) {
     self->priv = moose_status_get_instance_private(self);
-    self->priv->state = MOOSE_STATE_UNKNOWN;
-    self->priv->volume = -1;
-    self->priv->mixrampdb = 0.0;
-    self->priv->mixrampdelay = 0.0;
-    self->priv->song_pos = -1;
-    self->priv->song_id = -1;
-    self->priv->next_song_pos = -1;
-    self->priv->next_song_id = -1;
-
-    g_rw_lock_init(&self->priv->ref_lock);
-    self->priv->outputs = g_hash_table_new_full(
-        g_str_hash, g_direct_equal, NULL, (GDestroyNotify)g_variant_unref);
+    self->priv->data = moose_status_data_new();
+    g_mutex_init(&self->priv->write_lock);
 }
 
 MooseStatus *moose_status_new(void) {
@@ -461,6 +613,21 @@ unsigned moose_status_get_elapsed_ms(const MooseStatus *self) {
     READ(self, elapsed_ms, unsigned, 0)
 }
 
+unsigned moose_status_get_elapsed_ms_interpolated(const MooseStatus *self) {
+    g_return_val_if_fail(self, 0);
+
+    unsigned elapsed_ms = 0;
+    const MooseStatusData *data = moose_status_read_begin(self);
+    { elapsed_ms = moose_status_interpolate_elapsed_ms(data); }
+    moose_status_read_end(data);
+
+    return elapsed_ms;
+}
+
+gint64 moose_status_get_elapsed_timestamp(const MooseStatus *self) {
+    READ(self, elapsed_timestamp, gint64, 0)
+}
+
 unsigned moose_status_get_total_time(const MooseStatus *self) {
     READ(self, total_time, unsigned, 0)
 }
@@ -473,8 +640,16 @@ unsigned moose_status_get_update_id(const MooseStatus *self) {
     READ(self, update_id, unsigned, 0)
 }
 
-const char *moose_status_get_last_error(const MooseStatus *self) {
-    READ(self, last_error, const char *, NULL)
+char *moose_status_get_last_error(const MooseStatus *self) {
+    g_return_val_if_fail(self, NULL);
+
+    /* The snapshot may be replaced right after reading, so copy it meanwhile */
+    char *last_error = NULL;
+    const MooseStatusData *data = moose_status_read_begin(self);
+    { last_error = g_strdup(data->last_error); }
+    moose_status_read_end(data);
+
+    return last_error;
 }
 
 uint32_t moose_status_get_audio_sample_rate(const MooseStatus *self) {
@@ -489,86 +664,180 @@ uint8_t moose_status_get_audio_channels(const MooseStatus *self) {
     READ(self, audio.channels, uint8_t, 0)
 }
 
-void moose_status_convert(MooseStatus *self, MooseStatus *old, const struct mpd_status *status) {
+/* Assign value to data->field and remember the change bit if it differs */
+#define UPDATE(data, field, value, change, mask) \
+    {                                            \
+        if(data->field != (value)) {             \
+            data->field = (value);               \
+            mask |= change;                      \
+        }                                        \
+    }
+
+MooseStatusChange moose_status_update_from_struct(MooseStatus *self, const struct mpd_status *status) {
     g_assert(self);
     g_assert(status);
 
-    g_rw_lock_writer_lock(&self->priv->ref_lock);
+    MooseStatusChange mask = MOOSE_STATUS_CHANGE_NONE;
+    MooseStatusData *data = moose_status_write_begin(self);
     {
-        self->priv->volume = mpd_status_get_volume(status);
-        self->priv->repeat = mpd_status_get_repeat(status);
-        self->priv->random = mpd_status_get_random(status);
-        self->priv->single = mpd_status_get_single(status);
-        self->priv->consume = mpd_status_get_consume(status);
-        self->priv->queue_length = mpd_status_get_queue_length(status);
-        self->priv->queue_version = mpd_status_get_queue_version(status);
-        self->priv->state = (MooseState)mpd_status_get_state(status);
-        self->priv->crossfade = mpd_status_get_crossfade(status);
-        self->priv->mixrampdb = mpd_status_get_mixrampdb(status);
-        self->priv->mixrampdelay = mpd_status_get_mixrampdelay(status);
-        self->priv->song_pos = mpd_status_get_song_pos(status);
-        self->priv->song_id = mpd_status_get_song_id(status);
-        self->priv->next_song_pos = mpd_status_get_next_song_pos(status);
-        self->priv->next_song_id = mpd_status_get_next_song_id(status);
-        self->priv->elapsed_time = mpd_status_get_elapsed_time(status);
-        self->priv->elapsed_ms = mpd_status_get_elapsed_ms(status);
-        self->priv->total_time = mpd_status_get_total_time(status);
-        self->priv->kbit_rate = mpd_status_get_kbit_rate(status);
-        self->priv->update_id = mpd_status_get_update_id(status);
-        self->priv->last_error = g_strdup(mpd_status_get_error(status));
+        UPDATE(data, volume, mpd_status_get_volume(status), MOOSE_STATUS_CHANGE_VOLUME, mask);
+        UPDATE(data, repeat, mpd_status_get_repeat(status), MOOSE_STATUS_CHANGE_REPEAT, mask);
+        UPDATE(data, random, mpd_status_get_random(status), MOOSE_STATUS_CHANGE_RANDOM, mask);
+        UPDATE(data, single, mpd_status_get_single(status), MOOSE_STATUS_CHANGE_SINGLE, mask);
+        UPDATE(data, consume, mpd_status_get_consume(status), MOOSE_STATUS_CHANGE_CONSUME, mask);
+        UPDATE(data, queue_length, mpd_status_get_queue_length(status), MOOSE_STATUS_CHANGE_QUEUE, mask);
+        UPDATE(data, queue_version, mpd_status_get_queue_version(status), MOOSE_STATUS_CHANGE_QUEUE, mask);
+        UPDATE(data, state, (MooseState)mpd_status_get_state(status), MOOSE_STATUS_CHANGE_STATE, mask);
+        UPDATE(data, crossfade, mpd_status_get_crossfade(status), MOOSE_STATUS_CHANGE_CROSSFADE, mask);
+        UPDATE(data, mixrampdb, mpd_status_get_mixrampdb(status), MOOSE_STATUS_CHANGE_MIXRAMP, mask);
+        UPDATE(data, mixrampdelay, mpd_status_get_mixrampdelay(status), MOOSE_STATUS_CHANGE_MIXRAMP, mask);
+        UPDATE(data, song_pos, mpd_status_get_song_pos(status), MOOSE_STATUS_CHANGE_SONG, mask);
+        UPDATE(data, song_id, mpd_status_get_song_id(status), MOOSE_STATUS_CHANGE_SONG, mask);
+        UPDATE(data, next_song_pos, mpd_status_get_next_song_pos(status), MOOSE_STATUS_CHANGE_NEXT_SONG, mask);
+        UPDATE(data, next_song_id, mpd_status_get_next_song_id(status), MOOSE_STATUS_CHANGE_NEXT_SONG, mask);
+        UPDATE(data, elapsed_time, mpd_status_get_elapsed_time(status), MOOSE_STATUS_CHANGE_ELAPSED, mask);
+        UPDATE(data, elapsed_ms, mpd_status_get_elapsed_ms(status), MOOSE_STATUS_CHANGE_ELAPSED, mask);
+        UPDATE(data, total_time, mpd_status_get_total_time(status), MOOSE_STATUS_CHANGE_TOTAL_TIME, mask);
+        UPDATE(data, kbit_rate, mpd_status_get_kbit_rate(status), MOOSE_STATUS_CHANGE_KBIT_RATE, mask);
+        UPDATE(data, update_id, mpd_status_get_update_id(status), MOOSE_STATUS_CHANGE_UPDATE_ID, mask);
+        data->elapsed_timestamp = g_get_monotonic_time();
+
+        const char *error = mpd_status_get_error(status);
+        if(g_strcmp0(data->last_error, error) != 0) {
+            g_free(data->last_error);
+            data->last_error = g_strdup(error);
+            mask |= MOOSE_STATUS_CHANGE_LAST_ERROR;
+        }
 
         const struct mpd_audio_format *audio = mpd_status_get_audio_format(status);
         if(audio != NULL) {
-            self->priv->audio.sample_rate = audio->sample_rate;
-            self->priv->audio.channels = audio->channels;
-            self->priv->audio.bits = audio->bits;
-        }
-
-        if(old != NULL) {
-            self->priv->stats.number_of_artists = moose_status_stats_get_number_of_artists(old);
-            self->priv->stats.number_of_albums = moose_status_stats_get_number_of_albums(old);
-            self->priv->stats.number_of_songs = moose_status_stats_get_number_of_songs(old);
-            self->priv->stats.uptime = moose_status_stats_get_uptime(old);
-            self->priv->stats.db_update_time = moose_status_stats_get_db_update_time(old);
-            self->priv->stats.play_time = moose_status_stats_get_play_time(old);
-            self->priv->stats.db_play_time = moose_status_stats_get_db_play_time(old);
+            UPDATE(data, audio.sample_rate, audio->sample_rate, MOOSE_STATUS_CHANGE_AUDIO, mask);
+            UPDATE(data, audio.channels, audio->channels, MOOSE_STATUS_CHANGE_AUDIO, mask);
+            UPDATE(data, audio.bits, audio->bits, MOOSE_STATUS_CHANGE_AUDIO, mask);
         }
     }
-    g_rw_lock_writer_unlock(&self->priv->ref_lock);
+    /* Always publish, the elapsed timestamp is new */
+    moose_status_write_end(self, data, TRUE);
+
+    return mask;
 }
 
 MooseStatus *moose_status_new_from_struct(MooseStatus *old, const struct mpd_status *status) {
     g_return_val_if_fail(status, NULL);
 
     MooseStatus *self = moose_status_new();
-    moose_status_convert(self, old, status);
+    moose_status_update_from_struct(self, status);
+
+    if(old != NULL) {
+        const MooseStatusData *old_data = moose_status_read_begin(old);
+        MooseStatusData *data = moose_status_write_begin(self);
+        {
+            data->stats.number_of_artists = old_data->stats.number_of_artists;
+            data->stats.number_of_albums = old_data->stats.number_of_albums;
+            data->stats.number_of_songs = old_data->stats.number_of_songs;
+            data->stats.uptime = old_data->stats.uptime;
+            data->stats.db_update_time = old_data->stats.db_update_time;
+            data->stats.play_time = old_data->stats.play_time;
+            data->stats.db_play_time = old_data->stats.db_play_time;
+        }
+        moose_status_write_end(self, data, TRUE);
+        moose_status_read_end(old_data);
+    }
     return self;
 }
 
 MooseSong *moose_status_get_current_song(const MooseStatus *self) {
     g_return_val_if_fail(self, NULL);
-    if(self->priv->current_song) {
-        g_object_ref(MOOSE_SONG(self->priv->current_song));
+
+    MooseSong *song = NULL;
+    const MooseStatusData *data = moose_status_read_begin(self);
+    {
+        if(data->current_song != NULL) {
+            song = g_object_ref(MOOSE_SONG(data->current_song));
+        }
+    }
+    moose_status_read_end(data);
+    return song;
+}
+
+/* A song that was fetched again is only a change if it's a different one,
+ * or the same one with modified tags (which updates last-modified). */
+static gboolean moose_status_song_equal(const MooseSong *a, const MooseSong *b) {
+    if(a == b) {
+        return TRUE;
+    }
+
+    if(a == NULL || b == NULL) {
+        return FALSE;
+    }
+
+    MooseSong *song_a = MOOSE_SONG(a), *song_b = MOOSE_SONG(b);
+    return moose_song_get_id(song_a) == moose_song_get_id(song_b) &&
+           moose_song_get_last_modified(song_a) == moose_song_get_last_modified(song_b) &&
+           g_strcmp0(moose_song_get_uri(song_a), moose_song_get_uri(song_b)) == 0;
+}
+
+/* Swap the song in slot (of a private copy), returns true if the pointer differs */
+static gboolean moose_status_swap_song(const MooseSong **slot, const MooseSong *song) {
+    const MooseSong *old_song = *slot;
+    if(old_song == song) {
+        return FALSE;
+    }
+
+    if(song != NULL) {
+        g_object_ref(MOOSE_SONG(song));
+    }
+    *slot = song;
+
+    /* Only drops the reference of the copy */
+    if(old_song != NULL) {
+        g_object_unref(MOOSE_SONG(old_song));
     }
-    return (MooseSong *)self->priv->current_song;
+    return TRUE;
 }
 
-void moose_status_set_current_song(MooseStatus *self, const MooseSong *song) {
-    g_rw_lock_writer_lock(&self->priv->ref_lock);
+MooseStatusChange moose_status_set_current_song(MooseStatus *self, const MooseSong *song) {
+    g_return_val_if_fail(self, MOOSE_STATUS_CHANGE_NONE);
+
+    MooseStatusChange mask = MOOSE_STATUS_CHANGE_NONE;
+    MooseStatusData *data = moose_status_write_begin(self);
+    if(moose_status_song_equal(data->current_song, song) == FALSE) {
+        mask |= MOOSE_STATUS_CHANGE_CURRENT_SONG;
+    }
+
+    /* Publish the new object anyway, it is the one the store knows */
+    gboolean swapped = moose_status_swap_song(&data->current_song, song);
+    moose_status_write_end(self, data, swapped);
+    return mask;
+}
+
+MooseSong *moose_status_get_next_song(const MooseStatus *self) {
+    g_return_val_if_fail(self, NULL);
+
+    MooseSong *song = NULL;
+    const MooseStatusData *data = moose_status_read_begin(self);
     {
-        if(self->priv->current_song) {
-            g_object_unref(MOOSE_SONG(song));
-            self->priv->current_song = NULL;
+        if(data->next_song != NULL) {
+            song = g_object_ref(MOOSE_SONG(data->next_song));
         }
+    }
+    moose_status_read_end(data);
+    return song;
+}
 
-        if(self != NULL) {
-            if(song != NULL) {
-                g_object_ref(MOOSE_SONG(song));
-            }
-            self->priv->current_song = song;
-        }
+MooseStatusChange moose_status_set_next_song(MooseStatus *self, const MooseSong *song) {
+    g_return_val_if_fail(self, MOOSE_STATUS_CHANGE_NONE);
+
+    MooseStatusChange mask = MOOSE_STATUS_CHANGE_NONE;
+    MooseStatusData *data = moose_status_write_begin(self);
+    if(moose_status_song_equal(data->next_song, song) == FALSE) {
+        mask |= MOOSE_STATUS_CHANGE_NEXT_SONG;
     }
-    g_rw_lock_writer_unlock(&self->priv->ref_lock);
+
+    /* Publish the new object anyway, it is the one the store knows */
+    gboolean swapped = moose_status_swap_song(&data->next_song, song);
+    moose_status_write_end(self, data, swapped);
+    return mask;
 }
 
 unsigned moose_status_stats_get_number_of_artists(const MooseStatus *self) {
@@ -599,106 +868,107 @@ unsigned long moose_status_stats_get_db_play_time(const MooseStatus *self) {
     READ(self, stats.db_play_time, unsigned long, 0)
 }
 
-void moose_status_update_stats(const MooseStatus *self, const struct mpd_stats *stats) {
+MooseStatusChange moose_status_update_stats(const MooseStatus *self, const struct mpd_stats *stats) {
     g_assert(self);
     g_assert(stats);
 
-    g_rw_lock_writer_lock(&self->priv->ref_lock);
+    MooseStatusChange mask = MOOSE_STATUS_CHANGE_NONE;
+    MooseStatusData *data = moose_status_write_begin(self);
     {
-        self->priv->stats.number_of_artists = mpd_stats_get_number_of_artists(stats);
-        self->priv->stats.number_of_albums = mpd_stats_get_number_of_albums(stats);
-        self->priv->stats.number_of_songs = mpd_stats_get_number_of_songs(stats);
-        self->priv->stats.uptime = mpd_stats_get_uptime(stats);
-        self->priv->stats.db_update_time = mpd_stats_get_db_update_time(stats);
-        self->priv->stats.play_time = mpd_stats_get_play_time(stats);
-        self->priv->stats.db_play_time = mpd_stats_get_db_play_time(stats);
+        /* uptime ticks all the time and is therefore not considered a change */
+        data->stats.uptime = mpd_stats_get_uptime(stats);
+
+        UPDATE(data, stats.number_of_artists, mpd_stats_get_number_of_artists(stats), MOOSE_STATUS_CHANGE_STATS, mask);
+        UPDATE(data, stats.number_of_albums, mpd_stats_get_number_of_albums(stats), MOOSE_STATUS_CHANGE_STATS, mask);
+        UPDATE(data, stats.number_of_songs, mpd_stats_get_number_of_songs(stats), MOOSE_STATUS_CHANGE_STATS, mask);
+        UPDATE(data, stats.db_update_time, mpd_stats_get_db_update_time(stats), MOOSE_STATUS_CHANGE_STATS, mask);
+        UPDATE(data, stats.play_time, mpd_stats_get_play_time(stats), MOOSE_STATUS_CHANGE_STATS, mask);
+        UPDATE(data, stats.db_play_time, mpd_stats_get_db_play_time(stats), MOOSE_STATUS_CHANGE_STATS, mask);
     }
-    g_rw_lock_writer_unlock(&self->priv->ref_lock);
+    moose_status_write_end(self, data, TRUE);
+    return mask;
 }
 
 const char *moose_status_get_replay_gain_mode(const MooseStatus *self) {
     READ(self, replay_gain_mode, const char *, "off")
 }
 
-void moose_status_set_replay_gain_mode(const MooseStatus *self, const char *mode) {
-    g_return_if_fail(self);
+MooseStatusChange moose_status_set_replay_gain_mode(const MooseStatus *self, const char *mode) {
+    g_return_val_if_fail(self, MOOSE_STATUS_CHANGE_NONE);
 
+    MooseStatusChange mask = MOOSE_STATUS_CHANGE_NONE;
     if(mode != NULL) {
-        g_rw_lock_writer_lock(&self->priv->ref_lock);
-        {
-            strncpy(self->priv->replay_gain_mode,
-                    mode,
-                    sizeof(self->priv->replay_gain_mode) - 1);
-        }
-        g_rw_lock_writer_unlock(&self->priv->ref_lock);
+        MooseStatusData *data = moose_status_write_begin(self);
+        UPDATE(data, replay_gain_mode, g_intern_string(mode), MOOSE_STATUS_CHANGE_REPLAY_GAIN_MODE, mask);
+        moose_status_write_end(self, data, mask != MOOSE_STATUS_CHANGE_NONE);
     }
+    return mask;
 }
 
-void moose_status_outputs_clear(const MooseStatus *self) {
-    g_assert(self);
+GHashTable *moose_status_outputs_new(void) {
+    return g_hash_table_new_full(
+        g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_variant_unref);
+}
 
-    g_rw_lock_writer_lock(&self->priv->ref_lock);
-    {
-        GHashTable *outputs = self->priv->outputs;
-        if(outputs != NULL) {
-            self->priv->outputs = NULL;
-            g_hash_table_unref(outputs);
-            self->priv->outputs = g_hash_table_new_full(
-                g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_variant_unref);
+void moose_status_outputs_add(GHashTable *outputs, const char *name, int id, bool enabled) {
+    g_assert(outputs);
+    g_assert(name);
+
+    g_hash_table_insert(outputs,
+                        (gpointer)g_strdup(name),
+                        g_variant_ref_sink(g_variant_new("(sib)", name, id, enabled)));
+}
+
+/* Outputs are equal if they have the same names, ids and enabled states */
+static gboolean moose_status_outputs_equal(GHashTable *a, GHashTable *b) {
+    if(g_hash_table_size(a) != g_hash_table_size(b)) {
+        return FALSE;
+    }
+
+    GHashTableIter iter;
+    gpointer name = NULL, output = NULL;
+
+    g_hash_table_iter_init(&iter, a);
+    while(g_hash_table_iter_next(&iter, &name, &output)) {
+        GVariant *other = g_hash_table_lookup(b, name);
+        if(other == NULL || g_variant_equal(output, other) == FALSE) {
+            return FALSE;
         }
     }
-    g_rw_lock_writer_unlock(&self->priv->ref_lock);
+
+    return TRUE;
 }
 
-void moose_status_outputs_add(
-    const MooseStatus *self,
-    const char *name,
-    int id,
-    bool enabled
-) {
+MooseStatusChange moose_status_outputs_set(const MooseStatus *self, GHashTable *outputs) {
     g_assert(self);
-    g_assert(name);
+    g_assert(outputs);
 
-    g_rw_lock_writer_lock(&self->priv->ref_lock);
+    MooseStatusChange mask = MOOSE_STATUS_CHANGE_NONE;
+    MooseStatusData *data = moose_status_write_begin(self);
     {
-        g_hash_table_insert(self->priv->outputs,
-                            (gpointer)g_strdup(name),
-                            g_variant_ref(
-                                g_variant_new("(sib)", name, id, enabled)));
+        if(moose_status_outputs_equal(data->outputs, outputs)) {
+            g_hash_table_unref(outputs);
+        } else {
+            /* The table of the copy is shared with the published snapshot */
+            g_hash_table_unref(data->outputs);
+            data->outputs = outputs;
+            mask |= MOOSE_STATUS_CHANGE_OUTPUTS;
+        }
     }
-    g_rw_lock_writer_unlock(&self->priv->ref_lock);
+    moose_status_write_end(self, data, mask != MOOSE_STATUS_CHANGE_NONE);
+    return mask;
 }
 
 GHashTable *moose_status_outputs_get(const MooseStatus *self) {
     g_return_val_if_fail(self, NULL);
 
     GHashTable *ref = NULL;
-    g_rw_lock_reader_lock(&self->priv->ref_lock);
-    { ref = g_hash_table_ref(self->priv->outputs); }
-    g_rw_lock_reader_unlock(&self->priv->ref_lock);
+    const MooseStatusData *data = moose_status_read_begin(self);
+    { ref = g_hash_table_ref(data->outputs); }
+    moose_status_read_end(data);
     return ref;
 }
 
-void moose_status_outputs_copy(MooseStatus *self, const MooseStatus *other) {
-    g_assert(self);
-    g_assert(other);
-
-    moose_status_outputs_clear(self);
-
-    GHashTable *outputs = moose_status_outputs_get(other);
-    {
-        GHashTableIter iter;
-        g_hash_table_iter_init(&iter, outputs);
-        gpointer key, value;
-        while(g_hash_table_iter_next(&iter, &key, &value)) {
-            char *name = NULL; int id = 0; gboolean enabled = false;
-            g_variant_get((GVariant *)value, "(sib)", &name, &id, &enabled);
-            moose_status_outputs_add(self, name, id, enabled);
-        }
-    }
-    g_hash_table_unref(outputs);
-}
-
 int moose_status_output_lookup_id(const MooseStatus *self, const char *name) {
     g_return_val_if_fail(self, -1);
     g_return_val_if_fail(name, -1);
@@ -734,3 +1004,38 @@ GType moose_state_get_type(void) {
 
     return moose_state_type;
 }
+
+GType moose_status_change_get_type(void) {
+    static GType flags_type = 0;
+
+    if(flags_type == 0) {
+        static GFlagsValue change_types[] = {
+            {MOOSE_STATUS_CHANGE_VOLUME, "MOOSE_STATUS_CHANGE_VOLUME", "volume"},
+            {MOOSE_STATUS_CHANGE_REPEAT, "MOOSE_STATUS_CHANGE_REPEAT", "repeat"},
+            {MOOSE_STATUS_CHANGE_RANDOM, "MOOSE_STATUS_CHANGE_RANDOM", "random"},
+            {MOOSE_STATUS_CHANGE_SINGLE, "MOOSE_STATUS_CHANGE_SINGLE", "single"},
+            {MOOSE_STATUS_CHANGE_CONSUME, "MOOSE_STATUS_CHANGE_CONSUME", "consume"},
+            {MOOSE_STATUS_CHANGE_QUEUE, "MOOSE_STATUS_CHANGE_QUEUE", "queue"},
+            {MOOSE_STATUS_CHANGE_STATE, "MOOSE_STATUS_CHANGE_STATE", "state"},
+            {MOOSE_STATUS_CHANGE_CROSSFADE, "MOOSE_STATUS_CHANGE_CROSSFADE", "crossfade"},
+            {MOOSE_STATUS_CHANGE_MIXRAMP, "MOOSE_STATUS_CHANGE_MIXRAMP", "mixramp"},
+            {MOOSE_STATUS_CHANGE_SONG, "MOOSE_STATUS_CHANGE_SONG", "song"},
+            {MOOSE_STATUS_CHANGE_NEXT_SONG, "MOOSE_STATUS_CHANGE_NEXT_SONG", "next-song"},
+            {MOOSE_STATUS_CHANGE_ELAPSED, "MOOSE_STATUS_CHANGE_ELAPSED", "elapsed"},
+            {MOOSE_STATUS_CHANGE_TOTAL_TIME, "MOOSE_STATUS_CHANGE_TOTAL_TIME", "total-time"},
+            {MOOSE_STATUS_CHANGE_KBIT_RATE, "MOOSE_STATUS_CHANGE_KBIT_RATE", "kbit-rate"},
+            {MOOSE_STATUS_CHANGE_UPDATE_ID, "MOOSE_STATUS_CHANGE_UPDATE_ID", "update-id"},
+            {MOOSE_STATUS_CHANGE_AUDIO, "MOOSE_STATUS_CHANGE_AUDIO", "audio"},
+            {MOOSE_STATUS_CHANGE_LAST_ERROR, "MOOSE_STATUS_CHANGE_LAST_ERROR", "last-error"},
+            {MOOSE_STATUS_CHANGE_STATS, "MOOSE_STATUS_CHANGE_STATS", "stats"},
+            {MOOSE_STATUS_CHANGE_REPLAY_GAIN_MODE, "MOOSE_STATUS_CHANGE_REPLAY_GAIN_MODE", "replay-gain-mode"},
+            {MOOSE_STATUS_CHANGE_CURRENT_SONG, "MOOSE_STATUS_CHANGE_CURRENT_SONG", "current-song"},
+            {MOOSE_STATUS_CHANGE_OUTPUTS, "MOOSE_STATUS_CHANGE_OUTPUTS", "outputs"},
+            {MOOSE_STATUS_CHANGE_ALL, "MOOSE_STATUS_CHANGE_ALL", "all"},
+            {0, NULL, NULL}};
+
+        flags_type = g_flags_register_static("MooseStatusChange", change_types);
+    }
+
+    return flags_type;
+}
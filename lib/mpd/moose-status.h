@@ -10,6 +10,12 @@
  * Setters allow a faster deserialization from the disk.
  * Reference counting allows sharing the instances without the fear
  * of deleting it while the user still uses it.
+ *
+ * Every update publishes a new immutable snapshot of the values by swapping
+ * a pointer, so getters never take a lock and never block, even while the
+ * update thread is writing. Two getters called one after another may see
+ * different snapshots though. Strings returned by the getters stay valid
+ * for the lifetime of the program.
  */
 
 #include <glib-object.h>
@@ -42,6 +48,57 @@ typedef enum _MooseState {
 
 GType moose_state_get_type(void);
 
+/**
+ * MooseStatusChange:
+ *
+ * Bitmask of the #MooseStatus fields that changed during an update.
+ * Passed to the MooseClient::status-changed signal so listeners
+ * only need to refresh what actually changed.
+ */
+typedef enum _MooseStatusChange {
+    MOOSE_STATUS_CHANGE_NONE = 0,
+    MOOSE_STATUS_CHANGE_VOLUME = 1 << 0,
+    MOOSE_STATUS_CHANGE_REPEAT = 1 << 1,
+    MOOSE_STATUS_CHANGE_RANDOM = 1 << 2,
+    MOOSE_STATUS_CHANGE_SINGLE = 1 << 3,
+    MOOSE_STATUS_CHANGE_CONSUME = 1 << 4,
+
+    /* queue-length or queue-version */
+    MOOSE_STATUS_CHANGE_QUEUE = 1 << 5,
+    MOOSE_STATUS_CHANGE_STATE = 1 << 6,
+    MOOSE_STATUS_CHANGE_CROSSFADE = 1 << 7,
+
+    /* mixrampdb or mixrampdelay */
+    MOOSE_STATUS_CHANGE_MIXRAMP = 1 << 8,
+
+    /* song-pos or song-id */
+    MOOSE_STATUS_CHANGE_SONG = 1 << 9,
+
+    /* next-song-pos, next-song-id or the next song itself */
+    MOOSE_STATUS_CHANGE_NEXT_SONG = 1 << 10,
+
+    /* elapsed-time or elapsed-ms */
+    MOOSE_STATUS_CHANGE_ELAPSED = 1 << 11,
+    MOOSE_STATUS_CHANGE_TOTAL_TIME = 1 << 12,
+    MOOSE_STATUS_CHANGE_KBIT_RATE = 1 << 13,
+    MOOSE_STATUS_CHANGE_UPDATE_ID = 1 << 14,
+
+    /* sample rate, bits or channels */
+    MOOSE_STATUS_CHANGE_AUDIO = 1 << 15,
+    MOOSE_STATUS_CHANGE_LAST_ERROR = 1 << 16,
+
+    /* any of the stats_* values */
+    MOOSE_STATUS_CHANGE_STATS = 1 << 17,
+    MOOSE_STATUS_CHANGE_REPLAY_GAIN_MODE = 1 << 18,
+    MOOSE_STATUS_CHANGE_CURRENT_SONG = 1 << 19,
+    MOOSE_STATUS_CHANGE_OUTPUTS = 1 << 20,
+    MOOSE_STATUS_CHANGE_ALL = (1 << 21) - 1
+} MooseStatusChange;
+
+#define MOOSE_TYPE_STATUS_CHANGE (moose_status_change_get_type())
+
+GType moose_status_change_get_type(void);
+
 /*
  * Type macros.
  */
@@ -78,6 +135,18 @@ MooseStatus* moose_status_new(void);
 /* Create a MooseStatus from a moose_status */
 MooseStatus *moose_status_new_from_struct(MooseStatus *old, const struct mpd_status *status);
 
+/**
+ * moose_status_update_from_struct: skip:
+ * @self: a #MooseStatus
+ * @status: a freshly received status from libmpdclient
+ *
+ * Apply @status in place. Stats, outputs, replay gain mode and the
+ * current song are left untouched.
+ *
+ * Returns: a #MooseStatusChange mask of the fields that differ.
+ */
+MooseStatusChange moose_status_update_from_struct(MooseStatus *self, const struct mpd_status *status);
+
 /**
  * moose_status_unref:
  * @status: a #MooseStatus
@@ -229,6 +298,19 @@ unsigned moose_status_get_elapsed_time(const MooseStatus* status);
  */
 unsigned moose_status_get_elapsed_ms(const MooseStatus* status);
 
+/**
+ * moose_status_get_elapsed_ms_interpolated:
+ * @status: a #MooseStatus
+ *
+ * Like moose_status_get_elapsed_ms(), but while playing the time passed since
+ * the server reported the elapsed time is added (using a monotonic clock).
+ * This way the elapsed time can be displayed live without asking the server
+ * all the time. The result never exceeds the total time of the song.
+ *
+ * Returns: The interpolated time in milliseconds the current song has elapsed or 0
+ */
+unsigned moose_status_get_elapsed_ms_interpolated(const MooseStatus* status);
+
 /**
  * moose_status_get_total_time:
  * @status: a #MooseStatus
@@ -258,9 +340,10 @@ unsigned moose_status_get_kbit_rate(const MooseStatus* status);
  * Normally, this function is not needed, since you're supposed
  * to use g_log_set_handler()
  *
- * Returns: (transfer none): A descriptive error message.
+ * Returns: (transfer full): A copy of the descriptive error message,
+ * or NULL if there was none; free with g_free().
  */
-const char* moose_status_get_last_error(const MooseStatus* status);
+char* moose_status_get_last_error(const MooseStatus* status);
 
 /**
  * moose_status_get_update_id:
@@ -375,6 +458,18 @@ const char* moose_status_get_replay_gain_mode(const MooseStatus* status);
  */
 MooseSong* moose_status_get_current_song(const MooseStatus* status);
 
+/**
+ * moose_status_get_next_song:
+ * @status: a #MooseStatus
+ *
+ * The song that will be played after the current one. This is only
+ * available when a #MooseStore is attached to the client, since it is
+ * looked up there by next-song-id.
+ *
+ * Returns: (transfer full): a reffed #MooseSong or NULL
+ */
+MooseSong* moose_status_get_next_song(const MooseStatus* status);
+
 /**
  * moose_status_outputs_get:
  * @status: a #MooseStatus
@@ -383,7 +478,8 @@ MooseSong* moose_status_get_current_song(const MooseStatus* status);
  * a #GVariant of the output-name, the output-id and an gboolean, indicating
  * if the output is enabled. The format string you can use to unpack this
  * #GVariant is "(sib)". A ref was taken with g_hash_table_ref(), use
- * g_hash_table_unref() when done.
+ * g_hash_table_unref() when done. The table is never modified after
+ * being returned; new outputs are published as a new table.
  *
  * Hint: You can use something like this to switch the output-state:
  *
@@ -2,24 +2,15 @@
 #include "../moose-mpd-client-private.h"
 #include "../moose-mpd-client.h"
 #include "../../moose-config.h"
+#include "../../misc/moose-misc-reactor-private.h"
 
 #include <glib.h>
 #include <string.h>
 #include <stdio.h>
 
-#include <unistd.h>
 #include <mpd/async.h>
 #include <mpd/parser.h>
 
-#include <sys/socket.h>
-#include <sys/select.h>
-#include <errno.h>
-
-typedef enum _MooseListenerState {
-    LISTENER_ERROR = -2,
-    LISTENER_NOT_RUNNING = -1
-} MooseListenerState;
-
 typedef struct _MooseCmdClientPrivate {
     /* Connection to send commands */
     struct mpd_connection *cmnd_con;
@@ -27,96 +18,26 @@ typedef struct _MooseCmdClientPrivate {
     /* Protexct get/set of self->cmnd_con */
     GMutex cmnd_con_mtx;
 
-    /* Thread that polls idle_con */
-    GThread *listener_thread;
-
-    /* The current state of the listener thread.
-     * If this value is less than 0, it's using a member of MooseListenerState.
-     * Otherwise the fd of the idle-socket is stored here.
-     * On disconnect a "close\n" is sent to the fd.
-     */
-    volatile MooseListenerState run_listener;
-
-    /* Queue read from the pinger thread,
-     * once the queue is written to, the pinger thread exits.
-     * */
-    GAsyncQueue *run_pinger_queue;
+    /* Connection that only waits for idle events.
+     * Once connected, it is only touched by reactor callbacks. */
+    struct mpd_connection *idle_con;
 
-    /* Actual thread for the pinger thread.
-     * It is started on first connect,
-     * and shut down once the Client is freed.
-     * (not on disconnect!) */
-    GThread *pinger_thread;
+    /* The subscription mask the last "idle" was sent with */
+    MooseIdle idle_mask;
 
-    /* Protect write read access
-     * to the run_* flags
-     * */
-    GMutex flagmtx_run_listener;
+    /* Shared with all other clients; watches idle_con and pings cmnd_con */
+    MooseReactor *reactor;
 
-    /* Mutex to sync between the two connections on connect.
-     * We want to be sure that both connections are up and running
-     * before returning to the caller */
-    GMutex sync_mutex;
-
-    /* The actual condition variable mentioned above */
-    GCond sync_cond;
+    /* Reactor sources, or 0 if not connected */
+    guint idle_watch;
+    guint ping_timer;
 
+    /* Disarmed, until the subscriptions change; see do_resubscribe() */
+    guint wake_timer;
 } MooseCmdClientPrivate;
 
 G_DEFINE_TYPE_WITH_PRIVATE(MooseCmdClient, moose_cmd_client, MOOSE_TYPE_CLIENT);
 
-/* We want to make helgrind happy. */
-static gboolean moose_cmd_client_get_run_listener(MooseCmdClient *self) {
-    gboolean result = false;
-    g_mutex_lock(&self->priv->flagmtx_run_listener);
-    { result = self->priv->run_listener; }
-    g_mutex_unlock(&self->priv->flagmtx_run_listener);
-
-    return result;
-}
-
-static void moose_cmd_client_set_run_listener(MooseCmdClient *self,
-                                              volatile gboolean state) {
-    g_mutex_lock(&self->priv->flagmtx_run_listener);
-    { self->priv->run_listener = state; }
-    g_mutex_unlock(&self->priv->flagmtx_run_listener);
-}
-
-static enum mpd_async_event moose_sync_poll(struct mpd_async *async, struct timeval *tv) {
-    fd_set rfds, wfds, efds;
-    enum mpd_async_event events;
-    unsigned fd = mpd_async_get_fd(async);
-
-    if((events = mpd_async_events(async)) == 0) {
-        return 0;
-    }
-
-    FD_ZERO(&rfds);
-    FD_ZERO(&wfds);
-    FD_ZERO(&efds);
-
-    if(events & MPD_ASYNC_EVENT_READ)
-        FD_SET(fd, &rfds);
-    if(events & MPD_ASYNC_EVENT_WRITE)
-        FD_SET(fd, &wfds);
-    if(events & (MPD_ASYNC_EVENT_HUP | MPD_ASYNC_EVENT_ERROR))
-        FD_SET(fd, &efds);
-
-    int ret = select(fd + 1, &rfds, &wfds, &efds, tv);
-    if(ret > 0) {
-        if(!FD_ISSET(fd, &rfds))
-            events &= ~MPD_ASYNC_EVENT_READ;
-        if(!FD_ISSET(fd, &wfds))
-            events &= ~MPD_ASYNC_EVENT_WRITE;
-        if(!FD_ISSET(fd, &efds))
-            events &= ~(MPD_ASYNC_EVENT_HUP | MPD_ASYNC_EVENT_ERROR);
-
-        return events;
-    } else {
-        return 0;
-    }
-}
-
 static void check_async_error(struct mpd_async *async) {
     g_assert(async);
 
@@ -127,8 +48,8 @@ static void check_async_error(struct mpd_async *async) {
     }
 }
 
-static enum mpd_async_event moose_async_read_response(struct mpd_async *async) {
-    enum mpd_async_event events = 0;
+static MooseIdle moose_async_read_response(struct mpd_async *async) {
+    MooseIdle events = 0;
     char *line = NULL;
 
     struct mpd_parser *parser = mpd_parser_new();
@@ -158,114 +79,104 @@ cleanup:
     return events;
 }
 
-static gpointer moose_cmd_client_listener_thread(gpointer data) {
+/* Called in the reactor thread once idle_con is readable/writable */
+static gboolean moose_cmd_client_idle_event(MooseReactor *reactor, guint id,
+                                            GIOCondition condition, gpointer data) {
     MooseCmdClient *self = MOOSE_CMD_CLIENT(data);
     MooseClient *parent = MOOSE_CLIENT(self);
 
-    char *error_message = NULL;
-    char *host = moose_client_get_host(parent);
-    float timeout = moose_client_get_timeout(parent);
-    unsigned port = moose_client_get_port(parent);
-
-    struct mpd_connection *idle_con =
-        moose_base_connect((MooseClient *)self, host, port, timeout, &error_message);
-
-    g_free(host);
+    struct mpd_async *async = mpd_connection_get_async(self->priv->idle_con);
+    enum mpd_async_event events = gio_to_mpd_async(condition);
 
-    struct mpd_async *async = mpd_connection_get_async(idle_con);
-    if(mpd_async_send_command(async, "idle", NULL) == FALSE) {
+    if(events & (MPD_ASYNC_EVENT_HUP | MPD_ASYNC_EVENT_ERROR)) {
         check_async_error(async);
+        moose_message("Leaving idle-loop");
+        moose_client_connection_lost(parent);
+        return FALSE;
     }
 
-    /* Signal the connect function that we're almost up and running */
-    g_mutex_lock(&self->priv->sync_mutex);
-    {
-        if(idle_con && error_message == NULL) {
-            moose_cmd_client_set_run_listener(self, mpd_async_get_fd(async));
-        } else {
-            moose_cmd_client_set_run_listener(self, LISTENER_ERROR);
-            moose_critical("listener_thread: cannot connect: %s", error_message);
-            if(idle_con != NULL) {
-                mpd_connection_free(idle_con);
-                idle_con = NULL;
-            }
-        }
-        g_cond_signal(&self->priv->sync_cond);
+    if(mpd_async_io(async, events) == FALSE) {
+        moose_message("io-error - leaving");
+        moose_client_connection_lost(parent);
+        return FALSE;
     }
-    g_mutex_unlock(&self->priv->sync_mutex);
-
-    while(1) {
-        struct timeval max_timeout = {
-            .tv_sec = (int)timeout,
-            .tv_usec = (int)(timeout * 1000 * 1000) % (1000 * 1000)};
-        enum mpd_async_event events = moose_sync_poll(async, &max_timeout);
-
-        if(events & MPD_ASYNC_EVENT_ERROR || events == 0) {
-            check_async_error(async);
-            continue;
-        }
-
-        if(events & MPD_ASYNC_EVENT_HUP) {
-            check_async_error(async);
-            break;
-        }
-
-        if(mpd_async_io(async, events) == FALSE) {
-            moose_message("io-error (expected) - leaving");
-            break;
-        }
 
-        if(events & MPD_ASYNC_EVENT_READ) {
-            enum mpd_async_event events = moose_async_read_response(async);
-            moose_client_force_sync(parent, (MooseIdle)events);
-            mpd_async_send_command(async, "idle", NULL);
-        }
+    if(events & MPD_ASYNC_EVENT_READ) {
+        MooseIdle idle_events = moose_async_read_response(async);
+        moose_client_force_sync(parent, idle_events);
+        moose_client_send_idle(parent, async, &self->priv->idle_mask);
     }
 
-    moose_message("Leaving idle-loop");
+    /* Wait for whatever libmpdclient wants to do next */
+    moose_reactor_modify_fd(reactor, id, mpd_async_to_gio(mpd_async_events(async)));
+    return TRUE;
+}
 
-    if(idle_con != NULL) {
-        moose_cmd_client_set_run_listener(self, LISTENER_NOT_RUNNING);
-        mpd_connection_free(idle_con);
-        idle_con = NULL;
-    }
+/* Send a "noidle" on idle_con if the subscriptions changed since the
+ * last "idle"; the response brings us back to moose_cmd_client_idle_event(),
+ * which re-idles with the new mask. Only call from the reactor thread.
+ */
+static void moose_cmd_client_update_idle(MooseCmdClient *self, MooseReactor *reactor) {
+    MooseClient *parent = MOOSE_CLIENT(self);
 
-    return NULL;
+    if(moose_client_get_idle_mask(parent) != self->priv->idle_mask) {
+        struct mpd_async *async = mpd_connection_get_async(self->priv->idle_con);
+        mpd_async_send_command(async, "noidle", NULL);
+        self->priv->idle_mask = moose_client_get_idle_mask(parent);
+        moose_reactor_modify_fd(reactor, self->priv->idle_watch,
+                                mpd_async_to_gio(mpd_async_events(async)));
+    }
 }
 
-static void moose_cmd_client_shutdown_pinger(MooseCmdClient *self) {
-    g_assert(self);
+/* Ping every few seconds, so the server does not close cmnd_con.
+ *
+ * This runs in the reactor thread, shared with all other clients, so
+ * it must not wait for the server: the ping is only queued and runs in
+ * the client's own command thread.
+ */
+static gboolean moose_cmd_client_ping_server(MooseReactor *reactor,
+                                             G_GNUC_UNUSED guint id,
+                                             G_GNUC_UNUSED GIOCondition condition,
+                                             gpointer data) {
+    MooseCmdClient *self = MOOSE_CMD_CLIENT(data);
+    MooseClient *parent = MOOSE_CLIENT(self);
 
-    GAsyncQueue *queue = self->priv->run_pinger_queue;
-    g_async_queue_push(queue, queue);
+    /* Normally done by the wake timer already */
+    moose_cmd_client_update_idle(self, reactor);
 
-    if(self->priv->pinger_thread != NULL) {
-        g_thread_join(self->priv->pinger_thread);
-        self->priv->pinger_thread = NULL;
+    /* A busy connection needs no ping; also keeps disconnect out meanwhile */
+    if(g_rec_mutex_trylock(&parent->getput_mutex)) {
+        moose_client_ping(parent);
+        g_rec_mutex_unlock(&parent->getput_mutex);
     }
+    return TRUE;
+}
+
+/* Armed by do_resubscribe(), fires once */
+static gboolean moose_cmd_client_wake_idle(MooseReactor *reactor,
+                                           guint id,
+                                           G_GNUC_UNUSED GIOCondition condition,
+                                           gpointer data) {
+    moose_cmd_client_update_idle(MOOSE_CMD_CLIENT(data), reactor);
+    moose_reactor_set_timer(reactor, id, 0);
+    return TRUE;
 }
 
 static void moose_cmd_client_reset(MooseCmdClient *self) {
     if(self != NULL) {
-        /* Note: Idle thread is not joined.
-        *       It frees itself when it exits,
-        *       and we told it to exit by calling
-        *       moose_cmd_client_set_run_listener() avbove
-        */
-
-        int idle_fd = moose_cmd_client_get_run_listener(self);
-        if(idle_fd > 0) {
-            const char command[] = "close\n";
-            if(send(idle_fd, command, sizeof(command), 0) < 0) {
-                moose_critical("Unable to send 'close': %s\n", g_strerror(errno));
-            }
+        /* Waits for running callbacks; afterwards idle_con is ours again */
+        moose_reactor_remove(self->priv->reactor, self->priv->idle_watch);
+        moose_reactor_remove(self->priv->reactor, self->priv->ping_timer);
+        moose_reactor_remove(self->priv->reactor, self->priv->wake_timer);
+        self->priv->idle_watch = 0;
+        self->priv->ping_timer = 0;
+        self->priv->wake_timer = 0;
+
+        if(self->priv->idle_con != NULL) {
+            mpd_connection_free(self->priv->idle_con);
+            self->priv->idle_con = NULL;
         }
 
-        g_thread_join(self->priv->listener_thread);
-        self->priv->listener_thread = NULL;
-
-        moose_cmd_client_set_run_listener(self, LISTENER_NOT_RUNNING);
-
         g_mutex_lock(&self->priv->cmnd_con_mtx);
         {
             if(self->priv->cmnd_con) {
@@ -277,53 +188,6 @@ static void moose_cmd_client_reset(MooseCmdClient *self) {
     }
 }
 
-/* Loop, and send pings to the server once every connection_timeout_ms milliseconds.
- *
- * Why another thread? Because if we'd using a timeout event
- * (in the mainloop) the whole thing:
- *   a) would only work with the mainloop attached. (not to serious, but still)
- *   b) may interfer with other threads using the connection
- *   c) moose_client_get() may deadlock, if the connection hasn't been previously
- *unlocked.
- *      (this might happen if an client operation invokes the mainloop)
- *
- *
- * The ping-thread will also run while being disconnected, but will not do anything,
- * but sleeping a lot.
- */
-static gpointer moose_cmd_client_ping_server(MooseCmdClient *self) {
-    g_assert(self);
-
-    /* Timeout in milliseconds, after which we'll get disconnected,
-     * without sending a command. Note that this only affects the cmnd_con,
-     * since only here this span may be reached. The idle_con will wait
-     * for responses from the server, and has therefore this timeout disabled
-     * on server-side.
-     *
-     * The ping-thread only exists to work solely against this purpose. */
-
-    int timeout_ms = moose_client_get_timeout(MOOSE_CLIENT(self));
-    int timeout_micro = MIN(MAX(2000, timeout_ms), 20 * 1000) * 1000;
-
-    while(g_async_queue_timeout_pop(self->priv->run_pinger_queue, timeout_micro) ==
-          NULL) {
-        if(moose_client_is_connected((MooseClient *)self)) {
-            struct mpd_connection *con = moose_client_get((MooseClient *)self);
-            if(con != NULL) {
-                if(mpd_send_command(con, "ping", NULL) == false) {
-                    moose_client_check_error((MooseClient *)self, con);
-                }
-
-                if(mpd_response_finish(con) == false) {
-                    moose_client_check_error((MooseClient *)self, con);
-                }
-            }
-            moose_client_put((MooseClient *)self);
-        }
-    }
-    return NULL;
-}
-
 static char *moose_cmd_client_do_connect(MooseClient *parent,
                                          const char *host,
                                          int port,
@@ -331,15 +195,8 @@ static char *moose_cmd_client_do_connect(MooseClient *parent,
     char *error_message = NULL;
     MooseCmdClient *self = MOOSE_CMD_CLIENT(parent);
     MooseCmdClientPrivate *priv = self->priv;
-    GError *error = NULL;
 
-    /* start ping thread */
-    if(priv->pinger_thread == NULL) {
-        priv->pinger_thread = g_thread_new(
-            "cmnd-core-pinger", (GThreadFunc)moose_cmd_client_ping_server, self);
-    }
-
-    if(priv->listener_thread != NULL) {
+    if(priv->idle_con != NULL) {
         return NULL;
     }
 
@@ -355,34 +212,40 @@ static char *moose_cmd_client_do_connect(MooseClient *parent,
     }
     g_mutex_unlock(&priv->cmnd_con_mtx);
 
-    /* Set it to not yet initialized */
-    moose_cmd_client_set_run_listener(self, LISTENER_NOT_RUNNING);
+    if(error_message != NULL) {
+        return error_message;
+    }
 
-    /* Start thre thread */
-    self->priv->listener_thread = g_thread_try_new(
-        "listener-thread", moose_cmd_client_listener_thread, self, &error);
+    /* Second connection, only used for waiting on events */
+    priv->idle_con =
+        moose_base_connect((MooseClient *)self, host, port, timeout, &error_message);
 
-    if(error != NULL) {
-        moose_critical("Unable to spawn listener thread: %s", error->message);
-        g_error_free(error);
-        return "No listener thread.";
+    if(priv->idle_con == NULL) {
+        moose_critical("listener: cannot connect: %s", error_message);
+        g_free(error_message);
+        moose_cmd_client_reset(self);
+        return "Was not able to start a listener-connection";
     }
 
-    /* Wait for the thread to be connected and running */
-    MooseListenerState state;
-    g_mutex_lock(&self->priv->sync_mutex);
-    {
-        while((state = moose_cmd_client_get_run_listener(self)) <= 0) {
-            g_cond_wait(&self->priv->sync_cond, &self->priv->sync_mutex);
-        }
+    struct mpd_async *async = mpd_connection_get_async(priv->idle_con);
+    if(moose_client_send_idle(parent, async, &priv->idle_mask) == FALSE) {
+        check_async_error(async);
     }
-    g_mutex_unlock(&self->priv->sync_mutex);
 
-    if(state == LISTENER_ERROR) {
-        error_message = "Was not able to start a listener-connection";
-    }
+    priv->idle_watch = moose_reactor_add_fd(
+        priv->reactor, mpd_async_get_fd(async), mpd_async_to_gio(mpd_async_events(async)),
+        moose_cmd_client_idle_event, self);
+
+    /* timeout is in seconds; ping at most every 2 and at least every 20 seconds */
+    int timeout_ms = timeout * 1000;
+    priv->ping_timer =
+        moose_reactor_add_timer(priv->reactor, MIN(MAX(2000, timeout_ms), 20 * 1000),
+                                moose_cmd_client_ping_server, self);
+
+    priv->wake_timer =
+        moose_reactor_add_timer(priv->reactor, 0, moose_cmd_client_wake_idle, self);
 
-    return error_message;
+    return NULL;
 }
 
 static gboolean moose_cmd_client_do_is_connected(MooseClient *parent) {
@@ -414,23 +277,26 @@ static void moose_cmd_client_do_put(MooseClient *self) {
     (void)self;
 }
 
+static void moose_cmd_client_do_resubscribe(MooseClient *parent) {
+    /* idle_con belongs to the reactor thread, let it send the "noidle" now */
+    MooseCmdClient *self = MOOSE_CMD_CLIENT(parent);
+    moose_reactor_set_timer(self->priv->reactor, self->priv->wake_timer, 1);
+}
+
 static void moose_cmd_client_init(MooseCmdClient *object) {
     MooseClient *parent = MOOSE_CLIENT(object);
     parent->do_disconnect = moose_cmd_client_do_disconnect;
     parent->do_get = moose_cmd_client_do_get;
     parent->do_put = moose_cmd_client_do_put;
+    parent->do_resubscribe = moose_cmd_client_do_resubscribe;
     parent->do_connect = moose_cmd_client_do_connect;
     parent->do_is_connected = moose_cmd_client_do_is_connected;
 
     MooseCmdClient *self = MOOSE_CMD_CLIENT(object);
     self->priv = moose_cmd_client_get_instance_private(self);
-
-    self->priv->run_pinger_queue = g_async_queue_new();
+    self->priv->reactor = moose_reactor_ref_default();
 
     g_mutex_init(&self->priv->cmnd_con_mtx);
-    g_mutex_init(&self->priv->flagmtx_run_listener);
-    g_mutex_init(&self->priv->sync_mutex);
-    g_cond_init(&self->priv->sync_cond);
 }
 
 static void moose_cmd_client_finalize(GObject *gobject) {
@@ -439,22 +305,17 @@ static void moose_cmd_client_finalize(GObject *gobject) {
         return;
     }
 
-    /* Close the ping thread */
-    moose_cmd_client_shutdown_pinger(self);
     moose_cmd_client_do_disconnect(MOOSE_CLIENT(self));
-
-    g_async_queue_unref(self->priv->run_pinger_queue);
+    moose_reactor_unref(self->priv->reactor);
 
     g_mutex_clear(&self->priv->cmnd_con_mtx);
-    g_mutex_clear(&self->priv->flagmtx_run_listener);
-    g_mutex_clear(&self->priv->sync_mutex);
-    g_cond_clear(&self->priv->sync_cond);
 
     /* Remove API */
     MooseClient *parent = MOOSE_CLIENT(gobject);
     parent->do_disconnect = NULL;
     parent->do_get = NULL;
     parent->do_put = NULL;
+    parent->do_resubscribe = NULL;
     parent->do_connect = NULL;
     parent->do_is_connected = NULL;
 
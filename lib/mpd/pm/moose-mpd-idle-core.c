@@ -1,4 +1,5 @@
 #include "../../moose-config.h"
+#include "../../misc/moose-misc-reactor-private.h"
 #include "../moose-mpd-client-private.h"
 #include "moose-mpd-idle-core.h"
 
@@ -26,11 +27,15 @@ typedef struct _MooseIdleClientPrivate {
     /* the async connection being watched */
     struct mpd_async *async_mpd_conn;
 
-    /* A Glib IO Channel used as a watch on async_mpd_conn */
-    GIOChannel *async_chan;
+    /* Shared with all other clients, watches async_mpd_conn */
+    MooseReactor *reactor;
 
-    /* the id of a watch if active, or 0 */
-    int watch_source_id;
+    /* the id of a reactor watch if active, or 0 */
+    guint watch_source_id;
+
+    /* Timer that retries a watch event which came in while the
+     * connection was used by someone else. Disarmed if not needed. */
+    guint retry_timer_id;
 
     /* libmpdclient's helper for parsing async. recv'd lines */
     struct mpd_parser *parser;
@@ -83,9 +88,12 @@ GIOCondition mpd_async_to_gio(enum mpd_async_event events) {
     return (GIOCondition)condition;
 }
 
+/* Milliseconds to wait before retrying a watch event on a busy connection */
+#define MOOSE_IDLE_CLIENT_RETRY_MS 5
+
 /* Prototype */
-static gboolean moose_idle_client_socket_event(GIOChannel *source, GIOCondition condition,
-                                               gpointer data);
+static gboolean moose_idle_client_socket_event(MooseReactor *reactor, guint id,
+                                               GIOCondition condition, gpointer data);
 
 static void moose_idle_client_report_error(MooseIdleClient *self,
                                            G_GNUC_UNUSED enum mpd_error error,
@@ -102,7 +110,9 @@ static gboolean moose_idle_client_check_and_report_async_error(MooseIdleClient *
     if(error != MPD_ERROR_SUCCESS) {
         const char *error_msg = mpd_async_get_error_message(self->priv->async_mpd_conn);
         moose_idle_client_report_error(self, error, error_msg);
-        moose_client_disconnect(MOOSE_CLIENT(self));
+
+        /* Disconnects on the mainloop; we might be in the reactor thread */
+        moose_client_connection_lost(MOOSE_CLIENT(self));
         return TRUE;
     }
 
@@ -114,12 +124,13 @@ static void moose_idle_client_add_watch_kitten(MooseIdleClient *self) {
 
     MooseIdleClientPrivate *priv = self->priv;
     if(priv->watch_source_id == 0) {
-        /* Add a GIOSource that watches the socket for IO */
+        /* Add a reactor watch on the socket for IO */
         enum mpd_async_event events = mpd_async_events(priv->async_mpd_conn);
-        priv->watch_source_id = g_io_add_watch(priv->async_chan,
-                                               mpd_async_to_gio(events),
-                                               moose_idle_client_socket_event,
-                                               self);
+        priv->watch_source_id = moose_reactor_add_fd(priv->reactor,
+                                                     mpd_async_get_fd(priv->async_mpd_conn),
+                                                     mpd_async_to_gio(events),
+                                                     moose_idle_client_socket_event,
+                                                     self);
         /* remember the events we're polling for */
         priv->last_io_events = events;
     }
@@ -128,7 +139,7 @@ static void moose_idle_client_add_watch_kitten(MooseIdleClient *self) {
 static void moose_idle_client_remove_watch_kitten(MooseIdleClient *self) {
     MooseIdleClientPrivate *priv = self->priv;
     if(priv->watch_source_id != 0) {
-        g_source_remove(priv->watch_source_id);
+        moose_reactor_remove(priv->reactor, priv->watch_source_id);
         priv->watch_source_id = 0;
         priv->last_io_events = 0;
     }
@@ -159,7 +170,7 @@ static gboolean moose_idle_client_leave(MooseIdleClient *self) {
 static void moose_idle_client_enter(MooseIdleClient *self) {
     if(self->priv->is_in_idle_mode == false && self->priv->is_running_extern == false) {
         /* Do not wait for a reply */
-        if(mpd_async_send_command(self->priv->async_mpd_conn, "idle", NULL) == false) {
+        if(moose_client_send_idle(MOOSE_CLIENT(self), self->priv->async_mpd_conn, NULL) == false) {
             moose_idle_client_check_and_report_async_error(self);
         } else {
             /* Let's when input happens */
@@ -220,15 +231,14 @@ static gboolean moose_idle_client_process_received(MooseIdleClient *self) {
     return true;
 }
 
-static gboolean moose_idle_client_socket_event(GIOChannel *source, GIOCondition condition,
-                                               gpointer data)
-/* Called once something happens to the socket.
+static gboolean moose_idle_client_socket_event(MooseReactor *reactor, guint id,
+                                               GIOCondition condition, gpointer data)
+/* Called (in the reactor thread) once something happens to the socket.
  * The exact event is in @condition.
  *
  * This is basically where all the magic happens.
  * */
 {
-    g_assert(source);
     g_assert(data);
 
     MooseIdleClient *self = (MooseIdleClient *)data;
@@ -236,13 +246,23 @@ static gboolean moose_idle_client_socket_event(GIOChannel *source, GIOCondition
 
     /* We need to lock here because in the meantime a get/put
      * could happen from another thread. This could alter the state
-     * of the client while we're processing
+     * of the client while we're processing.
+     *
+     * The reactor is shared by all clients, so do not wait for the lock;
+     * pause the watch instead and let the retry timer pick it up again.
      */
-    g_rec_mutex_lock(&self->parent.getput_mutex);
+    if(g_rec_mutex_trylock(&self->parent.getput_mutex) == FALSE) {
+        moose_reactor_modify_fd(reactor, id, 0);
+        moose_reactor_set_timer(reactor, self->priv->retry_timer_id,
+                                MOOSE_IDLE_CLIENT_RETRY_MS);
+        return TRUE;
+    }
 
     if(mpd_async_io(self->priv->async_mpd_conn, events) == FALSE) {
         /* Failure during IO */
-        return !moose_idle_client_check_and_report_async_error(self);
+        gboolean keep_notify = !moose_idle_client_check_and_report_async_error(self);
+        g_rec_mutex_unlock(&self->parent.getput_mutex);
+        return keep_notify;
     }
 
     if(condition & G_IO_IN) {
@@ -253,7 +273,7 @@ static gboolean moose_idle_client_socket_event(GIOChannel *source, GIOCondition
 
     events = mpd_async_events(self->priv->async_mpd_conn);
 
-    gboolean keep_notify = FALSE;
+    gboolean keep_notify = TRUE;
     if(events == 0) {
         /* No events need to be polled - so disable the watch
          * (I've never seen this happen though.
@@ -262,13 +282,9 @@ static gboolean moose_idle_client_socket_event(GIOChannel *source, GIOCondition
         self->priv->last_io_events = 0;
         keep_notify = FALSE;
     } else if(events != self->priv->last_io_events) {
-        /* different event-mask, so we cannot reuse the current watch */
-        moose_idle_client_remove_watch_kitten(self);
-        moose_idle_client_add_watch_kitten(self);
-        keep_notify = FALSE;
-    } else {
-        /* Keep the old watch */
-        keep_notify = TRUE;
+        /* different event-mask, wait for the new events */
+        moose_reactor_modify_fd(reactor, id, mpd_async_to_gio(events));
+        self->priv->last_io_events = events;
     }
 
     /* Unlock again - We're now ready to take other
@@ -278,6 +294,29 @@ static gboolean moose_idle_client_socket_event(GIOChannel *source, GIOCondition
     return keep_notify;
 }
 
+/* Resumes a watch paused by moose_idle_client_socket_event() */
+static gboolean moose_idle_client_retry_watch(MooseReactor *reactor, guint id,
+                                              G_GNUC_UNUSED GIOCondition condition,
+                                              gpointer data) {
+    MooseIdleClient *self = (MooseIdleClient *)data;
+
+    if(g_rec_mutex_trylock(&self->parent.getput_mutex) == FALSE) {
+        /* Still busy, the timer fires again */
+        return TRUE;
+    }
+
+    moose_reactor_set_timer(reactor, id, 0);
+
+    /* The watch might have been replaced meanwhile, that's fine */
+    if(self->priv->watch_source_id != 0) {
+        moose_reactor_modify_fd(reactor, self->priv->watch_source_id,
+                                mpd_async_to_gio(self->priv->last_io_events));
+    }
+
+    g_rec_mutex_unlock(&self->parent.getput_mutex);
+    return TRUE;
+}
+
 /* code that is shared for connect/disconnect */
 static void moose_idle_client_reset_struct(MooseIdleClient *self) {
     /* Initially there is no watchkitteh, 0 tells us that */
@@ -307,13 +346,10 @@ static char *moose_idle_client_do_connect(MooseClient *parent, const char *host,
 
     /* Get the underlying async connection */
     self->priv->async_mpd_conn = mpd_connection_get_async(self->priv->con);
-    int async_fd = mpd_async_get_fd(self->priv->async_mpd_conn);
-    self->priv->async_chan = g_io_channel_unix_new(async_fd);
 
-    if(self->priv->async_chan == NULL) {
-        error = (char *)"Created GIOChannel is NULL (probably a bug!)";
-        goto failure;
-    }
+    /* Disarmed until needed */
+    self->priv->retry_timer_id =
+        moose_reactor_add_timer(self->priv->reactor, 0, moose_idle_client_retry_watch, self);
 
     /* the parser object needs to be instantiated only once */
     self->priv->parser = mpd_parser_new();
@@ -361,24 +397,23 @@ static gboolean moose_idle_client_do_disconnect(MooseClient *parent) {
     if(moose_idle_client_do_is_connected(parent)) {
         MooseIdleClient *self = MOOSE_IDLE_CLIENT(parent);
 
+        /* Keep reactor callbacks out (finalize calls us without the lock) */
+        g_rec_mutex_lock(&parent->getput_mutex);
         g_mutex_lock(&self->priv->one_thread_only_mtx);
 
         /* Be nice and send a final noidle if needed */
         moose_idle_client_leave(self);
 
+        /* Waits for running callbacks */
+        moose_idle_client_remove_watch_kitten(self);
+        moose_reactor_remove(self->priv->reactor, self->priv->retry_timer_id);
+        self->priv->retry_timer_id = 0;
+
         /* Underlying async connection is free too */
         mpd_connection_free(self->priv->con);
         self->priv->con = NULL;
         self->priv->async_mpd_conn = NULL;
 
-        if(self->priv->watch_source_id != 0) {
-            g_source_remove(self->priv->watch_source_id);
-            self->priv->watch_source_id = 0;
-        }
-
-        g_io_channel_unref(self->priv->async_chan);
-        self->priv->async_mpd_conn = NULL;
-
         if(self->priv->parser != NULL) {
             mpd_parser_free(self->priv->parser);
         }
@@ -386,6 +421,7 @@ static gboolean moose_idle_client_do_disconnect(MooseClient *parent) {
         /* Make the struct reconnect-able */
         moose_idle_client_reset_struct(self);
         g_mutex_unlock(&self->priv->one_thread_only_mtx);
+        g_rec_mutex_unlock(&parent->getput_mutex);
 
         return TRUE;
     } else {
@@ -404,12 +440,14 @@ static void moose_idle_client_init(MooseIdleClient *object) {
 
     MooseIdleClient *self = MOOSE_IDLE_CLIENT(object);
     self->priv = moose_idle_client_get_instance_private(self);
+    self->priv->reactor = moose_reactor_ref_default();
     g_mutex_init(&self->priv->one_thread_only_mtx);
 }
 
 static void moose_idle_client_finalize(GObject *gobject) {
     MooseIdleClient *self = MOOSE_IDLE_CLIENT(gobject);
     moose_idle_client_do_disconnect(MOOSE_CLIENT(self));
+    moose_reactor_unref(self->priv->reactor);
     g_mutex_clear(&self->priv->one_thread_only_mtx);
 
     MooseClient *parent = MOOSE_CLIENT(self);
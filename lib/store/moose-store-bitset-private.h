@@ -0,0 +1,71 @@
+#ifndef MOOSE_STORE_BITSET_PRIVATE_H
+#define MOOSE_STORE_BITSET_PRIVATE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Set of song indices (positions in the store's stack), one bit per song.
+ *
+ * Holds the result of a query, so the queue and stored playlists can be
+ * filtered by it: instead of sorting pointer arrays and searching them,
+ * membership is a single bit test, and iterating skips 64 songs per step.
+ * Even for 500k songs a set is only 61 KiB.
+ *
+ * There are no AND/OR/NOT operations on purpose: no query combines the
+ * queue, stored playlist or directory membership as sets. Those results
+ * keep the queue or playlist order and their duplicates, so they are
+ * filtered by membership tests instead. Add the operations together with
+ * the first query that really combines sets.
+ */
+
+typedef struct _MooseStoreBitset MooseStoreBitset;
+
+/**
+ * moose_store_bitset_new: skip:
+ * @size: number of indices the set can hold (0 ... size - 1).
+ *
+ * Returns: (transfer full): a new, empty set. Free with moose_store_bitset_free().
+ */
+MooseStoreBitset *moose_store_bitset_new(unsigned size);
+
+/**
+ * moose_store_bitset_free: skip:
+ * @self: a #MooseStoreBitset, may be NULL.
+ */
+void moose_store_bitset_free(MooseStoreBitset *self);
+
+/**
+ * moose_store_bitset_add: skip:
+ * @self: a #MooseStoreBitset
+ * @idx: index to add; ignored if not smaller than the size.
+ */
+void moose_store_bitset_add(MooseStoreBitset *self, unsigned idx);
+
+/**
+ * moose_store_bitset_contains: skip:
+ * @self: a #MooseStoreBitset
+ * @idx: index to test.
+ *
+ * Returns: TRUE if @idx is in the set.
+ */
+gboolean moose_store_bitset_contains(const MooseStoreBitset *self, unsigned idx);
+
+/**
+ * moose_store_bitset_next: skip:
+ * @self: a #MooseStoreBitset
+ * @from: index to start searching at.
+ *
+ * Iterate over a set in ascending order:
+ *
+ *      for(int i = moose_store_bitset_next(set, 0); i >= 0;
+ *          i = moose_store_bitset_next(set, i + 1)) { ... }
+ *
+ * Returns: the smallest index >= @from in the set, or -1.
+ */
+int moose_store_bitset_next(const MooseStoreBitset *self, unsigned from);
+
+G_END_DECLS
+
+#endif /* end of include guard: MOOSE_STORE_BITSET_PRIVATE_H */
@@ -0,0 +1,68 @@
+#include "moose-store-bitset-private.h"
+
+#define MOOSE_BITSET_WORD_BITS 64
+
+struct _MooseStoreBitset {
+    /* Number of valid bits */
+    unsigned size;
+
+    /* Number of words; bits >= size in the last one are always 0 */
+    unsigned n_words;
+
+    guint64 *words;
+};
+
+MooseStoreBitset *moose_store_bitset_new(unsigned size) {
+    MooseStoreBitset *self = g_slice_new0(MooseStoreBitset);
+    self->size = size;
+    self->n_words = (size + MOOSE_BITSET_WORD_BITS - 1) / MOOSE_BITSET_WORD_BITS;
+    self->words = g_new0(guint64, MAX(self->n_words, 1));
+    return self;
+}
+
+void moose_store_bitset_free(MooseStoreBitset *self) {
+    if(self != NULL) {
+        g_free(self->words);
+        g_slice_free(MooseStoreBitset, self);
+    }
+}
+
+void moose_store_bitset_add(MooseStoreBitset *self, unsigned idx) {
+    g_assert(self);
+    if(idx < self->size) {
+        self->words[idx / MOOSE_BITSET_WORD_BITS] |=
+            G_GUINT64_CONSTANT(1) << (idx % MOOSE_BITSET_WORD_BITS);
+    }
+}
+
+gboolean moose_store_bitset_contains(const MooseStoreBitset *self, unsigned idx) {
+    g_assert(self);
+    if(idx >= self->size) {
+        return FALSE;
+    }
+
+    return (self->words[idx / MOOSE_BITSET_WORD_BITS] >> (idx % MOOSE_BITSET_WORD_BITS)) &
+           1;
+}
+
+int moose_store_bitset_next(const MooseStoreBitset *self, unsigned from) {
+    g_assert(self);
+    if(from >= self->size) {
+        return -1;
+    }
+
+    unsigned word_idx = from / MOOSE_BITSET_WORD_BITS;
+
+    /* Mask out the bits below from in the first word */
+    guint64 word = self->words[word_idx] &
+                   (G_MAXUINT64 << (from % MOOSE_BITSET_WORD_BITS));
+
+    while(word == 0) {
+        if(++word_idx >= self->n_words) {
+            return -1;
+        }
+        word = self->words[word_idx];
+    }
+
+    return word_idx * MOOSE_BITSET_WORD_BITS + __builtin_ctzll(word);
+}
@@ -0,0 +1,51 @@
+#ifndef MOOSE_STORE_DIR_TREE_PRIVATE_H
+#define MOOSE_STORE_DIR_TREE_PRIVATE_H
+
+#include "moose-store-playlist.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Directory structure of the music database, kept in memory for browsing.
+ *
+ * Every directory is a node holding its full path (allocated once),
+ * its subdirectories (sorted by path) and the stack indices of the songs
+ * directly in it. Listing a directory is a hash lookup for the node
+ * and a walk over its children; nothing is formatted or allocated.
+ */
+
+typedef struct _MooseStoreDirTree MooseStoreDirTree;
+
+/**
+ * moose_store_dir_tree_new: skip:
+ * @songs: all songs of the database (the store's stack).
+ * @dirs: (nullable): paths of all directories, so empty ones are known too.
+ *
+ * Returns: (transfer full): a new tree. Free with moose_store_dir_tree_free().
+ */
+MooseStoreDirTree *moose_store_dir_tree_new(MoosePlaylist *songs, GPtrArray *dirs);
+
+/**
+ * moose_store_dir_tree_free: skip:
+ * @self: a #MooseStoreDirTree, may be NULL.
+ */
+void moose_store_dir_tree_free(MooseStoreDirTree *self);
+
+/**
+ * moose_store_dir_tree_list: skip:
+ * @self: a #MooseStoreDirTree
+ * @songs: the same songs the tree was built from.
+ * @directory: (nullable): path of the directory to list, NULL or "" for the root.
+ * @depth: levels below @directory to list, 1 for the direct children, -1 for all.
+ * @out_songs: stack to append the songs to.
+ * @out_dirs: array to append the paths of the directories to; they belong to @self.
+ *
+ * Returns: number of appended entries, or -1 if @directory does not exist.
+ */
+int moose_store_dir_tree_list(MooseStoreDirTree *self, MoosePlaylist *songs,
+                              const char *directory, int depth, MoosePlaylist *out_songs,
+                              GPtrArray *out_dirs);
+
+G_END_DECLS
+
+#endif /* end of include guard: MOOSE_STORE_DIR_TREE_PRIVATE_H */
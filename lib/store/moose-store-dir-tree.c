@@ -0,0 +1,193 @@
+#include "moose-store-dir-tree-private.h"
+#include "../mpd/moose-song.h"
+
+#include <string.h>
+
+typedef struct _MooseStoreDirNode {
+    /* Full path, "" for the root */
+    char *path;
+
+    /* Subdirectories (MooseStoreDirNode), sorted by path; NULL if none */
+    GPtrArray *children;
+
+    /* guint32 stack indices of the songs directly in this directory; NULL if none */
+    GArray *song_idxs;
+} MooseStoreDirNode;
+
+struct _MooseStoreDirTree {
+    /* Maps paths to their MooseStoreDirNode, the root is "" */
+    GHashTable *nodes;
+
+    MooseStoreDirNode *root;
+
+    /* Scratch buffer for lookups while building */
+    GString *key;
+};
+
+static void moose_store_dir_node_free(MooseStoreDirNode *node) {
+    if(node->children != NULL) {
+        g_ptr_array_free(node->children, true);
+    }
+
+    if(node->song_idxs != NULL) {
+        g_array_free(node->song_idxs, true);
+    }
+
+    g_free(node->path);
+    g_slice_free(MooseStoreDirNode, node);
+}
+
+static MooseStoreDirNode *moose_store_dir_tree_get_node(MooseStoreDirTree *self,
+                                                        const char *path, size_t len) {
+    g_string_truncate(self->key, 0);
+    g_string_append_len(self->key, path, len);
+
+    MooseStoreDirNode *node = g_hash_table_lookup(self->nodes, self->key->str);
+    if(node != NULL) {
+        return node;
+    }
+
+    node = g_slice_new0(MooseStoreDirNode);
+    node->path = g_strndup(path, len);
+    g_hash_table_insert(self->nodes, node->path, node);
+
+    /* Create the parents on the way up, the root exists already */
+    const char *slash = g_strrstr_len(path, len, "/");
+    MooseStoreDirNode *parent =
+        moose_store_dir_tree_get_node(self, path, (slash) ? (size_t)(slash - path) : 0);
+
+    if(parent->children == NULL) {
+        parent->children = g_ptr_array_new();
+    }
+    g_ptr_array_add(parent->children, node);
+
+    return node;
+}
+
+static gint moose_store_dir_node_compare(gconstpointer a, gconstpointer b) {
+    const MooseStoreDirNode *node_a = *(MooseStoreDirNode **)a;
+    const MooseStoreDirNode *node_b = *(MooseStoreDirNode **)b;
+    return g_strcmp0(node_a->path, node_b->path);
+}
+
+MooseStoreDirTree *moose_store_dir_tree_new(MoosePlaylist *songs, GPtrArray *dirs) {
+    g_assert(songs);
+
+    MooseStoreDirTree *self = g_slice_new0(MooseStoreDirTree);
+    self->nodes = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                        (GDestroyNotify)moose_store_dir_node_free);
+    self->key = g_string_sized_new(256);
+
+    self->root = g_slice_new0(MooseStoreDirNode);
+    self->root->path = g_strdup("");
+    g_hash_table_insert(self->nodes, self->root->path, self->root);
+
+    for(unsigned i = 0; dirs != NULL && i < dirs->len; ++i) {
+        const char *path = g_ptr_array_index(dirs, i);
+        moose_store_dir_tree_get_node(self, path, strlen(path));
+    }
+
+    for(unsigned i = 0; i < moose_playlist_length(songs); ++i) {
+        const char *uri = moose_song_get_uri(moose_playlist_at(songs, i));
+        if(uri == NULL) {
+            continue;
+        }
+
+        const char *slash = strrchr(uri, '/');
+        MooseStoreDirNode *node =
+            moose_store_dir_tree_get_node(self, uri, (slash) ? (size_t)(slash - uri) : 0);
+
+        if(node->song_idxs == NULL) {
+            node->song_idxs = g_array_new(false, false, sizeof(guint32));
+        }
+
+        guint32 song_idx = i;
+        g_array_append_val(node->song_idxs, song_idx);
+    }
+
+    GHashTableIter iter;
+    gpointer value = NULL;
+
+    g_hash_table_iter_init(&iter, self->nodes);
+    while(g_hash_table_iter_next(&iter, NULL, &value)) {
+        MooseStoreDirNode *node = value;
+        if(node->children != NULL) {
+            g_ptr_array_sort(node->children, moose_store_dir_node_compare);
+        }
+    }
+
+    g_string_free(self->key, true);
+    self->key = NULL;
+
+    return self;
+}
+
+void moose_store_dir_tree_free(MooseStoreDirTree *self) {
+    if(self != NULL) {
+        /* Frees the nodes, including the root */
+        g_hash_table_destroy(self->nodes);
+        g_slice_free(MooseStoreDirTree, self);
+    }
+}
+
+static int moose_store_dir_tree_collect(MooseStoreDirNode *node, MoosePlaylist *songs,
+                                        int depth, MoosePlaylist *out_songs,
+                                        GPtrArray *out_dirs) {
+    int appended = 0;
+    if(depth == 0) {
+        return appended;
+    }
+
+    for(unsigned i = 0; node->children != NULL && i < node->children->len; ++i) {
+        MooseStoreDirNode *child = g_ptr_array_index(node->children, i);
+        g_ptr_array_add(out_dirs, child->path);
+        appended += 1 + moose_store_dir_tree_collect(child, songs, depth - 1, out_songs,
+                                                     out_dirs);
+    }
+
+    unsigned n_songs = moose_playlist_length(songs);
+    for(unsigned i = 0; node->song_idxs != NULL && i < node->song_idxs->len; ++i) {
+        guint32 song_idx = g_array_index(node->song_idxs, guint32, i);
+        if(song_idx < n_songs) {
+            moose_playlist_append(out_songs, moose_playlist_at(songs, song_idx));
+            ++appended;
+        }
+    }
+
+    return appended;
+}
+
+int moose_store_dir_tree_list(MooseStoreDirTree *self, MoosePlaylist *songs,
+                              const char *directory, int depth, MoosePlaylist *out_songs,
+                              GPtrArray *out_dirs) {
+    g_assert(self);
+    g_assert(songs);
+    g_assert(out_songs);
+    g_assert(out_dirs);
+
+    /* "/", "/a/b" and "a/b/" are accepted too */
+    while(directory != NULL && *directory == '/') {
+        ++directory;
+    }
+
+    char *trimmed = NULL;
+    if(directory != NULL && g_str_has_suffix(directory, "/")) {
+        trimmed = g_strdup(directory);
+        directory = trimmed;
+
+        for(size_t len = strlen(trimmed); len > 0 && trimmed[len - 1] == '/'; --len) {
+            trimmed[len - 1] = 0;
+        }
+    }
+
+    MooseStoreDirNode *node =
+        g_hash_table_lookup(self->nodes, (directory != NULL) ? directory : "");
+    g_free(trimmed);
+
+    if(node == NULL) {
+        return -1;
+    }
+
+    /* Negative depths never reach 0, so they list everything */
+    return moose_store_dir_tree_collect(node, songs, depth, out_songs, out_dirs);
+}
@@ -0,0 +1,106 @@
+#ifndef MOOSE_STORE_LIBRARY_PRIVATE_H
+#define MOOSE_STORE_LIBRARY_PRIVATE_H
+
+#include "../mpd/moose-status.h"
+#include "moose-store-playlist.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Process wide registry of music databases, shared between all MooseStores
+ * in a process (e.g. one per room) whose servers use the very same database.
+ *
+ * A library is identified by a fingerprint of the server's stats; once one
+ * store fetched the songs, all others with the same fingerprint create their
+ * songs from it (see moose_song_new_shared()) instead of doing a listallinfo
+ * of their own. The song strings are therefore only held once; queue
+ * positions, ids and stored playlists stay per store.
+ *
+ * This does not make the memory of a room constant: every store still has
+ * one #MooseSong object per song (moose_song_get_instance_size() bytes,
+ * without strings), its own sqlite songs table with the FTS index, and its
+ * own moosecat_<host>:<port>.sqlite cache on disk. All of these grow with
+ * the size of the database times the number of stores, since the queue and
+ * playlist queries join against the per store tables. After loading, each
+ * store logs how much is shared and how much it holds on its own.
+ */
+
+typedef struct _MooseStoreLibrary MooseStoreLibrary;
+
+/**
+ * moose_store_library_fingerprint: skip:
+ * @status: a #MooseStatus with valid stats
+ * @tag_mask: the tags the store keeps, see #MooseStore:tag-mask
+ *
+ * Returns: (transfer full): a string identifying the database of the server,
+ *          or NULL if the stats are not known yet. Free with g_free().
+ */
+char *moose_store_library_fingerprint(const MooseStatus *status, unsigned tag_mask);
+
+/**
+ * moose_store_library_lookup: skip:
+ * @fingerprint: as returned by moose_store_library_fingerprint(), may be NULL.
+ *
+ * Returns: (transfer full): the library with this fingerprint or NULL.
+ */
+MooseStoreLibrary *moose_store_library_lookup(const char *fingerprint);
+
+/**
+ * moose_store_library_publish: skip:
+ * @fingerprint: as returned by moose_store_library_fingerprint().
+ * @songs: all songs of the database; they are reffed and their uri and tags
+ *         must not change from now on.
+ * @dirs: (transfer full): all directory paths of the database (strings).
+ *
+ * Make a complete database available to other stores.
+ * If there is already a library with this fingerprint it is kept as it is.
+ *
+ * Returns: (transfer full): the library with this fingerprint.
+ */
+MooseStoreLibrary *moose_store_library_publish(const char *fingerprint,
+                                               MoosePlaylist *songs, GPtrArray *dirs);
+
+/**
+ * moose_store_library_unref: skip:
+ * @self: a #MooseStoreLibrary, may be NULL.
+ *
+ * Once the last store dropped its reference the library is forgotten.
+ */
+void moose_store_library_unref(MooseStoreLibrary *self);
+
+/**
+ * moose_store_library_get_songs: skip:
+ * @self: a #MooseStoreLibrary
+ *
+ * Returns: (transfer none): all songs, in the order the server sent them.
+ */
+MoosePlaylist *moose_store_library_get_songs(MooseStoreLibrary *self);
+
+/**
+ * moose_store_library_get_dirs: skip:
+ * @self: a #MooseStoreLibrary
+ *
+ * Returns: (transfer none): all directory paths.
+ */
+GPtrArray *moose_store_library_get_dirs(MooseStoreLibrary *self);
+
+/**
+ * moose_store_library_find_song: skip:
+ * @self: a #MooseStoreLibrary
+ * @uri: the uri to look for.
+ *
+ * Returns: (transfer none): the song with this uri or NULL.
+ */
+MooseSong *moose_store_library_find_song(MooseStoreLibrary *self, const char *uri);
+
+/**
+ * moose_store_library_get_string_bytes: skip:
+ * @self: a #MooseStoreLibrary
+ *
+ * Returns: the bytes of uri and tag strings all stores share.
+ */
+gsize moose_store_library_get_string_bytes(MooseStoreLibrary *self);
+
+G_END_DECLS
+
+#endif /* end of include guard: MOOSE_STORE_LIBRARY_PRIVATE_H */
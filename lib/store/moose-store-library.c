@@ -0,0 +1,177 @@
+#include "moose-store-library-private.h"
+#include "../moose-config.h"
+
+#include <string.h>
+
+struct _MooseStoreLibrary {
+    char *fingerprint;
+
+    /* Reffed MooseSongs, in the order of listallinfo */
+    MoosePlaylist *songs;
+
+    /* Maps the uri of each song in songs to it */
+    GHashTable *uri_index;
+
+    /* Directory paths (strings) */
+    GPtrArray *dirs;
+
+    /* Bytes of uri and tag strings, held only once for all stores */
+    gsize string_bytes;
+
+    /* Number of stores using this library */
+    int refcount;
+};
+
+/* Maps fingerprints to (unreffed) MooseStoreLibrary */
+G_LOCK_DEFINE_STATIC(LIBRARIES);
+static GHashTable *LIBRARIES = NULL;
+
+char *moose_store_library_fingerprint(const MooseStatus *status, unsigned tag_mask) {
+    if(status == NULL) {
+        return NULL;
+    }
+
+    unsigned long db_update = moose_status_stats_get_db_update_time(status);
+    if(db_update == 0) {
+        return NULL;
+    }
+
+    /* db_update alone is just a second; the counts rule out most collisions.
+     * Stores keeping different tags cannot share their songs. */
+    return g_strdup_printf("%lu:%u:%u:%u:%lu:%x", db_update,
+                           moose_status_stats_get_number_of_songs(status),
+                           moose_status_stats_get_number_of_artists(status),
+                           moose_status_stats_get_number_of_albums(status),
+                           moose_status_stats_get_db_play_time(status), tag_mask);
+}
+
+MooseStoreLibrary *moose_store_library_lookup(const char *fingerprint) {
+    MooseStoreLibrary *self = NULL;
+    if(fingerprint == NULL) {
+        return NULL;
+    }
+
+    G_LOCK(LIBRARIES);
+    {
+        if(LIBRARIES != NULL) {
+            self = g_hash_table_lookup(LIBRARIES, fingerprint);
+        }
+
+        if(self != NULL) {
+            self->refcount++;
+        }
+    }
+    G_UNLOCK(LIBRARIES);
+
+    return self;
+}
+
+static MooseStoreLibrary *moose_store_library_new(const char *fingerprint,
+                                                  MoosePlaylist *songs, GPtrArray *dirs) {
+    MooseStoreLibrary *self = g_slice_new0(MooseStoreLibrary);
+    unsigned length = moose_playlist_length(songs);
+
+    self->fingerprint = g_strdup(fingerprint);
+    self->songs = moose_playlist_new_full(length + 1, (GDestroyNotify)moose_song_unref);
+    self->uri_index = g_hash_table_new(g_str_hash, g_str_equal);
+    self->dirs = dirs;
+    self->refcount = 1;
+
+    for(unsigned i = 0; i < length; ++i) {
+        MooseSong *song = moose_playlist_at(songs, i);
+        if(song != NULL) {
+            moose_playlist_append(self->songs, g_object_ref(song));
+            g_hash_table_insert(self->uri_index, (char *)moose_song_get_uri(song), song);
+            self->string_bytes += strlen(moose_song_get_uri(song)) + 1;
+
+            for(int tag = 0; tag < MOOSE_TAG_COUNT; ++tag) {
+                const char *value = moose_song_get_tag(song, tag);
+                if(value != NULL) {
+                    self->string_bytes += strlen(value) + 1;
+                }
+            }
+        }
+    }
+
+    return self;
+}
+
+MooseStoreLibrary *moose_store_library_publish(const char *fingerprint,
+                                               MoosePlaylist *songs, GPtrArray *dirs) {
+    g_assert(fingerprint);
+    g_assert(songs);
+    g_assert(dirs);
+
+    MooseStoreLibrary *self = NULL;
+
+    G_LOCK(LIBRARIES);
+    {
+        if(LIBRARIES == NULL) {
+            LIBRARIES = g_hash_table_new(g_str_hash, g_str_equal);
+        }
+
+        self = g_hash_table_lookup(LIBRARIES, fingerprint);
+        if(self != NULL) {
+            /* Somebody else was quicker; keep the songs other stores use already */
+            self->refcount++;
+        } else {
+            self = moose_store_library_new(fingerprint, songs, dirs);
+            g_hash_table_insert(LIBRARIES, self->fingerprint, self);
+            moose_message("library: sharing %u songs as %s",
+                          moose_playlist_length(self->songs), fingerprint);
+            dirs = NULL;
+        }
+    }
+    G_UNLOCK(LIBRARIES);
+
+    if(dirs != NULL) {
+        g_ptr_array_unref(dirs);
+    }
+
+    return self;
+}
+
+void moose_store_library_unref(MooseStoreLibrary *self) {
+    if(self == NULL) {
+        return;
+    }
+
+    gboolean is_last = FALSE;
+    G_LOCK(LIBRARIES);
+    {
+        if(--self->refcount == 0) {
+            g_hash_table_remove(LIBRARIES, self->fingerprint);
+            is_last = TRUE;
+        }
+    }
+    G_UNLOCK(LIBRARIES);
+
+    if(is_last) {
+        /* Songs created from ours keep them alive by themselves */
+        g_hash_table_destroy(self->uri_index);
+        moose_playlist_unref(self->songs);
+        g_ptr_array_unref(self->dirs);
+        g_free(self->fingerprint);
+        g_slice_free(MooseStoreLibrary, self);
+    }
+}
+
+MoosePlaylist *moose_store_library_get_songs(MooseStoreLibrary *self) {
+    g_assert(self);
+    return self->songs;
+}
+
+GPtrArray *moose_store_library_get_dirs(MooseStoreLibrary *self) {
+    g_assert(self);
+    return self->dirs;
+}
+
+MooseSong *moose_store_library_find_song(MooseStoreLibrary *self, const char *uri) {
+    g_assert(self);
+    return g_hash_table_lookup(self->uri_index, uri);
+}
+
+gsize moose_store_library_get_string_bytes(MooseStoreLibrary *self) {
+    g_assert(self);
+    return self->string_bytes;
+}
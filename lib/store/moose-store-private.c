@@ -1,6 +1,7 @@
 #include "../moose-config.h"
 #include "../mpd/moose-song-private.h"
 #include "moose-store-query-parser.h"
+#include "moose-store-bitset-private.h"
 
 /**
  * @brief Open a :memory: db
@@ -107,6 +108,35 @@ int moose_stprv_get_pl_version(MooseStorePrivate *self);
  */
 int moose_stprv_get_sc_version(MooseStorePrivate *self);
 
+/**
+ * @brief get the mask of tags the songs table was filled with
+ */
+unsigned moose_stprv_get_tag_mask(MooseStorePrivate *self);
+
+/**
+ * @brief Create a song from song_struct, with only the tags of the store's tag-mask.
+ */
+MooseSong *moose_stprv_song_new(MooseStorePrivate *self,
+                                const struct mpd_song *song_struct);
+
+/**
+ * @brief Ask the server to only send the tags of the store's tag-mask.
+ *
+ * Call moose_stprv_tagtypes_end() on the same connection when done.
+ * Does nothing if all tags are wanted or the server is too old.
+ *
+ * @return true if the tag types were restricted.
+ */
+bool moose_stprv_tagtypes_begin(MooseStorePrivate *self, struct mpd_connection *conn);
+
+/**
+ * @brief Let the server send all tags again.
+ *
+ * @param restricted the return value of moose_stprv_tagtypes_begin()
+ */
+void moose_stprv_tagtypes_end(MooseStorePrivate *self, struct mpd_connection *conn,
+                              bool restricted);
+
 /**
  * @brief get mpd port to the db where this belongs to.
  */
@@ -130,10 +160,28 @@ char *moose_stprv_get_mpd_host(MooseStorePrivate *self);
 int moose_stprv_queue_clip(MooseStorePrivate *self, int since_pos);
 
 /**
- * @brief Update a song, identified by file's pos/id to pos/idx
+ * @brief Remember that the song at stack index song_idx is queued at pos with id idx
+ *
+ * song_idx may be -1 for songs that are not in the database.
  */
 void moose_stprv_queue_insert_posid(MooseStorePrivate *self, int pos, int idx,
-                                    const char *file);
+                                    int song_idx);
+
+/**
+ * @brief Append song to self->stack and remember the index of its uri.
+ *
+ * @return the stack index of song
+ */
+int moose_stprv_stack_append(MooseStorePrivate *self, MooseSong *song);
+
+/**
+ * @brief Find the stack index of the song with this uri.
+ *
+ * If several songs have this uri (queue-only/hybrid) the first one is returned.
+ *
+ * @return the index or -1 if there is no such song.
+ */
+int moose_stprv_stack_find_uri(MooseStorePrivate *self, const char *uri);
 
 /**
  * @brief Update the song's stack songs pos/id according to the songs table.
@@ -187,6 +235,24 @@ void moose_stprv_dir_insert(MooseStorePrivate *self, const char *path);
  */
 void moose_stprv_dir_delete(MooseStorePrivate *self);
 
+/**
+ * @brief Select the paths of all directories in the dir table.
+ *
+ * @param self the store to operate on
+ *
+ * @return a newly allocated array of strings.
+ */
+GPtrArray *moose_stprv_dir_select_all(MooseStorePrivate *self);
+
+/**
+ * @brief Rebuild self->dir_tree from the stack and the dirs table.
+ *
+ * Call whenever the stack was rebuilt.
+ *
+ * @param self the store to operate on
+ */
+void moose_stprv_dir_tree_update(MooseStorePrivate *self);
+
 /**
  * @brief Query the database
  *
@@ -235,7 +301,19 @@ void moose_stprv_oper_listallinfo(MooseStorePrivate *store, volatile gboolean *c
 void moose_stprv_oper_plchanges(MooseStorePrivate *store, volatile gboolean *cancel);
 
 /**
- * @brief Init self->spl.*
+ * @brief Find out what changed while being disconnected from the same server.
+ *
+ * Only the db_version and the queue version are asked from the server;
+ * everything else in the store is kept as it is.
+ *
+ * @param store The Store passed.
+ *
+ * @return the MooseStoreOperation mask needed to catch up.
+ */
+int moose_stprv_oper_resume(MooseStorePrivate *store);
+
+/**
+ * @brief Init self->spl_loaded
  *
  * @param self the store to initialzie stored playlist support
  */
@@ -248,12 +326,31 @@ void moose_stprv_spl_init(MooseStorePrivate *self);
  */
 void moose_stprv_spl_destroy(MooseStorePrivate *self);
 
+/**
+ * @brief Restore the loaded stored playlists saved in the database.
+ *
+ * Call after moose_stprv_deserialize_songs().
+ *
+ * @param self the store to operate on
+ */
+void moose_stprv_spl_deserialize(MooseStorePrivate *self);
+
+/**
+ * @brief Mark all loaded stored playlists for reload.
+ *
+ * Needed once the songs table is rebuilt, since the songs get other indices.
+ * The next moose_stprv_spl_update() reloads them.
+ *
+ * @param self the store to operate on
+ */
+void moose_stprv_spl_invalidate(MooseStorePrivate *self);
+
 /**
  * @brief Update stored playlists from MPD
  *
  * - This will only fetch metadata about the playlist.
  *   use moose_stprv_spl_load to actually load them
- * - This will drop orphanded playlists.
+ * - This will drop orphanded playlists and reload changed ones.
  *
  * @param self the store to update.
  */
@@ -269,6 +366,19 @@ void moose_stprv_spl_update(MooseStorePrivate *self);
  */
 bool moose_stprv_spl_load(MooseStorePrivate *store, struct mpd_playlist *playlist);
 
+/**
+ * @brief Load known but not yet loaded stored playlists, one by one.
+ *
+ * Stops once the loaded playlists hold more than settings.spl_prefetch_budget
+ * songs, or as soon as the job is cancelled by a job of higher priority.
+ *
+ * @param self the store to load them to.
+ * @param cancel A flag indicating the desired cancellation of a Job.
+ *
+ * @return false if cancelled before all playlists (within budget) were loaded.
+ */
+bool moose_stprv_spl_prefetch(MooseStorePrivate *self, volatile gboolean *cancel);
+
 /**
  * @brief Load a playlist by it's name.
  *
@@ -311,6 +421,72 @@ int moose_stprv_spl_get_loaded_playlists(MooseStorePrivate *store, GPtrArray *st
  */
 int moose_stprv_spl_get_known_playlists(MooseStorePrivate *store, GPtrArray *stack);
 
+/**
+ * @brief Check if the songs table holds only the queue, not the database.
+ *
+ * True in hybrid and in queue-only mode.
+ *
+ * @param self the store to operate on
+ *
+ * @return true if only the queue is mirrored
+ */
+bool moose_stprv_mirrors_queue(MooseStorePrivate *self);
+
+/**
+ * @brief Drop all songs remembered from server searches (hybrid mode only).
+ *
+ * Needed after the database changed, since their tags might be outdated.
+ *
+ * @param self the store to operate on
+ */
+void moose_stprv_recent_clear(MooseStorePrivate *self);
+
+/**
+ * @brief Search the whole database on the server (hybrid mode only).
+ *
+ * Only a subset of the query syntax is understood: words, optionally
+ * prefixed by a tag ("artist:Knorkator") and quoted phrases; all of them
+ * need to match (case insensitive, as substring). Operators are ignored.
+ *
+ * @param self the store to operate on
+ * @param match_clause the query
+ * @param stack the stack to write the results to; it keeps the songs alive.
+ * @param limit_len max. number of results, negative for all.
+ *
+ * @return number of found songs.
+ */
+int moose_stprv_hybrid_search(MooseStorePrivate *self, const char *match_clause,
+                              MoosePlaylist *stack, int limit_len);
+
+/**
+ * @brief List a directory on the server (hybrid mode only).
+ *
+ * Directories are written as "-1:path", songs as "0:uri", since they
+ * have no row in the songs table.
+ *
+ * @param self the store to operate on
+ * @param stack stack to write the results to
+ * @param directory directory to list or NULL for the root
+ *
+ * @return number of entries or -1 on error.
+ */
+int moose_stprv_hybrid_query_directories(MooseStorePrivate *self, MoosePlaylist *stack,
+                                         const char *directory);
+
+/**
+ * @brief Filter a stored playlist by asking the server (hybrid mode only).
+ *
+ * @param self the store to operate on
+ * @param stack stack to write the results to; it keeps the songs alive.
+ * @param playlist_name name of the stored playlist
+ * @param match_clause query as understood by moose_stprv_hybrid_search()
+ *
+ * @return number of matching songs.
+ */
+int moose_stprv_hybrid_select_playlist(MooseStorePrivate *self, MoosePlaylist *stack,
+                                       const char *playlist_name,
+                                       const char *match_clause);
+
 /* strlen() */
 #include <string.h>
 
@@ -330,7 +506,7 @@ int moose_stprv_spl_get_known_playlists(MooseStorePrivate *store, GPtrArray *sta
  * DB Layout version.
  * Older tables will not be loaded.
  * */
-#define MOOSE_DB_SCHEMA_VERSION 2
+#define MOOSE_DB_SCHEMA_VERSION 5
 
 #define MOOSE_STORE_TMP_DB_PATH "/tmp/.moosecat.tmp.db"
 
@@ -370,7 +546,9 @@ typedef enum {
     MOOSE_OPER_UPDATE_META = 1 << 10,     /* Update meta information about the table */
     MOOSE_OPER_WRITE_DATABASE = 1 << 11,  /* Write Database to disk, making a backup */
     MOOSE_OPER_FIND_SONG_BY_ID = 1 << 12, /* Find a song by it's SongID */
-    MOOSE_OPER_ENUM_MAX = 1 << 13,        /* Highest Value in this Enum */
+    MOOSE_OPER_RESUME = 1 << 13,          /* Catch up after reconnecting to the server */
+    MOOSE_OPER_SPL_PREFETCH = 1 << 14,    /* Load stored playlists while idle */
+    MOOSE_OPER_ENUM_MAX = 1 << 15,        /* Highest Value in this Enum */
 } MooseStoreOperation;
 
 /*
@@ -413,6 +591,7 @@ enum {
     STMT_SQL_SELECT_META_SC_VERSION,
     STMT_SQL_SELECT_META_MPD_PORT,
     STMT_SQL_SELECT_META_MPD_HOST,
+    STMT_SQL_SELECT_META_TAG_MASK,
     /* count songs in db */
     STMT_SQL_COUNT,
     /* insert one song */
@@ -426,8 +605,13 @@ enum {
     STMT_SQL_DIR_SEARCH_DEPTH,
     STMT_SQL_DIR_SEARCH_PATH_AND_DEPTH,
     STMT_SQL_DIR_DELETE_ALL,
+    STMT_SQL_DIR_SELECT_ALL,
     STMT_SQL_DIR_STMT_COUNT,
-    STMT_SQL_SPL_SELECT_TABLES,
+    /* stored playlists */
+    STMT_SQL_SPL_SELECT_ALL,
+    STMT_SQL_SPL_REPLACE,
+    STMT_SQL_SPL_DELETE,
+    STMT_SQL_SPL_DELETE_ALL,
     /* === total number of defined sources === */
     STMT_SQL_SOURCE_COUNT
     /* ======================================= */
@@ -521,10 +705,6 @@ static const char *_sql_stmts[] =
          "                    \n"
          ");                                                                             "
          "                    \n"
-         "-- This is a bit of a hack, but necessary, without UPDATE is awfully slow.     "
-         "                    \n"
-         "CREATE UNIQUE INDEX IF NOT EXISTS queue_uri_index ON songs_content(c0uri);     "
-         "                    \n"
          "                                                                               "
          "                    \n"
          "-- A list of Queue contents (similar to a stored playlist, but not dynamic)    "
@@ -536,10 +716,16 @@ static const char *_sql_stmts[] =
          "                                                                               "
          "                    \n"
          "CREATE VIRTUAL TABLE IF NOT EXISTS dirs USING fts4(path TEXT NOT NULL, depth "
-         "INTEGER NOT NULL);    \n",
+         "INTEGER NOT NULL);    \n"
+         "                                                                               "
+         "                    \n"
+         "-- Loaded stored playlists, song_idx is a sorted array of uint32 song indices  "
+         "                    \n"
+         "CREATE TABLE IF NOT EXISTS spls(name TEXT PRIMARY KEY, last_modified INTEGER, "
+         "song_idx BLOB);       \n",
      [STMT_SQL_META_DUMMY] =
          "CREATE TABLE IF NOT EXISTS meta(db_version, pl_version, sc_version, mpd_port, "
-         "mpd_host); \n",
+         "mpd_host, tag_mask); \n",
      [STMT_SQL_META] =
          "-- Meta Table, containing information about the metadata itself.               "
          " \n"
@@ -557,11 +743,13 @@ static const char *_sql_stmts[] =
          " \n"
          "      mpd_port      INTEGER,  -- analogous, the port.                          "
          " \n"
-         "      mpd_host      TEXT      -- the hostname that this table was created "
+         "      mpd_host      TEXT,     -- the hostname that this table was created "
          "from. \n"
+         "      tag_mask      INTEGER   -- bitmask of the tags stored in songs           "
+         " \n"
          ");                                                                             "
          " \n"
-         "INSERT INTO meta VALUES(%d, %d, %d, %d, '%q');                                 "
+         "INSERT INTO meta VALUES(%d, %d, %d, %d, '%q', %u);                             "
          " \n"
          "COMMIT;                                                                        "
          " \n",
@@ -571,13 +759,13 @@ static const char *_sql_stmts[] =
      [STMT_SQL_SELECT_META_SC_VERSION] = "SELECT sc_version FROM meta;",
      [STMT_SQL_SELECT_META_MPD_PORT] = "SELECT mpd_port FROM meta;",
      [STMT_SQL_SELECT_META_MPD_HOST] = "SELECT mpd_host FROM meta;",
+     [STMT_SQL_SELECT_META_TAG_MASK] = "SELECT tag_mask FROM meta;",
      [STMT_SQL_COUNT] = "SELECT count(*) FROM songs;",
      [STMT_SQL_INSERT] =
          "INSERT INTO songs VALUES(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, "
          "?, ?, ?);",
      [STMT_SQL_QUEUE_INSERT_ROW] =
-         "INSERT INTO queue(song_idx, pos, idx) VALUES((SELECT rowid FROM songs_content "
-         "WHERE c0uri = ?), ?, ?);",
+         "INSERT INTO queue(song_idx, pos, idx) VALUES(?, ?, ?);",
      [STMT_SQL_QUEUE_CLEAR] = "DELETE FROM queue WHERE pos > ?;",
      [STMT_SQL_SELECT_MATCHED] = "SELECT rowid FROM songs WHERE artist MATCH ? LIMIT ?;",
      [STMT_SQL_SELECT_MATCHED_ALL] = "SELECT rowid FROM songs;",
@@ -587,6 +775,7 @@ static const char *_sql_stmts[] =
      [STMT_SQL_COMMIT] = "COMMIT;",
      [STMT_SQL_DIR_INSERT] = "INSERT INTO dirs VALUES(?, ?);",
      [STMT_SQL_DIR_DELETE_ALL] = "DELETE FROM dirs;",
+     [STMT_SQL_DIR_SELECT_ALL] = "SELECT path FROM dirs;",
      [STMT_SQL_DIR_SEARCH_PATH] =
          "SELECT -1, path FROM dirs WHERE path MATCH ? UNION "
          "SELECT rowid, uri FROM songs WHERE uri MATCH ? "
@@ -599,9 +788,10 @@ static const char *_sql_stmts[] =
          "SELECT -1, path FROM dirs WHERE depth = ? AND path MATCH ? UNION "
          "SELECT rowid, uri FROM songs WHERE uri_depth = ? AND uri MATCH ? "
          "ORDER BY songs.rowid, songs.uri, dirs.path;",
-     [STMT_SQL_SPL_SELECT_TABLES] =
-         "SELECT name FROM sqlite_master WHERE type = 'table' AND name LIKE 'spl_%' "
-         "ORDER BY name;",
+     [STMT_SQL_SPL_SELECT_ALL] = "SELECT name, last_modified, song_idx FROM spls;",
+     [STMT_SQL_SPL_REPLACE] = "INSERT OR REPLACE INTO spls VALUES(?, ?, ?);",
+     [STMT_SQL_SPL_DELETE] = "DELETE FROM spls WHERE name = ?;",
+     [STMT_SQL_SPL_DELETE_ALL] = "DELETE FROM spls;",
      [STMT_SQL_SOURCE_COUNT] = ""};
 
 void moose_stprv_lock(MooseStorePrivate *self) {
@@ -639,7 +829,8 @@ void moose_stprv_insert_meta_attributes(MooseStorePrivate *self) {
                                           queue_version,
                                           MOOSE_DB_SCHEMA_VERSION,
                                           moose_client_get_port(self->client),
-                                          moose_client_get_host(self->client));
+                                          moose_client_get_host(self->client),
+                                          self->settings.tag_mask);
     }
     moose_status_unref(status);
 
@@ -788,6 +979,9 @@ void moose_stprv_close_handle(MooseStorePrivate *self, bool free_statements) {
         g_ptr_array_free(self->spl_stack, true);
         self->spl_stack = NULL;
     }
+
+    /* Their song indices belong to this database */
+    g_hash_table_remove_all(self->spl_loaded);
 }
 
 void moose_stprv_begin(MooseStorePrivate *self) {
@@ -809,6 +1003,10 @@ void moose_stprv_delete_songs_table(MooseStorePrivate *self) {
         REPORT_SQL_ERROR(self, "WARNING: Cannot delete table contentes of 'songs'");
     }
     sqlite3_reset(SQL_STMT(self, DELETE_ALL));
+
+    /* The songs will get other indices */
+    g_hash_table_remove_all(self->uri_index);
+    moose_stprv_spl_invalidate(self);
 }
 
 /*
@@ -900,121 +1098,40 @@ static gint moose_stprv_select_impl_sort_func_by_pos(gconstpointer a, gconstpoin
     }
 }
 
-static gint moose_stprv_select_impl_sort_func_by_stack_ptr(gconstpointer a,
-                                                           gconstpointer b) {
-    if(a && b) {
-        MooseSong *sa = (*((MooseSong **)a));
-        MooseSong *sb = (*((MooseSong **)b));
-
-        if(sa == sb) {
-            return +0;
-        }
-
-        if(sa < sb) {
-            return -1;
-        }
-
-        return +1;
-    } else {
-        return +1; /* to sort NULL at the end */
-    }
-}
-
-/* Quadratic binary search algorithm adapted from:
- *
- *   http://research.ijcaonline.org/volume65/number14/pxc3886165.pdf
- *
- * This is more of a fun excercise, than a real speedup.
- */
-static MooseSong *moose_stprv_find_idx(MoosePlaylist *stack, MooseSong *key) {
-    int l = 0;
-    int r = moose_playlist_length(stack) - 1;
-    int qr1 = 0, qr3 = 0, mid = 0;
-
-    while(l <= r) {
-        mid = (l + r) / 2;
-        qr1 = l + (r - l) / 4;
-        qr3 = l + (r - l) * 3 / 4;
-
-        MooseSong *at_mid = moose_playlist_at(stack, mid);
-        MooseSong *at_qr1 = moose_playlist_at(stack, qr1);
-        MooseSong *at_qr3 = moose_playlist_at(stack, qr3);
-
-        if(at_mid == key || key == at_qr1 || key == at_qr3) {
-            int result_idx = 0;
-            if(at_mid == key) {
-                result_idx = mid;
-            } else if(at_qr1 == key) {
-                result_idx = qr1;
-            } else {
-                result_idx = qr3;
-            }
-            return moose_playlist_at(stack, result_idx);
-        } else if(key < at_mid && key < at_qr1) {
-            r = qr1 - 1;
-        } else if(key < at_mid && key > at_qr1) {
-            l = qr1 + 1;
-            r = mid - 1;
-        } else if(key > at_mid && key > at_qr3) {
-            l = qr3 + 1;
-        } else if(key > at_mid && key < at_qr3) {
-            l = mid + 1;
-            r = qr3 - 1;
-        }
-    }
-    return NULL;
-}
-
-static MoosePlaylist *moose_stprv_build_queue_content(MooseStorePrivate *self,
-                                                      MoosePlaylist *to_filter) {
+/* Append all songs of the queue whose index is in filter to out, in no particular
+ * order. Songs that are queued several times are appended several times. */
+static void moose_stprv_select_queue_content(MooseStorePrivate *self,
+                                             const MooseStoreBitset *filter,
+                                             MoosePlaylist *out) {
     g_assert(self);
 
     int error_id = SQLITE_OK;
     sqlite3_stmt *select_stmt = SQL_STMT(self, SELECT_ALL_QUEUE);
-    MoosePlaylist *queue_songs = moose_playlist_new();
 
     while((error_id = sqlite3_step(select_stmt)) == SQLITE_ROW) {
         int stack_idx = sqlite3_column_int(select_stmt, 0);
-        if(stack_idx <= 0) {
-            continue;
-        }
-
-        MooseSong *queue_song = moose_stprv_find_idx(
-            to_filter, moose_playlist_at(self->stack, stack_idx - 1));
-        if(queue_song != NULL) {
-            moose_playlist_append(queue_songs, queue_song);
+        if(stack_idx > 0 && moose_store_bitset_contains(filter, stack_idx - 1)) {
+            moose_playlist_append(out, moose_playlist_at(self->stack, stack_idx - 1));
         }
     }
 
-    if(sqlite3_errcode(self->handle) != SQLITE_DONE) {
+    if(error_id != SQLITE_DONE) {
         REPORT_SQL_ERROR(self, "Error while building queue contents");
     }
 
     if(sqlite3_reset(select_stmt) != SQLITE_OK) {
         REPORT_SQL_ERROR(self, "Error while resetting select queue statement");
     }
-
-    return queue_songs;
 }
 
-/*
- * Search stuff in the 'songs' table using a SELECT clause (also using MATCH).
- * Instead of selecting the actual songs, only the docid is selected, and used as
- * an index to the song-stack, which is quite a bit faster/memory efficient for
- * large returns.
- *
- * It uses the buffer passed to the function to store the pointer to mpd songs it found.
- * Do not free these, the memory of these are manged internally!
- *
- * This function will select at max. buffer_len songs.
- *
- * Returns: number of actually found songs, or -1 on error.
- */
-int moose_stprv_select_to_stack(MooseStorePrivate *self, const char *match_clause,
-                                bool queue_only, MoosePlaylist *stack, int limit_len) {
+/* Add the stack indices of all songs matching match_clause to matched.
+ * Returns the number of matching songs or -1 on error. */
+static int moose_stprv_select_matched(MooseStorePrivate *self, const char *match_clause,
+                                      int limit_len, MooseStoreBitset *matched) {
     int error_id = SQLITE_OK, pos_id = 1;
     limit_len = (limit_len < 0) ? INT_MAX : limit_len;
 
+    gint64 started = g_get_monotonic_time();
     const char *warning = NULL;
     int warning_pos = -1;
     gchar *match_clause_dup = moose_store_qp_parse(match_clause, &warning, &warning_pos);
@@ -1041,21 +1158,16 @@ int moose_stprv_select_to_stack(MooseStorePrivate *self, const char *match_claus
 
     if(error_id != SQLITE_OK) {
         REPORT_SQL_ERROR(self, "WARNING: Error while binding");
+        g_free(match_clause_dup);
         return -1;
     }
 
+    int match_count = 0;
     while((error_id = sqlite3_step(select_stmt)) == SQLITE_ROW) {
         int song_idx = sqlite3_column_int(select_stmt, 0);
-        MooseSong *selected = moose_playlist_at(self->stack, song_idx - 1);
-
-        /* Even if we set queue_only == true, all rows are searched using MATCH.
-         * This is because of MATCH does not like additianal constraints.
-         * Therefore we filter here the queue songs ourselves.
-         *
-         * We can do that a lot faster anyways;
-         * */
-        if(queue_only == false || ((int)moose_song_get_pos(selected) > -1)) {
-            moose_playlist_append(stack, selected);
+        if(song_idx > 0) {
+            moose_store_bitset_add(matched, song_idx - 1);
+            ++match_count;
         }
     }
 
@@ -1067,21 +1179,54 @@ int moose_stprv_select_to_stack(MooseStorePrivate *self, const char *match_claus
     sqlite3_reset(select_stmt);
 
     g_free(match_clause_dup);
+    moose_metrics_record_since(MOOSE_METRIC_STORE_QUERY, started);
+    return match_count;
+}
+
+/*
+ * Search stuff in the 'songs' table using a SELECT clause (also using MATCH).
+ * Instead of selecting the actual songs, only the docid is selected, and used as
+ * an index to the song-stack, which is quite a bit faster/memory efficient for
+ * large returns.
+ *
+ * It uses the buffer passed to the function to store the pointer to mpd songs it found.
+ * Do not free these, the memory of these are manged internally!
+ *
+ * This function will select at max. buffer_len songs.
+ *
+ * Returns: number of actually found songs, or -1 on error.
+ */
+int moose_stprv_select_to_stack(MooseStorePrivate *self, const char *match_clause,
+                                bool queue_only, MoosePlaylist *stack, int limit_len) {
+    unsigned stack_length = moose_playlist_length(self->stack);
+    MooseStoreBitset *matched = moose_store_bitset_new(stack_length);
+
+    if(moose_stprv_select_matched(self, match_clause, limit_len, matched) < 0) {
+        moose_store_bitset_free(matched);
+        return -1;
+    }
 
-    /* sort by position in queue if queue_only is passed. */
     if(queue_only) {
-        moose_playlist_sort(stack, moose_stprv_select_impl_sort_func_by_stack_ptr);
-        MoosePlaylist *queue = moose_stprv_build_queue_content(self, stack);
-        moose_playlist_clear(stack);
+        /* Even if we set queue_only == true, all rows are searched using MATCH.
+         * This is because of MATCH does not like additianal constraints.
+         * Therefore we filter here the queue songs ourselves, sorted by position.
+         * */
+        MoosePlaylist *queue = moose_playlist_new();
+        moose_stprv_select_queue_content(self, matched, queue);
+        moose_playlist_sort(queue, moose_stprv_select_impl_sort_func_by_pos);
 
-        /* Copy it over */
         for(unsigned i = 0; i < moose_playlist_length(queue); ++i) {
             moose_playlist_append(stack, moose_playlist_at(queue, i));
         }
-        stack = queue;
-        moose_playlist_sort(stack, moose_stprv_select_impl_sort_func_by_pos);
+        g_object_unref(queue);
+    } else {
+        for(int i = moose_store_bitset_next(matched, 0); i >= 0;
+            i = moose_store_bitset_next(matched, i + 1)) {
+            moose_playlist_append(stack, moose_playlist_at(self->stack, i));
+        }
     }
 
+    moose_store_bitset_free(matched);
     return moose_playlist_length(stack);
 }
 
@@ -1155,6 +1300,24 @@ void moose_stprv_lock_or_save(MooseStorePrivate *self, bool is_save,
     }
 }
 
+/*
+ * Log what the library saves and what the store still holds by itself;
+ * the latter grows with every store of the same database.
+ */
+static void moose_stprv_library_report(MooseStorePrivate *self) {
+    int cache_used = 0, cache_highwater = 0;
+    unsigned n_songs = moose_playlist_length(self->stack);
+
+    sqlite3_db_status(self->handle, SQLITE_DBSTATUS_CACHE_USED, &cache_used,
+                      &cache_highwater, 0);
+
+    moose_message("library: %lu bytes of strings shared; this store holds %lu bytes "
+                  "of songs and %d bytes of sqlite cache for %u songs",
+                  (unsigned long)moose_store_library_get_string_bytes(self->library),
+                  (unsigned long)(n_songs * moose_song_get_instance_size()), cache_used,
+                  n_songs);
+}
+
 #define feed_tag(tag_enum, sql_col_pos, stmt, song)                   \
     {                                                                 \
         char *value = (char *)sqlite3_column_text(stmt, sql_col_pos); \
@@ -1174,10 +1337,37 @@ void moose_stprv_deserialize_songs(MooseStorePrivate *self) {
     int progress_counter = 0;
     GTimer *timer = g_timer_new();
 
+    /* Another store might hold the same database already */
+    MooseStatus *status = moose_client_ref_status(self->client);
+    char *fingerprint = moose_store_library_fingerprint(status, self->settings.tag_mask);
+
+    /* The fingerprint describes the server's database as it is now;
+     * a cache from an older db_update must not be published under it,
+     * or other stores would clone the outdated songs. */
+    gboolean cache_is_current = (moose_stprv_get_db_version(self) ==
+                                 (int)moose_status_stats_get_db_update_time(status));
+    moose_status_unref(status);
+
+    moose_store_library_unref(self->library);
+    self->library = moose_store_library_lookup(fingerprint);
+
     /* loop over all rows in the songs table */
     while((error_id = sqlite3_step(stmt)) == SQLITE_ROW) {
+        const char *uri = (char *)sqlite3_column_text(stmt, SQL_COL_URI);
+        MooseSong *shared = NULL;
+
+        if(self->library != NULL) {
+            shared = moose_store_library_find_song(self->library, uri);
+        }
+
+        if(shared != NULL) {
+            moose_stprv_stack_append(self, moose_song_new_shared(shared));
+            ++progress_counter;
+            continue;
+        }
+
         MooseSong *song = moose_song_new();
-        moose_song_set_uri(song, (char *)sqlite3_column_text(stmt, SQL_COL_URI));
+        moose_song_set_uri(song, uri);
 
         /* Since SQLite is completely typeless we can just retrieve the column as string
          */
@@ -1208,7 +1398,7 @@ void moose_stprv_deserialize_songs(MooseStorePrivate *self) {
         feed_tag(MOOSE_TAG_MUSICBRAINZ_TRACKID, SQL_COL_MUSICBRAINZ_TRACK_ID, stmt, song);
 
         /* Remember it */
-        moose_playlist_append(self->stack, song);
+        moose_stprv_stack_append(self, song);
 
         ++progress_counter;
     }
@@ -1221,10 +1411,15 @@ void moose_stprv_deserialize_songs(MooseStorePrivate *self) {
 
     if(error_id != SQLITE_DONE) {
         REPORT_SQL_ERROR(self, "ERROR: cannot load songs from database");
+    } else if(self->library == NULL && fingerprint != NULL && cache_is_current) {
+        self->library = moose_store_library_publish(fingerprint, self->stack,
+                                                    moose_stprv_dir_select_all(self));
+        moose_stprv_library_report(self);
     }
 
     sqlite3_reset(stmt);
     g_timer_destroy(timer);
+    g_free(fingerprint);
 }
 
 #define SELECT_META_ATTRIBUTES(self, meta_enum, column_func, out_var, copy_func, \
@@ -1280,6 +1475,65 @@ char *moose_stprv_get_mpd_host(MooseStorePrivate *self) {
     return mpd_host;
 }
 
+unsigned moose_stprv_get_tag_mask(MooseStorePrivate *self) {
+    gint64 tag_mask = 0;
+    SELECT_META_ATTRIBUTES(self, SELECT_META_TAG_MASK, sqlite3_column_int64, tag_mask,
+                           ABS, gint64);
+    return (unsigned)tag_mask;
+}
+
+MooseSong *moose_stprv_song_new(MooseStorePrivate *self,
+                                const struct mpd_song *song_struct) {
+    return moose_song_new_from_struct_masked((struct mpd_song *)song_struct,
+                                             self->settings.tag_mask);
+}
+
+bool moose_stprv_tagtypes_begin(MooseStorePrivate *self, struct mpd_connection *conn) {
+#if LIBMPDCLIENT_CHECK_VERSION(2, 12, 0)
+    if(conn == NULL || self->settings.tag_mask == MOOSE_STORE_ALL_TAGS ||
+       mpd_connection_cmp_server_version(conn, 0, 21, 0) < 0) {
+        return false;
+    }
+
+    enum mpd_tag_type types[MOOSE_TAG_COUNT];
+    unsigned n_types = 0;
+
+    for(int tag = 0; tag < MOOSE_TAG_COUNT && tag < 32; ++tag) {
+        if(self->settings.tag_mask & (1u << tag)) {
+            types[n_types++] = tag;
+        }
+    }
+
+    bool restricted = mpd_send_clear_tag_types(conn) && mpd_response_finish(conn);
+    if(restricted && n_types > 0) {
+        restricted = mpd_send_enable_tag_types(conn, types, n_types) &&
+                     mpd_response_finish(conn);
+    }
+
+    if(restricted == false) {
+        moose_client_check_error(self->client, conn);
+    }
+    return restricted;
+#else
+    (void)self;
+    (void)conn;
+    return false;
+#endif
+}
+
+void moose_stprv_tagtypes_end(MooseStorePrivate *self, struct mpd_connection *conn,
+                              bool restricted) {
+    if(conn == NULL || restricted == false) {
+        return;
+    }
+
+    /* The client itself still wants all tags (e.g. for the current song) */
+    if(mpd_send_command(conn, "tagtypes", "all", NULL) == false ||
+       mpd_response_finish(conn) == false) {
+        moose_client_check_error(self->client, conn);
+    }
+}
+
 int moose_stprv_queue_clip(MooseStorePrivate *self, int since_pos) {
     g_assert(self);
 
@@ -1312,6 +1566,10 @@ void moose_stprv_queue_update_stack_posid(MooseStorePrivate *self) {
     /* Set the ID by parsing the ID */
     GHashTable *already_seen_ids = g_hash_table_new(NULL, NULL);
 
+    /* The caller sets the version again once it knows it */
+    g_hash_table_remove_all(self->id_index);
+    self->id_index_version = -1;
+
     while((error_id = sqlite3_step(select_stmt)) == SQLITE_ROW) {
         int row_idx = sqlite3_column_int(select_stmt, 0);
 
@@ -1323,8 +1581,12 @@ void moose_stprv_queue_update_stack_posid(MooseStorePrivate *self) {
                 g_hash_table_insert(already_seen_ids, song, GINT_TO_POINTER(TRUE));
 
                 /* Luckily we have a setter here, otherwise I would feel a bit strange. */
+                int queue_id = sqlite3_column_int(select_stmt, 2);
                 moose_song_set_pos(song, queue_pos);
-                moose_song_set_id(song, sqlite3_column_int(select_stmt, 2));
+                moose_song_set_id(song, queue_id);
+
+                g_hash_table_insert(self->id_index, GINT_TO_POINTER(queue_id),
+                                    g_object_ref(song));
             }
         }
     }
@@ -1346,9 +1608,14 @@ void moose_stprv_queue_update_stack_posid(MooseStorePrivate *self) {
 }
 
 void moose_stprv_queue_insert_posid(MooseStorePrivate *self, int pos, int idx,
-                                    const char *file) {
+                                    int song_idx) {
     int pos_idx = 1, error_id = SQLITE_OK;
-    BIND_TXT(self, QUEUE_INSERT_ROW, pos_idx, file, error_id);
+    if(song_idx < 0) {
+        error_id |= sqlite3_bind_null(SQL_STMT(self, QUEUE_INSERT_ROW), pos_idx++);
+    } else {
+        /* rowids start at 1 */
+        BIND_INT(self, QUEUE_INSERT_ROW, pos_idx, song_idx + 1, error_id);
+    }
     BIND_INT(self, QUEUE_INSERT_ROW, pos_idx, pos, error_id);
     BIND_INT(self, QUEUE_INSERT_ROW, pos_idx, idx, error_id);
     pos_idx = 1;
@@ -1366,6 +1633,32 @@ void moose_stprv_queue_insert_posid(MooseStorePrivate *self, int pos, int idx,
     sqlite3_reset(SQL_STMT(self, QUEUE_INSERT_ROW));
 }
 
+int moose_stprv_stack_append(MooseStorePrivate *self, MooseSong *song) {
+    g_assert(self);
+    g_assert(song);
+
+    int song_idx = moose_playlist_length(self->stack);
+    moose_playlist_append(self->stack, song);
+
+    /* The uri belongs to the song, which lives as long as the stack */
+    const char *uri = moose_song_get_uri(song);
+    if(uri != NULL && g_hash_table_contains(self->uri_index, uri) == false) {
+        g_hash_table_insert(self->uri_index, (char *)uri, GINT_TO_POINTER(song_idx + 1));
+    }
+
+    return song_idx;
+}
+
+int moose_stprv_stack_find_uri(MooseStorePrivate *self, const char *uri) {
+    g_assert(self);
+
+    if(uri == NULL) {
+        return -1;
+    }
+
+    return GPOINTER_TO_INT(g_hash_table_lookup(self->uri_index, uri)) - 1;
+}
+
 int moose_stprv_path_get_depth(const char *dir_path) {
     int dir_depth = 0;
     char *cursor = (char *)dir_path;
@@ -1422,25 +1715,61 @@ void moose_stprv_dir_delete(MooseStorePrivate *self) {
     sqlite3_reset(SQL_STMT(self, DIR_DELETE_ALL));
 }
 
-int moose_stprv_query_directories(MooseStorePrivate *self, MoosePlaylist *stack,
-                                  const char *directory, int depth) {
+GPtrArray *moose_stprv_dir_select_all(MooseStorePrivate *self) {
     g_assert(self);
-    g_assert(stack);
-    int returned = 0;
-    int pos_idx = 1;
+
+    GPtrArray *dirs = g_ptr_array_new_with_free_func(g_free);
+    sqlite3_stmt *select_stmt = SQL_STMT(self, DIR_SELECT_ALL);
+
     int error_id = SQLITE_OK;
+    while((error_id = sqlite3_step(select_stmt)) == SQLITE_ROW) {
+        g_ptr_array_add(dirs, g_strdup((char *)sqlite3_column_text(select_stmt, 0)));
+    }
 
-    if(directory && *directory == '/') {
-        directory = NULL;
+    if(error_id != SQLITE_DONE) {
+        REPORT_SQL_ERROR(self, "cannot SELECT directories");
     }
 
-    sqlite3_stmt *select_stmt = NULL;
+    sqlite3_reset(select_stmt);
+    return dirs;
+}
 
-    if(directory != NULL && depth < 0) {
-        select_stmt = SQL_STMT(self, DIR_SEARCH_PATH);
-        BIND_TXT(self, DIR_SEARCH_PATH, pos_idx, directory, error_id);
-        BIND_TXT(self, DIR_SEARCH_PATH, pos_idx, directory, error_id);
-    } else if(directory == NULL && depth >= 0) {
+void moose_stprv_dir_tree_update(MooseStorePrivate *self) {
+    g_assert(self);
+
+    GTimer *timer = g_timer_new();
+    GPtrArray *dirs = (self->library != NULL)
+                          ? g_ptr_array_ref(moose_store_library_get_dirs(self->library))
+                          : moose_stprv_dir_select_all(self);
+
+    moose_store_dir_tree_free(self->dir_tree);
+    self->dir_tree = moose_store_dir_tree_new(self->stack, dirs);
+    g_ptr_array_unref(dirs);
+
+    moose_debug("database: built directory tree (took %2.3fs)",
+                g_timer_elapsed(timer, NULL));
+    g_timer_destroy(timer);
+}
+
+int moose_stprv_query_directories(MooseStorePrivate *self, MoosePlaylist *stack,
+                                  const char *directory, int depth) {
+    g_assert(self);
+    g_assert(stack);
+    int returned = 0;
+    int pos_idx = 1;
+    int error_id = SQLITE_OK;
+
+    if(directory && *directory == '/') {
+        directory = NULL;
+    }
+
+    sqlite3_stmt *select_stmt = NULL;
+
+    if(directory != NULL && depth < 0) {
+        select_stmt = SQL_STMT(self, DIR_SEARCH_PATH);
+        BIND_TXT(self, DIR_SEARCH_PATH, pos_idx, directory, error_id);
+        BIND_TXT(self, DIR_SEARCH_PATH, pos_idx, directory, error_id);
+    } else if(directory == NULL && depth >= 0) {
         select_stmt = SQL_STMT(self, DIR_SEARCH_DEPTH);
         BIND_INT(self, DIR_SEARCH_DEPTH, pos_idx, depth, error_id);
         BIND_INT(self, DIR_SEARCH_DEPTH, pos_idx, depth, error_id);
@@ -1480,6 +1809,9 @@ int moose_stprv_query_directories(MooseStorePrivate *self, MoosePlaylist *stack,
 typedef struct {
     MooseStorePrivate *store;
     GAsyncQueue *queue;
+
+    /* Paths of all directories seen (listallinfo only) */
+    GPtrArray *dirs;
 } MooseStoreQueueTag;
 
 /* Popping this from a GAsyncQueue means
@@ -1493,6 +1825,7 @@ static gpointer moose_stprv_do_list_all_info_sql_thread(gpointer user_data) {
     GAsyncQueue *queue = tag->queue;
 
     struct mpd_entity *ent = NULL;
+    gint64 span = moose_trace_begin();
 
     /* Begin a new transaction */
     moose_stprv_begin(self);
@@ -1500,10 +1833,9 @@ static gpointer moose_stprv_do_list_all_info_sql_thread(gpointer user_data) {
     while((gpointer)(ent = g_async_queue_pop(queue)) != queue) {
         switch(mpd_entity_get_type(ent)) {
         case MPD_ENTITY_TYPE_SONG: {
-            MooseSong *song =
-                moose_song_new_from_struct((struct mpd_song *)mpd_entity_get_song(ent));
+            MooseSong *song = moose_stprv_song_new(self, mpd_entity_get_song(ent));
 
-            moose_playlist_append(self->stack, song);
+            moose_stprv_stack_append(self, song);
             moose_stprv_insert_song(self, song);
             mpd_entity_free(ent);
 
@@ -1515,6 +1847,7 @@ static gpointer moose_stprv_do_list_all_info_sql_thread(gpointer user_data) {
 
             if(dir != NULL) {
                 moose_stprv_dir_insert(self, mpd_directory_get_path(dir));
+                g_ptr_array_add(tag->dirs, g_strdup(mpd_directory_get_path(dir)));
                 mpd_entity_free(ent);
             }
 
@@ -1532,9 +1865,34 @@ static gpointer moose_stprv_do_list_all_info_sql_thread(gpointer user_data) {
     /* Commit changes */
     moose_stprv_commit(self);
 
+    moose_trace_end(span, "store", "listallinfo.insert");
     return NULL;
 }
 
+/*
+ * Fill the (empty) songs and dirs tables from a library another store
+ * already fetched. Songs share their strings with the library's songs.
+ */
+static void moose_stprv_library_clone(MooseStorePrivate *self,
+                                      MooseStoreLibrary *library) {
+    MoosePlaylist *songs = moose_store_library_get_songs(library);
+    GPtrArray *dirs = moose_store_library_get_dirs(library);
+
+    moose_stprv_begin(self);
+
+    for(unsigned i = 0; i < moose_playlist_length(songs); ++i) {
+        MooseSong *song = moose_song_new_shared(moose_playlist_at(songs, i));
+        moose_stprv_stack_append(self, song);
+        moose_stprv_insert_song(self, song);
+    }
+
+    for(unsigned i = 0; i < dirs->len; ++i) {
+        moose_stprv_dir_insert(self, g_ptr_array_index(dirs, i));
+    }
+
+    moose_stprv_commit(self);
+}
+
 /*
  * Query a 'listallinfo' from the MPD Server, and insert all returned
  * song into the database and the pointer stack.
@@ -1557,6 +1915,7 @@ void moose_stprv_oper_listallinfo(MooseStorePrivate *store, volatile gboolean *c
 
     int progress_counter = 0;
     size_t db_version = 0;
+    bool cancelled = false;
     MooseStatus *status = moose_client_ref_status(store->client);
 
     int number_of_songs = moose_status_stats_get_number_of_songs(status);
@@ -1568,6 +1927,7 @@ void moose_stprv_oper_listallinfo(MooseStorePrivate *store, volatile gboolean *c
 
         if(db_update_time == db_version) {
             moose_message("database: Will not update database, timestamp didn't change.");
+            moose_status_unref(status);
             return;
         } else {
             moose_message("database: Will update database (%u != %u)",
@@ -1577,14 +1937,14 @@ void moose_stprv_oper_listallinfo(MooseStorePrivate *store, volatile gboolean *c
         moose_message("database: Doing forced listallinfo");
     }
 
+    char *fingerprint = moose_store_library_fingerprint(status, store->settings.tag_mask);
     moose_status_unref(status);
 
     GTimer *timer = NULL;
-    GAsyncQueue *queue = g_async_queue_new();
+    GAsyncQueue *queue = NULL;
     GThread *sql_thread = NULL;
 
     MooseStoreQueueTag tag;
-    tag.queue = queue;
     tag.store = store;
 
     /* We're building the whole table new,
@@ -1598,6 +1958,8 @@ void moose_stprv_oper_listallinfo(MooseStorePrivate *store, volatile gboolean *c
      * Apparently GPtrArray does not support reallocating,
      * without adding NULL-cells to the array? */
     if(store->stack != NULL) {
+        g_hash_table_remove_all(store->id_index);
+        store->id_index_version = -1;
         g_object_unref(store->stack);
     }
 
@@ -1607,6 +1969,24 @@ void moose_stprv_oper_listallinfo(MooseStorePrivate *store, volatile gboolean *c
     /* Profiling */
     timer = g_timer_new();
 
+    moose_store_library_unref(store->library);
+    store->library = moose_store_library_lookup(fingerprint);
+
+    if(store->library != NULL) {
+        moose_stprv_library_clone(store, store->library);
+        moose_message("database: took %u songs from the shared library (took %2.3fs)",
+                      moose_playlist_length(store->stack), g_timer_elapsed(timer, NULL));
+        moose_stprv_library_report(store);
+
+        g_timer_destroy(timer);
+        g_free(fingerprint);
+        return;
+    }
+
+    queue = g_async_queue_new();
+    tag.queue = queue;
+    tag.dirs = g_ptr_array_new_with_free_func(g_free);
+
     sql_thread =
         g_thread_new("sql-thread", moose_stprv_do_list_all_info_sql_thread, &tag);
 
@@ -1615,6 +1995,9 @@ void moose_stprv_oper_listallinfo(MooseStorePrivate *store, volatile gboolean *c
         struct mpd_entity *ent = NULL;
 
         g_timer_start(timer);
+        gint64 span = moose_trace_begin();
+
+        bool restricted = moose_stprv_tagtypes_begin(store, conn);
 
         /* Order the real big list */
         mpd_send_list_all_meta(conn, "/");
@@ -1622,6 +2005,7 @@ void moose_stprv_oper_listallinfo(MooseStorePrivate *store, volatile gboolean *c
         while((ent = mpd_recv_entity(conn)) != NULL) {
             if(moose_job_manager_check_cancel(store->jm, cancel)) {
                 moose_warning("database: listallinfo cancelled!");
+                cancelled = true;
                 break;
             }
 
@@ -1634,6 +2018,9 @@ void moose_stprv_oper_listallinfo(MooseStorePrivate *store, volatile gboolean *c
         if(mpd_response_finish(conn) == false) {
             moose_client_check_error(store->client, conn);
         }
+
+        moose_stprv_tagtypes_end(store, conn, restricted);
+        moose_trace_end(span, "store", "listallinfo.recv");
     }
     moose_client_put(store->client);
 
@@ -1643,11 +2030,21 @@ void moose_stprv_oper_listallinfo(MooseStorePrivate *store, volatile gboolean *c
 
     moose_message("database: retrieved %d songs from mpd (took %2.3fs)", number_of_songs,
                   g_timer_elapsed(timer, NULL));
+    moose_metrics_count(MOOSE_METRIC_STORE_SONGS, progress_counter);
+
+    /* Only complete databases may be shared */
+    if(conn != NULL && cancelled == false && fingerprint != NULL) {
+        store->library = moose_store_library_publish(fingerprint, store->stack, tag.dirs);
+        moose_stprv_library_report(store);
+    } else {
+        g_ptr_array_unref(tag.dirs);
+    }
 
     moose_debug("Finished: Database update.");
 
     g_async_queue_unref(queue);
     g_timer_destroy(timer);
+    g_free(fingerprint);
 }
 
 static gpointer moose_stprv_do_plchanges_sql_thread(gpointer user_data) {
@@ -1660,6 +2057,7 @@ static gpointer moose_stprv_do_plchanges_sql_thread(gpointer user_data) {
     MooseSong *song = NULL;
     GTimer *timer = g_timer_new();
     gdouble clip_time = 0.0, posid_time = 0.0, stack_time = 0.0;
+    gint64 span = moose_trace_begin();
 
     /* start a transaction */
     moose_stprv_begin(self);
@@ -1673,6 +2071,16 @@ static gpointer moose_stprv_do_plchanges_sql_thread(gpointer user_data) {
                 start_position = moose_song_get_pos(song);
             }
             clipped = moose_stprv_queue_clip(self, start_position);
+
+            /* Mirroring only the queue, the songs table is it; always fetched fully */
+            if(moose_stprv_mirrors_queue(self)) {
+                moose_stprv_delete_songs_table(self);
+                g_hash_table_remove_all(self->id_index);
+                g_object_unref(self->stack);
+                self->stack =
+                    moose_playlist_new_full(100, (GDestroyNotify)moose_song_unref);
+            }
+
             clip_time = g_timer_elapsed(timer, NULL);
             g_timer_start(timer);
 
@@ -1680,11 +2088,22 @@ static gpointer moose_stprv_do_plchanges_sql_thread(gpointer user_data) {
         }
 
         if(song != (gpointer)EMPTY_QUEUE_INDICATOR) {
-            moose_stprv_queue_insert_posid(self,
-                                           moose_song_get_pos(song),
-                                           moose_song_get_id(song),
-                                           moose_song_get_uri(song));
-            moose_song_unref(song);
+            int song_idx = -1;
+
+            if(moose_stprv_mirrors_queue(self)) {
+                /* Every queue entry is a song of its own here */
+                moose_stprv_insert_song(self, song);
+                song_idx = moose_stprv_stack_append(self, song);
+            } else {
+                song_idx = moose_stprv_stack_find_uri(self, moose_song_get_uri(song));
+            }
+
+            moose_stprv_queue_insert_posid(self, moose_song_get_pos(song),
+                                           moose_song_get_id(song), song_idx);
+
+            if(moose_stprv_mirrors_queue(self) == false) {
+                moose_song_unref(song);
+            }
         }
     }
 
@@ -1706,6 +2125,7 @@ static gpointer moose_stprv_do_plchanges_sql_thread(gpointer user_data) {
     moose_debug("database: QueueSQL Timing: %2.3fs Clip | %2.3fs Posid | %2.3fs Stack",
                 clip_time, posid_time, stack_time);
 
+    moose_trace_end(span, "store", "plchanges.apply");
     return NULL;
 }
 
@@ -1714,6 +2134,7 @@ void moose_stprv_oper_plchanges(MooseStorePrivate *store, volatile gboolean *can
 
     int progress_counter = 0;
     size_t last_pl_version = 0;
+    gboolean fetched = FALSE;
 
     /* get last version of the queue (which we're having already.
      * (in case full queue is wanted take first version) */
@@ -1721,16 +2142,19 @@ void moose_stprv_oper_plchanges(MooseStorePrivate *store, volatile gboolean *can
         last_pl_version = moose_stprv_get_pl_version(store);
     }
 
-    if(store->force_update_plchanges == false) {
-        size_t current_pl_version = -1;
-        MooseStatus *status = moose_client_ref_status(store->client);
-        if(status != NULL) {
-            current_pl_version = moose_status_get_queue_version(status);
-        } else {
-            current_pl_version = last_pl_version;
-        }
-        moose_status_unref(status);
+    /* Queue version the id_index will be valid for, -1 if unknown.
+     * Taken before plchanges, so it is never newer than the data. */
+    long index_version = -1;
+    size_t current_pl_version = last_pl_version;
+    MooseStatus *status = moose_client_ref_status(store->client);
+    if(status != NULL) {
+        current_pl_version = moose_status_get_queue_version(status);
+        index_version = current_pl_version;
+    }
+    moose_status_unref(status);
 
+    /* Without a status (right after a reconnect) we cannot tell */
+    if(store->force_update_plchanges == false && status != NULL) {
         if(last_pl_version == current_pl_version) {
             moose_message(
                 "database: Will not update queue, version didn't change (%d == %d)",
@@ -1746,6 +2170,7 @@ void moose_stprv_oper_plchanges(MooseStorePrivate *store, volatile gboolean *can
     MooseStoreQueueTag tag;
     tag.queue = queue;
     tag.store = store;
+    tag.dirs = NULL;
 
     /* needs to be started after inserting meta attributes, since it calls 'begin;' */
     sql_thread = g_thread_new("queue-update", moose_stprv_do_plchanges_sql_thread, &tag);
@@ -1759,14 +2184,19 @@ void moose_stprv_oper_plchanges(MooseStorePrivate *store, volatile gboolean *can
     if(conn != NULL) {
         g_timer_start(timer);
 
+        /* The songs table only holds the queue in hybrid/queue-only mode, so no diffs */
+        size_t since_version = (moose_stprv_mirrors_queue(store)) ? 0 : last_pl_version;
+
         moose_message("database: Queue was updated. Will do ,,plchanges %d''",
-                      (int)last_pl_version);
+                      (int)since_version);
 
-        if(mpd_send_queue_changes_meta(conn, last_pl_version)) {
+        bool restricted = moose_stprv_tagtypes_begin(store, conn);
+
+        if(mpd_send_queue_changes_meta(conn, since_version)) {
             struct mpd_song *song_struct = NULL;
 
             while((song_struct = mpd_recv_song(conn)) != NULL) {
-                MooseSong *song = moose_song_new_from_struct(song_struct);
+                MooseSong *song = moose_stprv_song_new(store, song_struct);
                 mpd_song_free(song_struct);
 
                 if(moose_job_manager_check_cancel(store->jm, cancel)) {
@@ -1784,11 +2214,15 @@ void moose_stprv_oper_plchanges(MooseStorePrivate *store, volatile gboolean *can
             if(progress_counter == 0) {
                 g_async_queue_push(queue, (gpointer)EMPTY_QUEUE_INDICATOR);
             }
+
+            fetched = (song_struct == NULL);
         }
 
         if(mpd_response_finish(conn) == false) {
             moose_client_check_error(store->client, conn);
         }
+
+        moose_stprv_tagtypes_end(store, conn, restricted);
     }
     moose_client_put(store->client);
 
@@ -1796,6 +2230,11 @@ void moose_stprv_oper_plchanges(MooseStorePrivate *store, volatile gboolean *can
     g_async_queue_push(queue, queue);
     g_thread_join(sql_thread);
 
+    /* The sql thread rebuilt the id_index; only trust it if complete */
+    if(fetched) {
+        store->id_index_version = index_version;
+    }
+
     /* a bit of timing report */
     moose_debug("database: updated %d song's pos/id (took %2.3fs)", progress_counter,
                 g_timer_elapsed(timer, NULL));
@@ -1807,113 +2246,228 @@ void moose_stprv_oper_plchanges(MooseStorePrivate *store, volatile gboolean *can
 }
 
 /*
- * Random thoughts about storing playlists:
- *
- * Create pl table:
- * CREATE TABLE %q (song_idx integer, FOREIGN KEY(song_idx) REFERENCES songs(rowid));
- *
- * Update a playlist:
- * BEGIN IMMEDIATE;
- * DELETE FROM spl_%q;
- * INSERT INTO spl_%q VALUES((SELECT rowid FROM songs_content WHERE c0uri = %Q));
- * ...
- * COMMIT;
- *
- * Select songs from playlist:
- * SELECT rowid FROM songs JOIN spl%q ON songs.rowid = spl_%q.song_idx WHERE artist MATCH
- *?;
- *
+ * Stored playlists
+ * ================
  *
- * Delete playlist:
- * DROP spl_%q;
- *
- * List all loaded playlists:
- * SELECT name FROM sqlite_master WHERE type = 'table' AND name LIKE 'spl_%' ORDER BY
- *name;
- *
- * The plan:
  * On startup OR on MOOSE_IDLE_STORED_PLAYLIST:
- *    Get all playlists, either through:
- *        listplaylists
- *    or during:
- *        listallinfo
+ *    Get all playlists through 'listplaylists' (served by the client's cache).
+ *    The mpd_playlist objects are stored in self->spl_stack.
  *
- *    The mpd_playlist objects are stored in a stack.
- *
- *    Sync those with the database, i.e. playlists that are not up-to-date,
- *    or were deleted are dropped. New playlists are __not__ created.
- *    If the playlist was out of date it gets recreated.
+ *    Loaded playlists that were deleted are forgotten, those whose mtime
+ *    changed are reloaded. New playlists are __not__ loaded.
  *
  * On playlist load:
- *    Send 'listplaylist <pl_name>', create a table named spl_<pl_name>,
- *    and fill in all the song-ids
+ *    Send 'listplaylist <pl_name>' and remember the indices of its songs in
+ *    self->stack as sorted array (MooseStoreSpl) in self->spl_loaded.
+ *    Each uri is resolved with one lookup in self->uri_index. If an older
+ *    version is loaded already, only the entries added or removed since
+ *    are applied to its array, see moose_stprv_spl_apply_changes().
+ *    The array is written to the 'spls' table as blob, so it is saved
+ *    together with the songs and restored by moose_stprv_spl_deserialize().
+ *
+ * The indices stay valid until the songs table is rebuilt by listallinfo;
+ * moose_stprv_spl_invalidate() marks all playlists stale then, and the
+ * following moose_stprv_spl_update() reloads them.
+ *
+ * Selecting from a playlist never touches its entries in SQLite:
+ * without a match clause the indices are mapped to songs directly,
+ * otherwise each is tested in a bitset of the FTS result.
  */
 
-static char *moose_stprv_spl_construct_table_name(struct mpd_playlist *playlist) {
-    g_assert(playlist);
-    return g_strdup_printf("spl_%x_%s",
-                           (unsigned)mpd_playlist_get_last_modified(playlist),
-                           mpd_playlist_get_path(playlist));
+typedef struct {
+    /* mtime of the playlist when it was loaded */
+    time_t last_modified;
+
+    /* Sorted, unique guint32 indices into self->stack */
+    GArray *song_idxs;
+
+    /* True if song_idxs refer to a songs table that was rebuilt since */
+    bool stale;
+} MooseStoreSpl;
+
+static MooseStoreSpl *moose_stprv_spl_new(time_t last_modified, GArray *song_idxs) {
+    MooseStoreSpl *spl = g_slice_new0(MooseStoreSpl);
+    spl->last_modified = last_modified;
+    spl->song_idxs = song_idxs;
+    return spl;
 }
 
-static char *moose_stprv_spl_parse_table_name(const char *table_name,
-                                              /* OUT */ time_t *last_modified) {
-    g_assert(table_name);
+static void moose_stprv_spl_free(MooseStoreSpl *spl) {
+    if(spl != NULL) {
+        g_array_free(spl->song_idxs, true);
+        g_slice_free(MooseStoreSpl, spl);
+    }
+}
 
-    for(size_t i = 0; table_name[i] != 0; ++i) {
-        if(table_name[i] == '_') {
-            if(last_modified != NULL) {
-                *last_modified = g_ascii_strtoll(&table_name[i + 1], NULL, 16);
-            }
+static int moose_stprv_spl_idx_compare(const void *a, const void *b) {
+    guint32 idx_a = *(const guint32 *)a, idx_b = *(const guint32 *)b;
+    return (idx_a > idx_b) - (idx_a < idx_b);
+}
 
-            char *name_begin = strchr(&table_name[i + 1], '_');
+/* Sort song_idxs and remove duplicates in place */
+static void moose_stprv_spl_sort_unique(GArray *song_idxs) {
+    g_array_sort(song_idxs, moose_stprv_spl_idx_compare);
 
-            if(name_begin != NULL) {
-                return g_strdup(name_begin + 1);
-            } else {
-                return NULL;
-            }
+    unsigned n_unique = 0;
+    for(unsigned i = 0; i < song_idxs->len; ++i) {
+        guint32 song_idx = g_array_index(song_idxs, guint32, i);
+        if(n_unique == 0 || g_array_index(song_idxs, guint32, n_unique - 1) != song_idx) {
+            g_array_index(song_idxs, guint32, n_unique++) = song_idx;
         }
     }
+    g_array_set_size(song_idxs, n_unique);
+}
 
-    return NULL;
+/*
+ * Apply a new version of a playlist (received, unsorted) to the sorted
+ * indices of the previous one: entries found there are only marked as kept,
+ * the others are sorted on their own and merged in. Only the changed
+ * entries are sorted, instead of the whole playlist again.
+ *
+ * Returns: the new sorted, unique indices.
+ */
+static GArray *moose_stprv_spl_apply_changes(GArray *previous, GArray *received,
+                                             unsigned *n_added, unsigned *n_removed) {
+    MooseStoreBitset *kept = moose_store_bitset_new(previous->len);
+    GArray *added = g_array_new(false, false, sizeof(guint32));
+
+    for(unsigned i = 0; i < received->len; ++i) {
+        guint32 *found = bsearch(&g_array_index(received, guint32, i), previous->data,
+                                 previous->len, sizeof(guint32),
+                                 moose_stprv_spl_idx_compare);
+        if(found != NULL) {
+            moose_store_bitset_add(kept, found - (guint32 *)previous->data);
+        } else {
+            g_array_append_val(added, g_array_index(received, guint32, i));
+        }
+    }
+
+    moose_stprv_spl_sort_unique(added);
+
+    GArray *merged =
+        g_array_sized_new(false, false, sizeof(guint32), previous->len + added->len);
+    unsigned old_pos = 0, add_pos = 0;
+    *n_removed = 0;
+
+    while(old_pos < previous->len || add_pos < added->len) {
+        if(old_pos < previous->len &&
+           moose_store_bitset_contains(kept, old_pos) == FALSE) {
+            ++old_pos;
+            ++*n_removed;
+            continue;
+        }
+
+        /* Added entries were not in previous, so the two never are equal */
+        guint32 old_idx = (old_pos < previous->len)
+                              ? g_array_index(previous, guint32, old_pos)
+                              : G_MAXUINT32;
+        if(add_pos < added->len && g_array_index(added, guint32, add_pos) < old_idx) {
+            g_array_append_val(merged, g_array_index(added, guint32, add_pos));
+            ++add_pos;
+        } else {
+            g_array_append_val(merged, old_idx);
+            ++old_pos;
+        }
+    }
+
+    *n_added = added->len;
+    g_array_free(added, true);
+    moose_store_bitset_free(kept);
+    return merged;
 }
 
-static void moose_stprv_spl_drop_table(MooseStorePrivate *self, const char *table_name) {
-    g_assert(table_name);
+void moose_stprv_spl_init(MooseStorePrivate *self) {
     g_assert(self);
-    char *sql = sqlite3_mprintf("DROP TABLE IF EXISTS %q;", table_name);
-    if(sql != NULL) {
-        if(sqlite3_exec(self->handle, sql, 0, 0, 0) != SQLITE_OK) {
-            REPORT_SQL_ERROR(self, "Cannot DROP some stored playlist table...");
-        }
+    self->spl_loaded = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                             (GDestroyNotify)moose_stprv_spl_free);
+}
 
-        sqlite3_free(sql);
+void moose_stprv_spl_destroy(MooseStorePrivate *self) {
+    g_assert(self);
+    if(self->spl_loaded != NULL) {
+        g_hash_table_destroy(self->spl_loaded);
+        self->spl_loaded = NULL;
     }
 }
 
-static void moose_stprv_spl_create_table(MooseStorePrivate *self,
-                                         const char *table_name) {
+static void moose_stprv_spl_save(MooseStorePrivate *self, const char *playlist_name,
+                                 MooseStoreSpl *spl) {
+    int error_id = SQLITE_OK, pos_id = 1;
+    sqlite3_stmt *stmt = SQL_STMT(self, SPL_REPLACE);
+
+    BIND_TXT(self, SPL_REPLACE, pos_id, playlist_name, error_id);
+    error_id |= sqlite3_bind_int64(stmt, pos_id++, spl->last_modified);
+    error_id |= sqlite3_bind_blob(stmt, pos_id++, spl->song_idxs->data,
+                                  spl->song_idxs->len * sizeof(guint32), SQLITE_STATIC);
+
+    if(error_id != SQLITE_OK) {
+        REPORT_SQL_ERROR(self, "Cannot bind stored playlist");
+    } else if(sqlite3_step(stmt) != SQLITE_DONE) {
+        REPORT_SQL_ERROR(self, "Cannot save stored playlist");
+    }
+
+    CLEAR_BINDS(stmt);
+}
+
+static void moose_stprv_spl_forget(MooseStorePrivate *self, const char *playlist_name) {
+    int error_id = SQLITE_OK, pos_id = 1;
+
+    BIND_TXT(self, SPL_DELETE, pos_id, playlist_name, error_id);
+    if(error_id != SQLITE_OK || sqlite3_step(SQL_STMT(self, SPL_DELETE)) != SQLITE_DONE) {
+        REPORT_SQL_ERROR(self, "Cannot delete stored playlist");
+    }
+
+    CLEAR_BINDS_BY_NAME(self, SPL_DELETE);
+}
+
+void moose_stprv_spl_deserialize(MooseStorePrivate *self) {
     g_assert(self);
-    g_assert(table_name);
-    char *sql =
-        sqlite3_mprintf("CREATE TABLE IF NOT EXISTS %q (song_idx INTEGER);", table_name);
 
-    if(sql != NULL) {
-        if(sqlite3_exec(self->handle, sql, 0, 0, 0) != SQLITE_OK) {
-            REPORT_SQL_ERROR(self, "Cannot CREATE some stored playlist table...");
+    int error_id = SQLITE_OK;
+    sqlite3_stmt *stmt = SQL_STMT(self, SPL_SELECT_ALL);
+
+    g_hash_table_remove_all(self->spl_loaded);
+
+    while((error_id = sqlite3_step(stmt)) == SQLITE_ROW) {
+        const char *playlist_name = (const char *)sqlite3_column_text(stmt, 0);
+        const void *blob = sqlite3_column_blob(stmt, 2);
+        unsigned n_idxs = sqlite3_column_bytes(stmt, 2) / sizeof(guint32);
+
+        if(playlist_name != NULL) {
+            GArray *song_idxs = g_array_sized_new(false, false, sizeof(guint32), n_idxs);
+            g_array_append_vals(song_idxs, blob, n_idxs);
+            g_hash_table_replace(
+                self->spl_loaded, g_strdup(playlist_name),
+                moose_stprv_spl_new(sqlite3_column_int64(stmt, 1), song_idxs));
         }
+    }
 
-        sqlite3_free(sql);
+    if(error_id != SQLITE_DONE) {
+        REPORT_SQL_ERROR(self, "ERROR: cannot load stored playlists from database");
     }
+    sqlite3_reset(stmt);
+
+    moose_debug("database: deserialized %u stored playlists.",
+                g_hash_table_size(self->spl_loaded));
 }
 
-static void moose_stprv_spl_delete_content(MooseStorePrivate *self,
-                                           const char *table_name) {
+void moose_stprv_spl_invalidate(MooseStorePrivate *self) {
     g_assert(self);
-    g_assert(table_name);
-    moose_stprv_spl_drop_table(self, table_name);
-    moose_stprv_spl_create_table(self, table_name);
+
+    GHashTableIter iter;
+    gpointer value = NULL;
+
+    g_hash_table_iter_init(&iter, self->spl_loaded);
+    while(g_hash_table_iter_next(&iter, NULL, &value)) {
+        MooseStoreSpl *spl = value;
+        g_array_set_size(spl->song_idxs, 0);
+        spl->stale = true;
+    }
+
+    if(sqlite3_step(SQL_STMT(self, SPL_DELETE_ALL)) != SQLITE_DONE) {
+        REPORT_SQL_ERROR(self, "WARNING: Cannot delete stored playlists");
+    }
+    sqlite3_reset(SQL_STMT(self, SPL_DELETE_ALL));
 }
 
 static struct mpd_playlist *moose_stprv_spl_name_to_playlist(MooseStorePrivate *store,
@@ -1934,91 +2488,103 @@ static struct mpd_playlist *moose_stprv_spl_name_to_playlist(MooseStorePrivate *
     return playlist_result;
 }
 
-static void moose_stprv_spl_listplaylists(MooseStorePrivate *store) {
+int moose_stprv_oper_resume(MooseStorePrivate *store) {
     g_assert(store);
     g_assert(store->client);
-    MooseClient *self = store->client;
 
-    if(store->spl_stack != NULL) {
-        g_ptr_array_free(store->spl_stack, true);
-        store->spl_stack = NULL;
-    }
-
-    store->spl_stack = g_ptr_array_new_with_free_func((GDestroyNotify)mpd_playlist_free);
+    MooseClient *client = store->client;
+    GPtrArray *stats = NULL, *status = NULL;
 
-    struct mpd_connection *conn = moose_client_get(self);
+    struct mpd_connection *conn = moose_client_get(client);
     if(conn != NULL) {
-        struct mpd_playlist *playlist = NULL;
-        mpd_send_list_playlists(conn);
+        stats = moose_client_cache_run(client, conn, "stats");
+        status = moose_client_cache_run(client, conn, "status");
+    }
+    moose_client_put(client);
 
-        while((playlist = mpd_recv_playlist(conn)) != NULL) {
-            g_ptr_array_add(store->spl_stack, playlist);
-        }
+    const char *db_update =
+        (stats) ? moose_client_pairs_lookup(stats, "db_update") : NULL;
+    const char *playlist =
+        (status) ? moose_client_pairs_lookup(status, "playlist") : NULL;
 
-        if(mpd_response_finish(conn) == false) {
-            moose_client_check_error(self, conn);
-        }
+    int ops = MOOSE_OPER_UNDEFINED;
+    if(db_update == NULL || playlist == NULL) {
+        moose_warning("database: Cannot get versions after reconnect; will retry then.");
     } else {
-        moose_critical("Cannot get connection to get listplaylists (not connected?)");
+        ops = MOOSE_OPER_SPL_UPDATE;
+
+        unsigned long db_version = g_ascii_strtoull(db_update, NULL, 10);
+        unsigned long pl_version = g_ascii_strtoull(playlist, NULL, 10);
+
+        if(db_version != (unsigned long)moose_stprv_get_db_version(store)) {
+            moose_message("database: Changed while being disconnected.");
+            /* The status might still hold the stats from before */
+            store->force_update_listallinfo = true;
+            ops |= MOOSE_OPER_LISTALLINFO;
+        } else if(pl_version != (unsigned long)moose_stprv_get_pl_version(store)) {
+            moose_message("database: Queue changed while disconnected (%lu -> %lu).",
+                          (unsigned long)moose_stprv_get_pl_version(store), pl_version);
+            ops |= MOOSE_OPER_PLCHANGES;
+        } else {
+            moose_message("database: Nothing changed while being disconnected.");
+        }
     }
-    moose_client_put(self);
-}
-
-static GList *moose_stprv_spl_get_loaded_list(MooseStorePrivate *self) {
-    GList *table_name_list = NULL;
 
-    /* Select all table names from db that start with spl_ */
-    while(sqlite3_step(SQL_STMT(self, SPL_SELECT_TABLES)) == SQLITE_ROW) {
-        table_name_list = g_list_prepend(
-            table_name_list,
-            g_strdup((char *)sqlite3_column_text(SQL_STMT(self, SPL_SELECT_TABLES), 0)));
+    if(stats != NULL) {
+        g_ptr_array_unref(stats);
     }
 
-    /* Be nice, and always check for errors */
-    int error = sqlite3_errcode(self->handle);
-
-    if(error != SQLITE_DONE && error != SQLITE_OK) {
-        REPORT_SQL_ERROR(self, "Some error while selecting all playlists");
-    } else {
-        CLEAR_BINDS_BY_NAME(self, SPL_SELECT_TABLES);
+    if(status != NULL) {
+        g_ptr_array_unref(status);
     }
 
-    return table_name_list;
+    return ops;
 }
 
-static int moose_stprv_spl_get_song_count(MooseStorePrivate *self,
-                                          struct mpd_playlist *playlist) {
-    g_assert(self);
+static void moose_stprv_spl_listplaylists(MooseStorePrivate *store) {
+    g_assert(store);
+    g_assert(store->client);
+    MooseClient *self = store->client;
 
-    int count = -1;
-    char *table_name = moose_stprv_spl_construct_table_name(playlist);
+    if(store->spl_stack != NULL) {
+        g_ptr_array_free(store->spl_stack, true);
+        store->spl_stack = NULL;
+    }
 
-    if(table_name != NULL) {
-        char *dyn_sql = sqlite3_mprintf("SELECT count(*) FROM %q;", table_name);
+    store->spl_stack = g_ptr_array_new_with_free_func((GDestroyNotify)mpd_playlist_free);
 
-        if(dyn_sql != NULL) {
-            sqlite3_stmt *count_stmt = NULL;
+    struct mpd_connection *conn = moose_client_get(self);
+    if(conn != NULL) {
+        /* Served by the client's cache unless a playlist changed */
+        GPtrArray *pairs = moose_client_cache_run(self, conn, "listplaylists");
+        struct mpd_playlist *playlist = NULL;
 
-            if(sqlite3_prepare_v2(self->handle, dyn_sql, -1, &count_stmt, NULL) !=
-               SQLITE_OK) {
-                REPORT_SQL_ERROR(self, "Cannot prepare COUNT stmt!");
-            } else {
-                if(sqlite3_step(count_stmt) == SQLITE_ROW) {
-                    count = sqlite3_column_int(count_stmt, 0);
-                }
+        for(unsigned i = 0; pairs != NULL && i + 1 < pairs->len; i += 2) {
+            struct mpd_pair pair = {g_ptr_array_index(pairs, i),
+                                    g_ptr_array_index(pairs, i + 1)};
 
-                if(sqlite3_step(count_stmt) != SQLITE_DONE) {
-                    REPORT_SQL_ERROR(self,
-                                     "Cannot count songs in stored playlist table.");
-                }
+            /* Each playlist starts with a "playlist" pair */
+            if(playlist != NULL && mpd_playlist_feed(playlist, &pair)) {
+                continue;
             }
 
-            sqlite3_free(dyn_sql);
+            if(playlist != NULL) {
+                g_ptr_array_add(store->spl_stack, playlist);
+            }
+            playlist = mpd_playlist_begin(&pair);
         }
 
-        g_free(table_name);
+        if(playlist != NULL) {
+            g_ptr_array_add(store->spl_stack, playlist);
+        }
+
+        if(pairs != NULL) {
+            g_ptr_array_unref(pairs);
+        }
+    } else {
+        moose_critical("Cannot get connection to get listplaylists (not connected?)");
     }
-    return count;
+    moose_client_put(self);
 }
 
 void moose_stprv_spl_update(MooseStorePrivate *self) {
@@ -2027,115 +2593,41 @@ void moose_stprv_spl_update(MooseStorePrivate *self) {
     /* Get a new list of playlists from mpd */
     moose_stprv_spl_listplaylists(self);
 
-    GList *table_name_list = moose_stprv_spl_get_loaded_list(self);
-
     moose_message("database: Updating stored playlists...");
 
-    /* Filter all Playlist Tables that do not exist anymore in the current playlist stack.
-     * i.e. those that were deleted, or accidentally created. */
-    for(GList *iter = table_name_list; iter;) {
-        char *drop_table_name = iter->data;
-
-        if(drop_table_name != NULL) {
-            bool is_valid = false;
-
-            for(unsigned i = 0; i < self->spl_stack->len; ++i) {
-                struct mpd_playlist *playlist = g_ptr_array_index(self->spl_stack, i);
-                char *valid_table_name = moose_stprv_spl_construct_table_name(playlist);
-                is_valid = (g_strcmp0(valid_table_name, drop_table_name) == 0);
-                g_free(valid_table_name);
-
-                if(is_valid) {
-                    break;
-                }
-            }
-
-            if(is_valid == false) {
-                /* drop invalid table */
-                moose_message("database: Dropping orphaned playlist-table ,,%s''",
-                              drop_table_name);
-                moose_stprv_spl_drop_table(self, drop_table_name);
-                iter = iter->next;
-                table_name_list = g_list_delete_link(table_name_list, iter);
-                continue;
-            }
+    /* Forget all loaded playlists that do not exist anymore on the server */
+    GHashTableIter iter;
+    gpointer key = NULL;
+
+    g_hash_table_iter_init(&iter, self->spl_loaded);
+    while(g_hash_table_iter_next(&iter, &key, NULL)) {
+        if(moose_stprv_spl_name_to_playlist(self, key) == NULL) {
+            moose_message("database: Dropping orphaned stored playlist ,,%s''",
+                          (char *)key);
+            moose_stprv_spl_forget(self, key);
+            g_hash_table_iter_remove(&iter);
         }
-        iter = iter->next;
     }
 
-    /* Iterate over all loaded mpd_playlists,
-    * and find the corresponding table_name.
-    *
-    * If desired, also call load() on it.  */
+    /* Reload loaded playlists that changed, or whose songs were re-indexed */
     for(unsigned i = 0; i < self->spl_stack->len; ++i) {
         struct mpd_playlist *playlist = g_ptr_array_index(self->spl_stack, i);
 
-        if(playlist != NULL) {
-            /* Find matching playlists by name.
-             * If the playlist is too old:
-             *    Re-Load it.
-             * If the playlist does not exist in the stack anymore:
-             *    Drop it.
-             */
-            for(GList *iter = table_name_list; iter; iter = iter->next) {
-                char *old_table_name = iter->data;
-                time_t old_pl_time = 0;
-                char *old_pl_name =
-                    moose_stprv_spl_parse_table_name(old_table_name, &old_pl_time);
-
-                if(g_strcmp0(old_pl_name, mpd_playlist_get_path(playlist)) == 0) {
-                    time_t new_pl_time = mpd_playlist_get_last_modified(playlist);
-
-                    if(new_pl_time == old_pl_time) {
-                        /* nothing has changed */
-                    } else if(new_pl_time > old_pl_time) {
-                        /* reload old_pl? */
-                        moose_stprv_spl_load(self, playlist);
-                    } else {
-                        /* This should not happen */
-                        g_assert_not_reached();
-                    }
-
-                    g_free(old_pl_name);
-                    break;
-                }
-
-                g_free(old_pl_name);
-            }
+        if(playlist != NULL &&
+           g_hash_table_contains(self->spl_loaded, mpd_playlist_get_path(playlist))) {
+            moose_stprv_spl_load(self, playlist);
         }
     }
 
-    /* table names were dyn. allocated. */
-    g_list_free_full(table_name_list, g_free);
-
     moose_debug("Finished: Stored Playlist update.");
 }
 
 bool moose_stprv_spl_is_loaded(MooseStorePrivate *store, struct mpd_playlist *playlist) {
-    bool result = false;
-
-    /* Construct the table name for comparasion */
-    char *table_name = moose_stprv_spl_construct_table_name(playlist);
-    GList *table_names = moose_stprv_spl_get_loaded_list(store);
-
-    for(GList *iter = table_names; iter != NULL; iter = iter->next) {
-        char *comp_table_name = iter->data;
-        if(g_ascii_strcasecmp(comp_table_name, table_name) == 0) {
-            /* Get the actual playlist name from the table name and the last_mod date */
-            time_t comp_last_mod = 0;
-            g_free(moose_stprv_spl_parse_table_name(comp_table_name, &comp_last_mod));
-
-            if(comp_last_mod == mpd_playlist_get_last_modified(playlist)) {
-                result = true;
-                break;
-            }
-        }
-    }
-
-    g_free(table_name);
-    g_list_free_full(table_names, g_free);
+    MooseStoreSpl *spl =
+        g_hash_table_lookup(store->spl_loaded, mpd_playlist_get_path(playlist));
 
-    return result;
+    return spl != NULL && spl->stale == false &&
+           spl->last_modified == mpd_playlist_get_last_modified(playlist);
 }
 
 bool moose_stprv_spl_load(MooseStorePrivate *store, struct mpd_playlist *playlist) {
@@ -2145,80 +2637,125 @@ bool moose_stprv_spl_load(MooseStorePrivate *store, struct mpd_playlist *playlis
 
     bool successfully_loaded = false;
     MooseClient *self = store->client;
+    const char *playlist_name = mpd_playlist_get_path(playlist);
 
     if(moose_stprv_spl_is_loaded(store, playlist)) {
         moose_message("database: Stored playlist '%s' already loaded - skipping.",
-                      mpd_playlist_get_path(playlist));
+                      playlist_name);
         return true;
     } else {
-        moose_message("database: Loading stored playlist '%s'...",
-                      mpd_playlist_get_path(playlist));
+        moose_message("database: Loading stored playlist '%s'...", playlist_name);
     }
 
-    sqlite3_stmt *insert_stmt = NULL;
-    char *table_name = moose_stprv_spl_construct_table_name(playlist);
+    GArray *song_idxs = g_array_new(false, false, sizeof(guint32));
+    unsigned skipped = 0;
 
-    if(table_name != NULL) {
-        moose_stprv_begin(store);
-        moose_stprv_spl_delete_content(store, table_name);
-        char *sql = sqlite3_mprintf(
-            "INSERT INTO %q VALUES((SELECT rowid FROM songs_content WHERE c0uri  = ?));",
-            table_name);
+    /* Acquire the connection (this locks the connection for others) */
+    struct mpd_connection *conn = moose_client_get(self);
+    if(conn != NULL) {
+        if(mpd_send_list_playlist(conn, playlist_name)) {
+            struct mpd_pair *file_pair = NULL;
+
+            while((file_pair = mpd_recv_pair_named(conn, "file")) != NULL) {
+                int song_idx = moose_stprv_stack_find_uri(store, file_pair->value);
+
+                /* Songs not in the database (e.g. streams) are skipped */
+                if(song_idx >= 0) {
+                    guint32 stack_idx = song_idx;
+                    g_array_append_val(song_idxs, stack_idx);
+                } else {
+                    ++skipped;
+                }
 
-        if(sql != NULL) {
-            if(sqlite3_prepare_v2(store->handle, sql, -1, &insert_stmt, NULL) !=
-               SQLITE_OK) {
-                REPORT_SQL_ERROR(store, "Cannot prepare INSERT stmt!");
-                return false;
+                mpd_return_pair(conn, file_pair);
             }
 
-            moose_message("database: Loading stored playlist ,,%s'' from MPD",
-                          table_name);
-            sqlite3_free(sql);
-
-            /* Acquire the connection (this locks the connection for others) */
-            struct mpd_connection *conn = moose_client_get(self);
-            if(conn != NULL) {
-                if(mpd_send_list_playlist(conn, mpd_playlist_get_path(playlist))) {
-                    struct mpd_pair *file_pair = NULL;
-
-                    while((file_pair = mpd_recv_pair_named(conn, "file")) != NULL) {
-                        if(sqlite3_bind_text(insert_stmt, 1, file_pair->value, -1,
-                                             NULL) != SQLITE_OK) {
-                            REPORT_SQL_ERROR(store, "Cannot bind filename to SPL-Insert");
-                        }
-
-                        if(sqlite3_step(insert_stmt) != SQLITE_DONE) {
-                            REPORT_SQL_ERROR(
-                                store, "Cannot insert song index to stored playlist.");
-                        }
-
-                        CLEAR_BINDS(insert_stmt);
-                        mpd_return_pair(conn, file_pair);
-                    }
-
-                    if(mpd_response_finish(conn) == FALSE) {
-                        moose_client_check_error(self, conn);
-                    } else {
-                        moose_debug("Stored Playlist Sync");
-                        successfully_loaded = true;
-                    }
-                }
+            if(mpd_response_finish(conn) == FALSE) {
+                moose_client_check_error(self, conn);
+            } else {
+                moose_debug("Stored Playlist Sync");
+                successfully_loaded = true;
             }
+        }
+    }
 
-            /* Release the connection mutex */
-            moose_client_put(self);
+    /* Release the connection mutex */
+    moose_client_put(self);
 
-            if(sqlite3_finalize(insert_stmt) != SQLITE_OK) {
-                REPORT_SQL_ERROR(store, "Cannot finalize INSERT stmt");
-            }
+    if(successfully_loaded == false) {
+        g_array_free(song_idxs, true);
+        return false;
+    }
+
+    /* A changed playlist only needs its changed entries applied */
+    MooseStoreSpl *previous = g_hash_table_lookup(store->spl_loaded, playlist_name);
+    if(previous != NULL && previous->stale == false) {
+        unsigned n_added = 0, n_removed = 0;
+        GArray *merged = moose_stprv_spl_apply_changes(previous->song_idxs, song_idxs,
+                                                       &n_added, &n_removed);
+        g_array_free(song_idxs, true);
+        song_idxs = merged;
+
+        moose_message("database: Stored playlist ,,%s'' changed (%u added, %u removed)",
+                      playlist_name, n_added, n_removed);
+    } else {
+        moose_stprv_spl_sort_unique(song_idxs);
+    }
+
+    MooseStoreSpl *spl =
+        moose_stprv_spl_new(mpd_playlist_get_last_modified(playlist), song_idxs);
+    moose_stprv_spl_save(store, playlist_name, spl);
+    g_hash_table_replace(store->spl_loaded, g_strdup(playlist_name), spl);
+
+    moose_message("database: Loaded stored playlist ,,%s'' (%u songs, %u not in db)",
+                  playlist_name, song_idxs->len, skipped);
+
+    return true;
+}
+
+bool moose_stprv_spl_prefetch(MooseStorePrivate *self, volatile gboolean *cancel) {
+    g_assert(self);
+
+    unsigned budget = self->settings.spl_prefetch_budget;
+    if(budget == 0 || self->spl_stack == NULL) {
+        return true;
+    }
+
+    /* Songs held by the playlists loaded so far, prefetched or not */
+    unsigned n_songs = 0;
+    GHashTableIter iter;
+    gpointer value = NULL;
+
+    g_hash_table_iter_init(&iter, self->spl_loaded);
+    while(g_hash_table_iter_next(&iter, NULL, &value)) {
+        n_songs += ((MooseStoreSpl *)value)->song_idxs->len;
+    }
+
+    for(unsigned i = 0; i < self->spl_stack->len; ++i) {
+        struct mpd_playlist *playlist = g_ptr_array_index(self->spl_stack, i);
+        if(playlist == NULL || moose_stprv_spl_is_loaded(self, playlist)) {
+            continue;
+        }
+
+        if(n_songs >= budget) {
+            moose_message("database: Prefetch budget of %u songs used up.", budget);
+            break;
         }
 
-        moose_stprv_commit(store);
-        g_free(table_name);
+        /* Checked before each roundtrip, so interactive jobs wait for one at most */
+        if(moose_job_manager_check_cancel(self->jm, cancel)) {
+            moose_debug("database: Stored playlist prefetch interrupted.");
+            return false;
+        }
+
+        if(moose_stprv_spl_load(self, playlist)) {
+            MooseStoreSpl *spl =
+                g_hash_table_lookup(self->spl_loaded, mpd_playlist_get_path(playlist));
+            n_songs += (spl) ? spl->song_idxs->len : 0;
+        }
     }
 
-    return successfully_loaded;
+    return true;
 }
 
 bool moose_stprv_spl_load_by_playlist_name(MooseStorePrivate *store,
@@ -2237,45 +2774,6 @@ bool moose_stprv_spl_load_by_playlist_name(MooseStorePrivate *store,
     }
 }
 
-static inline int moose_stprv_spl_hash_compare(gconstpointer a, gconstpointer b) {
-    return *((gconstpointer **)a) - *((gconstpointer **)b);
-}
-
-static int moose_stprv_spl_bsearch_cmp(const void *key, const void *array) {
-    /* We only compare the pointers. The type is not important here. */
-    return (MooseSong *)key - *(MooseSong **)array;
-}
-
-static int moose_stprv_spl_filter_id_list(MooseStorePrivate *store,
-                                          GPtrArray *song_ptr_array,
-                                          const char *match_clause,
-                                          MoosePlaylist *out_stack) {
-    /* Roughly estimate the number of song pointer to expect */
-    int preallocations = moose_playlist_length(store->stack) /
-                         (((match_clause) ? MAX(strlen(match_clause), 1) : 1) * 2);
-
-    /* Temp. container to hold the query on the database */
-    MoosePlaylist *db_songs = moose_playlist_new_full(preallocations, NULL);
-
-    if(moose_stprv_select_to_stack(store, match_clause, false, db_songs, -1) > 0) {
-        for(size_t i = 0; i < moose_playlist_length(db_songs); ++i) {
-            MooseSong *song = moose_playlist_at(db_songs, i);
-            if(bsearch(song,
-                       song_ptr_array->pdata,
-                       song_ptr_array->len,
-                       sizeof(gpointer),
-                       moose_stprv_spl_bsearch_cmp)) {
-                moose_playlist_append(out_stack, song);
-            }
-        }
-    }
-
-    /* Set them free */
-    g_object_unref(db_songs);
-
-    return moose_playlist_length(out_stack);
-}
-
 int moose_stprv_spl_select_playlist(MooseStorePrivate *store, MoosePlaylist *out_stack,
                                     const char *playlist_name, const char *match_clause) {
     g_assert(store);
@@ -2285,121 +2783,433 @@ int moose_stprv_spl_select_playlist(MooseStorePrivate *store, MoosePlaylist *out
     /*
      * Algorithm:
      *
-     * ids = sort('select id from spl_xzy_1234')
-     * songs = queue_search(match_clause)
-     * for song in songs:
-     *     if bsearch(songs, song.id) == FOUND:
-     *          results.append(song)
-     *
-     * return len(songs)
-     *
+     * matched = bitset(search(match_clause))
+     * for idx in sorted indices of the playlist:
+     *     if idx in matched:
+     *          results.append(stack[idx])
      *
      * (JOIN is much more expensive, that's why.)
      */
 
-    int rc = 0;
-    char *table_name, *dyn_sql;
-    GPtrArray *song_ptr_array = NULL;
-    sqlite3_stmt *pl_id_stmt = NULL;
-    struct mpd_playlist *playlist;
-
     if(match_clause && *match_clause == 0) {
         match_clause = NULL;
     }
 
     /* Try to find the playlist structure in the playlist_struct list by name */
-    if((playlist = moose_stprv_spl_name_to_playlist(store, playlist_name)) == NULL) {
+    if(moose_stprv_spl_name_to_playlist(store, playlist_name) == NULL) {
         return -1;
     }
 
-    /* Use the acquired playlist to find out the correct playlist name */
-    if((table_name = moose_stprv_spl_construct_table_name(playlist)) == NULL) {
-        return -2;
+    MooseStoreSpl *spl = g_hash_table_lookup(store->spl_loaded, playlist_name);
+    if(spl == NULL || spl->stale) {
+        /* Not loaded (yet) */
+        return 0;
+    }
+
+    unsigned stack_length = moose_playlist_length(store->stack);
+
+    if(match_clause == NULL) {
+        for(unsigned i = 0; i < spl->song_idxs->len; ++i) {
+            guint32 song_idx = g_array_index(spl->song_idxs, guint32, i);
+            if(song_idx < stack_length) {
+                MooseSong *song = moose_playlist_at(store->stack, song_idx);
+                moose_playlist_append(out_stack, song);
+            }
+        }
+    } else {
+        MoosePlaylist *stack = store->stack;
+        MooseStoreBitset *matched = moose_store_bitset_new(stack_length);
+
+        if(moose_stprv_select_matched(store, match_clause, -1, matched) > 0) {
+            for(unsigned i = 0; i < spl->song_idxs->len; ++i) {
+                guint32 song_idx = g_array_index(spl->song_idxs, guint32, i);
+                if(moose_store_bitset_contains(matched, song_idx)) {
+                    moose_playlist_append(out_stack, moose_playlist_at(stack, song_idx));
+                }
+            }
+        }
+
+        moose_store_bitset_free(matched);
+    }
+
+    return moose_playlist_length(out_stack);
+}
+
+int moose_stprv_spl_get_loaded_playlists(MooseStorePrivate *store, GPtrArray *stack) {
+    g_assert(store);
+    g_assert(stack);
+
+    int rc = 0;
+    GList *playlist_names =
+        g_list_sort(g_hash_table_get_keys(store->spl_loaded), (GCompareFunc)g_strcmp0);
+
+    for(GList *iter = playlist_names; iter; iter = iter->next) {
+        MooseStoreSpl *spl = g_hash_table_lookup(store->spl_loaded, iter->data);
+        struct mpd_playlist *playlist =
+            moose_stprv_spl_name_to_playlist(store, iter->data);
+
+        if(playlist != NULL && spl->stale == false) {
+            g_ptr_array_add(stack, playlist);
+            ++rc;
+        }
     }
 
-    /* Use the table name to construct a select on this table */
-    if((dyn_sql = sqlite3_mprintf("SELECT song_idx FROM %q;", table_name)) == NULL) {
-        sqlite3_free(table_name);
-        return -3;
+    g_list_free(playlist_names);
+    return rc;
+}
+
+int moose_stprv_spl_get_known_playlists(MooseStorePrivate *store, GPtrArray *stack) {
+    for(unsigned i = 0; i < store->spl_stack->len; ++i) {
+        g_ptr_array_add(stack, g_ptr_array_index(store->spl_stack, i));
     }
+    return store->spl_stack->len;
+}
+
+/*
+ * Hybrid mode
+ * ===========
+ *
+ * For libraries too large to mirror only the queue is kept in the songs
+ * table and the stack. Everything else is asked from the server; the songs
+ * it returns are owned by the result playlist, so memory use depends on the
+ * size of the results, not of the library. A LRU of song-cache-size entries
+ * remembers the latest of them, so repeated queries reuse the same songs.
+ */
+
+/* Pseudo tag for constraints on the uri */
+#define MOOSE_STPRV_TAG_URI MOOSE_TAG_COUNT
 
-    if(sqlite3_prepare_v2(store->handle, dyn_sql, -1, &pl_id_stmt, NULL) != SQLITE_OK) {
-        REPORT_SQL_ERROR(store, "Cannot prepare playlist search statement");
+typedef struct {
+    /* A MooseTagType, MOOSE_TAG_UNKNOWN for any tag or MOOSE_STPRV_TAG_URI */
+    int tag;
+
+    /* What to search for, and its casefolded version for local matching */
+    char *value;
+    char *folded;
+} MooseStoreConstraint;
+
+static void moose_stprv_constraint_free(MooseStoreConstraint *constraint) {
+    g_free(constraint->value);
+    g_free(constraint->folded);
+    g_slice_free(MooseStoreConstraint, constraint);
+}
+
+static int moose_stprv_hybrid_parse_tag(const char *word, size_t len) {
+    const char *full = moose_store_qp_tag_abbrev_to_full(word, len + 1);
+    char *name = (full) ? g_strndup(full, strlen(full) - 1) : g_strndup(word, len);
+    int tag = MOOSE_TAG_UNKNOWN;
+
+    g_strdelimit(name, "_", '-');
+
+    if(g_ascii_strcasecmp(name, "uri") == 0) {
+        tag = MOOSE_STPRV_TAG_URI;
     } else {
-        int song_count = moose_stprv_spl_get_song_count(store, playlist);
-        song_ptr_array = g_ptr_array_sized_new(MAX(song_count, 1));
+        GEnumClass *klass = g_type_class_ref(MOOSE_TYPE_TAG_TYPE);
+        GEnumValue *value = g_enum_get_value_by_nick(klass, name);
+        if(value != NULL) {
+            tag = value->value;
+        }
+        g_type_class_unref(klass);
+    }
+
+    g_free(name);
+    return tag;
+}
+
+/* Translate a query to a list of MooseStoreConstraints */
+static GPtrArray *moose_stprv_hybrid_parse(const char *match_clause) {
+    GPtrArray *constraints =
+        g_ptr_array_new_with_free_func((GDestroyNotify)moose_stprv_constraint_free);
+    char **words = NULL;
+
+    if(match_clause == NULL) {
+        return constraints;
+    }
+
+    /* Splits by whitespace, but keeps "quoted phrases" together */
+    if(g_shell_parse_argv(match_clause, NULL, &words, NULL) == FALSE) {
+        words = g_strsplit_set(match_clause, " \t", -1);
+    }
+
+    for(int i = 0; words[i] != NULL; ++i) {
+        char *word = g_strstrip(g_strdelimit(words[i], "()", ' '));
 
-        while(sqlite3_step(pl_id_stmt) == SQLITE_ROW) {
-            /* Get the actual song */
-            int song_idx = sqlite3_column_int(pl_id_stmt, 0);
-            if(0 < song_idx && song_idx <= (int)moose_playlist_length(store->stack)) {
-                MooseSong *song = moose_playlist_at(store->stack, song_idx - 1);
+        if(*word == '-') {
+            moose_warning("database: Cannot negate ,,%s'' on the server; ignored.", word);
+            continue;
+        }
 
-                /* Remember the pointer */
-                g_ptr_array_add(song_ptr_array, song);
+        word += strspn(word, "+|#");
+        if(*word != 0 && word[strlen(word) - 1] == '*') {
+            word[strlen(word) - 1] = 0;
+        }
+
+        int tag = MOOSE_TAG_UNKNOWN;
+        char *colon = strchr(word, ':');
+        if(colon != NULL && colon != word) {
+            tag = moose_stprv_hybrid_parse_tag(word, colon - word);
+            if(tag != MOOSE_TAG_UNKNOWN) {
+                word = colon + 1;
             }
         }
 
-        if(sqlite3_errcode(store->handle) != SQLITE_DONE) {
-            REPORT_SQL_ERROR(store, "Error while matching stuff in playlist");
-        } else {
-            if(sqlite3_finalize(pl_id_stmt) != SQLITE_OK) {
-                REPORT_SQL_ERROR(store, "Error while finalizing getid statement");
-            } else {
-                g_ptr_array_sort(song_ptr_array, moose_stprv_spl_hash_compare);
-                rc = moose_stprv_spl_filter_id_list(store, song_ptr_array, match_clause,
-                                                    out_stack);
+        if(*word == 0) {
+            continue;
+        }
+
+        MooseStoreConstraint *constraint = g_slice_new0(MooseStoreConstraint);
+        constraint->tag = tag;
+        constraint->value = g_strdup(word);
+        constraint->folded = g_utf8_casefold(word, -1);
+        g_ptr_array_add(constraints, constraint);
+    }
+
+    g_strfreev(words);
+    return constraints;
+}
+
+static bool moose_stprv_hybrid_contains(const char *haystack, const char *folded) {
+    if(haystack == NULL) {
+        return false;
+    }
+
+    char *folded_haystack = g_utf8_casefold(haystack, -1);
+    bool result = strstr(folded_haystack, folded) != NULL;
+    g_free(folded_haystack);
+    return result;
+}
+
+/* Same semantics as MPD's search command */
+static bool moose_stprv_hybrid_matches(MooseSong *song, GPtrArray *constraints) {
+    for(unsigned i = 0; i < constraints->len; ++i) {
+        MooseStoreConstraint *constraint = g_ptr_array_index(constraints, i);
+        bool matches = false;
+
+        if(constraint->tag == MOOSE_STPRV_TAG_URI) {
+            matches = moose_stprv_hybrid_contains(moose_song_get_uri(song),
+                                                  constraint->folded);
+        } else if(constraint->tag == MOOSE_TAG_UNKNOWN) {
+            for(int tag = 0; tag < MOOSE_TAG_COUNT && !matches; ++tag) {
+                matches = moose_stprv_hybrid_contains(moose_song_get_tag(song, tag),
+                                                      constraint->folded);
             }
+        } else {
+            matches = moose_stprv_hybrid_contains(
+                moose_song_get_tag(song, constraint->tag), constraint->folded);
         }
 
-        g_ptr_array_free(song_ptr_array, true);
+        if(matches == false) {
+            return false;
+        }
     }
 
-    g_free(table_name);
-    sqlite3_free(dyn_sql);
+    return true;
+}
 
-    return rc;
+/* Get the MooseSong for song_struct, creating it if it was not seen lately */
+static MooseSong *moose_stprv_recent_get(MooseStorePrivate *self,
+                                         const struct mpd_song *song_struct) {
+    GList *link = g_hash_table_lookup(self->recent.index, mpd_song_get_uri(song_struct));
+
+    if(link != NULL) {
+        g_queue_unlink(&self->recent.songs, link);
+        g_queue_push_head_link(&self->recent.songs, link);
+        return link->data;
+    }
+
+    MooseSong *song = moose_stprv_song_new(self, song_struct);
+    moose_song_set_pos(song, -1);
+    moose_song_set_id(song, -1);
+
+    g_queue_push_head(&self->recent.songs, song);
+    g_hash_table_insert(self->recent.index, (char *)moose_song_get_uri(song),
+                        self->recent.songs.head);
+
+    while(self->recent.songs.length > MAX(self->recent.size, 1u)) {
+        MooseSong *oldest = g_queue_pop_tail(&self->recent.songs);
+        g_hash_table_remove(self->recent.index, moose_song_get_uri(oldest));
+        moose_song_unref(oldest);
+    }
+
+    return song;
 }
 
-int moose_stprv_spl_get_loaded_playlists(MooseStorePrivate *store, GPtrArray *stack) {
-    g_assert(store);
+/*
+ * Append a song from the LRU to a result playlist. Result playlists do not
+ * own their songs (stack songs belong to the store), so the reference is
+ * attached to the playlist and dropped along with it; songs stay valid even
+ * if the LRU forgets them in the meantime.
+ */
+static void moose_stprv_hybrid_append(MoosePlaylist *stack, MooseSong *song) {
+    GQuark owned_quark = g_quark_from_static_string("moose-store-hybrid-songs");
+    GPtrArray *owned = g_object_get_qdata(G_OBJECT(stack), owned_quark);
+    if(owned == NULL) {
+        owned = g_ptr_array_new_with_free_func((GDestroyNotify)moose_song_unref);
+        g_object_set_qdata_full(G_OBJECT(stack), owned_quark, owned,
+                                (GDestroyNotify)g_ptr_array_unref);
+    }
+
+    g_ptr_array_add(owned, g_object_ref(song));
+    moose_playlist_append(stack, song);
+}
+
+bool moose_stprv_mirrors_queue(MooseStorePrivate *self) {
+    g_assert(self);
+    return self->settings.hybrid || self->settings.queue_only;
+}
+
+void moose_stprv_recent_clear(MooseStorePrivate *self) {
+    g_assert(self);
+
+    g_hash_table_remove_all(self->recent.index);
+    g_queue_foreach(&self->recent.songs, (GFunc)moose_song_unref, NULL);
+    g_queue_clear(&self->recent.songs);
+}
+
+int moose_stprv_hybrid_search(MooseStorePrivate *self, const char *match_clause,
+                              MoosePlaylist *stack, int limit_len) {
+    g_assert(self);
     g_assert(stack);
 
-    int rc = 0;
-    GList *table_name_list = moose_stprv_spl_get_loaded_list(store);
+    unsigned limit = (limit_len >= 0) ? (unsigned)limit_len : G_MAXUINT;
+
+    int found = 0;
+    GPtrArray *constraints = moose_stprv_hybrid_parse(match_clause);
 
-    if(table_name_list != NULL) {
-        for(GList *iter = table_name_list; iter; iter = iter->next) {
-            char *table_name = iter->data;
+    struct mpd_connection *conn = moose_client_get(self->client);
+    if(conn != NULL && limit > 0) {
+        bool restricted = moose_stprv_tagtypes_begin(self, conn);
+        mpd_search_db_songs(conn, false);
 
-            if(table_name != NULL) {
-                char *playlist_name = moose_stprv_spl_parse_table_name(table_name, NULL);
+        for(unsigned i = 0; i < constraints->len; ++i) {
+            MooseStoreConstraint *constraint = g_ptr_array_index(constraints, i);
+
+            if(constraint->tag == MOOSE_STPRV_TAG_URI) {
+                mpd_search_add_uri_constraint(conn, MPD_OPERATOR_DEFAULT,
+                                              constraint->value);
+            } else if(constraint->tag == MOOSE_TAG_UNKNOWN) {
+                mpd_search_add_any_tag_constraint(conn, MPD_OPERATOR_DEFAULT,
+                                                  constraint->value);
+            } else {
+                mpd_search_add_tag_constraint(conn, MPD_OPERATOR_DEFAULT,
+                                              constraint->tag, constraint->value);
+            }
+        }
 
-                if(playlist_name != NULL) {
-                    struct mpd_playlist *playlist =
-                        moose_stprv_spl_name_to_playlist(store, playlist_name);
+        /* Nothing to search for; every uri contains "" */
+        if(constraints->len == 0) {
+            mpd_search_add_uri_constraint(conn, MPD_OPERATOR_DEFAULT, "");
+        }
 
-                    if(playlist != NULL) {
-                        g_ptr_array_add(stack, playlist);
-                        ++rc;
-                    }
+#if LIBMPDCLIENT_CHECK_VERSION(2, 10, 0)
+        /* Let the server cut the result, instead of transferring all of it */
+        if(limit_len >= 0) {
+            mpd_search_add_window(conn, 0, limit);
+        }
+#endif
 
-                    g_free(playlist_name);
+        if(mpd_search_commit(conn)) {
+            struct mpd_song *song_struct = NULL;
+            while((song_struct = mpd_recv_song(conn)) != NULL) {
+                if((unsigned)found < limit) {
+                    moose_stprv_hybrid_append(stack,
+                                              moose_stprv_recent_get(self, song_struct));
+                    ++found;
                 }
+                mpd_song_free(song_struct);
+            }
+        }
+
+        if(mpd_response_finish(conn) == false) {
+            moose_client_check_error(self->client, conn);
+        }
 
-                g_free(table_name);
+        moose_stprv_tagtypes_end(self, conn, restricted);
+    }
+    moose_client_put(self->client);
+
+    g_ptr_array_unref(constraints);
+    return found;
+}
+
+int moose_stprv_hybrid_query_directories(MooseStorePrivate *self, MoosePlaylist *stack,
+                                         const char *directory) {
+    g_assert(self);
+    g_assert(stack);
+
+    int returned = -1;
+
+    if(directory == NULL || *directory == '/') {
+        directory = "";
+    }
+
+    struct mpd_connection *conn = moose_client_get(self->client);
+    if(conn != NULL && mpd_send_list_meta(conn, directory)) {
+        struct mpd_entity *ent = NULL;
+        returned = 0;
+
+        while((ent = mpd_recv_entity(conn)) != NULL) {
+            switch(mpd_entity_get_type(ent)) {
+            case MPD_ENTITY_TYPE_DIRECTORY:
+                moose_playlist_append(
+                    stack, g_strjoin(":", "-1", mpd_directory_get_path(
+                                                    mpd_entity_get_directory(ent)),
+                                     NULL));
+                ++returned;
+                break;
+            case MPD_ENTITY_TYPE_SONG:
+                moose_playlist_append(
+                    stack, g_strjoin(":", "0", mpd_song_get_uri(mpd_entity_get_song(ent)),
+                                     NULL));
+                ++returned;
+                break;
+            default:
+                break;
             }
+            mpd_entity_free(ent);
         }
+    }
 
-        g_list_free(table_name_list);
+    if(conn != NULL && mpd_response_finish(conn) == false) {
+        moose_client_check_error(self->client, conn);
     }
+    moose_client_put(self->client);
 
-    return rc;
+    return returned;
 }
 
-int moose_stprv_spl_get_known_playlists(MooseStorePrivate *store, GPtrArray *stack) {
-    for(unsigned i = 0; i < store->spl_stack->len; ++i) {
-        g_ptr_array_add(stack, g_ptr_array_index(store->spl_stack, i));
+int moose_stprv_hybrid_select_playlist(MooseStorePrivate *self, MoosePlaylist *stack,
+                                       const char *playlist_name,
+                                       const char *match_clause) {
+    g_assert(self);
+    g_assert(stack);
+    g_assert(playlist_name);
+
+    int found = 0;
+    GPtrArray *constraints = moose_stprv_hybrid_parse(match_clause);
+
+    struct mpd_connection *conn = moose_client_get(self->client);
+    if(conn != NULL && mpd_send_list_playlist_meta(conn, playlist_name)) {
+        struct mpd_song *song_struct = NULL;
+
+        while((song_struct = mpd_recv_song(conn)) != NULL) {
+            /* Only matches may go to the LRU, others would push them out */
+            MooseSong *candidate = moose_stprv_song_new(self, song_struct);
+            if(moose_stprv_hybrid_matches(candidate, constraints)) {
+                moose_stprv_hybrid_append(stack,
+                                          moose_stprv_recent_get(self, song_struct));
+                ++found;
+            }
+            moose_song_unref(candidate);
+            mpd_song_free(song_struct);
+        }
     }
-    return store->spl_stack->len;
+
+    if(conn != NULL && mpd_response_finish(conn) == false) {
+        moose_client_check_error(self->client, conn);
+    }
+    moose_client_put(self->client);
+
+    g_ptr_array_unref(constraints);
+    return found;
 }
@@ -1,9 +1,14 @@
 #include "../moose-config.h"
 #include "../misc/moose-misc-gzip.h"
 #include "../misc/moose-misc-job-manager.h"
+#include "../misc/moose-misc-reactor-private.h"
+#include "../misc/moose-misc-metrics-private.h"
+#include "../misc/moose-misc-trace-private.h"
 
 #include "../mpd/moose-mpd-client-private.h"
 #include "moose-store.h"
+#include "moose-store-library-private.h"
+#include "moose-store-dir-tree-private.h"
 #include "sqlite3.h"
 
 /* g_unlink() */
@@ -45,6 +50,12 @@ typedef struct _MooseStorePrivate {
     /* Support for stored playlists */
     GPtrArray *spl_stack;
 
+    /* Maps the names of loaded stored playlists to their songs (MooseStoreSpl) */
+    GHashTable *spl_loaded;
+
+    /* True while a MOOSE_OPER_SPL_PREFETCH job waits in the job manager */
+    bool spl_prefetch_queued;
+
     /* If this flag is set listallinfo will retrieve all songs,
      * and skipping the check if is actually necessary.
      * */
@@ -58,6 +69,26 @@ typedef struct _MooseStorePrivate {
     /* Job manager used to process database tasks in the background */
     MooseJobManager *jm;
 
+    /* Update jobs caused by client events are merged,
+     * see moose_store_update_callback() */
+    struct {
+        /* Operations waiting for the timer to fire */
+        MooseStoreOperation pending;
+
+        /* Operations sent to jm that did not start yet */
+        MooseStoreOperation queued;
+
+        /* Protects pending and queued; never held for long */
+        GMutex mtx;
+
+        /* Disarmed while nothing is pending */
+        MooseReactor *reactor;
+        guint timer;
+
+        /* Milliseconds to wait for more events, see MooseStore:update-debounce */
+        unsigned debounce;
+    } update;
+
     /* Locked when setting an attribute, or reading from one
      * Attributes are:
      *    - stack
@@ -81,10 +112,53 @@ typedef struct _MooseStorePrivate {
 
     MooseStoreCompletion *completion;
 
+    /* Maps the queue id of songs in stack to the (reffed) song.
+     * Rebuilt together with the pos/id info of the stack. */
+    GHashTable *id_index;
+
+    /* Queue version id_index reflects, -1 while unknown */
+    long id_index_version;
+
+    /* Our moose_client_subscribe() id */
+    guint subscription_id;
+
+    /* The shared database our songs were taken from or offered to, or NULL */
+    MooseStoreLibrary *library;
+
+    /* Maps the uris of the songs in stack to their index + 1 (first one wins) */
+    GHashTable *uri_index;
+
+    /* Directories of the database, for moose_store_list_directory() */
+    MooseStoreDirTree *dir_tree;
+
+    /* Songs returned by the server in hybrid mode, see moose_stprv_recent_get() */
+    struct {
+        /* Reffed MooseSongs, most recently seen first */
+        GQueue songs;
+
+        /* Maps the uri of each song to its link in songs */
+        GHashTable *index;
+
+        /* Maximum length of songs */
+        unsigned size;
+    } recent;
+
     struct {
         bool use_memory_db;
         bool use_compression;
         char tokenizer[32];
+
+        /* Only mirror the queue, search the database on the server */
+        bool hybrid;
+
+        /* Only mirror the queue, never look at the database at all */
+        bool queue_only;
+
+        /* Bit (1 << tag) is set for each MooseTagType to fetch and keep */
+        unsigned tag_mask;
+
+        /* Stop prefetching stored playlists once they hold this many songs */
+        unsigned spl_prefetch_budget;
     } settings;
 } MooseStorePrivate;
 
@@ -95,6 +169,12 @@ enum {
     PROP_USE_COMPRESSION,
     PROP_USE_MEMORY_DB,
     PROP_TOKENIZER,
+    PROP_HYBRID,
+    PROP_SONG_CACHE_SIZE,
+    PROP_TAG_MASK,
+    PROP_QUEUE_ONLY,
+    PROP_PLAYLIST_PREFETCH_BUDGET,
+    PROP_UPDATE_DEBOUNCE,
     PROP_N
 };
 
@@ -116,6 +196,7 @@ typedef struct {
     int length_limit;
     int dir_depth;
     MoosePlaylist *out_stack;
+    GPtrArray *out_dirs;
     unsigned needle_song_id;
 } MooseJobData;
 
@@ -128,7 +209,8 @@ int MooseJobPrios[] =
      [MOOSE_OPER_SPL_UPDATE] = +1,      [MOOSE_OPER_UPDATE_META] = +1,
      [MOOSE_OPER_DB_SEARCH] = +2,       [MOOSE_OPER_DIR_SEARCH] = +2,
      [MOOSE_OPER_SPL_QUERY] = +2,       [MOOSE_OPER_WRITE_DATABASE] = +3,
-     [MOOSE_OPER_FIND_SONG_BY_ID] = +4, [MOOSE_OPER_UNDEFINED] = 10};
+     [MOOSE_OPER_FIND_SONG_BY_ID] = +4, [MOOSE_OPER_RESUME] = -1,
+     [MOOSE_OPER_SPL_PREFETCH] = +5,    [MOOSE_OPER_UNDEFINED] = 10};
 
 /**
  * Map MooseOpFinishedEnum members to meaningful strings
@@ -144,6 +226,8 @@ const char *MooseJobNames[] = {[MOOSE_OPER_DESERIALIZE] = "DESERIALIZE",
                                [MOOSE_OPER_SPL_QUERY] = "SPL_QUERY",
                                [MOOSE_OPER_WRITE_DATABASE] = "WRITE_DATABASE",
                                [MOOSE_OPER_FIND_SONG_BY_ID] = "FIND_SONG_BY_ID",
+                               [MOOSE_OPER_RESUME] = "RESUME",
+                               [MOOSE_OPER_SPL_PREFETCH] = "SPL_PREFETCH",
                                [MOOSE_OPER_UNDEFINED] = "[Unknown]"};
 
 /**
@@ -227,23 +311,50 @@ static char *moose_store_construct_full_dbpath(MooseStore *self, const char *dir
  */
 MoosePlaylist *moose_store_find_song_by_id_impl(MooseStore *self,
                                                 int needle_song_id) {
-    unsigned length = moose_playlist_length(self->priv->stack);
-    for(unsigned i = 0; i < length; ++i) {
-        MooseSong *song = moose_playlist_at(self->priv->stack, i);
-        if(song != NULL && moose_song_get_id(song) == needle_song_id) {
-            MoosePlaylist *stack = moose_playlist_new();
-            if(stack != NULL) {
-                /* return a stack with one element
-                 * (because that's what the interfaces wants :/)
-                 */
-                moose_playlist_append(stack, song);
-                return stack;
-            }
+    MooseSong *song =
+        g_hash_table_lookup(self->priv->id_index, GINT_TO_POINTER(needle_song_id));
+    if(song != NULL) {
+        MoosePlaylist *stack = moose_playlist_new();
+        if(stack != NULL) {
+            /* return a stack with one element
+             * (because that's what the interfaces wants :/)
+             */
+            moose_playlist_append(stack, song);
+            return stack;
         }
     }
     return NULL;
 }
 
+/**
+ * @brief MooseClientSongResolver for the client this store mirrors.
+ *
+ * Runs on the client's update thread. If the store is busy (or its queue
+ * info is not of queue_version) NULL is returned and the client falls
+ * back to currentsong, so it never waits on a running job.
+ *
+ * @return a reffed song or NULL.
+ */
+static MooseSong *moose_store_resolve_song(G_GNUC_UNUSED MooseClient *client,
+                                           int song_id,
+                                           unsigned queue_version,
+                                           gpointer user_data) {
+    MooseStore *self = user_data;
+    MooseSong *song = NULL;
+
+    if(g_mutex_trylock(&self->priv->attr_set_mtx)) {
+        if(self->priv->id_index_version == (long)queue_version) {
+            song = g_hash_table_lookup(self->priv->id_index, GINT_TO_POINTER(song_id));
+            if(song != NULL) {
+                g_object_ref(song);
+            }
+        }
+        g_mutex_unlock(&self->priv->attr_set_mtx);
+    }
+
+    return song;
+}
+
 /**
  * @brief Will return true, if the database located on disk is still valid.
  *
@@ -253,6 +364,7 @@ MoosePlaylist *moose_store_find_song_by_id_impl(MooseStore *self,
  *  #2 try to open the database (no :memory: connection)
  *  #3 check if hostname/port matches the current one.
  *  #4 check if db_version and sc_version are equal.
+ *  #5 check if the same tags were stored.
  *
  *  - in order to use the old database all checks must succeed.
  *  - there may not be a connection open already on the store!
@@ -338,6 +450,14 @@ static int moose_store_check_if_db_is_still_valid(MooseStore *self, const char *
         goto close_handle;
     }
 
+    /* check #5 */
+    unsigned cached_tag_mask = moose_stprv_get_tag_mask(self->priv);
+    if(cached_tag_mask != self->priv->settings.tag_mask) {
+        moose_warning("database: %s has other tags (old=%x, new=%x), creating new.",
+                      db_path, cached_tag_mask, self->priv->settings.tag_mask);
+        goto close_handle;
+    }
+
     /* All okay! we can use the old database */
     song_count = moose_stprv_get_song_count(self->priv);
 
@@ -355,17 +475,30 @@ static void moose_store_shutdown(MooseStore *self) {
     MooseStorePrivate *priv = self->priv;
 
     /* Free the song stack */
+    g_hash_table_remove_all(priv->id_index);
+    priv->id_index_version = -1;
+    g_hash_table_remove_all(priv->uri_index);
     g_object_unref(priv->stack);
     priv->stack = NULL;
 
+    moose_store_library_unref(priv->library);
+    priv->library = NULL;
+
+    moose_store_dir_tree_free(priv->dir_tree);
+    priv->dir_tree = NULL;
+
+    moose_stprv_recent_clear(priv);
+
     char *db_path = moose_store_construct_full_dbpath(self, priv->db_directory);
 
-    if(priv->write_to_disk) {
-        moose_stprv_lock_or_save(self->priv, true, db_path);
-    }
+    if(moose_stprv_mirrors_queue(priv) == false) {
+        if(priv->write_to_disk) {
+            moose_stprv_lock_or_save(self->priv, true, db_path);
+        }
 
-    if(priv->settings.use_compression && moose_gzip(db_path) == false) {
-        moose_warning("Weird, zipping failed.");
+        if(priv->settings.use_compression && moose_gzip(db_path) == false) {
+            moose_warning("Weird, zipping failed.");
+        }
     }
 
     moose_stprv_close_handle(self->priv, true);
@@ -391,7 +524,21 @@ static void moose_store_buildup(MooseStore *self) {
 
     self->priv->needs_buildup = FALSE;
 
-    if((song_count = moose_store_check_if_db_is_still_valid(self, db_path)) < 0) {
+    if(moose_stprv_mirrors_queue(self->priv)) {
+        moose_message("database: %s mode, will only mirror the queue.",
+                      (self->priv->settings.queue_only) ? "queue-only" : "hybrid");
+
+        /* Nothing worth to be cached on disk, the queue is fetched quickly */
+        moose_strprv_open_memdb(self->priv);
+        moose_stprv_prepare_all_statements(self->priv);
+        moose_stprv_insert_meta_attributes(self->priv);
+
+        self->priv->force_update_plchanges = true;
+        self->priv->stack =
+            moose_playlist_new_full(100, (GDestroyNotify)moose_song_unref);
+
+        moose_store_send_job_no_args(self, MOOSE_OPER_PLCHANGES);
+    } else if((song_count = moose_store_check_if_db_is_still_valid(self, db_path)) < 0) {
         moose_message("database: will fetch stuff from mpd.");
 
         /* open a sqlite handle, pointing to a database, either a new one will be created,
@@ -459,18 +606,97 @@ static void moose_store_update_callback(MooseClient *client,
 
     g_assert(self && client && self->priv->client == client);
 
+    MooseStoreOperation op = MOOSE_OPER_UNDEFINED;
     if(events & MOOSE_IDLE_DATABASE) {
-        moose_store_send_job_no_args(self, MOOSE_OPER_LISTALLINFO);
+        op = MOOSE_OPER_LISTALLINFO;
     } else if(events & MOOSE_IDLE_QUEUE) {
-        moose_store_send_job_no_args(self, MOOSE_OPER_PLCHANGES);
+        op = MOOSE_OPER_PLCHANGES;
     } else if(events & MOOSE_IDLE_STORED_PLAYLIST) {
-        moose_store_send_job_no_args(self, MOOSE_OPER_SPL_UPDATE);
+        op = MOOSE_OPER_SPL_UPDATE;
+    }
+
+    /* Events of a burst (e.g. a script adding songs one by one) are collected
+     * for update.debounce ms from the first one on and then sent as one job.
+     * Each job fetches everything since the version the store has,
+     * so nothing is lost by merging them. */
+    g_mutex_lock(&self->priv->update.mtx);
+    {
+        bool arm = self->priv->update.pending == 0;
+        self->priv->update.pending |= op;
+
+        if(arm) {
+            moose_reactor_set_timer(self->priv->update.reactor, self->priv->update.timer,
+                                    MAX(self->priv->update.debounce, 1));
+        }
+    }
+    g_mutex_unlock(&self->priv->update.mtx);
+}
+
+/* Called in the reactor thread once the debounce window of an event burst ended */
+static gboolean moose_store_update_timeout(MooseReactor *reactor,
+                                           guint id,
+                                           G_GNUC_UNUSED GIOCondition condition,
+                                           gpointer data) {
+    MooseStore *self = MOOSE_STORE(data);
+    MooseStoreOperation op = MOOSE_OPER_UNDEFINED;
+
+    g_mutex_lock(&self->priv->update.mtx);
+    {
+        MooseStoreOperation pending = self->priv->update.pending;
+        self->priv->update.pending = 0;
+        moose_reactor_set_timer(reactor, id, 0);
+
+        /* LISTALLINFO implies PLCHANGES, which implies SPL_UPDATE.
+         * A job of the same kind that did not start yet covers this one too. */
+        MooseStoreOperation chain[] = {MOOSE_OPER_LISTALLINFO, MOOSE_OPER_PLCHANGES,
+                                       MOOSE_OPER_SPL_UPDATE};
+
+        for(unsigned i = 0; op == MOOSE_OPER_UNDEFINED && i < G_N_ELEMENTS(chain); ++i) {
+            if(self->priv->update.queued & chain[i]) {
+                break;
+            }
+
+            if(pending & chain[i]) {
+                op = chain[i];
+            }
+        }
+
+        self->priv->update.queued |= op;
+    }
+    g_mutex_unlock(&self->priv->update.mtx);
+
+    if(op != MOOSE_OPER_UNDEFINED) {
+        moose_store_send_job_no_args(self, op);
     }
+
+    return TRUE;
+}
+
+/**
+ * @brief Check if the store is built up and mirrors the server client is connected to.
+ */
+static bool moose_store_is_mirroring(MooseStore *self, MooseClient *client) {
+    char *host = moose_client_get_host(client);
+    bool is_mirroring = false;
+
+    g_mutex_lock(&self->priv->mirrored_mtx);
+    {
+        is_mirroring = self->priv->stack != NULL && self->priv->needs_buildup == false &&
+                       self->priv->mirrored_port == (int)moose_client_get_port(client) &&
+                       g_strcmp0(self->priv->mirrored_host, host) == 0;
+    }
+    g_mutex_unlock(&self->priv->mirrored_mtx);
+
+    g_free(host);
+    return is_mirroring;
 }
 
 /**
  * @brief Called when the connection status changes.
  *
+ * A reconnect to the server we mirror keeps the store as it is;
+ * only the changes since the connection dropped are fetched.
+ *
  * @param client the client to watch.
  * @param server_changed did the server changed since last connect()?
  * @param self the store to operate on
@@ -481,18 +707,34 @@ static void moose_store_connectivity_callback(MooseClient *client,
     g_assert(self && client && self->priv->client == client);
 
     if(moose_client_is_connected(client)) {
-        if(server_changed) {
+        if(server_changed == false && moose_store_is_mirroring(self, client)) {
+            moose_store_send_job_no_args(self, MOOSE_OPER_RESUME);
+        } else if(server_changed) {
             moose_stprv_lock(self->priv);
             {
                 moose_store_shutdown(self);
-                g_free(self->priv->mirrored_host);
-                self->priv->mirrored_host = g_strdup(moose_client_get_host(client));
-                self->priv->mirrored_port = moose_client_get_port(client);
+
+                g_mutex_lock(&self->priv->mirrored_mtx);
+                {
+                    g_free(self->priv->mirrored_host);
+                    self->priv->mirrored_host = moose_client_get_host(client);
+                    self->priv->mirrored_port = moose_client_get_port(client);
+                }
+                g_mutex_unlock(&self->priv->mirrored_mtx);
+
                 self->priv->needs_buildup = TRUE;
                 moose_store_buildup(self);
             }
             moose_stprv_unlock(self->priv);
         } else {
+            g_mutex_lock(&self->priv->mirrored_mtx);
+            {
+                g_free(self->priv->mirrored_host);
+                self->priv->mirrored_host = moose_client_get_host(client);
+                self->priv->mirrored_port = moose_client_get_port(client);
+            }
+            g_mutex_unlock(&self->priv->mirrored_mtx);
+
             /* Do the actual hard work */
             self->priv->needs_buildup = TRUE;
             moose_store_buildup(self);
@@ -513,14 +755,24 @@ void *moose_store_job_execute_callback(
     void *result = NULL;
     MooseStore *self = user_data;
     MooseJobData *data = job_data;
+    bool send_prefetch = false;
 
     if(data->op == 0) {
         goto cleanup;
     }
 
+    /* Events from now on need a job of their own */
+    g_mutex_lock(&self->priv->update.mtx);
+    { self->priv->update.queued &= ~data->op; }
+    g_mutex_unlock(&self->priv->update.mtx);
+
+    /* Recorded as single operation; further ones are added below */
+    const char *job_name = MooseJobNames[data->op];
+    gint64 span = moose_trace_begin();
+
     moose_stprv_lock(self->priv);
     {
-        moose_debug("Processing: %s", MooseJobNames[data->op]);
+        moose_debug("Processing: %s", job_name);
 
         /* NOTE:
          *
@@ -532,23 +784,48 @@ void *moose_store_job_execute_callback(
          * but is not restricted to that.
          */
 
+        if(data->op & MOOSE_OPER_RESUME) {
+            data->op |= moose_stprv_oper_resume(self->priv);
+        }
+
+        if(moose_stprv_mirrors_queue(self->priv) && (data->op & MOOSE_OPER_LISTALLINFO)) {
+            /* There's no database to list, but the tags of known songs might be old */
+            data->op &= ~MOOSE_OPER_LISTALLINFO;
+            data->op |= MOOSE_OPER_PLCHANGES;
+            moose_stprv_recent_clear(self->priv);
+            self->priv->force_update_listallinfo = false;
+            self->priv->force_update_plchanges = true;
+        }
+
         if(data->op & MOOSE_OPER_DESERIALIZE) {
             moose_stprv_deserialize_songs(self->priv);
+            moose_stprv_spl_deserialize(self->priv);
             moose_stprv_queue_update_stack_posid(self->priv);
+            self->priv->id_index_version = moose_stprv_get_pl_version(self->priv);
             data->op |=
                 (MOOSE_OPER_PLCHANGES | MOOSE_OPER_SPL_UPDATE | MOOSE_OPER_UPDATE_META);
             self->priv->force_update_listallinfo = false;
         }
 
         if(data->op & MOOSE_OPER_LISTALLINFO) {
+            gint64 started = g_get_monotonic_time(), phase = moose_trace_begin();
             moose_stprv_oper_listallinfo(self->priv, cancel_op);
+            moose_metrics_record_since(MOOSE_METRIC_STORE_LISTALLINFO, started);
+            moose_trace_end(phase, "store", "listallinfo");
             data->op |=
                 (MOOSE_OPER_PLCHANGES | MOOSE_OPER_SPL_UPDATE | MOOSE_OPER_UPDATE_META);
             self->priv->force_update_listallinfo = false;
         }
 
+        if(data->op & (MOOSE_OPER_DESERIALIZE | MOOSE_OPER_LISTALLINFO)) {
+            moose_stprv_dir_tree_update(self->priv);
+        }
+
         if(data->op & MOOSE_OPER_PLCHANGES) {
+            gint64 started = g_get_monotonic_time(), phase = moose_trace_begin();
             moose_stprv_oper_plchanges(self->priv, cancel_op);
+            moose_metrics_record_since(MOOSE_METRIC_STORE_PLCHANGES, started);
+            moose_trace_end(phase, "store", "plchanges");
             data->op |= (MOOSE_OPER_SPL_UPDATE | MOOSE_OPER_UPDATE_META);
             self->priv->force_update_plchanges = false;
         }
@@ -557,34 +834,75 @@ void *moose_store_job_execute_callback(
             moose_stprv_insert_meta_attributes(self->priv);
         }
 
-        if(data->op & MOOSE_OPER_SPL_UPDATE) {
+        /* Queue-only stores do not know about stored playlists */
+        if((data->op & MOOSE_OPER_SPL_UPDATE) &&
+           self->priv->settings.queue_only == false) {
             moose_stprv_spl_update(self->priv);
+
+            /* In sync now; load the remaining playlists once nothing else is to do */
+            send_prefetch = moose_stprv_mirrors_queue(self->priv) == false;
         }
 
-        if(data->op & MOOSE_OPER_SPL_LOAD) {
+        /* In hybrid mode stored playlists are always queried from the server */
+        if((data->op & MOOSE_OPER_SPL_LOAD) &&
+           moose_stprv_mirrors_queue(self->priv) == false) {
             moose_stprv_spl_load_by_playlist_name(self->priv, data->playlist_name);
         }
 
         if(data->op & MOOSE_OPER_DB_SEARCH) {
-            moose_stprv_select_to_stack(self->priv, data->match_clause, data->queue_only,
-                                        data->out_stack, data->length_limit);
+            if(self->priv->settings.queue_only) {
+                /* The songs table is the queue, nothing else can be found */
+                moose_stprv_select_to_stack(self->priv, data->match_clause, true,
+                                            data->out_stack, data->length_limit);
+            } else if(self->priv->settings.hybrid && data->queue_only == false) {
+                moose_stprv_hybrid_search(self->priv, data->match_clause,
+                                          data->out_stack, data->length_limit);
+            } else {
+                moose_stprv_select_to_stack(self->priv, data->match_clause,
+                                            data->queue_only, data->out_stack,
+                                            data->length_limit);
+            }
             result = data->out_stack;
         }
 
         if(data->op & MOOSE_OPER_DIR_SEARCH) {
-            moose_stprv_query_directories(self->priv, data->out_stack,
-                                          data->dir_directory, data->dir_depth);
+            if(data->out_dirs != NULL) {
+                /* moose_store_list_directory(); no tree when mirroring the queue only */
+                if(self->priv->dir_tree != NULL) {
+                    moose_store_dir_tree_list(self->priv->dir_tree, self->priv->stack,
+                                              data->dir_directory, data->dir_depth,
+                                              data->out_stack, data->out_dirs);
+                }
+            } else if(self->priv->settings.queue_only) {
+                /* No directories known; leave the stack empty */
+            } else if(self->priv->settings.hybrid) {
+                moose_stprv_hybrid_query_directories(self->priv, data->out_stack,
+                                                     data->dir_directory);
+            } else {
+                moose_stprv_query_directories(self->priv, data->out_stack,
+                                              data->dir_directory, data->dir_depth);
+            }
             result = data->out_stack;
         }
 
         if(data->op & MOOSE_OPER_SPL_QUERY) {
-            moose_stprv_spl_select_playlist(self->priv, data->out_stack,
-                                            data->playlist_name, data->match_clause);
+            if(self->priv->settings.queue_only) {
+                /* No stored playlists known; leave the stack empty */
+            } else if(self->priv->settings.hybrid) {
+                moose_stprv_hybrid_select_playlist(self->priv, data->out_stack,
+                                                   data->playlist_name,
+                                                   data->match_clause);
+            } else {
+                moose_stprv_spl_select_playlist(self->priv, data->out_stack,
+                                                data->playlist_name,
+                                                data->match_clause);
+            }
             result = data->out_stack;
         }
 
         if(data->op & MOOSE_OPER_WRITE_DATABASE) {
-            if(self->priv->write_to_disk) {
+            if(self->priv->write_to_disk &&
+               moose_stprv_mirrors_queue(self->priv) == false) {
                 char *full_path =
                     moose_store_construct_full_dbpath(self, self->priv->db_directory);
                 moose_stprv_lock_or_save(self->priv, true, full_path);
@@ -593,20 +911,38 @@ void *moose_store_job_execute_callback(
         }
 
         if(data->op & MOOSE_OPER_FIND_SONG_BY_ID) {
-            data->out_stack =
-                moose_store_find_song_by_id_impl(self, data->needle_song_id);
-            result = data->out_stack;
+            /* A new playlist, owned by the job manager already */
+            result = moose_store_find_song_by_id_impl(self, data->needle_song_id);
+        }
+
+        if(data->op & MOOSE_OPER_SPL_PREFETCH) {
+            self->priv->spl_prefetch_queued = false;
+
+            /* Interrupted by an interactive job; continue after it */
+            send_prefetch = moose_stprv_spl_prefetch(self->priv, cancel_op) == false;
+        }
+
+        if(send_prefetch && self->priv->spl_prefetch_queued == false) {
+            self->priv->spl_prefetch_queued = true;
+            moose_store_send_job_no_args(self, MOOSE_OPER_SPL_PREFETCH);
         }
 
         /* If the operation includes writing stuff, we need to remember to save
          * the database to disk */
         if(data->op &
            (0 | MOOSE_OPER_LISTALLINFO | MOOSE_OPER_PLCHANGES | MOOSE_OPER_SPL_UPDATE |
-            MOOSE_OPER_SPL_LOAD | MOOSE_OPER_UPDATE_META)) {
+            MOOSE_OPER_SPL_LOAD | MOOSE_OPER_SPL_PREFETCH | MOOSE_OPER_UPDATE_META)) {
             self->priv->write_to_disk = TRUE;
         }
     }
     moose_stprv_unlock(self->priv);
+    moose_trace_end(span, "job", (job_name) ? job_name : "[Unknown]");
+
+    /* The caller owns out_stack; the job manager holds its own reference,
+     * so results that are never fetched can expire safely. */
+    if(result != NULL && result == data->out_stack) {
+        g_object_ref(result);
+    }
 
     char buf[256] = {0};
     moose_store_op_to_string(data->op, buf, sizeof(buf));
@@ -671,6 +1007,23 @@ long moose_store_query_directories(MooseStore *self, MoosePlaylist *stack,
                                   data);
 }
 
+long moose_store_list_directory(MooseStore *self, const char *directory, int depth,
+                                MoosePlaylist *songs, GPtrArray *directories) {
+    g_assert(self);
+    g_assert(songs);
+    g_assert(directories);
+
+    MooseJobData *data = g_new0(MooseJobData, 1);
+    data->op = MOOSE_OPER_DIR_SEARCH;
+    data->dir_directory = g_strdup(directory);
+    data->dir_depth = depth;
+    data->out_stack = songs;
+    data->out_dirs = directories;
+
+    return moose_job_manager_send(self->priv->jm, MooseJobPrios[MOOSE_OPER_DIR_SEARCH],
+                                  data);
+}
+
 long moose_store_playlist_get_all_known(MooseStore *self, MoosePlaylist *stack) {
     g_assert(self);
     g_assert(stack);
@@ -706,7 +1059,13 @@ void moose_store_wait_for_job(MooseStore *self, int job_id) {
 }
 
 MoosePlaylist *moose_store_get_result(MooseStore *self, int job_id) {
-    return moose_job_manager_get_result(self->priv->jm, job_id);
+    MoosePlaylist *result = moose_job_manager_get_result(self->priv->jm, job_id);
+
+    /* Drop the job manager's reference, the caller passed in its own */
+    if(result != NULL) {
+        g_object_unref(result);
+    }
+    return result;
 }
 
 MoosePlaylist *moose_store_gw(MooseStore *self, int job_id) {
@@ -729,12 +1088,17 @@ MooseSong *moose_store_find_song_by_id(MooseStore *self, unsigned needle_song_id
     unsigned job_id = moose_job_manager_send(
         self->priv->jm, MooseJobPrios[MOOSE_OPER_FIND_SONG_BY_ID], data);
     moose_store_wait_for_job(self, job_id);
-    MoosePlaylist *stack = moose_store_get_result(self, job_id);
-    if(stack != NULL && moose_playlist_length(stack) > 0) {
-        MooseSong *song = moose_playlist_at(stack, 0);
-        return song;
+
+    /* Nobody else holds this playlist; the song itself belongs to the store */
+    MooseSong *song = NULL;
+    MoosePlaylist *stack = moose_job_manager_get_result(self->priv->jm, job_id);
+    if(stack != NULL) {
+        if(moose_playlist_length(stack) > 0) {
+            song = moose_playlist_at(stack, 0);
+        }
+        g_object_unref(stack);
     }
-    return NULL;
+    return song;
 }
 
 static GList *moose_store_get_playlists_impl(MooseStore *self,
@@ -784,13 +1148,32 @@ static void moose_store_init(MooseStore *self) {
     /* Initialize the Attribute mutex early */
     g_mutex_init(&priv->attr_set_mtx);
     g_mutex_init(&priv->mirrored_mtx);
+    g_mutex_init(&priv->update.mtx);
 
     priv->completion = NULL;
+    priv->id_index = g_hash_table_new_full(
+        g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)moose_song_unref);
+    priv->id_index_version = -1;
+    priv->uri_index = g_hash_table_new(g_str_hash, g_str_equal);
+
+    g_queue_init(&priv->recent.songs);
+    priv->recent.index = g_hash_table_new(g_str_hash, g_str_equal);
+    priv->recent.size = 1000;
+    priv->settings.tag_mask = MOOSE_STORE_ALL_TAGS;
+    priv->settings.spl_prefetch_budget = MOOSE_STORE_PREFETCH_BUDGET;
+    moose_stprv_spl_init(priv);
 
     /* Initialize the job manager used to background jobs */
     priv->jm = moose_job_manager_new();
+    moose_job_manager_set_result_free_func(priv->jm, g_object_unref);
     g_signal_connect(priv->jm, "dispatch", G_CALLBACK(moose_store_job_execute_callback),
                      self);
+
+    /* Armed by moose_store_update_callback() */
+    priv->update.debounce = MOOSE_STORE_UPDATE_DEBOUNCE;
+    priv->update.reactor = moose_reactor_ref_default();
+    priv->update.timer = moose_reactor_add_timer(priv->update.reactor, 0,
+                                                 moose_store_update_timeout, self);
 }
 
 /*
@@ -808,21 +1191,34 @@ static void moose_store_finalize(GObject *gobject) {
         return;
     }
 
+    /* Waits for a currently running lookup */
+    moose_client_set_song_resolver(self->priv->client, NULL, NULL);
+    moose_client_unsubscribe(self->priv->client, self->priv->subscription_id);
+
     g_signal_handlers_disconnect_by_func(self->priv->client, moose_store_update_callback,
                                          self);
     g_signal_handlers_disconnect_by_func(self->priv->client,
                                          moose_store_connectivity_callback, self);
 
-    moose_stprv_lock(self->priv);
+    /* Waits for a running moose_store_update_timeout(); pending updates are dropped */
+    moose_reactor_remove(self->priv->update.reactor, self->priv->update.timer);
+    moose_reactor_unref(self->priv->update.reactor);
 
-    /* Close the job pool (still finishes current operation) */
+    /* Close the job pool; pending jobs still run and need the lock below */
     moose_job_manager_unref(self->priv->jm);
 
+    moose_stprv_lock(self->priv);
+
     moose_store_shutdown(self);
 
     moose_stprv_unlock(self->priv);
+    g_hash_table_destroy(self->priv->id_index);
+    g_hash_table_destroy(self->priv->recent.index);
+    g_hash_table_destroy(self->priv->uri_index);
+    moose_stprv_spl_destroy(self->priv);
     g_mutex_clear(&self->priv->attr_set_mtx);
     g_mutex_clear(&self->priv->mirrored_mtx);
+    g_mutex_clear(&self->priv->update.mtx);
 
     /* NOTE: Settings should be destroyed by caller,
      *       Since it should be valid to call close()
@@ -862,6 +1258,24 @@ static void moose_store_get_property(GObject *object,
     case PROP_DB_DIRECTORY:
         g_value_set_string(value, priv->db_directory);
         break;
+    case PROP_HYBRID:
+        g_value_set_boolean(value, priv->settings.hybrid);
+        break;
+    case PROP_SONG_CACHE_SIZE:
+        g_value_set_uint(value, priv->recent.size);
+        break;
+    case PROP_TAG_MASK:
+        g_value_set_uint(value, priv->settings.tag_mask);
+        break;
+    case PROP_QUEUE_ONLY:
+        g_value_set_boolean(value, priv->settings.queue_only);
+        break;
+    case PROP_PLAYLIST_PREFETCH_BUDGET:
+        g_value_set_uint(value, priv->settings.spl_prefetch_budget);
+        break;
+    case PROP_UPDATE_DEBOUNCE:
+        g_value_set_uint(value, priv->update.debounce);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
         break;
@@ -893,6 +1307,34 @@ static void moose_store_set_property(GObject *object,
         g_free(priv->db_directory);
         priv->db_directory = g_value_dup_string(value);
         break;
+    case PROP_HYBRID:
+        priv->settings.hybrid = g_value_get_boolean(value);
+        break;
+    case PROP_TAG_MASK:
+        priv->settings.tag_mask = g_value_get_uint(value);
+        break;
+    case PROP_QUEUE_ONLY:
+        priv->settings.queue_only = g_value_get_boolean(value);
+        break;
+    case PROP_PLAYLIST_PREFETCH_BUDGET:
+        moose_stprv_lock(priv);
+        {
+            priv->settings.spl_prefetch_budget = g_value_get_uint(value);
+        }
+        moose_stprv_unlock(priv);
+        break;
+    case PROP_UPDATE_DEBOUNCE:
+        g_mutex_lock(&priv->update.mtx);
+        { priv->update.debounce = g_value_get_uint(value); }
+        g_mutex_unlock(&priv->update.mtx);
+        break;
+    case PROP_SONG_CACHE_SIZE:
+        moose_stprv_lock(priv);
+        {
+            priv->recent.size = g_value_get_uint(value);
+        }
+        moose_stprv_unlock(priv);
+        break;
     case PROP_CLIENT:
         priv->client = g_value_get_object(value);
         g_object_ref(priv->client);
@@ -901,11 +1343,6 @@ static void moose_store_set_property(GObject *object,
         priv->mirrored_host = g_strdup(moose_client_get_host(priv->client));
         priv->mirrored_port = moose_client_get_port(priv->client);
 
-        if(moose_client_is_connected(priv->client)) {
-            self->priv->needs_buildup = TRUE;
-            moose_store_buildup(self);
-        }
-
         /* Register for client events */
         g_signal_connect(priv->client, "client-event",
                          G_CALLBACK(moose_store_update_callback), self);
@@ -915,6 +1352,14 @@ static void moose_store_set_property(GObject *object,
                          "connectivity",
                          G_CALLBACK(moose_store_connectivity_callback),
                          self);
+
+        /* Let the client take the current song from us */
+        moose_client_set_song_resolver(priv->client, moose_store_resolve_song, self);
+
+        /* Only those are handled in moose_store_update_callback */
+        priv->subscription_id = moose_client_subscribe(
+            priv->client,
+            MOOSE_IDLE_DATABASE | MOOSE_IDLE_QUEUE | MOOSE_IDLE_STORED_PLAYLIST);
         break;
     case PROP_FULL_PLAYLIST:
     default:
@@ -923,9 +1368,23 @@ static void moose_store_set_property(GObject *object,
     }
 }
 
+static void moose_store_constructed(GObject *object) {
+    MooseStore *self = MOOSE_STORE(object);
+
+    G_OBJECT_CLASS(g_type_class_peek_parent(G_OBJECT_GET_CLASS(self)))
+        ->constructed(object);
+
+    /* Only now all construct properties (like "hybrid") are known */
+    if(self->priv->client != NULL && moose_client_is_connected(self->priv->client)) {
+        self->priv->needs_buildup = TRUE;
+        moose_store_buildup(self);
+    }
+}
+
 static void moose_store_class_init(MooseStoreClass *klass) {
     GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
     gobject_class->finalize = moose_store_finalize;
+    gobject_class->constructed = moose_store_constructed;
     gobject_class->get_property = moose_store_get_property;
     gobject_class->set_property = moose_store_set_property;
 
@@ -1018,6 +1477,111 @@ static void moose_store_class_init(MooseStoreClass *klass) {
      *
      */
     g_object_class_install_property(gobject_class, PROP_TOKENIZER, pspec);
+
+    pspec = g_param_spec_boolean("hybrid",
+                                 "Hybrid",
+                                 "Only mirror the queue and search the server?",
+                                 FALSE, /* default value */
+                                 G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+
+    /**
+     * MooseStore:hybrid: (type boolean)
+     *
+     * Only mirror the queue and let the server search the database?
+     *
+     * Adv: Memory usage does not depend on the size of the library.
+     * Dis: Every search is a roundtrip, and only simple queries work.
+     */
+    g_object_class_install_property(gobject_class, PROP_HYBRID, pspec);
+
+    pspec = g_param_spec_uint("song-cache-size",
+                              "Song cache size",
+                              "How many songs found on the server to keep",
+                              1, G_MAXUINT,
+                              1000, /* default value */
+                              G_PARAM_READWRITE);
+
+    /**
+     * MooseStore:song-cache-size: (type guint)
+     *
+     * Number of songs returned by the server in hybrid mode that are kept
+     * for reuse by later results. Each result playlist holds its own songs,
+     * so this does not limit the length of a result.
+     */
+    g_object_class_install_property(gobject_class, PROP_SONG_CACHE_SIZE, pspec);
+
+    pspec = g_param_spec_uint("tag-mask",
+                              "Tag mask",
+                              "Bitmask of the tags to fetch, store and index",
+                              0, G_MAXUINT,
+                              MOOSE_STORE_ALL_TAGS, /* default value */
+                              G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+
+    /**
+     * MooseStore:tag-mask: (type guint)
+     *
+     * Set bit (1 << tag) for each #MooseTagType the store should know,
+     * e.g. (1 << MOOSE_TAG_ARTIST) | (1 << MOOSE_TAG_TITLE).
+     * Other tags are not fetched (if the server supports "tagtypes"),
+     * stored in the database or held by the songs; searching them finds nothing.
+     *
+     * Adv: Less memory, a smaller cache and faster indexing.
+     * Dis: Changing it rebuilds the cache.
+     */
+    g_object_class_install_property(gobject_class, PROP_TAG_MASK, pspec);
+
+    pspec = g_param_spec_boolean("queue-only",
+                                 "Queue only",
+                                 "Only mirror the queue and search in it?",
+                                 FALSE, /* default value */
+                                 G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+
+    /**
+     * MooseStore:queue-only: (type boolean)
+     *
+     * Only mirror the queue, for clients that never show the database.
+     * moose_store_query() always searches the queue then, directories
+     * and stored playlists are empty. Takes precedence over #MooseStore:hybrid.
+     *
+     * Adv: Starts without a listallinfo; memory grows with the queue only.
+     * Dis: Nothing outside the queue can be found.
+     */
+    g_object_class_install_property(gobject_class, PROP_QUEUE_ONLY, pspec);
+
+    pspec = g_param_spec_uint("playlist-prefetch-budget",
+                              "Playlist prefetch budget",
+                              "How many songs of stored playlists to load in advance",
+                              0, G_MAXUINT,
+                              MOOSE_STORE_PREFETCH_BUDGET, /* default value */
+                              G_PARAM_READWRITE);
+
+    /**
+     * MooseStore:playlist-prefetch-budget: (type guint)
+     *
+     * Once in sync with the server, stored playlists are loaded in the
+     * background, as if moose_store_playlist_load() was called for each.
+     * Any other job interrupts this; it continues afterwards.
+     * Prefetching stops once the loaded playlists hold this many songs
+     * (4 bytes each); 0 disables it.
+     */
+    g_object_class_install_property(gobject_class, PROP_PLAYLIST_PREFETCH_BUDGET, pspec);
+
+    pspec = g_param_spec_uint("update-debounce",
+                              "Update debounce",
+                              "Milliseconds to collect server events before updating",
+                              0, 60 * 1000,
+                              MOOSE_STORE_UPDATE_DEBOUNCE, /* default value */
+                              G_PARAM_READWRITE);
+
+    /**
+     * MooseStore:update-debounce: (type guint)
+     *
+     * After the server reported a change, further changes are awaited for
+     * this many milliseconds; then a single update is done for all of them.
+     * Higher values mean fewer updates during bursts of changes,
+     * but the store lags behind the server for longer.
+     */
+    g_object_class_install_property(gobject_class, PROP_UPDATE_DEBOUNCE, pspec);
 }
 
 MooseStore *moose_store_new(MooseClient *client) {
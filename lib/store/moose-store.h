@@ -7,6 +7,27 @@
 
 G_BEGIN_DECLS
 
+/**
+ * MOOSE_STORE_ALL_TAGS:
+ *
+ * Value of #MooseStore:tag-mask that keeps every tag (the default).
+ */
+#define MOOSE_STORE_ALL_TAGS G_MAXUINT
+
+/**
+ * MOOSE_STORE_PREFETCH_BUDGET:
+ *
+ * Default of #MooseStore:playlist-prefetch-budget (about 4 MiB of songs).
+ */
+#define MOOSE_STORE_PREFETCH_BUDGET (1024 * 1024)
+
+/**
+ * MOOSE_STORE_UPDATE_DEBOUNCE:
+ *
+ * Default of #MooseStore:update-debounce in milliseconds.
+ */
+#define MOOSE_STORE_UPDATE_DEBOUNCE 100
+
 /*
  * Type macros.
  */
@@ -127,11 +148,33 @@ long moose_store_playlist_query(MooseStore *self, MoosePlaylist *stack,
  *
  * List a directory in MPD's database.
  *
+ * In hybrid mode (see #MooseStore:hybrid) the directory is listed by the
+ * server and @depth is ignored; songs are returned as "0:uri" then.
+ *
  * Returns: A job id which you can call moose_store_wait_for_job on.
  */
 long moose_store_query_directories(MooseStore *self, MoosePlaylist *stack,
                                    const char *directory, int depth);
 
+/**
+ * moose_store_list_directory:
+ * @self: the store to operate on.
+ * @directory: (nullable): path of the directory to list. (NULL == '/')
+ * @depth: levels below @directory to list, 1 for its direct children, -1 for all.
+ * @songs: a stack to append the songs to.
+ * @directories: (element-type utf8): an array to append the paths of the
+ *               directories to. Do not free them; like the songs they stay
+ *               valid until the database changes.
+ *
+ * Browse the music directory through an index kept in memory.
+ * Unlike moose_store_query_directories() @directory is a path, not a pattern,
+ * and nothing needs to be split up. Returns nothing in hybrid or queue-only mode.
+ *
+ * Returns: A job id which you can call moose_store_wait_for_job on.
+ */
+long moose_store_list_directory(MooseStore *self, const char *directory, int depth,
+                                MoosePlaylist *songs, GPtrArray *directories);
+
 /**
  * moose_store_query:
  * @self: a #MooseStore
@@ -142,6 +185,10 @@ long moose_store_query_directories(MooseStore *self, MoosePlaylist *stack,
  *
  * Search the Queue or the whole Database.
  * Direclty after calling this function you will have no results yet in the stack.
+ *
+ * In hybrid mode (see #MooseStore:hybrid) the whole database is searched by the
+ * server, which only understands tags, words and "quoted phrases" of the query
+ * syntax. The found songs are kept alive by @stack then.
  * You should call moose_store_wait_for_job() to wait for it to be filled.
  *
  * Example:
@@ -213,9 +260,7 @@ MoosePlaylist *moose_store_gw(MooseStore *self, int job_id);
  * Find a song by it's ID in the database.
  *
  * This is often used and therefore implemented for convienience/speed in C.
- * Note: This has linear complexity since it needs to scan the whole list.
- *
- * TODO: Can this be more efficient?
+ * The lookup uses an index of the queue ids, so it is constant time.
  *
  * Returns: (transfer full): NULL if not found or a mpd_song struct (do not free!)
  */
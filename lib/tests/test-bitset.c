@@ -0,0 +1,78 @@
+#include <glib.h>
+#include "../moose-api.h"
+#include "../store/moose-store-bitset-private.h"
+
+static void test_bitset_empty(void) {
+    MooseStoreBitset *set = moose_store_bitset_new(0);
+    g_assert(moose_store_bitset_next(set, 0) == -1);
+    g_assert(moose_store_bitset_contains(set, 0) == FALSE);
+
+    /* Out of range, must be ignored */
+    moose_store_bitset_add(set, 0);
+    g_assert(moose_store_bitset_next(set, 0) == -1);
+    moose_store_bitset_free(set);
+}
+
+static void test_bitset_next_word_boundaries(void) {
+    /* Three words, the last one only partly used */
+    MooseStoreBitset *set = moose_store_bitset_new(130);
+    const unsigned indices[] = {0, 63, 64, 127, 129};
+
+    for(unsigned i = 0; i < G_N_ELEMENTS(indices); ++i) {
+        moose_store_bitset_add(set, indices[i]);
+    }
+
+    /* Iterating yields them in order, nothing else */
+    unsigned n_seen = 0;
+    for(int i = moose_store_bitset_next(set, 0); i >= 0;
+        i = moose_store_bitset_next(set, i + 1)) {
+        g_assert_cmpuint(n_seen, <, G_N_ELEMENTS(indices));
+        g_assert_cmpint(i, ==, indices[n_seen++]);
+    }
+    g_assert_cmpuint(n_seen, ==, G_N_ELEMENTS(indices));
+
+    /* Starting in the middle of a word, or at its last bit */
+    g_assert_cmpint(moose_store_bitset_next(set, 1), ==, 63);
+    g_assert_cmpint(moose_store_bitset_next(set, 63), ==, 63);
+    g_assert_cmpint(moose_store_bitset_next(set, 65), ==, 127);
+    g_assert_cmpint(moose_store_bitset_next(set, 128), ==, 129);
+    g_assert_cmpint(moose_store_bitset_next(set, 130), ==, -1);
+    g_assert_cmpint(moose_store_bitset_next(set, G_MAXUINT), ==, -1);
+
+    g_assert(moose_store_bitset_contains(set, 64));
+    g_assert(moose_store_bitset_contains(set, 65) == FALSE);
+    moose_store_bitset_free(set);
+}
+
+static void test_bitset_tail(void) {
+    /* Bits behind the size stay unset, so next() never reports them */
+    MooseStoreBitset *set = moose_store_bitset_new(70);
+    moose_store_bitset_add(set, 70);
+    moose_store_bitset_add(set, 127);
+    g_assert(moose_store_bitset_contains(set, 70) == FALSE);
+    g_assert_cmpint(moose_store_bitset_next(set, 0), ==, -1);
+
+    moose_store_bitset_add(set, 69);
+    g_assert_cmpint(moose_store_bitset_next(set, 0), ==, 69);
+    g_assert_cmpint(moose_store_bitset_next(set, 70), ==, -1);
+    moose_store_bitset_free(set);
+}
+
+static void test_bitset_skips_empty_words(void) {
+    MooseStoreBitset *set = moose_store_bitset_new(500000);
+    moose_store_bitset_add(set, 499999);
+    g_assert_cmpint(moose_store_bitset_next(set, 0), ==, 499999);
+    g_assert_cmpint(moose_store_bitset_next(set, 499999), ==, 499999);
+    moose_store_bitset_free(set);
+}
+
+int main(int argc, char **argv) {
+    moose_debug_install_handler();
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/store/bitset/empty", test_bitset_empty);
+    g_test_add_func("/store/bitset/next_word_boundaries",
+                    test_bitset_next_word_boundaries);
+    g_test_add_func("/store/bitset/tail", test_bitset_tail);
+    g_test_add_func("/store/bitset/skips_empty_words", test_bitset_skips_empty_words);
+    return g_test_run();
+}
@@ -0,0 +1,131 @@
+#include <glib.h>
+#include "../moose-api.h"
+#include "../mpd/moose-song-private.h"
+#include "../store/moose-store-dir-tree-private.h"
+
+static const char *SONG_URIS[] = {"root.mp3", "a/1.mp3", "a/b/2.mp3", "a/b/c/3.mp3",
+                                  "x/y/4.mp3"};
+
+/* x and x/y are only known by the song in them */
+static const char *DIR_PATHS[] = {"a", "a/b", "a/b/c", "empty", "z"};
+
+static MoosePlaylist *SONGS = NULL;
+static MooseStoreDirTree *TREE = NULL;
+
+static void setup(void) {
+    SONGS = moose_playlist_new_full(G_N_ELEMENTS(SONG_URIS),
+                                    (GDestroyNotify)moose_song_unref);
+
+    for(unsigned i = 0; i < G_N_ELEMENTS(SONG_URIS); ++i) {
+        MooseSong *song = moose_song_new();
+        moose_song_set_uri(song, SONG_URIS[i]);
+        moose_playlist_append(SONGS, song);
+    }
+
+    GPtrArray *dirs = g_ptr_array_new();
+    for(unsigned i = 0; i < G_N_ELEMENTS(DIR_PATHS); ++i) {
+        g_ptr_array_add(dirs, (char *)DIR_PATHS[i]);
+    }
+
+    TREE = moose_store_dir_tree_new(SONGS, dirs);
+    g_ptr_array_unref(dirs);
+}
+
+static void teardown(void) {
+    moose_store_dir_tree_free(TREE);
+    g_object_unref(SONGS);
+}
+
+/* List directory and compare with the expected, comma separated, entries */
+static void check_list(const char *directory, int depth, int expected_rc,
+                       const char *expected_dirs, const char *expected_songs) {
+    MoosePlaylist *out_songs = moose_playlist_new();
+    GPtrArray *out_dirs = g_ptr_array_new();
+
+    int rc =
+        moose_store_dir_tree_list(TREE, SONGS, directory, depth, out_songs, out_dirs);
+    g_assert_cmpint(rc, ==, expected_rc);
+
+    GString *dirs = g_string_new(NULL);
+    for(unsigned i = 0; i < out_dirs->len; ++i) {
+        g_string_append_printf(dirs, "%s%s", (i) ? "," : "",
+                               (char *)g_ptr_array_index(out_dirs, i));
+    }
+
+    GString *songs = g_string_new(NULL);
+    for(unsigned i = 0; i < moose_playlist_length(out_songs); ++i) {
+        g_string_append_printf(songs, "%s%s", (i) ? "," : "",
+                               moose_song_get_uri(moose_playlist_at(out_songs, i)));
+    }
+
+    g_assert_cmpstr(dirs->str, ==, expected_dirs);
+    g_assert_cmpstr(songs->str, ==, expected_songs);
+
+    g_string_free(dirs, TRUE);
+    g_string_free(songs, TRUE);
+    g_ptr_array_unref(out_dirs);
+    g_object_unref(out_songs);
+}
+
+static void test_dir_tree_root(void) {
+    setup();
+
+    /* NULL, "" and "/" are all the root */
+    check_list(NULL, 1, 5, "a,empty,x,z", "root.mp3");
+    check_list("", 1, 5, "a,empty,x,z", "root.mp3");
+    check_list("/", 1, 5, "a,empty,x,z", "root.mp3");
+
+    teardown();
+}
+
+static void test_dir_tree_depth(void) {
+    setup();
+
+    check_list("a", 0, 0, "", "");
+    check_list("a", 1, 2, "a/b", "a/1.mp3");
+    check_list("a", 2, 4, "a/b,a/b/c", "a/b/2.mp3,a/1.mp3");
+    check_list("a", 3, 5, "a/b,a/b/c", "a/b/c/3.mp3,a/b/2.mp3,a/1.mp3");
+
+    /* Deeper than the tree and negative depths list everything */
+    check_list("a", 10, 5, "a/b,a/b/c", "a/b/c/3.mp3,a/b/2.mp3,a/1.mp3");
+    check_list("a", -1, 5, "a/b,a/b/c", "a/b/c/3.mp3,a/b/2.mp3,a/1.mp3");
+    check_list(NULL, -1, 12, "a,a/b,a/b/c,empty,x,x/y,z",
+               "a/b/c/3.mp3,a/b/2.mp3,a/1.mp3,x/y/4.mp3,root.mp3");
+
+    teardown();
+}
+
+static void test_dir_tree_slashes(void) {
+    setup();
+
+    /* Leading and trailing slashes are ignored */
+    check_list("/a", 1, 2, "a/b", "a/1.mp3");
+    check_list("a/", 1, 2, "a/b", "a/1.mp3");
+    check_list("//a//", 1, 2, "a/b", "a/1.mp3");
+    check_list("/a/b/", 1, 2, "a/b/c", "a/b/2.mp3");
+
+    teardown();
+}
+
+static void test_dir_tree_missing(void) {
+    setup();
+
+    check_list("nope", 1, -1, "", "");
+    check_list("a/b/c/3.mp3", 1, -1, "", "");
+
+    /* Known, but without anything in it */
+    check_list("empty", -1, 0, "", "");
+    check_list("x", 1, 1, "x/y", "");
+
+    teardown();
+}
+
+int main(int argc, char **argv) {
+    moose_debug_install_handler();
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/store/dir_tree/root", test_dir_tree_root);
+    g_test_add_func("/store/dir_tree/depth", test_dir_tree_depth);
+    g_test_add_func("/store/dir_tree/slashes", test_dir_tree_slashes);
+    g_test_add_func("/store/dir_tree/missing", test_dir_tree_missing);
+    return g_test_run();
+}
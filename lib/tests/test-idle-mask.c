@@ -0,0 +1,41 @@
+#include <glib.h>
+#include "../moose-api.h"
+
+/* Events the client needs for its MooseStatus */
+static const MooseIdle STATUS_EVENTS = MOOSE_IDLE_PLAYER | MOOSE_IDLE_MIXER |
+                                       MOOSE_IDLE_OPTIONS | MOOSE_IDLE_OUTPUT |
+                                       MOOSE_IDLE_SEEK;
+
+static void test_idle_mask_unsubscribed(void) {
+    MooseClient *client = moose_client_new(MOOSE_PROTOCOL_IDLE);
+    g_assert(moose_client_get_idle_mask(client) == MOOSE_IDLE_ALL);
+    moose_client_unref(client);
+}
+
+static void test_idle_mask_store_subscription(void) {
+    MooseClient *client = moose_client_new(MOOSE_PROTOCOL_IDLE);
+
+    /* What a MooseStore subscribes to */
+    guint id = moose_client_subscribe(
+        client, MOOSE_IDLE_DATABASE | MOOSE_IDLE_QUEUE | MOOSE_IDLE_STORED_PLAYLIST);
+
+    MooseIdle mask = moose_client_get_idle_mask(client);
+    g_assert((mask & STATUS_EVENTS) == STATUS_EVENTS);
+    g_assert(mask & MOOSE_IDLE_STORED_PLAYLIST);
+
+    /* Nobody is interested in those */
+    g_assert((mask & MOOSE_IDLE_STICKER) == 0);
+    g_assert((mask & MOOSE_IDLE_MESSAGE) == 0);
+
+    moose_client_unsubscribe(client, id);
+    g_assert(moose_client_get_idle_mask(client) == MOOSE_IDLE_ALL);
+    moose_client_unref(client);
+}
+
+int main(int argc, char **argv) {
+    moose_debug_install_handler();
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/mpd/client/idle_mask", test_idle_mask_unsubscribed);
+    g_test_add_func("/mpd/client/idle_mask_store", test_idle_mask_store_subscription);
+    return g_test_run();
+}
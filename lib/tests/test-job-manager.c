@@ -21,9 +21,180 @@ static void test_launch_job_manager(void) {
     moose_job_manager_unref(self);
 }
 
+static gpointer _on_execute_many(G_GNUC_UNUSED MooseJobManager *self,
+                                 G_GNUC_UNUSED volatile gboolean *cancel,
+                                 void *job_data, G_GNUC_UNUSED gpointer user_data) {
+    g_usleep(1000);
+    return job_data;
+}
+
+static void test_workers_job_manager(void) {
+    MooseJobManager *self = moose_job_manager_new_full(4, 1000);
+    g_signal_connect(self, "dispatch", G_CALLBACK(_on_execute_many), self);
+
+    long job_ids[64];
+    for(int i = 0; i < 64; ++i) {
+        job_ids[i] = moose_job_manager_send(self, i % 3, GINT_TO_POINTER(i + 1));
+    }
+
+    moose_job_manager_wait(self);
+    for(int i = 0; i < 64; ++i) {
+        moose_job_manager_wait_for_id(self, job_ids[i]);
+        void *result = moose_job_manager_get_result(self, job_ids[i]);
+        g_assert(result == GINT_TO_POINTER(i + 1));
+
+        /* Results are handed out only once */
+        g_assert(moose_job_manager_get_result(self, job_ids[i]) == NULL);
+    }
+
+    moose_job_manager_unref(self);
+}
+
+/* Counts the results passed to the free func */
+static int N_FREED = 0;
+
+static void _on_free_result(G_GNUC_UNUSED gpointer result) {
+    g_atomic_int_inc(&N_FREED);
+}
+
+static void test_result_ttl_job_manager(void) {
+    MooseJobManager *self = moose_job_manager_new_full(1, 10);
+    moose_job_manager_set_result_free_func(self, _on_free_result);
+    g_signal_connect(self, "dispatch", G_CALLBACK(_on_execute_many), self);
+    N_FREED = 0;
+
+    long old_id = moose_job_manager_send(self, 0, GINT_TO_POINTER(1));
+    moose_job_manager_wait_for_id(self, old_id);
+    g_usleep(50 * 1000);
+
+    /* Finishing the next job forgets the expired result */
+    long new_id = moose_job_manager_send(self, 0, GINT_TO_POINTER(2));
+    moose_job_manager_wait_for_id(self, new_id);
+    g_assert(moose_job_manager_get_result(self, old_id) == NULL);
+    g_assert_cmpint(g_atomic_int_get(&N_FREED), ==, 1);
+
+    /* Retrieved results are not freed */
+    g_assert(moose_job_manager_get_result(self, new_id) == GINT_TO_POINTER(2));
+    moose_job_manager_unref(self);
+    g_assert_cmpint(g_atomic_int_get(&N_FREED), ==, 1);
+}
+
+static void test_result_ttl_zero_job_manager(void) {
+    MooseJobManager *self = moose_job_manager_new_full(1, 0);
+    moose_job_manager_set_result_free_func(self, _on_free_result);
+    g_signal_connect(self, "dispatch", G_CALLBACK(_on_execute_many), self);
+    N_FREED = 0;
+
+    long first_id = moose_job_manager_send(self, 0, GINT_TO_POINTER(1));
+    moose_job_manager_wait_for_id(self, first_id);
+    g_usleep(10 * 1000);
+
+    long second_id = moose_job_manager_send(self, 0, GINT_TO_POINTER(2));
+    moose_job_manager_wait_for_id(self, second_id);
+
+    /* Nothing expires; results not retrieved are freed on unref */
+    g_assert(moose_job_manager_get_result(self, first_id) == GINT_TO_POINTER(1));
+    g_assert_cmpint(g_atomic_int_get(&N_FREED), ==, 0);
+    moose_job_manager_unref(self);
+    g_assert_cmpint(g_atomic_int_get(&N_FREED), ==, 1);
+}
+
+/* Lets the first job block until the others are queued */
+static GMutex GATE_MUTEX;
+static GCond GATE_COND;
+static gboolean GATE_OPEN = FALSE;
+
+/* Order in which the job_data of the jobs was seen */
+static GArray *ORDER = NULL;
+
+static gpointer _on_execute_ordered(G_GNUC_UNUSED MooseJobManager *self,
+                                    G_GNUC_UNUSED volatile gboolean *cancel,
+                                    void *job_data, G_GNUC_UNUSED gpointer user_data) {
+    int value = GPOINTER_TO_INT(job_data);
+
+    g_mutex_lock(&GATE_MUTEX);
+    {
+        while(GATE_OPEN == FALSE) {
+            g_cond_wait(&GATE_COND, &GATE_MUTEX);
+        }
+        g_array_append_val(ORDER, value);
+    }
+    g_mutex_unlock(&GATE_MUTEX);
+
+    return job_data;
+}
+
+static void open_gate(void) {
+    g_mutex_lock(&GATE_MUTEX);
+    GATE_OPEN = TRUE;
+    g_cond_broadcast(&GATE_COND);
+    g_mutex_unlock(&GATE_MUTEX);
+}
+
+static void test_priority_job_manager(void) {
+    MooseJobManager *self = moose_job_manager_new_full(1, 1000);
+    g_signal_connect(self, "dispatch", G_CALLBACK(_on_execute_ordered), self);
+    ORDER = g_array_new(FALSE, FALSE, sizeof(int));
+    GATE_OPEN = FALSE;
+
+    /* Occupies the only worker while the others are queued */
+    moose_job_manager_send(self, -100, GINT_TO_POINTER(-100));
+    g_usleep(10 * 1000);
+
+    const int prios[] = {5, 1, 3, -2, 1, 4};
+    for(unsigned i = 0; i < G_N_ELEMENTS(prios); ++i) {
+        moose_job_manager_send(self, prios[i], GINT_TO_POINTER(prios[i]));
+    }
+
+    open_gate();
+    moose_job_manager_wait(self);
+
+    /* Small priorities first, equal ones in the order they were sent */
+    const int expected[] = {-100, -2, 1, 1, 3, 4, 5};
+    g_assert_cmpuint(ORDER->len, ==, G_N_ELEMENTS(expected));
+    for(unsigned i = 0; i < G_N_ELEMENTS(expected); ++i) {
+        g_assert_cmpint(g_array_index(ORDER, int, i), ==, expected[i]);
+    }
+
+    moose_job_manager_unref(self);
+    g_array_free(ORDER, TRUE);
+}
+
+static gpointer _open_gate_later(G_GNUC_UNUSED gpointer data) {
+    g_usleep(20 * 1000);
+    open_gate();
+    return NULL;
+}
+
+static void test_unref_runs_pending_job_manager(void) {
+    MooseJobManager *self = moose_job_manager_new_full(1, 1000);
+    g_signal_connect(self, "dispatch", G_CALLBACK(_on_execute_ordered), self);
+    ORDER = g_array_new(FALSE, FALSE, sizeof(int));
+    GATE_OPEN = FALSE;
+
+    for(int i = 0; i < 4; ++i) {
+        moose_job_manager_send(self, i, GINT_TO_POINTER(i));
+    }
+
+    /* The jobs are still blocked when the manager goes away */
+    GThread *opener = g_thread_new("opener", _open_gate_later, NULL);
+    moose_job_manager_unref(self);
+    g_thread_join(opener);
+
+    g_assert_cmpuint(ORDER->len, ==, 4);
+    g_array_free(ORDER, TRUE);
+}
+
 int main(int argc, char **argv) {
     moose_debug_install_handler();
     g_test_init(&argc, &argv, NULL);
     g_test_add_func("/misc/job_manager", test_launch_job_manager);
+    g_test_add_func("/misc/job_manager_workers", test_workers_job_manager);
+    g_test_add_func("/misc/job_manager_result_ttl", test_result_ttl_job_manager);
+    g_test_add_func("/misc/job_manager_result_ttl_zero",
+                    test_result_ttl_zero_job_manager);
+    g_test_add_func("/misc/job_manager_priority", test_priority_job_manager);
+    g_test_add_func("/misc/job_manager_unref_runs_pending",
+                    test_unref_runs_pending_job_manager);
     return g_test_run();
 }
@@ -0,0 +1,154 @@
+#include <glib.h>
+#include "../moose-api.h"
+#include "../misc/moose-misc-metrics-private.h"
+
+/* Nothing in this test process runs store queries, so it is ours */
+#define TEST_METRIC MOOSE_METRIC_STORE_QUERY
+#define TEST_METRIC_NAME "store.query"
+
+static GVariant *lookup_histogram(GVariant *snapshot) {
+    GVariant *histogram =
+        g_variant_lookup_value(snapshot, TEST_METRIC_NAME, G_VARIANT_TYPE_VARDICT);
+    g_assert(histogram != NULL);
+    return histogram;
+}
+
+static guint64 lookup_uint64(GVariant *histogram, const char *key) {
+    guint64 value = 0;
+    gboolean found = g_variant_lookup(histogram, key, "t", &value);
+    g_assert(found);
+    return value;
+}
+
+static guint64 lookup_bucket(GVariant *histogram, unsigned bucket) {
+    gsize n_buckets = 0;
+    GVariant *array = g_variant_lookup_value(histogram, "buckets", G_VARIANT_TYPE("at"));
+    const guint64 *buckets =
+        g_variant_get_fixed_array(array, &n_buckets, sizeof(guint64));
+
+    g_assert_cmpuint(bucket, <, n_buckets);
+    guint64 value = buckets[bucket];
+    g_variant_unref(array);
+    return value;
+}
+
+static void test_metrics_buckets(void) {
+    moose_metrics_reset();
+
+    /* Bucket i holds [2^(i-1), 2^i); 0 and negative durations go to bucket 0 */
+    moose_metrics_record(TEST_METRIC, 0);
+    moose_metrics_record(TEST_METRIC, -5);
+    moose_metrics_record(TEST_METRIC, 1);
+    moose_metrics_record(TEST_METRIC, 2);
+    moose_metrics_record(TEST_METRIC, 3);
+    moose_metrics_record(TEST_METRIC, 4);
+    moose_metrics_record(TEST_METRIC, 1023);
+    moose_metrics_record(TEST_METRIC, 1024);
+
+    /* Too large for any bucket, ends up in the last one */
+    moose_metrics_record(TEST_METRIC, G_GINT64_CONSTANT(1) << 50);
+
+    GVariant *snapshot = moose_metrics_snapshot();
+    GVariant *histogram = lookup_histogram(snapshot);
+
+    g_assert_cmpuint(lookup_uint64(histogram, "count"), ==, 9);
+    g_assert_cmpuint(lookup_uint64(histogram, "sum_us"), ==,
+                     1 + 2 + 3 + 4 + 1023 + 1024 + (G_GUINT64_CONSTANT(1) << 50));
+
+    g_assert_cmpuint(lookup_bucket(histogram, 0), ==, 2);
+    g_assert_cmpuint(lookup_bucket(histogram, 1), ==, 1);
+    g_assert_cmpuint(lookup_bucket(histogram, 2), ==, 2);
+    g_assert_cmpuint(lookup_bucket(histogram, 3), ==, 1);
+    g_assert_cmpuint(lookup_bucket(histogram, 10), ==, 1);
+    g_assert_cmpuint(lookup_bucket(histogram, 11), ==, 1);
+    g_assert_cmpuint(lookup_bucket(histogram, 39), ==, 1);
+    g_assert_cmpuint(lookup_uint64(histogram, "max_us"), ==, G_GUINT64_CONSTANT(1) << 39);
+
+    g_variant_unref(histogram);
+    g_variant_unref(snapshot);
+}
+
+static void test_metrics_percentiles(void) {
+    moose_metrics_reset();
+
+    /* 90 fast samples, 9 slower ones and a single outlier */
+    for(int i = 0; i < 90; ++i) {
+        moose_metrics_record(TEST_METRIC, 100);
+    }
+    for(int i = 0; i < 9; ++i) {
+        moose_metrics_record(TEST_METRIC, 1000);
+    }
+    moose_metrics_record(TEST_METRIC, 100000);
+
+    GVariant *snapshot = moose_metrics_snapshot();
+    GVariant *histogram = lookup_histogram(snapshot);
+
+    /* Percentiles report the upper bound of the bucket they fall into */
+    g_assert_cmpuint(lookup_uint64(histogram, "count"), ==, 100);
+    g_assert_cmpuint(lookup_uint64(histogram, "sum_us"), ==,
+                     90 * 100 + 9 * 1000 + 100000);
+    g_assert_cmpuint(lookup_uint64(histogram, "p50_us"), ==, 128);
+    g_assert_cmpuint(lookup_uint64(histogram, "p90_us"), ==, 128);
+    g_assert_cmpuint(lookup_uint64(histogram, "p99_us"), ==, 1024);
+    g_assert_cmpuint(lookup_uint64(histogram, "max_us"), ==, 131072);
+
+    g_variant_unref(histogram);
+    g_variant_unref(snapshot);
+}
+
+static void test_metrics_single_sample(void) {
+    moose_metrics_reset();
+    moose_metrics_record(TEST_METRIC, 5);
+
+    GVariant *snapshot = moose_metrics_snapshot();
+    GVariant *histogram = lookup_histogram(snapshot);
+
+    /* Every percentile is the only sample */
+    g_assert_cmpuint(lookup_uint64(histogram, "p50_us"), ==, 8);
+    g_assert_cmpuint(lookup_uint64(histogram, "p99_us"), ==, 8);
+    g_assert_cmpuint(lookup_uint64(histogram, "max_us"), ==, 8);
+
+    g_variant_unref(histogram);
+    g_variant_unref(snapshot);
+}
+
+static void test_metrics_counter_and_reset(void) {
+    moose_metrics_reset();
+    moose_metrics_count(MOOSE_METRIC_STORE_SONGS, 5);
+    moose_metrics_count(MOOSE_METRIC_STORE_SONGS, 7);
+    moose_metrics_record(TEST_METRIC, 10);
+
+    guint64 songs = 0;
+    GVariant *snapshot = moose_metrics_snapshot();
+    gboolean found = g_variant_lookup(snapshot, "store.songs", "t", &songs);
+    g_assert(found);
+    g_assert_cmpuint(songs, ==, 12);
+    g_variant_unref(snapshot);
+
+    moose_metrics_reset();
+    snapshot = moose_metrics_snapshot();
+    found = g_variant_lookup(snapshot, "store.songs", "t", &songs);
+    g_assert(found);
+    g_assert_cmpuint(songs, ==, 0);
+
+    /* Without samples there are no percentiles */
+    GVariant *histogram = lookup_histogram(snapshot);
+    g_assert_cmpuint(lookup_uint64(histogram, "count"), ==, 0);
+    g_assert_cmpuint(lookup_uint64(histogram, "sum_us"), ==, 0);
+    gboolean has_p50 = g_variant_lookup(histogram, "p50_us", "t", NULL);
+    gboolean has_max = g_variant_lookup(histogram, "max_us", "t", NULL);
+    g_assert(has_p50 == FALSE && has_max == FALSE);
+
+    g_variant_unref(histogram);
+    g_variant_unref(snapshot);
+}
+
+int main(int argc, char **argv) {
+    moose_debug_install_handler();
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/misc/metrics/buckets", test_metrics_buckets);
+    g_test_add_func("/misc/metrics/percentiles", test_metrics_percentiles);
+    g_test_add_func("/misc/metrics/single_sample", test_metrics_single_sample);
+    g_test_add_func("/misc/metrics/counter_and_reset", test_metrics_counter_and_reset);
+    return g_test_run();
+}
@@ -0,0 +1,213 @@
+#include <glib.h>
+#include <unistd.h>
+#include "../moose-api.h"
+#include "../misc/moose-misc-reactor-private.h"
+
+/* Shared between the test and the reactor thread */
+static GMutex MUTEX;
+static GCond COND;
+static int CALLS = 0;
+static gboolean IN_CALLBACK = FALSE;
+
+static void reset_calls(void) {
+    g_mutex_lock(&MUTEX);
+    CALLS = 0;
+    IN_CALLBACK = FALSE;
+    g_mutex_unlock(&MUTEX);
+}
+
+static void count_call(void) {
+    g_mutex_lock(&MUTEX);
+    CALLS++;
+    g_cond_broadcast(&COND);
+    g_mutex_unlock(&MUTEX);
+}
+
+/* Wait until the callbacks ran at least n times; FALSE on timeout */
+static gboolean wait_for_calls(int n) {
+    gint64 end_time = g_get_monotonic_time() + 5 * G_TIME_SPAN_SECOND;
+    gboolean reached = TRUE;
+
+    g_mutex_lock(&MUTEX);
+    while(CALLS < n && reached) {
+        reached = g_cond_wait_until(&COND, &MUTEX, end_time);
+    }
+    reached = CALLS >= n;
+    g_mutex_unlock(&MUTEX);
+
+    return reached;
+}
+
+static int get_calls(void) {
+    g_mutex_lock(&MUTEX);
+    int calls = CALLS;
+    g_mutex_unlock(&MUTEX);
+    return calls;
+}
+
+static gboolean timer_cb(G_GNUC_UNUSED MooseReactor *reactor, G_GNUC_UNUSED guint id,
+                         GIOCondition condition, G_GNUC_UNUSED gpointer user_data) {
+    g_assert(condition & G_IO_IN);
+    count_call();
+
+    /* Remove ourselves after the third time */
+    return get_calls() < 3;
+}
+
+static void test_reactor_timer(void) {
+    reset_calls();
+
+    MooseReactor *reactor = moose_reactor_ref_default();
+    moose_reactor_add_timer(reactor, 10, timer_cb, NULL);
+    g_assert(wait_for_calls(3));
+
+    /* Returning FALSE removed it */
+    g_usleep(50 * 1000);
+    g_assert_cmpint(get_calls(), ==, 3);
+    moose_reactor_unref(reactor);
+}
+
+static void test_reactor_set_timer(void) {
+    reset_calls();
+
+    MooseReactor *reactor = moose_reactor_ref_default();
+
+    /* Added disarmed, so nothing happens until it is set */
+    guint id = moose_reactor_add_timer(reactor, 0, timer_cb, NULL);
+    g_usleep(50 * 1000);
+    g_assert_cmpint(get_calls(), ==, 0);
+
+    moose_reactor_set_timer(reactor, id, 10);
+    g_assert(wait_for_calls(1));
+
+    moose_reactor_remove(reactor, id);
+    moose_reactor_unref(reactor);
+}
+
+static gboolean read_cb(G_GNUC_UNUSED MooseReactor *reactor, G_GNUC_UNUSED guint id,
+                        GIOCondition condition, gpointer user_data) {
+    int fd = GPOINTER_TO_INT(user_data);
+    char byte = 0;
+
+    g_assert(condition & G_IO_IN);
+    ssize_t n_read = read(fd, &byte, 1);
+    g_assert(n_read == 1 && byte == 'x');
+    count_call();
+    return TRUE;
+}
+
+static void test_reactor_fd(void) {
+    reset_calls();
+
+    int fds[2];
+    int rc = pipe(fds);
+    g_assert(rc == 0);
+
+    MooseReactor *reactor = moose_reactor_ref_default();
+    guint id = moose_reactor_add_fd(reactor, fds[0], G_IO_IN, read_cb,
+                                    GINT_TO_POINTER(fds[0]));
+    g_assert(id != 0);
+
+    for(int i = 1; i <= 3; ++i) {
+        ssize_t n_written = write(fds[1], "x", 1);
+        g_assert(n_written == 1);
+        g_assert(wait_for_calls(i));
+    }
+
+    moose_reactor_remove(reactor, id);
+    moose_reactor_unref(reactor);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static gboolean hangup_cb(MooseReactor *reactor, guint id, GIOCondition condition,
+                          G_GNUC_UNUSED gpointer user_data) {
+    g_assert(condition & G_IO_HUP);
+
+    /* Pause; the hangup must not be reported over and over again */
+    moose_reactor_modify_fd(reactor, id, 0);
+    count_call();
+    return TRUE;
+}
+
+static void test_reactor_pause_hangup(void) {
+    reset_calls();
+
+    int fds[2];
+    int rc = pipe(fds);
+    g_assert(rc == 0);
+
+    MooseReactor *reactor = moose_reactor_ref_default();
+    guint id = moose_reactor_add_fd(reactor, fds[0], G_IO_IN, hangup_cb, NULL);
+
+    close(fds[1]);
+    g_assert(wait_for_calls(1));
+    g_usleep(50 * 1000);
+    g_assert_cmpint(get_calls(), ==, 1);
+
+    /* Resuming reports it again */
+    moose_reactor_modify_fd(reactor, id, G_IO_IN);
+    g_assert(wait_for_calls(2));
+
+    moose_reactor_remove(reactor, id);
+    moose_reactor_unref(reactor);
+    close(fds[0]);
+}
+
+static gboolean slow_cb(G_GNUC_UNUSED MooseReactor *reactor, G_GNUC_UNUSED guint id,
+                        G_GNUC_UNUSED GIOCondition condition,
+                        G_GNUC_UNUSED gpointer user_data) {
+    g_mutex_lock(&MUTEX);
+    IN_CALLBACK = TRUE;
+    g_cond_broadcast(&COND);
+    g_mutex_unlock(&MUTEX);
+
+    g_usleep(100 * 1000);
+
+    g_mutex_lock(&MUTEX);
+    IN_CALLBACK = FALSE;
+    g_mutex_unlock(&MUTEX);
+
+    count_call();
+    return TRUE;
+}
+
+static void test_reactor_remove_while_dispatching(void) {
+    reset_calls();
+
+    MooseReactor *reactor = moose_reactor_ref_default();
+    guint id = moose_reactor_add_timer(reactor, 10, slow_cb, NULL);
+
+    /* Wait till the callback is running */
+    g_mutex_lock(&MUTEX);
+    while(IN_CALLBACK == FALSE) {
+        g_cond_wait(&COND, &MUTEX);
+    }
+    g_mutex_unlock(&MUTEX);
+
+    /* Has to wait for the callback to return */
+    moose_reactor_remove(reactor, id);
+
+    g_mutex_lock(&MUTEX);
+    g_assert(IN_CALLBACK == FALSE);
+    int calls = CALLS;
+    g_mutex_unlock(&MUTEX);
+
+    /* And it is not called anymore */
+    g_usleep(50 * 1000);
+    g_assert_cmpint(get_calls(), ==, calls);
+
+    moose_reactor_unref(reactor);
+}
+
+int main(int argc, char **argv) {
+    moose_debug_install_handler();
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/misc/reactor/timer", test_reactor_timer);
+    g_test_add_func("/misc/reactor/set_timer", test_reactor_set_timer);
+    g_test_add_func("/misc/reactor/fd", test_reactor_fd);
+    g_test_add_func("/misc/reactor/pause_hangup", test_reactor_pause_hangup);
+    g_test_add_func("/misc/reactor/remove_while_dispatching",
+                    test_reactor_remove_while_dispatching);
+    return g_test_run();
+}
@@ -14,50 +14,32 @@ from gi.repository import GLib
 class Heartbeat:
     '''Count the elapsed song time without querying MPD.
 
-    It simply looks for signals and calculates the current song position on
-    accessing ``elapsed``.
-
-    .. note::
-
-        For pedantics: Heartbeat assumes it was instanced near to a status
-        update.  If the last update was long ago it will return slightly wrong
-        results till next update. You will likely never notice in reality.
+    The elapsed time is interpolated by libmoosecat itself
+    (see ``Status.get_elapsed_ms_interpolated``), the listened counter is
+    updated on every client-event. Nothing is polled.
 
     :client: A Client object.
     '''
     def __init__(self, client, use_listened_counter=True):
         self._client = client
         self._last_song_queue_pos = -1
-        self._last_update_tmstp = self._current_time_ms()
+        self._use_listened_counter = use_listened_counter
 
-        self._interval = 200
         self._curr_listened = self._last_listened = self._last_duration = 0.0
+        self._last_tick = self._current_time_ms()
+        self._is_playing = False
 
         self._client.connect(
             'client-event',
             self._on_client_event,
         )
 
-        if use_listened_counter:
-            self._last_tick = self._current_time_ms()
-            GLib.timeout_add(self._interval, self._on_poll_elapsed)
-
-    def _on_poll_elapsed(self):
-        'Update every timeslice the player is running a counter'
-        if not self._client.is_connected:
-            return 0.0
-
-        now = self._current_time_ms()
-        with self._client.reffed_status() as status:
-            if status is not None and status.get_state() is Moose.State.PLAY:
-                self._curr_listened += now - self._last_tick
-
-        with self._client.reffed_current_song() as song:
-            if song is not None:
-                self._last_duration = song.get_duration()
-
-        self._last_tick = now
-        return True
+    def _listened_ms(self):
+        'Listened milliseconds, including the currently running stretch'
+        listened = self._curr_listened
+        if self._is_playing:
+            listened += self._current_time_ms() - self._last_tick
+        return listened
 
     @property
     def currently_listened_percent(self):
@@ -67,7 +49,7 @@ class Heartbeat:
         more than 100 percent is possible (imagine listening the whole song
         and skipping back to the beginning).
         '''
-        secs = self._curr_listened / (1000 / self._interval * self._interval)
+        secs = self._listened_ms() / 1000
         duration = self._last_duration
         if duration != 0.0:
             return secs / duration
@@ -93,12 +75,7 @@ class Heartbeat:
         elapsed = 0
         with self._client.reffed_status() as status:
             if status is not None:
-                if status.get_state() is Moose.State.PLAY:
-                    offset = self._current_time_ms() - self._last_update_tmstp
-                else:
-                    offset = 0
-
-            elapsed = (status.get_elapsed_ms() + offset) / 1000.0
+                elapsed = status.get_elapsed_ms_interpolated() / 1000.0
         return elapsed
 
     @property
@@ -128,21 +105,32 @@ class Heartbeat:
         return 0
 
     def _on_client_event(self, client, event):
-        'client-event callback - updates the update timestamp'
-        if not event & (Moose.Idle.IDLE_PLAYER | Moose.Idle.IDLE_SEEK):
-            return
-
-        song_queue_pos = -1
-        with client.reffed_current_song() as song:
-            if song is not None:
-                song_queue_pos = song.get_pos()
-
-        if self._last_song_queue_pos != song_queue_pos:
-            self._last_listened = self.currently_listened_percent
-            self._curr_listened = self.elapsed * 1000.0
-            self._last_song_queue_pos = song_queue_pos
-
-        self._last_update_tmstp = self._current_time_ms()
+        'client-event callback - updates the listened counter'
+        if self._use_listened_counter:
+            now = self._current_time_ms()
+            if self._is_playing:
+                self._curr_listened += now - self._last_tick
+            self._last_tick = now
+
+        if event & (Moose.Idle.IDLE_PLAYER | Moose.Idle.IDLE_SEEK):
+            song_queue_pos = -1
+            with client.reffed_current_song() as song:
+                if song is not None:
+                    song_queue_pos = song.get_pos()
+
+            if self._last_song_queue_pos != song_queue_pos:
+                self._last_listened = self.currently_listened_percent
+                self._curr_listened = self.elapsed * 1000.0
+                self._last_song_queue_pos = song_queue_pos
+
+        if self._use_listened_counter:
+            with client.reffed_status() as status:
+                self._is_playing = \
+                    status is not None and status.get_state() is Moose.State.PLAY
+
+            with client.reffed_current_song() as song:
+                if song is not None:
+                    self._last_duration = song.get_duration()
 
     def _current_time_ms(self):
         return time() * 1000